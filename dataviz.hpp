@@ -32,7 +32,173 @@ struct dataviz_vertex
 
 typedef dataviz_vertex dataviz_vertex_z;
 
+/** @brief A vertex with a surface normal, rendered as a small lit disk.
+ *
+ * @details The normal is stored with octahedron encoding, as two signed normalized 16-bit values.
+ *          Use @ref datviz_pack_normal or @ref datviz_make_surfels to fill it in.
+ * */
+struct dataviz_surfel_vertex
+{
+  /** The X position coordinate of the vertex. */
+  float x;
+  /** The Y position coordinate of the vertex. */
+  float y;
+  /** The Z position coordinate of the vertex. */
+  float z;
+  /** The red channel value of the vertex. */
+  unsigned char r;
+  /** The green channel value of the vertex. */
+  unsigned char g;
+  /** The blue channel value of the vertex. */
+  unsigned char b;
+  /** The alpha channel value of the vertex. */
+  unsigned char a;
+  /** The octahedron encoded unit normal of the vertex. */
+  int16_t normal[2];
+};
+
+typedef dataviz_surfel_vertex dataviz_surfel_vertex_z;
+
+/** @brief An oriented box, such as the output of an object detector.
+ * */
+struct dataviz_box
+{
+  /** The position of the center of the box. */
+  float center[3];
+  /** The full size of the box along each of its local axes. */
+  float extent[3];
+  /** The orientation of the box, as a unit quaternion in X, Y, Z, W order. */
+  float rotation[4];
+  /** The red channel value of the box edges. */
+  unsigned char r;
+  /** The green channel value of the box edges. */
+  unsigned char g;
+  /** The blue channel value of the box edges. */
+  unsigned char b;
+  /** The alpha channel value of the box edges. */
+  unsigned char a;
+};
+
+typedef dataviz_box dataviz_box_z;
+
+/** @brief A line of text that is drawn at a position in the scene.
+ * */
+struct dataviz_label
+{
+  /** The position that the label is anchored to. The baseline of the first line of text starts here. */
+  float position[3];
+  /** The null terminated ASCII text of the label. A newline starts a new line below the previous one. */
+  const char* text;
+  /** The height of a capital letter, in pixels. */
+  float size;
+  /** The red channel value of the text. */
+  unsigned char r;
+  /** The green channel value of the text. */
+  unsigned char g;
+  /** The blue channel value of the text. */
+  unsigned char b;
+  /** The alpha channel value of the text. */
+  unsigned char a;
+};
+
+typedef dataviz_label dataviz_label_z;
+
+/** @brief Points stored as separate columns, such as the columns of a table or the axes of a strided array.
+ *
+ * @details Each column is read with its own stride, so the columns may be separate arrays or interleaved in one.
+ * */
+struct dataviz_point_columns
+{
+  /** The X position coordinates. */
+  const float* x;
+  /** The Y position coordinates. */
+  const float* y;
+  /** The Z position coordinates. */
+  const float* z;
+  /** The colors, as four bytes in red, green, blue, alpha order. If this is null, the points are opaque white. */
+  const unsigned char* rgba;
+  /** The number of bytes from one X coordinate to the next, or zero if they are tightly packed. */
+  uint32_t x_stride;
+  /** The number of bytes from one Y coordinate to the next, or zero if they are tightly packed. */
+  uint32_t y_stride;
+  /** The number of bytes from one Z coordinate to the next, or zero if they are tightly packed. */
+  uint32_t z_stride;
+  /** The number of bytes from one color to the next, or zero if they are tightly packed. */
+  uint32_t rgba_stride;
+};
+
+typedef dataviz_point_columns dataviz_point_columns_z;
+
+/** @brief Measurements of the last frame that was displayed.
+ * */
+struct dataviz_frame_stats
+{
+  /** The time from the end of the frame before to the end of this one, in milliseconds. */
+  float frame_time_ms;
+  /** The frame rate, averaged over the last 120 frames. */
+  float frames_per_second;
+  /** The number of points that were drawn, counting every draw of a point. */
+  uint64_t points_drawn;
+  /** The number of points of retained clouds and maps that were skipped, for being outside of a slab or out of view. */
+  uint64_t points_culled;
+  /** The number of draw calls made by the library. */
+  uint32_t draw_calls;
+  /** The rate at which vertex data was uploaded to the GPU during the frame, in megabytes per second. */
+  float upload_megabytes_per_second;
+  /** The GPU memory held by the buffers of retained clouds, maps, voxels and lines, including the spare ones. */
+  uint64_t gpu_memory_bytes;
+  /** The number of GL calls made during the frame. Zero unless the library is built with DATAVIZ_GL_INSTRUMENTATION. */
+  uint32_t gl_calls;
+  /** The bytes passed to buffer and texture uploads during the frame. Zero unless the library is built with
+   * DATAVIZ_GL_INSTRUMENTATION. Unlike the upload rate, this covers every upload, including textures and the ones
+   * made to recycle buffers. */
+  uint64_t gl_upload_bytes;
+};
+
+typedef dataviz_frame_stats dataviz_frame_stats_z;
+
+/** @brief The calls made to one GL entry point during a frame.
+ * */
+struct dataviz_gl_call_stats
+{
+  /** The name of the entry point, such as "glBufferData". It stays valid until the library is unloaded. */
+  const char* name;
+  /** The number of times that the entry point was called. */
+  uint32_t calls;
+  /** The bytes passed to the entry point, for the ones that upload buffers or textures. */
+  uint64_t bytes;
+};
+
+typedef dataviz_gl_call_stats dataviz_gl_call_stats_z;
+
+/** @brief The color maps that scalar values can be mapped through.
+ * */
+enum datviz_colormap
+{
+  /** Perceptually uniform, from dark purple to yellow. */
+  DATVIZ_COLORMAP_VIRIDIS = 0,
+  /** Perceptually uniform, from black through red to pale yellow. */
+  DATVIZ_COLORMAP_INFERNO = 1,
+  /** A rainbow map with smooth steps in lightness, from dark blue to dark red. */
+  DATVIZ_COLORMAP_TURBO = 2,
+  /** From black to white. */
+  DATVIZ_COLORMAP_GRAYSCALE = 3
+};
+
+/** @brief The ways that points can be rendered.
+ * */
+enum datviz_render_mode
+{
+  /** Each point is drawn with its own color. */
+  DATVIZ_RENDER_MODE_POINTS = 0,
+  /** The number of points that land on each pixel is counted, and the counts are drawn through a color map. */
+  DATVIZ_RENDER_MODE_DENSITY = 1
+};
+
 /** @brief Initializes global resources used by the library.
+ *
+ * @details If the DATAVIZ_CAPTURE environment variable holds a path, a capture of every following call is started,
+ *          as if by @ref datviz_capture_begin. It is compressed if the library was built with zlib.
  *
  * @return Zero on success, non-zero on failure.
  * */
@@ -40,10 +206,72 @@ int
 datviz_global_init(void);
 
 /** @brief Releases global resources used by the library.
+ *
+ * @details A capture that is still running is ended first.
  * */
 void
 datviz_global_cleanup(void);
 
+/** @brief The type of the function that runs a task of the library.
+ *
+ * @param task The task to run, as it was passed to the executor.
+ * */
+typedef void (*datviz_task_callback)(void* task);
+
+/** @brief The type of the callback that hands a task of the library to an executor.
+ *
+ * @param user_data The pointer from the executor.
+ *
+ * @param run The function to call, on any thread, with @p task.
+ *
+ * @param task The task to run. It must be run exactly once, and it holds on to whatever the task needs, so it is safe
+ *             to run long after the work that it belongs to has finished.
+ * */
+typedef void (*datviz_submit_callback)(void* user_data, datviz_task_callback run, void* task);
+
+/** @brief An executor that runs the parallel work of the library, such as sorting, filtering and building maps.
+ * */
+struct dataviz_executor
+{
+  /** Hands a task to the executor. This must not wait for the task to finish. */
+  datviz_submit_callback submit;
+  /** Passed to the submit callback. */
+  void* user_data;
+  /** The number of threads that the executor runs tasks on, which decides how many tasks work is split into. */
+  uint32_t concurrency;
+};
+
+typedef dataviz_executor dataviz_executor_z;
+
+/** @brief Sets the executor that the library runs its parallel work on.
+ *
+ * @details By default, the library runs its work on a work-stealing thread pool of its own, which is started the
+ *          first time that it is needed. Applications that already have a pool, such as one from TBB, can hand the
+ *          work to it instead, so that the two do not compete for the same cores.
+ *
+ *          The thread that starts a piece of work always takes part in it, and runs the tasks that the executor has not
+ *          started yet by the time it needs them done. So the library never waits on an executor that is busy, and
+ *          an executor that runs tasks late, or on the thread that submits them, only costs parallelism.
+ *
+ *          This must not be called while the library is working on another thread.
+ *
+ * @param executor The executor to use, which is copied. May be null, in which case the library goes back to its own
+ *                 thread pool.
+ * */
+void
+datviz_set_executor(const dataviz_executor* executor);
+
+/** @brief Sets the number of threads of the thread pool of the library, counting the thread that starts the work.
+ *
+ * @details This has no effect while an executor is set with @ref datviz_set_executor. The pool is restarted with the
+ *          new size the next time that it is needed, and it must not be called while the library is working.
+ *
+ * @param thread_count The number of threads to use, or zero to use one per hardware thread, which is the default.
+ *                     One runs all work on the thread that starts it.
+ * */
+void
+datviz_set_thread_count(uint32_t thread_count);
+
 /** @brief The type of the callback used for logging information.
  * */
 typedef void (*datviz_logger_callback)(void* user_data, const char* message_data, uint32_t message_size);
@@ -92,6 +320,31 @@ datviz_add_logger(datviz_z* viz, void* logger_data, datviz_logger_callback callb
 void
 datviz_set_window_title(datviz_z* viz, const char* title);
 
+/** @brief Shows or hides the window.
+ *
+ * @details Hidden windows are still rendered to, which is useful for benchmarks and replays that should not take over
+ *          the screen. Windows are visible by default. Calling this before the first frame keeps a hidden window from
+ *          ever appearing.
+ *
+ * @param viz The viewer to show or hide the window of.
+ *
+ * @param visible Non-zero to show the window, zero to hide it.
+ * */
+void
+datviz_set_window_visible(datviz_z* viz, int visible);
+
+/** @brief Sets whether ending a frame waits for the vertical blank of the display.
+ *
+ * @details This is on by default. Turning it off lets frames be rendered as fast as possible, which is what
+ *          benchmarks need, at the cost of tearing.
+ *
+ * @param viz The viewer to set the swap behavior of.
+ *
+ * @param enabled Non-zero to wait for the vertical blank, zero to swap right away.
+ * */
+void
+datviz_set_vsync_enabled(datviz_z* viz, int enabled);
+
 /** @brief Sets whether or not user camera controls are enabled.
  *
  * @note Camera controls are enabled by default.
@@ -110,6 +363,11 @@ datviz_set_camera_controls_enabled(datviz_z* viz, int enabled);
  *          The second it does is clear the color buffer and depth buffer.
  *          Finally, the function will set the viewport transform to the width and height of the framebuffer.
  *
+ *          The first call also starts compiling the shader programs in the background. Until a program is ready, the
+ *          things that it draws are drawn in a simpler way where there is one (surfels as points, density as colored
+ *          points). Otherwise, such as for boxes, lines, labels, arrows, maps and voxels, the first draw waits for its
+ *          program, so only the first frames that use them are held up, and never by the programs of anything else.
+ *
  * @param viz The viewer to begin a new frame on.
  * */
 void
@@ -129,129 +387,1485 @@ datviz_begin_frame(datviz_z* viz);
 void
 datviz_render_points(datviz_z* viz, const dataviz_vertex* xyz_rgb, uint32_t point_count);
 
-/** @brief Performs the buffer swap that causes the rendered contents to be displayed on the window.
+/** @brief Renders a subset of points, selected by an index list, onto the current framebuffer.
  *
- * @param viz The viewer to complete the frame with.
+ * @details This is useful for drawing the output of the filtering functions without compacting the point data.
+ *
+ * @param viz The viewer to render points onto.
+ *
+ * @param xyz_rgb The buffer containing the positions and color of each particle.
+ *
+ * @param point_count The number of points in @p xyz_rgb.
+ *
+ * @param indices The indices of the points to render. Each index must be less than @p point_count.
+ *
+ * @param index_count The number of indices to render.
  * */
 void
-datviz_end_frame(datviz_z* viz);
+datviz_render_indexed_points(datviz_z* viz,
+                             const dataviz_vertex* xyz_rgb,
+                             uint32_t point_count,
+                             const uint32_t* indices,
+                             uint32_t index_count);
 
-// TODO: What do these report when the window is created hidden?
-
-/** @brief Gets the size of the window, in terms of pixels.
+/** @brief Renders points as disks that are oriented by their normals and lit by a head light.
  *
- * @param viz The viewer to get the window size of.
+ * @details Surfels cover the surface between points, so a sparser cloud can be drawn at the same visual quality.
+ *          The disks are drawn as point sprites, so their size is limited by the largest point size of the driver.
  *
- * @param w The variable to assign the window width to, in pixels.
+ * @param viz The viewer to render the surfels onto.
  *
- * @param h The variable to assign the window height to, in pixels.
+ * @param surfels The surfels to render.
+ *
+ * @param count The number of surfels to render.
+ *
+ * @param radius The radius of each disk, in the same units as the positions.
  * */
 void
-datviz_get_window_size(datviz_z* viz, int* w, int* h);
+datviz_render_surfels(datviz_z* viz, const dataviz_surfel_vertex* surfels, uint32_t count, float radius);
 
-/** @brief Gets the size of the framebuffer, in terms of pixels.
+/** @brief Sets whether surfels that face away from the camera are skipped.
  *
- * @param viz The viewer to get the framebuffer size of.
+ * @details This is off by default, in which case surfels facing away are lit as if they were facing the camera.
+ *          Culling requires the normals to be oriented consistently, such as toward the sensor that captured them.
  *
- * @param w The variable to assign the framebuffer width to, in pixels.
+ * @param viz The viewer to set the culling mode of.
  *
- * @param h The variable to assign the framebuffer height to, in pixels.
+ * @param enabled A boolean integer that indicates whether or not back facing surfels are culled.
  * */
 void
-datviz_get_framebuffer_size(datviz_z* viz, int* w, int* h);
+datviz_set_surfel_backface_culling(datviz_z* viz, int enabled);
 
-/** @brief Sets the background color of the frame.
+/** @brief Renders the edges of oriented boxes onto the current framebuffer.
  *
- * @details This affects the color that fills the frame when @ref datviz_begin_frame gets called.
+ * @details All of the boxes are drawn with a single instanced draw call. Each box is packed into 36 bytes before it is
+ *          uploaded, so thousands of boxes can be updated every frame.
  *
- * @param viz The viewer to set the background of.
+ * @param viz The viewer to render the boxes onto.
  *
- * @param r The red channel value of the background color.
+ * @param boxes The boxes to render.
  *
- * @param g The green channel value of the background color.
+ * @param count The number of boxes to render.
+ * */
+void
+datviz_render_boxes(datviz_z* viz, const dataviz_box* boxes, uint32_t count);
+
+/** @brief Renders text labels over the current framebuffer.
  *
- * @param b The blue channel value of the background color.
+ * @details The labels keep the same size on screen regardless of their distance from the camera, and are drawn on top
+ *          of the scene. All of the labels are drawn with a single instanced draw call, so hundreds of labels can be
+ *          drawn every frame. Labels anchored behind the camera are not drawn.
  *
- * @param a The alpha channel value of the background color.
+ * @param viz The viewer to render the labels onto.
+ *
+ * @param labels The labels to render.
+ *
+ * @param count The number of labels to render.
  * */
 void
-datviz_set_background(datviz_z* viz, float r, float g, float b, float a);
+datviz_render_labels(datviz_z* viz, const dataviz_label* labels, uint32_t count);
 
-/** @brief Sets the view transform of the render functions.
+/** @brief Renders a field of vectors as arrows onto the current framebuffer.
  *
- * @param viz The viewer to set the view transform of.
+ * @details Each arrow starts at a point and points along its vector. The arrows are built and oriented on the GPU, so
+ *          the points and vectors are uploaded once as a single instance buffer and drawn with a single draw call.
  *
- * @param view_transform The 4x4 view space transformation, in column-major order.
+ * @param viz The viewer to render the arrows onto.
+ *
+ * @param points The points that the arrows start at. The color of each point is used for its arrow.
+ *
+ * @param vectors The vectors to draw, as three floats per point.
+ *
+ * @param count The number of points and vectors.
+ *
+ * @param stride Only every stride-th vector is drawn, which thins out dense fields. Zero is treated as one.
+ *
+ * @param scale The length of an arrow per unit of vector length.
  * */
 void
-datviz_set_view_transform(datviz_z* viz, const float* view_transform);
+datviz_render_vector_field(datviz_z* viz,
+                           const dataviz_vertex* points,
+                           const float* vectors,
+                           uint32_t count,
+                           uint32_t stride,
+                           float scale);
 
-/** @brief Sets the view transform of the render functions by using three vectors.
+/** @brief A point cloud that is kept in GPU memory, so that it does not have to be uploaded every frame.
+ * */
+typedef struct datviz_cloud_struct datviz_cloud_z;
+
+/** @brief Creates a new retained point cloud, which is initially empty.
  *
- * @param viz The viewer to set the view transform of.
+ * @param viz The viewer that the cloud will be rendered with.
  *
- * @param eye A 3D position vector indicating the position of the camera.
+ * @return A new cloud. Use @ref datviz_cloud_destroy to release it before the viewer is destroyed.
+ *         A null pointer is returned if the GPU resources could not be created.
+ * */
+datviz_cloud_z*
+datviz_cloud_create(datviz_z* viz);
+
+/** @brief Releases a retained point cloud.
  *
- * @param center A 3D position vector indicating the position that the camera is looking at.
+ * @details The GPU buffer of the cloud is not deleted right away. It is kept by the viewer until the GPU has finished
+ *          the frames that draw from it, and is then reused by clouds that need a buffer of a similar size. The same
+ *          happens to the old buffer whenever the contents of a cloud are replaced, or it grows.
  *
- * @param up A 3D unit vector to indicate which direction is up.
+ * @param cloud The cloud to release. A null pointer may be passed, in which case nothing will happen.
  * */
 void
-datviz_look_at(datviz_z* viz, const float* eye, const float* center, const float* up);
+datviz_cloud_destroy(datviz_cloud_z* cloud);
 
-/** @brief Sets the projection space transformation.
+/** @brief Replaces the contents of a cloud.
  *
- * @param viz The viewer to set the projection space transformation of.
+ * @param cloud The cloud to upload the points to.
  *
- * @param projection_transform A 4x4 matrix, in column-major order, to indicate the projection space transformation.
+ * @param xyz_rgb The points to upload. They are copied, so the buffer may be released after this call.
+ *
+ * @param point_count The number of points to upload.
+ *
+ * @return Zero on success, non-zero on failure.
  * */
-void
-datviz_set_projection_transform(datviz_z* viz, const float* projection_transform);
+int
+datviz_cloud_upload(datviz_cloud_z* cloud, const dataviz_vertex* xyz_rgb, uint32_t point_count);
 
-/** @brief Sets the projection space transformation using a perspective transform.
+/** @brief The type of the callback that releases a buffer which was given to the library.
  *
- * @note The aspect ratio is calculated from the width and height of the window.
+ * @param user_data The pointer that was passed along with the callback.
  *
- * @note Calling this function in the render loop is useful to handle the user changing the window aspect ratio.
+ * @param xyz_rgb The buffer to release.
  *
- * @param viz The viewer to set the projection space transformation of.
+ * @param point_count The number of points in the buffer.
+ * */
+typedef void (*datviz_release_callback)(void* user_data, dataviz_vertex* xyz_rgb, uint32_t point_count);
+
+/** @brief Replaces the contents of a cloud, taking ownership of the buffer of points.
  *
- * @param fovy The vertical field of view angle, in radians.
+ * @details The points are uploaded straight from the buffer, and the buffer is released as soon as the upload is done.
+ *          This saves callers from keeping a buffer alive, or making a copy that they can hand off, just for the
+ *          duration of the upload.
  *
- * @param near The distance to the near plane.
+ * @param cloud The cloud to upload the points to.
  *
- * @param far The distance to the far plane.
+ * @param xyz_rgb The points to upload.
+ *
+ * @param point_count The number of points to upload.
+ *
+ * @param release The callback that releases the buffer. It is called exactly once, before this function returns,
+ *                even if the upload fails. This may be null, in which case the buffer is only borrowed.
+ *
+ * @param user_data A pointer that is passed to the release callback. May be null.
+ *
+ * @return Zero on success, non-zero on failure.
  * */
-void
-datviz_set_perspective(datviz_z* viz, float fovy, float near, float far);
+int
+datviz_cloud_upload_owned(datviz_cloud_z* cloud,
+                          dataviz_vertex* xyz_rgb,
+                          uint32_t point_count,
+                          datviz_release_callback release,
+                          void* user_data);
 
-/** @brief Sets the model transformation to apply to the rendered primitives.
+/** @brief Makes room for a number of points in the cloud, without changing its contents.
  *
- * @param viz The viewer to set the model space transformation of.
+ * @details Calling this before a series of appends avoids growing the GPU buffer more than once.
  *
- * @param model_transform A 4x4 matrix, in column-major order, to indicate the model space transformation of.
+ * @param cloud The cloud to reserve space in.
+ *
+ * @param capacity The total number of points that the cloud should have room for.
+ *
+ * @return Zero on success, non-zero on failure.
+ * */
+int
+datviz_cloud_reserve(datviz_cloud_z* cloud, uint32_t capacity);
+
+/** @brief Adds points to the end of a cloud.
+ *
+ * @details Only the new points are uploaded. When the cloud runs out of room, its buffer grows by at least double and
+ *          the existing points are copied on the GPU.
+ *
+ * @param cloud The cloud to append the points to.
+ *
+ * @param xyz_rgb The points to append.
+ *
+ * @param point_count The number of points to append.
+ *
+ * @return Zero on success, non-zero on failure.
+ * */
+int
+datviz_cloud_append(datviz_cloud_z* cloud, const dataviz_vertex* xyz_rgb, uint32_t point_count);
+
+/** @brief Replaces the contents of a cloud with points stored as separate columns.
+ *
+ * @details The columns are interleaved a block at a time into a small staging buffer on their way to the GPU, so the
+ *          points are never copied into one interleaved array on the CPU.
+ *
+ * @param cloud The cloud to upload the points to.
+ *
+ * @param columns The columns of the points to upload.
+ *
+ * @param point_count The number of points to upload.
+ *
+ * @return Zero on success, non-zero on failure.
+ * */
+int
+datviz_cloud_upload_columns(datviz_cloud_z* cloud, const dataviz_point_columns* columns, uint32_t point_count);
+
+/** @brief Adds points stored as separate columns to the end of a cloud.
+ *
+ * @details This is the same as @ref datviz_cloud_append, except for the layout of the points.
+ *
+ * @param cloud The cloud to append the points to.
+ *
+ * @param columns The columns of the points to append.
+ *
+ * @param point_count The number of points to append.
+ *
+ * @return Zero on success, non-zero on failure.
+ * */
+int
+datviz_cloud_append_columns(datviz_cloud_z* cloud, const dataviz_point_columns* columns, uint32_t point_count);
+
+/** @brief Removes all points from a cloud, keeping its GPU buffer for reuse.
+ *
+ * @param cloud The cloud to clear.
  * */
 void
-datviz_set_model_transform(datviz_z* viz, const float* model_transform);
+datviz_cloud_clear(datviz_cloud_z* cloud);
 
-/** @brief Checks for window input from either a mouse or keyboard.
+/** @brief Gets the number of points in a cloud.
  *
- * @details Calling this function is required for handling user interactions.
+ * @param cloud The cloud to get the size of.
  *
- * @param viz The viewer to check input for.
+ * @return The number of points in the cloud.
+ * */
+uint32_t
+datviz_cloud_size(const datviz_cloud_z* cloud);
+
+/** @brief Renders a retained point cloud onto the current framebuffer.
+ *
+ * @param viz The viewer to render the cloud onto. This must be the viewer that the cloud was created with.
+ *
+ * @param cloud The cloud to render.
  * */
 void
-datviz_poll_input(datviz_z* viz);
+datviz_render_cloud(datviz_z* viz, datviz_cloud_z* cloud);
 
-/** @brief Indicates whether or not the viewer should be closed.
+/** @brief Replaces the contents of a cloud with points sorted along an axis, for drawing cross sections.
  *
- * @details This function is affected by the user clicking the window exit button or the escape key.
+ * @details The points are sorted with a parallel radix sort before they are uploaded, and their coordinates along the
+ *          axis are kept on the CPU (four bytes per point). Any slab along the axis is then one contiguous range of the
+ *          cloud, found with a binary search, so moving a slab costs nothing but the search.
+ *          Uploading or appending points in any other way, or clearing the cloud, discards the sorted order.
  *
- * @param viz The viewer to check for a close signal.
+ * @param cloud The cloud to upload the points to.
  *
- * @return Non-zero if the viewer should close, zero otherwise.
+ * @param xyz_rgb The points to upload. They are copied, so the buffer may be released after this call.
+ *
+ * @param point_count The number of points to upload.
+ *
+ * @param axis The axis to sort along. Zero for X, one for Y and two for Z.
+ *
+ * @return Zero on success, non-zero on failure.
  * */
 int
-datviz_should_close(datviz_z* viz);
+datviz_cloud_upload_sorted(datviz_cloud_z* cloud, const dataviz_vertex* xyz_rgb, uint32_t point_count, int axis);
+
+/** @brief Finds the range of a sorted cloud that is within a slab.
+ *
+ * @param cloud The cloud to search, which must have been uploaded with @ref datviz_cloud_upload_sorted.
+ *
+ * @param min The lowest coordinate of the slab along the sorted axis, in the space of the points.
+ *
+ * @param max The highest coordinate of the slab along the sorted axis, in the space of the points.
+ *
+ * @param first Receives the index of the first point in the slab.
+ *
+ * @param count Receives the number of points in the slab.
+ *
+ * @return Zero on success, non-zero if the cloud is not sorted.
+ * */
+int
+datviz_cloud_find_slab(const datviz_cloud_z* cloud, float min, float max, uint32_t* first, uint32_t* count);
+
+/** @brief Renders the points of a sorted cloud that are within a slab, with a single draw call.
+ *
+ * @details See @ref datviz_cloud_find_slab for how the slab is found. Nothing is drawn if the cloud is not sorted.
+ *
+ * @param viz The viewer to render the cloud onto. This must be the viewer that the cloud was created with.
+ *
+ * @param cloud The cloud to render.
+ *
+ * @param min The lowest coordinate of the slab along the sorted axis.
+ *
+ * @param max The highest coordinate of the slab along the sorted axis.
+ * */
+void
+datviz_render_cloud_slab(datviz_z* viz, datviz_cloud_z* cloud, float min, float max);
+
+/** @brief Performs the buffer swap that causes the rendered contents to be displayed on the window.
+ *
+ * @param viz The viewer to complete the frame with.
+ * */
+void
+datviz_end_frame(datviz_z* viz);
+
+// TODO: What do these report when the window is created hidden?
+
+/** @brief Gets the size of the window, in terms of pixels.
+ *
+ * @param viz The viewer to get the window size of.
+ *
+ * @param w The variable to assign the window width to, in pixels.
+ *
+ * @param h The variable to assign the window height to, in pixels.
+ * */
+void
+datviz_get_window_size(datviz_z* viz, int* w, int* h);
+
+/** @brief Gets the size of the framebuffer, in terms of pixels.
+ *
+ * @param viz The viewer to get the framebuffer size of.
+ *
+ * @param w The variable to assign the framebuffer width to, in pixels.
+ *
+ * @param h The variable to assign the framebuffer height to, in pixels.
+ * */
+void
+datviz_get_framebuffer_size(datviz_z* viz, int* w, int* h);
+
+/** @brief Sets the background color of the frame.
+ *
+ * @details This affects the color that fills the frame when @ref datviz_begin_frame gets called.
+ *
+ * @param viz The viewer to set the background of.
+ *
+ * @param r The red channel value of the background color.
+ *
+ * @param g The green channel value of the background color.
+ *
+ * @param b The blue channel value of the background color.
+ *
+ * @param a The alpha channel value of the background color.
+ * */
+void
+datviz_set_background(datviz_z* viz, float r, float g, float b, float a);
+
+/** @brief Looks straight down at the XY plane with an orthographic projection.
+ *
+ * @details X points to the right and Y points up on the screen. The view follows changes to the size of the
+ *          framebuffer, so that the scale stays the same. Setting a view or projection transform, or a perspective
+ *          projection, switches back to a free view.
+ *
+ * @param viz The viewer to set the view of.
+ *
+ * @param center_x The X coordinate at the center of the view.
+ *
+ * @param center_y The Y coordinate at the center of the view.
+ *
+ * @param units_per_pixel The zoom level of the view, as the distance covered by one pixel.
+ * */
+void
+datviz_set_top_down_view(datviz_z* viz, float center_x, float center_y, float units_per_pixel);
+
+/** @brief Sets how points are rendered.
+ *
+ * @details In density mode, points are added up per pixel in an offscreen target without depth testing, and the counts
+ *          are drawn through a color map when the frame ends. The cost of a frame then depends on the number of points
+ *          and the size of the window, rather than on how the points overlap, and dense regions stay readable at any
+ *          zoom level. Pixels without points keep whatever else was drawn in the frame.
+ *
+ *          This affects points, indexed points and retained clouds. The mode may be changed between frames.
+ *
+ * @param viz The viewer to set the render mode of.
+ *
+ * @param mode The render mode to use for the following frames.
+ * */
+void
+datviz_set_render_mode(datviz_z* viz, datviz_render_mode mode);
+
+/** @brief Sets how point counts are colored in density mode.
+ *
+ * @details Counts are scaled logarithmically, so that both sparse and dense regions can be told apart.
+ *          Where floating point render targets are not supported, counts above 255 saturate.
+ *
+ * @param viz The viewer to set the density colors of.
+ *
+ * @param colormap The color map to draw the counts with.
+ *
+ * @param saturation The number of points in one pixel that reaches the top of the color map.
+ * */
+void
+datviz_set_density_colormap(datviz_z* viz, datviz_colormap colormap, float saturation);
+
+/** @brief Sets the view transform of the render functions.
+ *
+ * @param viz The viewer to set the view transform of.
+ *
+ * @param view_transform The 4x4 view space transformation, in column-major order.
+ * */
+void
+datviz_set_view_transform(datviz_z* viz, const float* view_transform);
+
+/** @brief Sets the view transform of the render functions by using three vectors.
+ *
+ * @param viz The viewer to set the view transform of.
+ *
+ * @param eye A 3D position vector indicating the position of the camera.
+ *
+ * @param center A 3D position vector indicating the position that the camera is looking at.
+ *
+ * @param up A 3D unit vector to indicate which direction is up.
+ * */
+void
+datviz_look_at(datviz_z* viz, const float* eye, const float* center, const float* up);
+
+/** @brief Sets the projection space transformation.
+ *
+ * @param viz The viewer to set the projection space transformation of.
+ *
+ * @param projection_transform A 4x4 matrix, in column-major order, to indicate the projection space transformation.
+ * */
+void
+datviz_set_projection_transform(datviz_z* viz, const float* projection_transform);
+
+/** @brief Gets the combined model, view and projection transform that points are rendered with.
+ *
+ * @details When a top down view is set, its transform is only computed at the start of each frame, so this should be
+ *          called after @ref datviz_begin_frame to get the transform of the current frame.
+ *
+ * @param viz The viewer to get the transform of.
+ *
+ * @param mvp The 16 floats to write the transform to, in column-major order.
+ * */
+void
+datviz_get_model_view_projection(datviz_z* viz, float* mvp);
+
+/** @brief Sets the projection space transformation using a perspective transform.
+ *
+ * @note The aspect ratio is calculated from the width and height of the window.
+ *
+ * @note Calling this function in the render loop is useful to handle the user changing the window aspect ratio.
+ *
+ * @param viz The viewer to set the projection space transformation of.
+ *
+ * @param fovy The vertical field of view angle, in radians.
+ *
+ * @param near The distance to the near plane.
+ *
+ * @param far The distance to the far plane.
+ * */
+void
+datviz_set_perspective(datviz_z* viz, float fovy, float near, float far);
+
+/** @brief Sets the model transformation to apply to the rendered primitives.
+ *
+ * @param viz The viewer to set the model space transformation of.
+ *
+ * @param model_transform A 4x4 matrix, in column-major order, to indicate the model space transformation of.
+ * */
+void
+datviz_set_model_transform(datviz_z* viz, const float* model_transform);
+
+/** @brief Gets the measurements of the last frame that was displayed.
+ *
+ * @param viz The viewer to get the measurements of.
+ *
+ * @param stats Receives the measurements. Every field is zero until the first frame has ended.
+ * */
+void
+datviz_get_frame_stats(datviz_z* viz, dataviz_frame_stats* stats);
+
+/** @brief Gets the GL calls made during the last frame, one entry point at a time.
+ *
+ * @details This is only available when the library is built with DATAVIZ_GL_INSTRUMENTATION, which routes every entry
+ *          point of the GL loader through a wrapper that counts it. Frames are counted from the end of the frame
+ *          before, and the calls of the performance overlay are left out. The calls of every viewer and of the
+ *          background shader compiler share the same counters, so the counts are only exact with a single viewer.
+ *
+ * @param viz The viewer to get the calls of.
+ *
+ * @param stats Receives the entry points that were called, from the most called to the least. May be null to only get
+ *              the number of them.
+ *
+ * @param capacity The number of elements that @p stats has room for.
+ *
+ * @return The number of entry points that were called, which may be more than @p capacity. Always zero without the
+ *         instrumentation.
+ * */
+uint32_t
+datviz_get_gl_call_stats(datviz_z* viz, dataviz_gl_call_stats* stats, uint32_t capacity);
+
+/** @brief Shows or hides the performance overlay.
+ *
+ * @details The overlay is drawn in the top left corner of the window, after everything else in the frame. It shows a
+ *          graph of the last 120 frame times against a 60 Hz budget line, along with the measurements of
+ *          @ref datviz_get_frame_stats. It is drawn with two instanced draw calls, and is off by default. The time it
+ *          takes to issue them is measured as the "hud" region of @ref datviz_get_perf_counters.
+ *
+ * @param viz The viewer to show or hide the overlay of.
+ *
+ * @param enabled Non-zero to show the overlay, zero to hide it.
+ * */
+void
+datviz_set_hud_enabled(datviz_z* viz, int enabled);
+
+/** @brief Checks for window input from either a mouse or keyboard.
+ *
+ * @details Calling this function is required for handling user interactions.
+ *
+ * @param viz The viewer to check input for.
+ * */
+void
+datviz_poll_input(datviz_z* viz);
+
+/** @brief Indicates whether or not the viewer should be closed.
+ *
+ * @details This function is affected by the user clicking the window exit button or the escape key.
+ *
+ * @param viz The viewer to check for a close signal.
+ *
+ * @return Non-zero if the viewer should close, zero otherwise.
+ * */
+int
+datviz_should_close(datviz_z* viz);
+
+/** @brief Keeps the points that are inside of a box.
+ *
+ * @details The filtering functions all share the same output convention.
+ *          They either write the kept points to @p out_points, the indices of the kept points to @p out_indices, or
+ *          both. Either of the output pointers may be null, and when both are null only the number of kept points is
+ *          computed. Output buffers must have room for @p point_count elements and must not overlap the input. The
+ *          kept points are written in the same order that they appear in the input.
+ *
+ * @param points The points to filter.
+ *
+ * @param point_count The number of points to filter.
+ *
+ * @param box_min The minimum X, Y and Z coordinates of the box.
+ *
+ * @param box_max The maximum X, Y and Z coordinates of the box.
+ *
+ * @param box_transform A 4x4 matrix, in column-major order, that transforms points into the space of the box.
+ *                      This may be null, in which case the box is axis aligned in the space of the points.
+ *
+ * @param invert If non-zero, the points outside of the box are kept instead.
+ *
+ * @param out_points The buffer to write the kept points to. May be null.
+ *
+ * @param out_indices The buffer to write the indices of the kept points to. May be null.
+ *
+ * @return The number of points that were kept.
+ * */
+uint32_t
+datviz_crop_box(const dataviz_vertex* points,
+                uint32_t point_count,
+                const float* box_min,
+                const float* box_max,
+                const float* box_transform,
+                int invert,
+                dataviz_vertex* out_points,
+                uint32_t* out_indices);
+
+/** @brief Keeps the points that are inside of a polygon prism.
+ *
+ * @details The prism is made by extruding a polygon on the XY plane between two Z values.
+ *          Self-intersecting polygons are handled with the even-odd rule.
+ *          See @ref datviz_crop_box for how the output is written.
+ *
+ * @param points The points to filter.
+ *
+ * @param point_count The number of points to filter.
+ *
+ * @param polygon_xy The X and Y coordinates of each polygon vertex, interleaved.
+ *
+ * @param polygon_size The number of vertices in the polygon.
+ *
+ * @param z_min The lowest Z value of the prism.
+ *
+ * @param z_max The highest Z value of the prism.
+ *
+ * @param invert If non-zero, the points outside of the prism are kept instead.
+ *
+ * @param out_points The buffer to write the kept points to. May be null.
+ *
+ * @param out_indices The buffer to write the indices of the kept points to. May be null.
+ *
+ * @return The number of points that were kept.
+ * */
+uint32_t
+datviz_crop_polygon(const dataviz_vertex* points,
+                    uint32_t point_count,
+                    const float* polygon_xy,
+                    uint32_t polygon_size,
+                    float z_min,
+                    float z_max,
+                    int invert,
+                    dataviz_vertex* out_points,
+                    uint32_t* out_indices);
+
+/** @brief Finds the points that project inside of a polygon on the screen, such as a lasso drawn with the mouse.
+ *
+ * @details The points are projected in groups of four with SIMD and tested on all available threads.
+ *          Each run of points is first tested as a whole by projecting its bounding box, so that the points in runs
+ *          that fall outside of the polygon or the view are skipped. Points behind the camera or outside of the near
+ *          and far planes are never selected. Self-intersecting polygons are handled with the even-odd rule.
+ *
+ * @param mvp The 4x4 model, view and projection transform, in column-major order.
+ *            See @ref datviz_get_model_view_projection.
+ *
+ * @param width The width of the screen that the polygon is on, in the same units as the polygon.
+ *
+ * @param height The height of the screen that the polygon is on, in the same units as the polygon.
+ *
+ * @param polygon_xy The X and Y coordinates of each polygon vertex, interleaved.
+ *                   The origin is the top left corner of the screen, with Y pointing down, as with cursor positions.
+ *
+ * @param polygon_size The number of vertices in the polygon.
+ *
+ * @param points The points to select from.
+ *
+ * @param point_count The number of points to select from.
+ *
+ * @param out_indices The buffer to write the indices of the selected points to, in increasing order.
+ *                    This may be null, in which case the selected points are only counted.
+ *
+ * @return The number of points that were selected.
+ * */
+uint32_t
+datviz_select_polygon(const float* mvp,
+                      int width,
+                      int height,
+                      const float* polygon_xy,
+                      uint32_t polygon_size,
+                      const dataviz_vertex* points,
+                      uint32_t point_count,
+                      uint32_t* out_indices);
+
+/** @brief Removes points that have too few neighbors within a radius.
+ *
+ * @details The points are bucketed into a grid with cells the size of the radius, and the grid cells are processed
+ *          on all available threads. See @ref datviz_crop_box for how the output is written.
+ *
+ * @param points The points to filter.
+ *
+ * @param point_count The number of points to filter.
+ *
+ * @param radius The radius to count neighbors in.
+ *
+ * @param min_neighbors The number of neighbors a point needs within the radius to be kept.
+ *
+ * @param out_points The buffer to write the kept points to. May be null.
+ *
+ * @param out_indices The buffer to write the indices of the kept points to. May be null.
+ *
+ * @return The number of points that were kept.
+ * */
+uint32_t
+datviz_remove_radius_outliers(const dataviz_vertex* points,
+                              uint32_t point_count,
+                              float radius,
+                              uint32_t min_neighbors,
+                              dataviz_vertex* out_points,
+                              uint32_t* out_indices);
+
+/** @brief Removes points whose mean distance to their nearest neighbors is unusually large.
+ *
+ * @details For each point, the mean distance to its @p k nearest neighbors is computed.
+ *          Points are kept if that distance is no more than the global mean plus @p stddev_multiplier standard
+ *          deviations. Points that are too isolated to find @p k neighbors are always removed.
+ *          See @ref datviz_crop_box for how the output is written.
+ *
+ * @param points The points to filter.
+ *
+ * @param point_count The number of points to filter.
+ *
+ * @param k The number of nearest neighbors to consider for each point.
+ *
+ * @param stddev_multiplier The number of standard deviations above the mean that a point may be and still be kept.
+ *
+ * @param out_points The buffer to write the kept points to. May be null.
+ *
+ * @param out_indices The buffer to write the indices of the kept points to. May be null.
+ *
+ * @return The number of points that were kept.
+ * */
+uint32_t
+datviz_remove_statistical_outliers(const dataviz_vertex* points,
+                                   uint32_t point_count,
+                                   uint32_t k,
+                                   float stddev_multiplier,
+                                   dataviz_vertex* out_points,
+                                   uint32_t* out_indices);
+
+/** @brief A chain of point processing stages that run together in a single pass.
+ *
+ * @details Every stage of a pipeline only looks at one point at a time, which lets the pipeline split the input into
+ *          chunks and run all of the stages on a chunk while it is still in cache. No intermediate arrays are made
+ *          between stages, and at most a few chunks per thread are held in memory at once.
+ *
+ *          Stages that need to look at neighboring points, such as @ref datviz_remove_statistical_outliers, cannot be
+ *          fused this way and should be run before or after the pipeline.
+ * */
+typedef struct datviz_pipeline_struct datviz_pipeline_z;
+
+/** @brief Creates a new pipeline with no stages.
+ *
+ * @return A new pipeline. Use @ref datviz_pipeline_destroy to release it.
+ * */
+datviz_pipeline_z*
+datviz_pipeline_create(void);
+
+/** @brief Releases a pipeline.
+ *
+ * @param pipeline The pipeline to release. A null pointer may be passed, in which case nothing will happen.
+ * */
+void
+datviz_pipeline_destroy(datviz_pipeline_z* pipeline);
+
+/** @brief Sets the number of points that are processed together.
+ *
+ * @details Chunks should be small enough to stay in cache. The default is 65536 points.
+ *
+ * @param pipeline The pipeline to set the chunk size of.
+ *
+ * @param chunk_size The number of points in a chunk.
+ * */
+void
+datviz_pipeline_set_chunk_size(datviz_pipeline_z* pipeline, uint32_t chunk_size);
+
+/** @brief Adds a stage that keeps the points inside of a box.
+ *
+ * @details The parameters have the same meaning as they do for @ref datviz_crop_box.
+ * */
+void
+datviz_pipeline_add_crop_box(datviz_pipeline_z* pipeline,
+                             const float* box_min,
+                             const float* box_max,
+                             const float* box_transform,
+                             int invert);
+
+/** @brief Adds a stage that keeps the points inside of a polygon prism.
+ *
+ * @details The parameters have the same meaning as they do for @ref datviz_crop_polygon.
+ *          The polygon is copied, so the buffer may be released after this call.
+ * */
+void
+datviz_pipeline_add_crop_polygon(datviz_pipeline_z* pipeline,
+                                 const float* polygon_xy,
+                                 uint32_t polygon_size,
+                                 float z_min,
+                                 float z_max,
+                                 int invert);
+
+/** @brief Adds a stage that transforms the position of each point.
+ *
+ * @param pipeline The pipeline to add the stage to.
+ *
+ * @param transform A 4x4 matrix, in column-major order, to transform the points with.
+ * */
+void
+datviz_pipeline_add_transform(datviz_pipeline_z* pipeline, const float* transform);
+
+/** @brief Adds a stage that keeps a random fraction of the points.
+ *
+ * @details Whether a point is kept depends only on its index in the input, so running the same pipeline on the same
+ *          input always gives the same result.
+ *
+ * @param pipeline The pipeline to add the stage to.
+ *
+ * @param keep_fraction The fraction of points to keep, between zero and one.
+ * */
+void
+datviz_pipeline_add_subsample(datviz_pipeline_z* pipeline, float keep_fraction);
+
+/** @brief Adds a stage that colors points with a gradient along an axis.
+ *
+ * @param pipeline The pipeline to add the stage to.
+ *
+ * @param axis The axis to color along. Zero for X, one for Y and two for Z.
+ *
+ * @param min The coordinate that maps to @p low_rgba.
+ *
+ * @param max The coordinate that maps to @p high_rgba.
+ *
+ * @param low_rgba The color of points at or below @p min.
+ *
+ * @param high_rgba The color of points at or above @p max.
+ * */
+void
+datviz_pipeline_add_colorize_axis(datviz_pipeline_z* pipeline,
+                                  int axis,
+                                  float min,
+                                  float max,
+                                  const unsigned char* low_rgba,
+                                  const unsigned char* high_rgba);
+
+/** @brief Runs a pipeline, writing the output points to memory.
+ *
+ * @param pipeline The pipeline to run.
+ *
+ * @param points The points to process.
+ *
+ * @param point_count The number of points to process.
+ *
+ * @param out_points The buffer to write the output to. It must have room for @p point_count points.
+ *
+ * @return The number of points that were written.
+ * */
+uint32_t
+datviz_pipeline_run(const datviz_pipeline_z* pipeline,
+                    const dataviz_vertex* points,
+                    uint32_t point_count,
+                    dataviz_vertex* out_points);
+
+/** @brief Runs a pipeline, streaming the output points into a retained cloud.
+ *
+ * @details The previous contents of the cloud are replaced. Each chunk is appended to the cloud as soon as it is
+ *          processed, so the output is never held in memory as a whole. This must be called from the thread that
+ *          renders with the cloud's viewer.
+ *
+ * @param pipeline The pipeline to run.
+ *
+ * @param points The points to process.
+ *
+ * @param point_count The number of points to process.
+ *
+ * @param cloud The cloud to write the output to.
+ *
+ * @return Zero on success, non-zero on failure.
+ * */
+int
+datviz_pipeline_run_to_cloud(const datviz_pipeline_z* pipeline,
+                             const dataviz_vertex* points,
+                             uint32_t point_count,
+                             datviz_cloud_z* cloud);
+
+/** @brief Estimates a surface normal for each point from its nearest neighbors.
+ *
+ * @details The normal is the direction of least variance of each point and its @p k nearest neighbors.
+ *          The points are processed on all available threads, in the order of a spatial grid.
+ *
+ * @param points The points to estimate normals for.
+ *
+ * @param point_count The number of points.
+ *
+ * @param k The number of neighbors to use for each point. Values between 8 and 32 usually work well.
+ *
+ * @param viewpoint The position that the normals are oriented toward, such as the sensor position.
+ *                  This may be null, in which case the origin is used.
+ *
+ * @param out_normals The buffer to write the unit normals to, three floats per point.
+ *
+ * @return Zero on success, non-zero if there were no points or @p k was less than two.
+ * */
+int
+datviz_estimate_normals(const dataviz_vertex* points,
+                        uint32_t point_count,
+                        uint32_t k,
+                        const float* viewpoint,
+                        float* out_normals);
+
+/** @brief Encodes a unit normal with octahedron encoding.
+ *
+ * @param normal The three components of the unit normal.
+ *
+ * @param packed The two signed normalized values to write the encoded normal to.
+ * */
+void
+datviz_pack_normal(const float* normal, int16_t* packed);
+
+/** @brief Combines points and their normals into surfel vertices.
+ *
+ * @param points The points to get the position and color from.
+ *
+ * @param normals The unit normals of the points, three floats per point.
+ *
+ * @param point_count The number of points.
+ *
+ * @param out_surfels The buffer to write the surfels to.
+ * */
+void
+datviz_make_surfels(const dataviz_vertex* points,
+                    const float* normals,
+                    uint32_t point_count,
+                    dataviz_surfel_vertex* out_surfels);
+
+/** @brief A batch of polylines, such as trajectories, that are drawn together.
+ *
+ * @details All of the polylines in a batch share one GPU buffer and are drawn with a single draw call.
+ *          Polylines can only grow, which keeps updates down to uploading the newly added segments.
+ * */
+typedef struct datviz_lines_struct datviz_lines_z;
+
+/** @brief Creates a new, empty batch of polylines.
+ *
+ * @param viz The viewer that the lines will be rendered with.
+ *
+ * @return A new line batch. Use @ref datviz_lines_destroy to release it before the viewer is destroyed.
+ *         A null pointer is returned if the GPU resources could not be created.
+ * */
+datviz_lines_z*
+datviz_lines_create(datviz_z* viz);
+
+/** @brief Releases a batch of polylines.
+ *
+ * @param lines The batch to release. A null pointer may be passed, in which case nothing will happen.
+ * */
+void
+datviz_lines_destroy(datviz_lines_z* lines);
+
+/** @brief Adds a polyline to a batch.
+ *
+ * @param lines The batch to add the polyline to.
+ *
+ * @param vertices The initial vertices of the polyline. The color of each segment is blended between its two ends.
+ *
+ * @param count The number of initial vertices. This may be zero.
+ *
+ * @return An identifier for the polyline, to be passed to @ref datviz_lines_append.
+ * */
+uint32_t
+datviz_lines_add_polyline(datviz_lines_z* lines, const dataviz_vertex* vertices, uint32_t count);
+
+/** @brief A point cloud that has been rasterized into a pyramid of map tiles, for drawing it from above.
+ * */
+typedef struct datviz_map_struct datviz_map_z;
+
+/** @brief Creates a map from a point cloud.
+ *
+ * @details Each cell of the finest level of the map takes the color of the highest point in it. Each level after that
+ *          halves the resolution, until a single tile covers the cloud. The tiles are built in parallel, and the
+ *          points are kept on the GPU in tile order for drawing when zoomed in past the finest level.
+ *
+ *          If a cache file is given and it was made from the same points and cell size, the tiles are loaded from it
+ *          instead of being built. Otherwise, the tiles are written to it once they are built.
+ *
+ * @param viz The viewer that the map will be rendered with.
+ *
+ * @param points The points of the cloud.
+ *
+ * @param count The number of points.
+ *
+ * @param cell_size The size of the cells of the finest level. It is doubled until the finest level fits in 4096
+ *                  tiles of 256 by 256 cells.
+ *
+ * @param cache_path The path of the cache file, or null to always build the tiles.
+ *
+ * @return A new map, or null on failure.
+ * */
+datviz_map_z*
+datviz_map_create(datviz_z* viz, const dataviz_vertex* points, uint32_t count, float cell_size, const char* cache_path);
+
+/** @brief Releases the memory allocated by a map.
+ *
+ * @param map The map to destroy. May be null.
+ * */
+void
+datviz_map_destroy(datviz_map_z* map);
+
+/** @brief Renders a map onto the current framebuffer.
+ *
+ * @details This is meant to be used with @ref datviz_set_top_down_view. Only the tiles in view are drawn, from the
+ *          level where a cell covers about one pixel. When zoomed in further than the finest level, the points under
+ *          the view are drawn instead.
+ *
+ * @param viz The viewer to render the map onto. This must be the viewer that the map was created with.
+ *
+ * @param map The map to render.
+ * */
+void
+datviz_render_map(datviz_z* viz, datviz_map_z* map);
+
+/** @brief A set of occupied voxels, drawn as solid cubes.
+ * */
+typedef struct datviz_voxels_struct datviz_voxels_z;
+
+/** @brief Creates an empty voxel set.
+ *
+ * @param viz The viewer that the voxels will be rendered with.
+ *
+ * @return A new voxel set, or null on failure.
+ * */
+datviz_voxels_z*
+datviz_voxels_create(datviz_z* viz);
+
+/** @brief Releases the memory allocated by a voxel set.
+ *
+ * @param voxels The voxel set to destroy. May be null.
+ * */
+void
+datviz_voxels_destroy(datviz_voxels_z* voxels);
+
+/** @brief Replaces the contents of a voxel set with the voxels that contain points.
+ *
+ * @details The voxels are aligned to the lowest corner of the bounds of the points, and each takes the color of one of
+ *          the points in it. The set is built in parallel. Faces shared by two occupied voxels are not drawn, and
+ *          voxels that are enclosed on all sides are left out, so large solid regions only cost their surface.
+ *
+ * @param voxels The voxel set to build.
+ *
+ * @param points The points to build the voxels from.
+ *
+ * @param count The number of points.
+ *
+ * @param voxel_size The size of each voxel along every axis.
+ *
+ * @return Zero on success, non-zero if the points span more than 2^21 voxels along an axis or the upload failed.
+ * */
+int
+datviz_voxels_build(datviz_voxels_z* voxels, const dataviz_vertex* points, uint32_t count, float voxel_size);
+
+/** @brief Gets the number of voxels in a set that have at least one visible face.
+ * */
+uint32_t
+datviz_voxels_size(const datviz_voxels_z* voxels);
+
+/** @brief Renders a voxel set onto the current framebuffer, with a single instanced draw call.
+ *
+ * @param viz The viewer to render the voxels onto. This must be the viewer that the voxel set was created with.
+ *
+ * @param voxels The voxel set to render.
+ * */
+void
+datviz_render_voxels(datviz_z* viz, datviz_voxels_z* voxels);
+
+/** @brief Adds vertices to the end of a polyline.
+ *
+ * @details The new segments are uploaded the next time the batch is rendered, together with the segments added to
+ *          any other polyline, so appending one vertex to thousands of polylines per frame is cheap.
+ *
+ * @param lines The batch that contains the polyline.
+ *
+ * @param polyline The identifier returned by @ref datviz_lines_add_polyline.
+ *
+ * @param vertices The vertices to append.
+ *
+ * @param count The number of vertices to append.
+ *
+ * @return Zero on success, non-zero if the polyline identifier is not valid.
+ * */
+int
+datviz_lines_append(datviz_lines_z* lines, uint32_t polyline, const dataviz_vertex* vertices, uint32_t count);
+
+/** @brief Removes all polylines from a batch.
+ *
+ * @details Polyline identifiers start from zero again after this call. The GPU buffer is kept for reuse.
+ *
+ * @param lines The batch to clear.
+ * */
+void
+datviz_lines_clear(datviz_lines_z* lines);
+
+/** @brief Renders a batch of polylines onto the current framebuffer.
+ *
+ * @param viz The viewer to render the lines onto. This must be the viewer that the batch was created with.
+ *
+ * @param lines The batch to render.
+ *
+ * @param width The width of the lines, in pixels. Widths above one are drawn as screen space quads.
+ * */
+void
+datviz_render_lines(datviz_z* viz, datviz_lines_z* lines, float width);
+
+/** @brief Colors points by mapping a scalar value per point through a color map.
+ *
+ * @details Only the red, green and blue channels of the points are changed.
+ *
+ * @param values The value of each point.
+ *
+ * @param count The number of values and points.
+ *
+ * @param min_value The value that maps to the bottom of the color map. Values below it are clamped.
+ *
+ * @param max_value The value that maps to the top of the color map. Values above it are clamped.
+ *
+ * @param colormap The color map to use.
+ *
+ * @param points The points to color.
+ * */
+void
+datviz_apply_colormap(const float* values,
+                      uint32_t count,
+                      float min_value,
+                      float max_value,
+                      datviz_colormap colormap,
+                      dataviz_vertex* points);
+
+/** @brief Colors points by an integer label per point, such as a cluster or segment id.
+ *
+ * @details The labels are mapped to a palette of eighteen distinct colors, repeating for larger labels.
+ *          Points labeled UINT32_MAX are colored dark gray. Only the red, green and blue channels are changed.
+ *
+ * @param labels The label of each point.
+ *
+ * @param count The number of labels and points.
+ *
+ * @param points The points to color.
+ * */
+void
+datviz_apply_palette(const uint32_t* labels, uint32_t count, dataviz_vertex* points);
+
+/** @brief Computes the distance from each point to the nearest point of a reference cloud.
+ *
+ * @details This is meant for finding changes between two scans of the same scene. The reference points are put into
+ *          a grid sized by their own spacing, built in parallel, and the points are then queried on all available
+ *          threads. Passing the result to @ref datviz_apply_colormap with a range of zero to @p max_distance colors
+ *          the points by how much they moved.
+ *
+ * @param reference The points to measure the distances to.
+ *
+ * @param reference_count The number of reference points.
+ *
+ * @param points The points to measure the distances from.
+ *
+ * @param point_count The number of points to measure the distances from.
+ *
+ * @param max_distance The farthest distance to search. Points with no reference point this close get this distance.
+ *                     Smaller values make the search faster where the clouds differ.
+ *
+ * @param out_distances The buffer to write the distance of each point to.
+ *
+ * @return Zero on success, non-zero if there are no reference points or @p max_distance is not positive.
+ * */
+int
+datviz_compute_cloud_distances(const dataviz_vertex* reference,
+                               uint32_t reference_count,
+                               const dataviz_vertex* points,
+                               uint32_t point_count,
+                               float max_distance,
+                               float* out_distances);
+
+/** @brief Splits points into clusters that are connected by steps no longer than a tolerance.
+ *
+ * @details Two points are in the same cluster if a chain of points connects them where each step is at most
+ *          @p tolerance long. The points are put into a grid with cells small enough that any two points in a cell are
+ *          connected, and a parallel union-find then merges neighboring cells that have a pair of points within the
+ *          tolerance. Cells that are already in the same cluster are not compared again.
+ *          The labels can be passed to @ref datviz_apply_palette to color the clusters.
+ *
+ * @param points The points to cluster.
+ *
+ * @param point_count The number of points.
+ *
+ * @param tolerance The largest distance between neighboring points of a cluster.
+ *
+ * @param min_cluster_size The fewest points that a cluster may have. Points in smaller clusters are left unlabeled.
+ *
+ * @param out_labels The buffer to write the label of each point to. Clusters are numbered from zero, largest first,
+ *                   and unlabeled points get UINT32_MAX.
+ *
+ * @return The number of clusters.
+ * */
+uint32_t
+datviz_cluster_euclidean(const dataviz_vertex* points,
+                         uint32_t point_count,
+                         float tolerance,
+                         uint32_t min_cluster_size,
+                         uint32_t* out_labels);
+
+/** @brief The counts of one measured region of CPU work, summed over every thread and every call.
+ * */
+struct dataviz_perf_counters
+{
+  /** The name of the region. It stays valid until the library is unloaded. */
+  const char* name;
+  /** The number of times that the region was entered. Threads that the work of a region was handed to do not add to
+   *  this. */
+  uint64_t calls;
+  /** The wall time from entering the region to leaving it, summed over the calls, in nanoseconds. */
+  uint64_t nanoseconds;
+  /** The CPU cycles spent in the region by every thread that worked on it, outside of the kernel. */
+  uint64_t cycles;
+  /** The instructions retired in the region, outside of the kernel. Dividing these by the cycles gives the IPC. */
+  uint64_t instructions;
+  /** The last level cache misses in the region. */
+  uint64_t cache_misses;
+  /** The mispredicted branches in the region. */
+  uint64_t branch_misses;
+};
+
+typedef dataviz_perf_counters dataviz_perf_counters_z;
+
+/** @brief The state of a measurement that was started with @ref datviz_perf_begin.
+ *
+ * @details The members are only meant to be read by @ref datviz_perf_end.
+ * */
+struct dataviz_perf_scope
+{
+  /** The region that the counts are added to. */
+  uint32_t region;
+  /** The region that the thread was measuring before this one. */
+  uint32_t outer_region;
+  /** The time and counter values when the measurement started. */
+  uint64_t start[5];
+};
+
+typedef dataviz_perf_scope dataviz_perf_scope_z;
+
+/** @brief Checks whether regions are measured with hardware performance counters.
+ *
+ * @details Counters are only available on Linux, in builds configured with DATAVIZ_PERF_COUNTERS, and when the kernel
+ *          allows a process to count its own events (see /proc/sys/kernel/perf_event_paranoid). Without the option,
+ *          every measurement function does nothing. Without kernel support, regions still count calls and time.
+ *
+ * @return Non-zero if the counters of the calling thread could be opened.
+ * */
+int
+datviz_perf_counters_available(void);
+
+/** @brief Finds a measured region by name, adding it if there is none.
+ *
+ * @details The library measures its own CPU heavy paths, such as sorting, conversion, filtering and map building,
+ *          in regions that are named after them. Applications can add regions for their own kernels.
+ *
+ * @param name The name of the region. It is copied.
+ *
+ * @return The index of the region. If there is no room for another region, or the library was built without counters,
+ *         an index that @ref datviz_perf_begin ignores is returned.
+ * */
+uint32_t
+datviz_perf_region(const char* name);
+
+/** @brief Starts measuring the calling thread as part of a region.
+ *
+ * @details Work that the library hands to other threads while the measurement runs is counted in the same region.
+ *          Measurements can be nested, and each must be ended on the thread that started it.
+ *
+ * @param region The index from @ref datviz_perf_region.
+ *
+ * @param scope The state of the measurement, to pass to @ref datviz_perf_end.
+ * */
+void
+datviz_perf_begin(uint32_t region, dataviz_perf_scope* scope);
+
+/** @brief Adds the counts since @ref datviz_perf_begin to the region that was measured.
+ * */
+void
+datviz_perf_end(const dataviz_perf_scope* scope);
+
+/** @brief Gets the counts of the measured regions.
+ *
+ * @param counters The buffer to write the counts to, in the order that the regions were added. May be null.
+ *
+ * @param capacity The number of counts that fit in @p counters.
+ *
+ * @return The number of regions, which may be more than @p capacity.
+ * */
+uint32_t
+datviz_get_perf_counters(dataviz_perf_counters* counters, uint32_t capacity);
+
+/** @brief Sets the counts of every region back to zero. The regions themselves are kept.
+ * */
+void
+datviz_reset_perf_counters(void);
+
+/** @brief Writes the counts of the measured regions to a JSON file.
+ *
+ * @details The file holds an object with a "regions" array, and each region has the members of
+ *          @ref dataviz_perf_counters along with its IPC, so it can be collected next to benchmark results.
+ *
+ *          Without DATAVIZ_PERF_COUNTERS, no file is written.
+ *
+ * @param path The path of the file to write.
+ *
+ * @return Zero on success, non-zero if the file could not be written.
+ * */
+int
+datviz_write_perf_counters_json(const char* path);
+
+/** @brief The options of a capture.
+ * */
+enum datviz_capture_flags
+{
+  /** Compress the calls with zlib. Ignored if the library was built without zlib. */
+  DATVIZ_CAPTURE_COMPRESSED = 1
+};
+
+/** @brief Starts recording the calls made to the viewer functions, along with the points passed to them, to a file.
+ *
+ * @details Every call that changes what is rendered is recorded with the time that it was made at, including the
+ *          creation of viewers, clouds, maps, voxels and lines, the uploads to them, and every render call. Calls on
+ *          objects that were created before the capture began cannot be replayed, so captures should be started
+ *          before the first viewer is created. The point processing functions, such as the filters, are not recorded.
+ *          Captures hold every point that is uploaded or rendered, so they grow quickly.
+ *
+ *          The file is only meant to be read by @ref datviz_replay_capture. It stores values in the byte order of the
+ *          machine, so it can be replayed on any machine of the same byte order.
+ *
+ * @param path The path of the file to write the capture to.
+ *
+ * @param flags A combination of @ref datviz_capture_flags.
+ *
+ * @return Zero on success, non-zero if a capture is already running or the file could not be opened.
+ * */
+int
+datviz_capture_begin(const char* path, int flags);
+
+/** @brief Stops recording calls, and closes the capture file.
+ *
+ * @return Zero on success, non-zero if no capture was running or the file could not be written completely.
+ * */
+int
+datviz_capture_end(void);
+
+/** @brief The options of a replay.
+ * */
+enum datviz_replay_flags
+{
+  /** Wait between calls so that they are made at the times that they were captured at, instead of right away. */
+  DATVIZ_REPLAY_REAL_TIME = 1,
+  /** Render into hidden windows, without waiting for the vertical blank. */
+  DATVIZ_REPLAY_HEADLESS = 2
+};
+
+/** @brief Measurements of a replay.
+ * */
+struct dataviz_replay_stats
+{
+  /** The number of calls that were replayed. */
+  uint64_t calls;
+  /** The number of calls that were skipped, for being made on objects that were created before the capture began. */
+  uint64_t skipped_calls;
+  /** The number of frames that were replayed. */
+  uint32_t frames;
+  /** The time that the replay took, in seconds. */
+  double seconds;
+  /** The average time of a frame, from the start of one to the start of the next, in milliseconds. */
+  float mean_frame_ms;
+  /** The longest time of a frame, in milliseconds. */
+  float max_frame_ms;
+};
+
+typedef dataviz_replay_stats dataviz_replay_stats_z;
+
+/** @brief Plays back the calls of a capture.
+ *
+ * @details The calls are made on new objects, in the order that they were captured in. Maps are always built from
+ *          their points, since their cache files may not exist on the machine that replays them. Objects that the
+ *          capture did not destroy are destroyed at the end. The library must be initialized, and the calls are made
+ *          on the calling thread.
+ *
+ * @param path The path of the capture file.
+ *
+ * @param flags A combination of @ref datviz_replay_flags.
+ *
+ * @param stats Set to the measurements of the replay. May be null.
+ *
+ * @return Zero on success, non-zero if the file could not be read or is not a valid capture.
+ * */
+int
+datviz_replay_capture(const char* path, int flags, dataviz_replay_stats* stats);
+
+/** @brief Options for reading a file with @ref datviz_stream_file.
+ * */
+enum datviz_stream_flags
+{
+  /** Reads past the page cache, so that scanning a file larger than memory does not evict everything else. This is
+   * ignored where the file system does not support it. */
+  DATVIZ_STREAM_DIRECT = 1,
+  /** Reads with a few threads that each wait on a read, even where io_uring is available. */
+  DATVIZ_STREAM_NO_IO_URING = 2
+};
+
+/** @brief The type of the callback that receives the blocks of a file.
+ *
+ * @param user_data The pointer that was passed along with the callback.
+ *
+ * @param data The block. It is only valid until the callback returns, since its buffer is reused for a later read.
+ *
+ * @param size The number of bytes in the block, which is the block size for every block but the last one.
+ *
+ * @param offset The offset of the block in the file.
+ *
+ * @return Zero to keep reading, non-zero to stop.
+ * */
+typedef int (*datviz_stream_callback)(void* user_data, const void* data, uint64_t size, uint64_t offset);
+
+/** @brief Reads a file from start to end, with many large reads in flight, and hands its blocks to a callback in order.
+ *
+ * @details On Linux, the reads are queued on an io_uring, so that the device always has work and no thread is needed
+ *          per read. Where io_uring is not available or not allowed, a few threads each wait on a read instead. The
+ *          callback is called on the calling thread while the next reads are in flight, so parsing a block overlaps
+ *          with reading the ones after it.
+ *
+ * @param path The path of the file to read.
+ *
+ * @param block_size The size of each read in bytes, which is rounded up to a multiple of 4096. Zero uses 4 MiB.
+ *
+ * @param queue_depth The number of reads that are kept in flight, each with a buffer of the block size. Zero uses 16.
+ *
+ * @param flags A combination of @ref datviz_stream_flags.
+ *
+ * @param callback The callback that receives the blocks.
+ *
+ * @param user_data A pointer that is passed to the callback. May be null.
+ *
+ * @return Zero if the whole file was read, non-zero if it could not be read or the callback stopped the reading.
+ * */
+int
+datviz_stream_file(const char* path,
+                   uint32_t block_size,
+                   uint32_t queue_depth,
+                   int flags,
+                   datviz_stream_callback callback,
+                   void* user_data);
+
+/** @brief Points that were loaded from a text file, such as an XYZ, CSV or TXT export.
+ * */
+typedef struct datviz_text_points_struct datviz_text_points_z;
+
+/** @brief Loads the points of a text file with one point per line.
+ *
+ * @details Each line holds X, Y and Z, optionally followed by red, green and blue, and then optionally by an intensity,
+ *          for three, four, six or seven columns. The columns may be separated by spaces, tabs, commas or semicolons.
+ *          The number of columns is taken from the first line that is made of numbers, and lines before it, such as a
+ *          header, are skipped, along with any later line that does not have the same number of columns.
+ *
+ *          Colors are expected from 0 to 255. Points without colors are white. The file is mapped into memory and
+ *          split at line boundaries across all available threads, and numbers are parsed with a vectorized parser
+ *          that gives the same floats as strtof. It falls back to strtof for numbers with more than 19 digits, with
+ *          large exponents, or that are too close to halfway between two floats for its own rounding to settle.
+ *
+ * @param path The path of the file to load.
+ *
+ * @return The loaded points, or null if the file could not be read, has no lines of points, or has more than
+ *         4294967295 of them. Use @ref datviz_text_points_destroy to release them.
+ * */
+datviz_text_points_z*
+datviz_text_points_load(const char* path);
+
+/** @brief Releases points that were loaded from a text file.
+ *
+ * @param points The points to release. A null pointer may be passed, in which case nothing will happen.
+ * */
+void
+datviz_text_points_destroy(datviz_text_points_z* points);
+
+/** @brief Gets the number of points that were loaded.
+ * */
+uint32_t
+datviz_text_points_count(const datviz_text_points_z* points);
+
+/** @brief Gets the points that were loaded, in the order of the file.
+ *
+ * @return The points, which stay valid until they are released. These can be passed to any function that takes points,
+ *         such as @ref datviz_cloud_upload.
+ * */
+const dataviz_vertex*
+datviz_text_points_vertices(const datviz_text_points_z* points);
+
+/** @brief Gets the intensity of each point, for files that have an intensity column.
+ *
+ * @return One intensity per point, or null if the file has no intensity column. These can be colored with
+ *         @ref datviz_apply_colormap.
+ * */
+const float*
+datviz_text_points_intensities(const datviz_text_points_z* points);
+
+/** @brief Gets the number of lines that were skipped, for not being made of the same number of numbers as the points.
+ *
+ * @details Blank lines are not counted.
+ * */
+uint64_t
+datviz_text_points_skipped_lines(const datviz_text_points_z* points);
 
 } // namespace dataviz
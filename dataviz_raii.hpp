@@ -0,0 +1,319 @@
+/// @file dataviz_raii.hpp
+///
+/// @brief C++ wrappers for the public API, which manage the lifetime of objects and accept owned or borrowed buffers.
+
+#pragma once
+
+#include "datviz.h"
+
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace dataviz {
+
+/** @brief A view of contiguous vertices that are owned by someone else.
+ *
+ * @details Views are made implicitly from any container with `data()` and `size()` members that give vertices, such as
+ *          `std::vector`, `std::array` or `std::span`, so the wrapper functions can be called with any of them without
+ *          a copy.
+ * */
+class VertexSpan final
+{
+  template<typename Container>
+  using holds_vertices =
+    std::is_convertible<decltype(std::declval<const Container&>().data()), const dataviz_vertex*>;
+
+public:
+  constexpr VertexSpan() = default;
+
+  constexpr VertexSpan(const dataviz_vertex* data, size_t size)
+    : data_(data)
+    , size_(size)
+  {
+  }
+
+  template<typename Container, typename = typename std::enable_if<holds_vertices<Container>::value>::type>
+  constexpr VertexSpan(const Container& container)
+    : data_(container.data())
+    , size_(container.size())
+  {
+  }
+
+  constexpr const dataviz_vertex* data() const { return data_; }
+
+  constexpr size_t size() const { return size_; }
+
+  /** @brief Whether the number of vertices fits in the counts of the C functions.
+   * */
+  constexpr bool fits() const { return size_ <= UINT32_MAX; }
+
+private:
+  const dataviz_vertex* data_ = nullptr;
+
+  size_t size_ = 0;
+};
+
+namespace detail {
+
+/** @brief A buffer that the library has taken ownership of, released through @ref datviz_release_callback.
+ * */
+class OwnedBuffer
+{
+public:
+  virtual ~OwnedBuffer() = default;
+
+  static void release(void* user_data, dataviz_vertex*, uint32_t) { delete static_cast<OwnedBuffer*>(user_data); }
+};
+
+template<typename Container>
+class OwnedContainer final : public OwnedBuffer
+{
+public:
+  explicit OwnedContainer(Container&& container)
+    : container_(std::move(container))
+  {
+  }
+
+  Container& container() { return container_; }
+
+private:
+  Container container_;
+};
+
+template<typename Deleter>
+class OwnedPointer final : public OwnedBuffer
+{
+public:
+  OwnedPointer(dataviz_vertex* data, Deleter&& deleter)
+    : data_(data)
+    , deleter_(std::move(deleter))
+  {
+  }
+
+  ~OwnedPointer() override { deleter_(data_); }
+
+private:
+  dataviz_vertex* data_ = nullptr;
+
+  Deleter deleter_;
+};
+
+} // namespace detail
+
+/** @brief Initializes the global resources of the library for as long as it is in scope.
+ * */
+class GlobalScope final
+{
+public:
+  GlobalScope()
+    : initialized_(datviz_global_init() == 0)
+  {
+  }
+
+  ~GlobalScope()
+  {
+    if (initialized_)
+      datviz_global_cleanup();
+  }
+
+  GlobalScope(const GlobalScope&) = delete;
+
+  GlobalScope& operator=(const GlobalScope&) = delete;
+
+  explicit operator bool() const { return initialized_; }
+
+private:
+  bool initialized_ = false;
+};
+
+/** @brief A viewer window, destroyed along with this object.
+ * */
+class Viewer final
+{
+public:
+  Viewer()
+    : viz_(datviz_create())
+  {
+  }
+
+  ~Viewer() { datviz_destroy(viz_); }
+
+  Viewer(Viewer&& other) noexcept
+    : viz_(other.viz_)
+  {
+    other.viz_ = nullptr;
+  }
+
+  Viewer& operator=(Viewer&& other) noexcept
+  {
+    std::swap(viz_, other.viz_);
+    return *this;
+  }
+
+  Viewer(const Viewer&) = delete;
+
+  Viewer& operator=(const Viewer&) = delete;
+
+  /** @brief Whether the window was created successfully.
+   * */
+  explicit operator bool() const { return viz_ != nullptr; }
+
+  datviz_z* get() const { return viz_; }
+
+  bool should_close() const { return datviz_should_close(viz_) != 0; }
+
+  void poll_input() { datviz_poll_input(viz_); }
+
+  void begin_frame() { datviz_begin_frame(viz_); }
+
+  void end_frame() { datviz_end_frame(viz_); }
+
+  /** @brief Renders points straight from a borrowed buffer, without keeping them.
+   * */
+  void render_points(VertexSpan points)
+  {
+    if (points.fits())
+      datviz_render_points(viz_, points.data(), uint32_t(points.size()));
+  }
+
+private:
+  datviz_z* viz_ = nullptr;
+};
+
+/** @brief A point cloud kept in GPU memory, destroyed along with this object.
+ *
+ * @details The upload functions either borrow a buffer for the duration of the call, or take ownership of it and
+ *          release it as soon as the points are on the GPU. Neither makes a copy of the points on the CPU.
+ *          The cloud must be destroyed before the viewer that it was created with.
+ * */
+class Cloud final
+{
+public:
+  Cloud() = default;
+
+  explicit Cloud(Viewer& viewer)
+    : viz_(viewer.get())
+    , cloud_(viewer ? datviz_cloud_create(viewer.get()) : nullptr)
+  {
+  }
+
+  ~Cloud() { datviz_cloud_destroy(cloud_); }
+
+  Cloud(Cloud&& other) noexcept
+    : viz_(other.viz_)
+    , cloud_(other.cloud_)
+  {
+    other.viz_ = nullptr;
+    other.cloud_ = nullptr;
+  }
+
+  Cloud& operator=(Cloud&& other) noexcept
+  {
+    std::swap(viz_, other.viz_);
+    std::swap(cloud_, other.cloud_);
+    return *this;
+  }
+
+  Cloud(const Cloud&) = delete;
+
+  Cloud& operator=(const Cloud&) = delete;
+
+  /** @brief Whether the GPU resources of the cloud were created successfully.
+   * */
+  explicit operator bool() const { return cloud_ != nullptr; }
+
+  datviz_cloud_z* get() const { return cloud_; }
+
+  /** @brief Replaces the contents of the cloud with borrowed points.
+   * */
+  bool upload(VertexSpan points)
+  {
+    return points.fits() && (datviz_cloud_upload(cloud_, points.data(), uint32_t(points.size())) == 0);
+  }
+
+  /** @brief Replaces the contents of the cloud, taking ownership of the points.
+   *
+   * @details The vector is moved from, and its memory is released as soon as the upload is done.
+   * */
+  bool upload(std::vector<dataviz_vertex>&& points) { return upload_owned(std::move(points)); }
+
+  /** @brief Replaces the contents of the cloud, taking ownership of the points.
+   *
+   * @param deleter Called with @p data once the upload is done, or if it fails.
+   * */
+  template<typename Deleter>
+  bool upload(dataviz_vertex* data, size_t size, Deleter deleter)
+  {
+    auto* owned = new detail::OwnedPointer<Deleter>(data, std::move(deleter));
+
+    if (size > UINT32_MAX) {
+      delete owned;
+      return false;
+    }
+
+    return datviz_cloud_upload_owned(cloud_, data, uint32_t(size), &detail::OwnedBuffer::release, owned) == 0;
+  }
+
+  /** @brief Replaces the contents of the cloud with borrowed points, sorted along an axis.
+   *
+   * @details See @ref datviz_cloud_upload_sorted.
+   * */
+  bool upload_sorted(VertexSpan points, int axis)
+  {
+    return points.fits() && (datviz_cloud_upload_sorted(cloud_, points.data(), uint32_t(points.size()), axis) == 0);
+  }
+
+  /** @brief Replaces the contents of the cloud with borrowed points stored as separate columns.
+   * */
+  bool upload(const dataviz_point_columns& columns, uint32_t size)
+  {
+    return datviz_cloud_upload_columns(cloud_, &columns, size) == 0;
+  }
+
+  bool reserve(uint32_t capacity) { return datviz_cloud_reserve(cloud_, capacity) == 0; }
+
+  bool append(VertexSpan points)
+  {
+    return points.fits() && (datviz_cloud_append(cloud_, points.data(), uint32_t(points.size())) == 0);
+  }
+
+  bool append(const dataviz_point_columns& columns, uint32_t size)
+  {
+    return datviz_cloud_append_columns(cloud_, &columns, size) == 0;
+  }
+
+  void clear() { datviz_cloud_clear(cloud_); }
+
+  uint32_t size() const { return datviz_cloud_size(cloud_); }
+
+  void render() { datviz_render_cloud(viz_, cloud_); }
+
+  void render_slab(float min, float max) { datviz_render_cloud_slab(viz_, cloud_, min, max); }
+
+private:
+  template<typename Container>
+  bool upload_owned(Container&& points)
+  {
+    auto* owned = new detail::OwnedContainer<Container>(std::move(points));
+
+    auto& container = owned->container();
+
+    if (container.size() > UINT32_MAX) {
+      delete owned;
+      return false;
+    }
+
+    return datviz_cloud_upload_owned(
+             cloud_, container.data(), uint32_t(container.size()), &detail::OwnedBuffer::release, owned) == 0;
+  }
+
+  datviz_z* viz_ = nullptr;
+
+  datviz_cloud_z* cloud_ = nullptr;
+};
+
+} // namespace dataviz
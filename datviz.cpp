@@ -1,6 +1,14 @@
 #include "datviz.h"
 
+#include "datviz_capture.h"
+#include "datviz_colormap.h"
+#include "datviz_font.h"
+#include "datviz_gl_counters.h"
 #include "datviz_glad.h"
+#include "datviz_parallel.h"
+#include "datviz_perf.h"
+#include "datviz_tiles.h"
+#include "datviz_voxels.h"
 
 #include <GLFW/glfw3.h>
 
@@ -8,15 +16,27 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <assert.h>
+#include <stdio.h>
 #include <string.h>
 
+using namespace datviz_detail;
+
 //===========//
 // Constants //
 //===========//
@@ -25,6 +45,45 @@ namespace {
 
 constexpr uint32_t g_vertex_size = 16;
 
+constexpr uint32_t g_surfel_vertex_size = 20;
+
+/// How far above and below the XY plane the top down view reaches.
+constexpr float g_top_down_depth = 1.0e6f;
+
+/// The number of points that each thread takes at a time when sorting a cloud.
+constexpr size_t g_sort_grain = 65536;
+
+/// The number of points that are interleaved at a time when uploading columns, which keeps the staging buffer small.
+constexpr uint32_t g_column_block = 65536;
+
+/// The number of points that each thread interleaves at a time.
+constexpr size_t g_column_grain = 8192;
+
+/// The number of frames that a recycled buffer may go unused before it is deleted.
+constexpr uint64_t g_pool_max_idle_frames = 120;
+
+/// The most memory that recycled buffers may hold while they wait to be reused.
+constexpr GLsizeiptr g_pool_max_bytes = GLsizeiptr(256) << 20;
+
+/// From KHR_parallel_shader_compile, which the loader was not generated with.
+constexpr GLenum g_completion_status = 0x91B1;
+
+/// The number of frame times that are averaged and graphed by the performance overlay.
+constexpr size_t g_frame_history = 120;
+
+/// The frame time that the performance overlay graphs against, in milliseconds.
+constexpr float g_frame_budget_ms = 1000.0f / 60.0f;
+
+/// The distance of the performance overlay from the corner of the window, and between its text and graph, in pixels.
+constexpr float g_overlay_margin = 10.0f;
+
+constexpr float g_overlay_text_size = 14.0f;
+
+constexpr float g_overlay_graph_height = 60.0f;
+
+/// The horizontal distance between the frames of the overlay graph, in pixels.
+constexpr float g_overlay_graph_step = 2.0f;
+
 } // namespace
 
 //===================//
@@ -141,6 +200,8 @@ public:
 
   bool is_created() const { return window_ != nullptr; }
 
+  GLFWwindow* handle() { return window_; }
+
   bool make_context_current()
   {
     auto* win = get_or_initialize_window();
@@ -165,6 +226,30 @@ public:
     return true;
   }
 
+  /** @brief Shows or hides the window, or decides whether it is shown once it is created.
+   * */
+  void set_visible(bool visible)
+  {
+    visible_ = visible;
+
+    if (!window_)
+      return;
+
+    if (visible)
+      glfwShowWindow(window_);
+    else
+      glfwHideWindow(window_);
+  }
+
+  void set_vsync_enabled(bool enabled)
+  {
+    vsync_enabled_ = enabled;
+
+    // The swap interval belongs to the context, so it can only be set while the context is current.
+    if (make_context_current())
+      glfwSwapInterval(enabled ? 1 : 0);
+  }
+
   bool get_window_size(int* w, int* h)
   {
     auto* win = get_or_initialize_window();
@@ -192,6 +277,7 @@ private:
       return window_;
 
     glfwWindowHint(GLFW_MAXIMIZED, GLFW_TRUE);
+    glfwWindowHint(GLFW_VISIBLE, visible_ ? GLFW_TRUE : GLFW_FALSE);
     glfwWindowHint(GLFW_SAMPLES, 4);
     glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -209,6 +295,10 @@ private:
 
     gladLoadGLES2Loader((GLADloadproc)glfwGetProcAddress);
 
+    install_gl_counters();
+
+    glfwSwapInterval(vsync_enabled_ ? 1 : 0);
+
     glEnable(GL_DEPTH);
 
     return window_;
@@ -225,6 +315,221 @@ private:
 
 private:
   GLFWwindow* window_ = nullptr;
+
+  bool visible_ = true;
+
+  bool vsync_enabled_ = true;
+};
+
+} // namespace
+
+//=============//
+// Buffer Pool //
+//=============//
+
+namespace {
+
+/** @brief Holds on to released vertex buffers until the GPU is done with them, and hands them to new allocations.
+ *
+ * @details Buffers that are released during a frame are tagged with a fence at the end of the frame, so neither
+ *          deleting nor reusing them waits on draws that still read them. Once the fence has signaled, a buffer can be
+ *          handed to an allocation that needs between half and all of it. Buffers that go unused for a while, or that
+ *          push the pool over its memory budget, are deleted.
+ * */
+class BufferPool final
+{
+public:
+  /** @brief Gets a buffer with room for at least a number of bytes, and binds it to a target.
+   *
+   * @param capacity Set to the size of the buffer, which may be larger than the size that was asked for.
+   * */
+  GLuint acquire(GLenum target, GLsizeiptr size, GLenum usage, GLsizeiptr& capacity)
+  {
+    auto best = free_.end();
+
+    for (auto it = free_.begin(); it != free_.end(); ++it) {
+      if ((it->capacity >= size) && (it->capacity <= (size * 2)) &&
+          ((best == free_.end()) || (it->capacity < best->capacity)))
+        best = it;
+    }
+
+    GLuint buffer = 0;
+
+    if (best != free_.end()) {
+
+      buffer = best->buffer;
+
+      capacity = best->capacity;
+
+      free_bytes_ -= capacity;
+
+      free_.erase(best);
+
+      glBindBuffer(target, buffer);
+
+      return buffer;
+    }
+
+    glGenBuffers(1, &buffer);
+
+    glBindBuffer(target, buffer);
+
+    glBufferData(target, size, nullptr, usage);
+
+    capacity = size;
+
+    allocated_bytes_ += size;
+
+    return buffer;
+  }
+
+  /** @brief Gives a buffer back to the pool, once the commands that have been issued so far are done with it.
+   * */
+  void release(GLuint buffer, GLsizeiptr capacity)
+  {
+    if (buffer == 0)
+      return;
+
+    // A buffer without storage is not worth keeping, and the GPU cannot be reading from it.
+    if (capacity == 0) {
+      glDeleteBuffers(1, &buffer);
+      return;
+    }
+
+    pending_.push_back(PooledBuffer{ buffer, capacity, 0 });
+  }
+
+  /** @brief Fences the buffers released during this frame, and recycles the ones whose fences have signaled.
+   * */
+  void end_frame()
+  {
+    frame_++;
+
+    if (!pending_.empty()) {
+
+      const GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+      if (fence) {
+        in_flight_.push_back(FencedBatch{ fence, std::move(pending_) });
+      } else {
+        // Without a fence there is no telling when the GPU is done, so the buffers are left for the driver to delete.
+        for (const auto& b : pending_) {
+          glDeleteBuffers(1, &b.buffer);
+          allocated_bytes_ -= b.capacity;
+        }
+      }
+
+      pending_.clear();
+    }
+
+    // Fences signal in the order that they were made, so polling stops at the first one that has not.
+    size_t signaled = 0;
+
+    for (; signaled < in_flight_.size(); signaled++) {
+
+      auto& batch = in_flight_[signaled];
+
+      if (glClientWaitSync(batch.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        break;
+
+      glDeleteSync(batch.fence);
+
+      for (auto& b : batch.buffers) {
+        b.last_used_frame = frame_;
+        free_bytes_ += b.capacity;
+        free_.push_back(b);
+      }
+    }
+
+    in_flight_.erase(in_flight_.begin(), in_flight_.begin() + std::ptrdiff_t(signaled));
+
+    trim();
+  }
+
+  void cleanup()
+  {
+    for (const auto& batch : in_flight_) {
+
+      glDeleteSync(batch.fence);
+
+      for (const auto& b : batch.buffers)
+        glDeleteBuffers(1, &b.buffer);
+    }
+
+    for (const auto& b : pending_)
+      glDeleteBuffers(1, &b.buffer);
+
+    for (const auto& b : free_)
+      glDeleteBuffers(1, &b.buffer);
+
+    in_flight_.clear();
+
+    pending_.clear();
+
+    free_.clear();
+
+    free_bytes_ = 0;
+
+    allocated_bytes_ = 0;
+  }
+
+  /** @brief Gets the size of every buffer that was made by the pool and not yet deleted, whether in use or not.
+   * */
+  uint64_t allocated_bytes() const { return uint64_t(allocated_bytes_); }
+
+private:
+  struct PooledBuffer final
+  {
+    GLuint buffer = 0;
+
+    GLsizeiptr capacity = 0;
+
+    uint64_t last_used_frame = 0;
+  };
+
+  struct FencedBatch final
+  {
+    GLsync fence = nullptr;
+
+    std::vector<PooledBuffer> buffers;
+  };
+
+  /** @brief Deletes the buffers that have gone unused for too long, or that do not fit in the budget.
+   *
+   * @details Free buffers are kept in the order that they were recycled in, so the oldest ones go first.
+   * */
+  void trim()
+  {
+    size_t expired = 0;
+
+    for (; expired < free_.size(); expired++) {
+
+      const auto& b = free_[expired];
+
+      if (((frame_ - b.last_used_frame) <= g_pool_max_idle_frames) && (free_bytes_ <= g_pool_max_bytes))
+        break;
+
+      glDeleteBuffers(1, &b.buffer);
+
+      free_bytes_ -= b.capacity;
+
+      allocated_bytes_ -= b.capacity;
+    }
+
+    free_.erase(free_.begin(), free_.begin() + std::ptrdiff_t(expired));
+  }
+
+  std::vector<PooledBuffer> pending_;
+
+  std::vector<FencedBatch> in_flight_;
+
+  std::vector<PooledBuffer> free_;
+
+  GLsizeiptr free_bytes_ = 0;
+
+  GLsizeiptr allocated_bytes_ = 0;
+
+  uint64_t frame_ = 0;
 };
 
 } // namespace
@@ -242,6 +547,112 @@ struct Vertex final
   unsigned char rgba[4]{ 192, 192, 192, 255 };
 };
 
+/** @brief Describes one attribute of a vertex format.
+ * */
+struct VertexAttribute final
+{
+  GLuint location = 0;
+
+  GLint size = 0;
+
+  GLenum type = GL_FLOAT;
+
+  GLboolean normalized = GL_FALSE;
+
+  uint32_t offset = 0;
+
+  /// Non-zero for per-instance attributes.
+  GLuint divisor = 0;
+};
+
+/** @brief Describes how vertices are laid out in a vertex buffer.
+ * */
+struct VertexLayout final
+{
+  uint32_t stride = 0;
+
+  std::vector<VertexAttribute> attributes;
+};
+
+/** @brief The layout of @ref dataviz_vertex : 12 bytes per position, 4 bytes per color.
+ * */
+VertexLayout
+point_vertex_layout()
+{
+  return VertexLayout{ g_vertex_size,
+                       { { 0, 3, GL_FLOAT, GL_FALSE, 0 }, { 1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 12 } } };
+}
+
+/** @brief The layout of @ref dataviz_surfel_vertex : a point vertex followed by an octahedron encoded normal.
+ * */
+VertexLayout
+surfel_vertex_layout()
+{
+  return VertexLayout{
+    g_surfel_vertex_size,
+    { { 0, 3, GL_FLOAT, GL_FALSE, 0 }, { 1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 12 }, { 2, 2, GL_SHORT, GL_TRUE, 16 } }
+  };
+}
+
+/** @brief The layout of a line segment instance: two point vertices, one for each end of the segment.
+ * */
+VertexLayout
+segment_instance_layout()
+{
+  return VertexLayout{ 2 * g_vertex_size,
+                       { { 0, 3, GL_FLOAT, GL_FALSE, 0, 1 },
+                         { 1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 12, 1 },
+                         { 2, 3, GL_FLOAT, GL_FALSE, 16, 1 },
+                         { 3, 4, GL_UNSIGNED_BYTE, GL_TRUE, 28, 1 } } };
+}
+
+/** @brief The layout of a box instance, see @ref BoxInstance.
+ * */
+VertexLayout
+box_instance_layout()
+{
+  return VertexLayout{ 36,
+                       { { 0, 3, GL_FLOAT, GL_FALSE, 0, 1 },
+                         { 1, 3, GL_FLOAT, GL_FALSE, 12, 1 },
+                         { 2, 4, GL_SHORT, GL_TRUE, 24, 1 },
+                         { 3, 4, GL_UNSIGNED_BYTE, GL_TRUE, 32, 1 } } };
+}
+
+/** @brief The layout of a glyph instance, see @ref GlyphInstance.
+ * */
+VertexLayout
+glyph_instance_layout()
+{
+  return VertexLayout{ 28,
+                       { { 0, 3, GL_FLOAT, GL_FALSE, 0, 1 },
+                         { 1, 1, GL_FLOAT, GL_FALSE, 12, 1 },
+                         { 2, 2, GL_SHORT, GL_FALSE, 16, 1 },
+                         { 3, 4, GL_UNSIGNED_BYTE, GL_TRUE, 20, 1 },
+                         { 4, 1, GL_UNSIGNED_SHORT, GL_FALSE, 24, 1 } } };
+}
+
+/** @brief The layout of an arrow instance, see @ref ArrowInstance.
+ * */
+VertexLayout
+arrow_instance_layout()
+{
+  return VertexLayout{ 28,
+                       { { 0, 3, GL_FLOAT, GL_FALSE, 0, 1 },
+                         { 1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 12, 1 },
+                         { 2, 3, GL_FLOAT, GL_FALSE, 16, 1 } } };
+}
+
+/** @brief The layout of a voxel instance, see @ref VoxelInstance.
+ * */
+VertexLayout
+voxel_instance_layout()
+{
+  return VertexLayout{ 20,
+                       { { 0, 3, GL_FLOAT, GL_FALSE, 0, 1 },
+                         { 1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 12, 1 },
+                         { 2, 1, GL_UNSIGNED_BYTE, GL_FALSE, 16, 1 } } };
+}
+
 class VertexArray final
 {
 public:
@@ -253,25 +664,37 @@ public:
   {
     // These should have been cleaned up before this.
     assert(buffer_ == 0);
+    assert(index_buffer_ == 0);
     assert(array_ == 0);
   }
 
-  bool init()
+  /** @brief Creates the vertex array and its buffers.
+   *
+   * @param pool If this is not null, the vertex buffer is taken from and released to this pool.
+   * */
+  bool init(const VertexLayout& layout = point_vertex_layout(), BufferPool* pool = nullptr)
   {
+    layout_ = layout;
+
+    pool_ = pool;
+
     glGenBuffers(1, &buffer_);
 
+    glGenBuffers(1, &index_buffer_);
+
     glGenVertexArrays(1, &array_);
 
     glBindBuffer(GL_ARRAY_BUFFER, buffer_);
 
     glBindVertexArray(array_);
 
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
+    // The element buffer binding is part of the vertex array state.
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer_);
+
+    for (const auto& attrib : layout_.attributes)
+      glEnableVertexAttribArray(attrib.location);
 
-    const auto stride = 16; // 12 bytes per position, 4 bytes per color
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, 0);
-    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, reinterpret_cast<const void*>(12));
+    setup_attributes();
 
     glBindVertexArray(0);
 
@@ -282,13 +705,15 @@ public:
 
   void cleanup()
   {
-    if (buffer_ != 0)
-      glDeleteBuffers(1, &buffer_);
+    release_buffer();
+
+    if (index_buffer_ != 0)
+      glDeleteBuffers(1, &index_buffer_);
 
     if (array_ != 0)
       glDeleteVertexArrays(1, &array_);
 
-    buffer_ = 0;
+    index_buffer_ = 0;
 
     array_ = 0;
   }
@@ -313,14 +738,132 @@ public:
   {
     assert(is_bound_);
 
-    glBufferData(GL_ARRAY_BUFFER, vertex_count * g_vertex_size, data, usage);
+    const GLsizeiptr size = GLsizeiptr(vertex_count) * layout_.stride;
+
+    if (!pool_) {
+      glBufferData(GL_ARRAY_BUFFER, size, data, usage);
+      buffer_capacity_ = size;
+      return glGetError() == GL_NO_ERROR;
+    }
+
+    // The GPU may still be drawing from the old buffer, so it is swapped for one that the GPU is done with.
+    release_buffer();
+
+    buffer_ = pool_->acquire(GL_ARRAY_BUFFER, size, usage, buffer_capacity_);
+
+    setup_attributes();
+
+    if (data && (size > 0))
+      glBufferSubData(GL_ARRAY_BUFFER, 0, size, data);
+
+    return glGetError() == GL_NO_ERROR;
+  }
+
+  bool buffer_indices(const uint32_t* indices, uint32_t index_count, GLenum usage = GL_DYNAMIC_DRAW)
+  {
+    assert(is_bound_);
+
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_count * sizeof(uint32_t), indices, usage);
+
+    return glGetError() == GL_NO_ERROR;
+  }
+
+  bool buffer_sub_data(uint32_t first_vertex, const void* data, uint32_t vertex_count)
+  {
+    assert(is_bound_);
+
+    glBufferSubData(GL_ARRAY_BUFFER,
+                    GLintptr(first_vertex) * layout_.stride,
+                    GLsizeiptr(vertex_count) * layout_.stride,
+                    data);
+
+    return glGetError() == GL_NO_ERROR;
+  }
+
+  /** @brief Replaces the vertex buffer with a larger one, copying over the vertices that should be kept.
+   *
+   * @details The copy happens on the GPU, so the vertices never travel back to the host.
+   * */
+  bool reallocate(uint32_t vertex_capacity, uint32_t kept_vertex_count, GLenum usage = GL_STATIC_DRAW)
+  {
+    assert(is_bound_);
+
+    const GLsizeiptr size = GLsizeiptr(vertex_capacity) * layout_.stride;
+
+    GLsizeiptr new_capacity = size;
+
+    GLuint new_buffer = 0;
+
+    if (pool_) {
+      new_buffer = pool_->acquire(GL_COPY_WRITE_BUFFER, size, usage, new_capacity);
+    } else {
+      glGenBuffers(1, &new_buffer);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, new_buffer);
+      glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, usage);
+    }
+
+    if (kept_vertex_count > 0) {
+      glBindBuffer(GL_COPY_READ_BUFFER, buffer_);
+      glCopyBufferSubData(
+        GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, GLsizeiptr(kept_vertex_count) * layout_.stride);
+      glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    release_buffer();
+
+    buffer_ = new_buffer;
+
+    buffer_capacity_ = new_capacity;
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+
+    setup_attributes();
 
     return glGetError() == GL_NO_ERROR;
   }
 
+  /** @brief Gets the number of vertices that fit in the vertex buffer, which may be more than were last uploaded.
+   * */
+  uint32_t capacity() const { return uint32_t(buffer_capacity_ / layout_.stride); }
+
+private:
+  void release_buffer()
+  {
+    if (pool_)
+      pool_->release(buffer_, buffer_capacity_);
+    else if (buffer_ != 0)
+      glDeleteBuffers(1, &buffer_);
+
+    buffer_ = 0;
+
+    buffer_capacity_ = 0;
+  }
+
+  /** @brief Points the vertex attributes at the currently bound vertex buffer.
+   * */
+  void setup_attributes()
+  {
+    for (const auto& a : layout_.attributes) {
+      const auto* offset = reinterpret_cast<const void*>(static_cast<uintptr_t>(a.offset));
+      glVertexAttribPointer(a.location, a.size, a.type, a.normalized, layout_.stride, offset);
+      glVertexAttribDivisor(a.location, a.divisor);
+    }
+  }
+
 private:
+  VertexLayout layout_;
+
+  BufferPool* pool_ = nullptr;
+
   GLuint buffer_ = 0;
 
+  /// The size of the vertex buffer, in bytes.
+  GLsizeiptr buffer_capacity_ = 0;
+
+  GLuint index_buffer_ = 0;
+
   GLuint array_ = 0;
 
   bool is_bound_ = false;
@@ -344,7 +887,9 @@ public:
 
   ~Shader() { assert(id_ == 0); }
 
-  bool init(const char* source)
+  /** @brief Issues the compile, without waiting for it to finish.
+   * */
+  void start(const char* source)
   {
     id_ = glCreateShader(Kind);
 
@@ -353,24 +898,11 @@ public:
     glShaderSource(id_, 1, &source, &length);
 
     glCompileShader(id_);
-
-    return check_shader(source);
-  }
-
-  void cleanup()
-  {
-    if (id_ == 0)
-      return;
-
-    glDeleteShader(id_);
-
-    id_ = 0;
   }
 
-  GLuint id() { return id_; }
-
-private:
-  bool check_shader(const char* source)
+  /** @brief Waits for the compile to finish, printing the errors if it failed.
+   * */
+  bool check(const char* source)
   {
     GLint is_compiled = GL_FALSE;
 
@@ -394,6 +926,19 @@ private:
     return false;
   }
 
+  void cleanup()
+  {
+    if (id_ == 0)
+      return;
+
+    glDeleteShader(id_);
+
+    id_ = 0;
+  }
+
+  GLuint id() { return id_; }
+
+private:
   void print_shader_error(const char* source, const std::string& info_log, std::ostream& stream)
   {
     size_t line = 1;
@@ -425,53 +970,391 @@ private:
 
 } // namespace
 
-//================//
-// Shader Program //
-//================//
+//=================//
+// Shader Compiler //
+//=================//
 
 namespace {
 
-class ShaderProgram final
+/** @brief The objects of a program that is being compiled, which may be filled in by another thread.
+ * */
+struct CompileJob final
 {
-public:
-  ShaderProgram() = default;
+  const char* vert_source = nullptr;
 
-  ShaderProgram(const ShaderProgram&) = delete;
+  const char* frag_source = nullptr;
 
-  ~ShaderProgram() { assert(id_ == 0); }
+  Shader<GL_VERTEX_SHADER> vert_shader;
 
-  bool init(const char* vert_source, const char* frag_source)
+  Shader<GL_FRAGMENT_SHADER> frag_shader;
+
+  GLuint program = 0;
+
+  /// Set once the program is linked and can be used from the context of the window.
+  std::atomic<bool> done{ false };
+
+  /** @brief Issues the compiles and the link, without waiting for any of them to finish.
+   * */
+  void start()
   {
-    Shader<GL_VERTEX_SHADER> vert_shader;
+    vert_shader.start(vert_source);
 
-    if (!vert_shader.init(vert_source)) {
-      vert_shader.cleanup();
-      return false;
+    frag_shader.start(frag_source);
+
+    program = glCreateProgram();
+
+    glAttachShader(program, vert_shader.id());
+
+    glAttachShader(program, frag_shader.id());
+
+    glLinkProgram(program);
+  }
+
+  void cleanup()
+  {
+    vert_shader.cleanup();
+
+    frag_shader.cleanup();
+
+    if (program != 0)
+      glDeleteProgram(program);
+
+    program = 0;
+  }
+};
+
+/** @brief Compiles shader programs away from the render loop, so that the first frames do not wait on the compiler.
+ *
+ * @details With KHR_parallel_shader_compile, programs are compiled on the threads of the driver and polled for
+ *          completion. Otherwise they are compiled on a worker thread, in a hidden context that shares its objects with
+ *          the window. If that context cannot be made either, programs are compiled as they are submitted.
+ * */
+class ShaderCompiler final
+{
+public:
+  ~ShaderCompiler() { assert(!worker_.joinable()); }
+
+  /** @brief Picks the way that programs are compiled.
+   *
+   * @details This must be called on the main thread, with the context of the window current.
+   * */
+  void init(GLFWwindow* window)
+  {
+    if (enable_parallel_compile()) {
+      mode_ = Mode::parallel;
+      return;
+    }
+
+    glfwDefaultWindowHints();
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+
+    worker_context_ = glfwCreateWindow(1, 1, "", nullptr, window);
+
+    glfwDefaultWindowHints();
+
+    if (!worker_context_) {
+      mode_ = Mode::immediate;
+      return;
+    }
+
+    mode_ = Mode::worker;
+
+    stopping_ = false;
+
+    worker_ = std::thread([this]() { run_worker(); });
+  }
+
+  /** @brief Stops the worker, if there is one. Jobs that it has not started are left without a program.
+   * */
+  void cleanup()
+  {
+    if (worker_.joinable()) {
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+      }
+
+      wake_.notify_one();
+
+      worker_.join();
+    }
+
+    queue_.clear();
+
+    if (worker_context_)
+      glfwDestroyWindow(worker_context_);
+
+    worker_context_ = nullptr;
+  }
+
+  void submit(const std::shared_ptr<CompileJob>& job)
+  {
+    if (mode_ == Mode::worker) {
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(job);
+      }
+
+      wake_.notify_one();
+
+      return;
     }
 
-    Shader<GL_FRAGMENT_SHADER> frag_shader;
+    job->start();
+
+    if (mode_ == Mode::immediate)
+      job->done.store(true, std::memory_order_release);
+  }
+
+  /** @brief Checks whether a job is done, without waiting for it.
+   * */
+  bool is_done(CompileJob& job) const
+  {
+    if (job.done.load(std::memory_order_acquire))
+      return true;
+
+    if (mode_ != Mode::parallel)
+      return false;
+
+    GLint completed = GL_FALSE;
 
-    if (!frag_shader.init(frag_source)) {
-      vert_shader.cleanup();
-      frag_shader.cleanup();
+    glGetProgramiv(job.program, g_completion_status, &completed);
+
+    if (completed != GL_TRUE)
       return false;
+
+    job.done.store(true, std::memory_order_release);
+
+    return true;
+  }
+
+  /** @brief Waits for a job to be done.
+   *
+   * @details A job that the worker has not started yet is taken back and compiled on the calling thread, instead of
+   *          waiting behind the jobs before it. This must be called with the context of the window current.
+   * */
+  void wait(CompileJob& job)
+  {
+    if (job.done.load(std::memory_order_acquire))
+      return;
+
+    if (mode_ == Mode::parallel) {
+      // Querying the link status waits for the link.
+      GLint linked = GL_FALSE;
+      glGetProgramiv(job.program, GL_LINK_STATUS, &linked);
+      job.done.store(true, std::memory_order_release);
+      return;
+    }
+
+    if (mode_ != Mode::worker)
+      return;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    const auto queued = std::find_if(
+      queue_.begin(), queue_.end(), [&job](const std::shared_ptr<CompileJob>& other) { return other.get() == &job; });
+
+    if (queued != queue_.end()) {
+
+      queue_.erase(queued);
+
+      lock.unlock();
+
+      job.start();
+
+      job.done.store(true, std::memory_order_release);
+
+      return;
+    }
+
+    finished_.wait(lock, [this, &job]() { return stopping_ || job.done.load(std::memory_order_acquire); });
+  }
+
+private:
+  enum class Mode
+  {
+    immediate,
+    parallel,
+    worker
+  };
+
+  typedef void(APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+
+  static bool enable_parallel_compile()
+  {
+    GLint extension_count = 0;
+
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+
+    for (GLint i = 0; i < extension_count; i++) {
+
+      const auto* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, GLuint(i)));
+
+      if (!name || (strcmp(name, "GL_KHR_parallel_shader_compile") != 0))
+        continue;
+
+      auto max_threads =
+        reinterpret_cast<MaxShaderCompilerThreadsProc>(glfwGetProcAddress("glMaxShaderCompilerThreadsKHR"));
+
+      if (!max_threads)
+        return false;
+
+      // Lets the driver use as many threads as it likes.
+      max_threads(0xffffffffu);
+
+      return true;
+    }
+
+    return false;
+  }
+
+  void run_worker()
+  {
+    glfwMakeContextCurrent(worker_context_);
+
+    for (;;) {
+
+      std::shared_ptr<CompileJob> job;
+
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        wake_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+
+        if (stopping_)
+          break;
+
+        job = queue_.front();
+
+        queue_.pop_front();
+      }
+
+      job->start();
+
+      // Querying the link status waits for the link, and finishing makes the program complete in the other context.
+      GLint linked = GL_FALSE;
+
+      glGetProgramiv(job->program, GL_LINK_STATUS, &linked);
+
+      glFinish();
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job->done.store(true, std::memory_order_release);
+      }
+
+      finished_.notify_all();
     }
 
-    id_ = glCreateProgram();
+    glfwMakeContextCurrent(nullptr);
+  }
+
+  Mode mode_ = Mode::immediate;
+
+  GLFWwindow* worker_context_ = nullptr;
+
+  std::thread worker_;
+
+  std::mutex mutex_;
 
-    glAttachShader(id_, vert_shader.id());
-    glAttachShader(id_, frag_shader.id());
+  std::condition_variable wake_;
 
-    glLinkProgram(id_);
+  /// Signaled when the worker is done with a job, for threads that @ref wait on one.
+  std::condition_variable finished_;
 
-    glDetachShader(id_, vert_shader.id());
-    glDetachShader(id_, frag_shader.id());
+  std::deque<std::shared_ptr<CompileJob>> queue_;
+
+  bool stopping_ = false;
+};
+
+} // namespace
+
+//================//
+// Shader Program //
+//================//
+
+namespace {
+
+class ShaderProgram final
+{
+public:
+  ShaderProgram() = default;
+
+  ShaderProgram(const ShaderProgram&) = delete;
+
+  ~ShaderProgram() { assert((id_ == 0) && !job_); }
+
+  /** @brief Compiles and links the program, waiting for it to finish.
+   * */
+  bool init(const char* vert_source, const char* frag_source)
+  {
+    job_ = make_job(vert_source, frag_source);
+
+    job_->start();
+
+    return finish();
+  }
+
+  /** @brief Starts compiling the program in the background. Use @ref ready to find out when it can be drawn with.
+   * */
+  bool init(ShaderCompiler& compiler, const char* vert_source, const char* frag_source)
+  {
+    compiler_ = &compiler;
+
+    job_ = make_job(vert_source, frag_source);
+
+    compiler.submit(job_);
 
     return glGetError() == GL_NO_ERROR;
   }
 
+  /** @brief Whether the program has finished compiling in the background, and can be drawn with.
+   *
+   * @param setup Called with the program bound the first time that it is ready, to look up its uniforms.
+   * */
+  template<typename Setup>
+  bool ready(Setup setup)
+  {
+    if (id_ != 0)
+      return true;
+
+    // A program that failed to build stays without an ID and a job, so it is never checked again.
+    if (!job_ || !compiler_ || !compiler_->is_done(*job_))
+      return false;
+
+    if (!finish())
+      return false;
+
+    bind();
+
+    setup();
+
+    unbind();
+
+    return true;
+  }
+
+  /** @brief Waits for the program to finish compiling in the background, for drawing with a program that has nothing
+   *         to fall back on until it is ready.
+   * */
+  void wait()
+  {
+    if ((id_ == 0) && job_ && compiler_)
+      compiler_->wait(*job_);
+  }
+
   void cleanup()
   {
+    if (job_)
+      job_->cleanup();
+
+    job_.reset();
+
     if (id_ == 0)
       return;
 
@@ -502,6 +1385,66 @@ public:
   }
 
 private:
+  static std::shared_ptr<CompileJob> make_job(const char* vert_source, const char* frag_source)
+  {
+    auto job = std::make_shared<CompileJob>();
+
+    job->vert_source = vert_source;
+
+    job->frag_source = frag_source;
+
+    return job;
+  }
+
+  /** @brief Checks the results of the job, and takes the program from it if it linked.
+   * */
+  bool finish()
+  {
+    auto job = std::move(job_);
+
+    // A worker that was stopped before it got to the job leaves it without a program.
+    bool success = job->program != 0;
+
+    success = success && job->vert_shader.check(job->vert_source);
+
+    success = success && job->frag_shader.check(job->frag_source);
+
+    GLint linked = GL_FALSE;
+
+    if (success)
+      glGetProgramiv(job->program, GL_LINK_STATUS, &linked);
+
+    if (success && (linked != GL_TRUE)) {
+
+      GLint max_length = 0;
+
+      glGetProgramiv(job->program, GL_INFO_LOG_LENGTH, &max_length);
+
+      std::string info_log(size_t(std::max(max_length, 1)), '\0');
+
+      glGetProgramInfoLog(job->program, max_length, &max_length, &info_log[0]);
+
+      std::cerr << info_log;
+
+      success = false;
+    }
+
+    if (success) {
+      glDetachShader(job->program, job->vert_shader.id());
+      glDetachShader(job->program, job->frag_shader.id());
+      id_ = job->program;
+      job->program = 0;
+    }
+
+    job->cleanup();
+
+    return success;
+  }
+
+  ShaderCompiler* compiler_ = nullptr;
+
+  std::shared_ptr<CompileJob> job_;
+
   GLuint id_ = 0;
 
   bool is_bound_ = false;
@@ -539,13 +1482,16 @@ void main()
 const char* frag_source = R"(
 #version 300 es
 
+// When non-zero, points write this weight into every channel instead of their color, for counting them.
+uniform highp float splat_weight;
+
 in lowp vec4 g_point_color;
 
-out lowp vec4 g_out_color;
+out highp vec4 g_out_color;
 
 void main()
 {
-  g_out_color = g_point_color;
+  g_out_color = (splat_weight > 0.0) ? vec4(splat_weight) : g_point_color;
 }
 )";
 
@@ -559,11 +1505,21 @@ public:
     if (!shader_program_.init(point_shader::vert_source, point_shader::frag_source))
       return false;
 
+    shader_program_.bind();
+
     mvp_location_ = shader_program_.get_uniform_location("mvp");
 
-    return true;
+    splat_weight_location_ = shader_program_.get_uniform_location("splat_weight");
+
+    shader_program_.unbind();
+
+    return vertex_array_.init();
   }
 
+  /** @brief Sets the weight that points add to a density target, or zero to draw points with their colors.
+   * */
+  void set_splat_weight(float weight) { splat_weight_ = weight; }
+
   void cleanup()
   {
     shader_program_.cleanup();
@@ -581,6 +1537,8 @@ public:
 
     glUniformMatrix4fv(mvp_location_, 1, GL_FALSE, glm::value_ptr(mvp));
 
+    glUniform1f(splat_weight_location_, splat_weight_);
+
     glDrawArrays(GL_POINTS, 0, point_count);
 
     shader_program_.unbind();
@@ -590,329 +1548,4016 @@ public:
     return glGetError() == GL_NO_ERROR;
   }
 
+  bool render_indexed_points(const dataviz_vertex_z* vertices,
+                             uint32_t point_count,
+                             const uint32_t* indices,
+                             uint32_t index_count,
+                             const glm::mat4& mvp)
+  {
+    vertex_array_.bind();
+
+    shader_program_.bind();
+
+    vertex_array_.buffer_data(vertices, point_count);
+
+    vertex_array_.buffer_indices(indices, index_count);
+
+    glUniformMatrix4fv(mvp_location_, 1, GL_FALSE, glm::value_ptr(mvp));
+
+    glUniform1f(splat_weight_location_, splat_weight_);
+
+    glDrawElements(GL_POINTS, index_count, GL_UNSIGNED_INT, nullptr);
+
+    shader_program_.unbind();
+
+    vertex_array_.unbind();
+
+    return glGetError() == GL_NO_ERROR;
+  }
+
+  bool render_vertex_array(VertexArray& vertex_array, uint32_t first, uint32_t count, const glm::mat4& mvp)
+  {
+    vertex_array.bind();
+
+    shader_program_.bind();
+
+    glUniformMatrix4fv(mvp_location_, 1, GL_FALSE, glm::value_ptr(mvp));
+
+    glUniform1f(splat_weight_location_, splat_weight_);
+
+    glDrawArrays(GL_POINTS, first, count);
+
+    shader_program_.unbind();
+
+    vertex_array.unbind();
+
+    return glGetError() == GL_NO_ERROR;
+  }
+
 private:
   ShaderProgram shader_program_;
 
   VertexArray vertex_array_;
 
-  GLint mvp_location_ = -1;
-};
+  GLint mvp_location_ = -1;
+
+  GLint splat_weight_location_ = -1;
+
+  float splat_weight_ = 0;
+};
+
+} // namespace
+
+//=======================//
+// Surfel Shader Program //
+//=======================//
+
+namespace {
+
+namespace surfel_shader {
+
+const char* vert_source = R"(
+#version 300 es
+
+uniform highp mat4 mvp;
+
+uniform highp mat4 model_view;
+
+// The number of pixels covered by one unit at a clip space W of one.
+uniform highp float point_scale;
+
+uniform highp float radius;
+
+uniform bool cull_backfaces;
+
+layout(location = 0) in highp vec3 g_position;
+
+layout(location = 1) in lowp vec4 g_color;
+
+layout(location = 2) in highp vec2 g_normal;
+
+out lowp vec4 g_surfel_color;
+
+out highp vec3 g_view_normal;
+
+highp vec3 decode_normal(highp vec2 e)
+{
+  highp vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  if (n.z < 0.0)
+    n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+  return normalize(n);
+}
+
+void main()
+{
+  highp vec4 view_position = model_view * vec4(g_position, 1.0);
+
+  highp vec3 n = normalize(mat3(model_view) * decode_normal(g_normal));
+
+  bool facing_away = dot(n, -view_position.xyz) < 0.0;
+
+  if (facing_away && cull_backfaces) {
+    // Outside of the clip volume, so the point is dropped before rasterization.
+    gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+    gl_PointSize = 1.0;
+    return;
+  }
+
+  g_view_normal = facing_away ? -n : n;
+
+  g_surfel_color = g_color;
+
+  gl_Position = mvp * vec4(g_position, 1.0);
+
+  gl_PointSize = max((2.0 * radius * point_scale) / gl_Position.w, 1.0);
+}
+)";
+
+const char* frag_source = R"(
+#version 300 es
+
+in lowp vec4 g_surfel_color;
+
+in highp vec3 g_view_normal;
+
+out lowp vec4 g_out_color;
+
+void main()
+{
+  // Sprite coordinates, with Y pointing up to match view space.
+  highp vec2 c = (gl_PointCoord * 2.0) - 1.0;
+  c.y = -c.y;
+
+  highp vec3 n = g_view_normal;
+
+  // The depth of the disk plane at this coordinate, relative to the center of the disk.
+  highp float dz = -((n.x * c.x) + (n.y * c.y)) / max(abs(n.z), 0.05);
+
+  if (dot(c, c) + (dz * dz) > 1.0)
+    discard;
+
+  // A head light, pointing down the view direction.
+  lowp float diffuse = abs(n.z);
+
+  g_out_color = vec4(g_surfel_color.rgb * (0.25 + (0.75 * diffuse)), g_surfel_color.a);
+}
+)";
+
+} // namespace surfel_shader
+
+class SurfelShaderProgram final
+{
+public:
+  bool init(ShaderCompiler& compiler)
+  {
+    if (!shader_program_.init(compiler, surfel_shader::vert_source, surfel_shader::frag_source))
+      return false;
+
+    return vertex_array_.init(surfel_vertex_layout());
+  }
+
+  bool ready()
+  {
+    return shader_program_.ready([this]() {
+      mvp_location_ = shader_program_.get_uniform_location("mvp");
+
+      model_view_location_ = shader_program_.get_uniform_location("model_view");
+
+      point_scale_location_ = shader_program_.get_uniform_location("point_scale");
+
+      radius_location_ = shader_program_.get_uniform_location("radius");
+
+      cull_backfaces_location_ = shader_program_.get_uniform_location("cull_backfaces");
+    });
+  }
+
+  void cleanup()
+  {
+    shader_program_.cleanup();
+
+    vertex_array_.cleanup();
+  }
+
+  /** @brief Uploads surfels without drawing them, so that they can be drawn by another program.
+   * */
+  VertexArray& upload(const dataviz_surfel_vertex_z* vertices, uint32_t count)
+  {
+    vertex_array_.bind();
+
+    vertex_array_.buffer_data(vertices, count);
+
+    vertex_array_.unbind();
+
+    return vertex_array_;
+  }
+
+  bool render_surfels(const dataviz_surfel_vertex_z* vertices,
+                      uint32_t count,
+                      float radius,
+                      bool cull_backfaces,
+                      const glm::mat4& model_view,
+                      const glm::mat4& projection,
+                      int framebuffer_height)
+  {
+    if (!ready())
+      return false;
+
+    vertex_array_.bind();
+
+    shader_program_.bind();
+
+    vertex_array_.buffer_data(vertices, count);
+
+    const auto mvp = projection * model_view;
+
+    glUniformMatrix4fv(mvp_location_, 1, GL_FALSE, glm::value_ptr(mvp));
+
+    glUniformMatrix4fv(model_view_location_, 1, GL_FALSE, glm::value_ptr(model_view));
+
+    glUniform1f(point_scale_location_, 0.5f * float(framebuffer_height) * projection[1][1]);
+
+    glUniform1f(radius_location_, radius);
+
+    glUniform1i(cull_backfaces_location_, cull_backfaces ? 1 : 0);
+
+    glDrawArrays(GL_POINTS, 0, count);
+
+    shader_program_.unbind();
+
+    vertex_array_.unbind();
+
+    return glGetError() == GL_NO_ERROR;
+  }
+
+private:
+  ShaderProgram shader_program_;
+
+  VertexArray vertex_array_;
+
+  GLint mvp_location_ = -1;
+
+  GLint model_view_location_ = -1;
+
+  GLint point_scale_location_ = -1;
+
+  GLint radius_location_ = -1;
+
+  GLint cull_backfaces_location_ = -1;
+};
+
+} // namespace
+
+//================//
+// Retained Cloud //
+//================//
+
+namespace {
+
+/** @brief A point cloud that is kept in GPU memory between frames.
+ *
+ * @details A cloud may be uploaded sorted along an axis, in which case the sorted coordinates are kept on the CPU so
+ *          that any slab along that axis maps to one range of the buffer.
+ * */
+class RetainedCloud final
+{
+public:
+  bool init(BufferPool* pool, const VertexLayout& layout = point_vertex_layout())
+  {
+    return vertex_array_.init(layout, pool);
+  }
+
+  void cleanup()
+  {
+    vertex_array_.cleanup();
+
+    size_ = 0;
+
+    capacity_ = 0;
+
+    unsort();
+  }
+
+  bool upload(const dataviz_vertex_z* vertices, uint32_t count)
+  {
+    unsort();
+
+    vertex_array_.bind();
+
+    const bool success = vertex_array_.buffer_data(vertices, count, GL_STATIC_DRAW);
+
+    vertex_array_.unbind();
+
+    size_ = success ? count : 0;
+
+    // A recycled buffer may have room to spare, which appends can use.
+    capacity_ = success ? vertex_array_.capacity() : 0;
+
+    return success;
+  }
+
+  bool upload_sorted(const dataviz_vertex_z* vertices, uint32_t count, int axis)
+  {
+    std::vector<uint32_t> keys(count);
+
+    std::vector<uint32_t> order(count);
+
+    parallel_for(count, g_sort_grain, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        keys[i] = orderable_key((&vertices[i].x)[axis]);
+        order[i] = uint32_t(i);
+      }
+    });
+
+    parallel_sort_by_key(keys, order);
+
+    std::vector<dataviz_vertex_z> sorted(count);
+
+    parallel_for(count, g_sort_grain, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++)
+        sorted[i] = vertices[order[i]];
+    });
+
+    if (!upload(sorted.data(), count))
+      return false;
+
+    sorted_coordinates_.resize(count);
+
+    parallel_for(count, g_sort_grain, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++)
+        sorted_coordinates_[i] = (&sorted[i].x)[axis];
+    });
+
+    sorted_axis_ = axis;
+
+    return true;
+  }
+
+  /** @brief Finds the range of points whose coordinate along the sorted axis is within a slab.
+   *
+   * @return False if the cloud is not sorted.
+   * */
+  bool find_slab(float min, float max, uint32_t& first, uint32_t& count) const
+  {
+    first = 0;
+
+    count = 0;
+
+    if (sorted_axis_ < 0)
+      return false;
+
+    const auto begin = std::lower_bound(sorted_coordinates_.begin(), sorted_coordinates_.end(), min);
+
+    const auto end = std::upper_bound(begin, sorted_coordinates_.end(), max);
+
+    first = uint32_t(begin - sorted_coordinates_.begin());
+
+    count = uint32_t(end - begin);
+
+    return true;
+  }
+
+  int sorted_axis() const { return sorted_axis_; }
+
+  bool reserve(uint32_t capacity)
+  {
+    if (capacity <= capacity_)
+      return true;
+
+    vertex_array_.bind();
+
+    const bool success = vertex_array_.reallocate(capacity, size_);
+
+    vertex_array_.unbind();
+
+    if (success)
+      capacity_ = vertex_array_.capacity();
+
+    return success;
+  }
+
+  bool append(const dataviz_vertex_z* vertices, uint32_t count)
+  {
+    // New points would land outside of the sorted order.
+    unsort();
+
+    if (!make_room(count))
+      return false;
+
+    vertex_array_.bind();
+
+    const bool success = vertex_array_.buffer_sub_data(size_, vertices, count);
+
+    vertex_array_.unbind();
+
+    if (success)
+      size_ += count;
+
+    return success;
+  }
+
+  bool upload_columns(const dataviz_point_columns_z& columns, uint32_t count)
+  {
+    unsort();
+
+    vertex_array_.bind();
+
+    bool success = vertex_array_.buffer_data(nullptr, count, GL_STATIC_DRAW);
+
+    if (success)
+      success = write_columns(0, columns, count);
+
+    vertex_array_.unbind();
+
+    size_ = success ? count : 0;
+
+    // A recycled buffer may have room to spare, which appends can use.
+    capacity_ = success ? vertex_array_.capacity() : 0;
+
+    return success;
+  }
+
+  bool append_columns(const dataviz_point_columns_z& columns, uint32_t count)
+  {
+    unsort();
+
+    if (!make_room(count))
+      return false;
+
+    vertex_array_.bind();
+
+    const bool success = write_columns(size_, columns, count);
+
+    vertex_array_.unbind();
+
+    if (success)
+      size_ += count;
+
+    return success;
+  }
+
+  void clear()
+  {
+    size_ = 0;
+
+    unsort();
+  }
+
+  uint32_t size() const { return size_; }
+
+  VertexArray& vertex_array() { return vertex_array_; }
+
+private:
+  void unsort()
+  {
+    sorted_axis_ = -1;
+
+    sorted_coordinates_.clear();
+  }
+
+  /** @brief Grows the buffer, if needed, so that a number of points fit after the current ones.
+   *
+   * @return False if the points would not fit in a 32 bit count, or the buffer could not be grown.
+   * */
+  bool make_room(uint32_t count)
+  {
+    if (count > (std::numeric_limits<uint32_t>::max() - size_))
+      return false;
+
+    const uint32_t required = size_ + count;
+
+    if (required <= capacity_)
+      return true;
+
+    // Grow geometrically, so that appending in small pieces does not copy the buffer every time.
+    const uint32_t doubled = (capacity_ > (std::numeric_limits<uint32_t>::max() / 2))
+                               ? std::numeric_limits<uint32_t>::max()
+                               : (capacity_ * 2);
+
+    return reserve(std::max(required, doubled));
+  }
+
+  /** @brief Interleaves columns of points into vertices and writes them to the bound buffer, one block at a time.
+   * */
+  bool write_columns(uint32_t first, const dataviz_point_columns_z& columns, uint32_t count)
+  {
+    const size_t x_stride = columns.x_stride ? columns.x_stride : sizeof(float);
+    const size_t y_stride = columns.y_stride ? columns.y_stride : sizeof(float);
+    const size_t z_stride = columns.z_stride ? columns.z_stride : sizeof(float);
+    const size_t rgba_stride = columns.rgba_stride ? columns.rgba_stride : 4;
+
+    const auto* x = reinterpret_cast<const unsigned char*>(columns.x);
+    const auto* y = reinterpret_cast<const unsigned char*>(columns.y);
+    const auto* z = reinterpret_cast<const unsigned char*>(columns.z);
+
+    std::vector<dataviz_vertex_z> block(std::min(count, g_column_block));
+
+    for (uint32_t offset = 0; offset < count; offset += g_column_block) {
+
+      const uint32_t block_size = std::min(count - offset, g_column_block);
+
+      {
+        DATVIZ_PERF_SCOPE("column_conversion");
+
+        parallel_for(block_size, g_column_grain, [&](size_t begin, size_t end) {
+          for (size_t i = begin; i < end; i++) {
+
+            const size_t j = offset + i;
+
+            auto& v = block[i];
+
+            // The columns may come from arrays with any alignment, so they are read with memcpy.
+            memcpy(&v.x, x + (j * x_stride), sizeof(float));
+            memcpy(&v.y, y + (j * y_stride), sizeof(float));
+            memcpy(&v.z, z + (j * z_stride), sizeof(float));
+
+            if (columns.rgba) {
+              memcpy(&v.r, columns.rgba + (j * rgba_stride), 4);
+            } else {
+              v.r = 255;
+              v.g = 255;
+              v.b = 255;
+              v.a = 255;
+            }
+          }
+        });
+      }
+
+      if (!vertex_array_.buffer_sub_data(first + offset, block.data(), block_size))
+        return false;
+    }
+
+    return true;
+  }
+
+  VertexArray vertex_array_;
+
+  uint32_t size_ = 0;
+
+  uint32_t capacity_ = 0;
+
+  /// The axis that the points are sorted along, or -1 if they are in the order that they were given.
+  int sorted_axis_ = -1;
+
+  std::vector<float> sorted_coordinates_;
+};
+
+} // namespace
+
+//============//
+// Line Batch //
+//============//
+
+namespace {
+
+/** @brief A line segment, as it is stored in the segment buffer of a line batch.
+ * */
+struct Segment final
+{
+  dataviz_vertex_z a;
+
+  dataviz_vertex_z b;
+};
+
+static_assert(sizeof(Segment) == (2 * g_vertex_size), "Segments must match the segment instance layout.");
+
+/** @brief Many polylines, packed into a single buffer of line segments.
+ *
+ * @details Every polyline is broken into independent segments, so segments from all polylines can be drawn together
+ *          in one instanced draw, and a polyline can grow without moving any of the segments before it. New segments
+ *          are collected on the host and uploaded together when the batch is next drawn.
+ * */
+class LineBatch final
+{
+public:
+  bool init(BufferPool* pool) { return segments_.init(pool, segment_instance_layout()); }
+
+  void cleanup() { segments_.cleanup(); }
+
+  uint32_t add_polyline(const dataviz_vertex_z* vertices, uint32_t count)
+  {
+    const auto id = static_cast<uint32_t>(polylines_.size());
+
+    polylines_.emplace_back();
+
+    append(id, vertices, count);
+
+    return id;
+  }
+
+  bool append(uint32_t id, const dataviz_vertex_z* vertices, uint32_t count)
+  {
+    if (id >= polylines_.size())
+      return false;
+
+    auto& polyline = polylines_[id];
+
+    for (uint32_t i = 0; i < count; i++) {
+
+      if (polyline.has_last)
+        pending_.push_back(Segment{ polyline.last, vertices[i] });
+
+      polyline.last = vertices[i];
+
+      polyline.has_last = true;
+    }
+
+    return true;
+  }
+
+  void clear()
+  {
+    polylines_.clear();
+
+    pending_.clear();
+
+    segments_.clear();
+  }
+
+  /** @brief Uploads the segments that were added since the last flush.
+   * */
+  bool flush()
+  {
+    if (pending_.empty())
+      return true;
+
+    const bool success = segments_.append(reinterpret_cast<const dataviz_vertex_z*>(pending_.data()),
+                                          static_cast<uint32_t>(pending_.size()));
+
+    pending_.clear();
+
+    return success;
+  }
+
+  uint32_t segment_count() const { return segments_.size(); }
+
+  /// The number of segments that the next flush uploads.
+  size_t pending_count() const { return pending_.size(); }
+
+  VertexArray& vertex_array() { return segments_.vertex_array(); }
+
+private:
+  struct Polyline final
+  {
+    dataviz_vertex_z last{};
+
+    bool has_last = false;
+  };
+
+  std::vector<Polyline> polylines_;
+
+  std::vector<Segment> pending_;
+
+  /// Holds segments, one per element, with the segment instance layout.
+  RetainedCloud segments_;
+};
+
+} // namespace
+
+//====================//
+// Box Shader Program //
+//====================//
+
+namespace {
+
+namespace box_shader {
+
+const char* vert_source = R"(
+#version 300 es
+
+uniform highp mat4 mvp;
+
+layout(location = 0) in highp vec3 g_center;
+
+layout(location = 1) in highp vec3 g_extent;
+
+layout(location = 2) in highp vec4 g_rotation;
+
+layout(location = 3) in lowp vec4 g_color;
+
+out lowp vec4 g_box_color;
+
+// The twelve edges of a unit cube, as pairs of line end points.
+const highp vec3 edges[24] = vec3[24](
+  vec3(-0.5, -0.5, -0.5), vec3( 0.5, -0.5, -0.5),
+  vec3( 0.5, -0.5, -0.5), vec3( 0.5,  0.5, -0.5),
+  vec3( 0.5,  0.5, -0.5), vec3(-0.5,  0.5, -0.5),
+  vec3(-0.5,  0.5, -0.5), vec3(-0.5, -0.5, -0.5),
+  vec3(-0.5, -0.5,  0.5), vec3( 0.5, -0.5,  0.5),
+  vec3( 0.5, -0.5,  0.5), vec3( 0.5,  0.5,  0.5),
+  vec3( 0.5,  0.5,  0.5), vec3(-0.5,  0.5,  0.5),
+  vec3(-0.5,  0.5,  0.5), vec3(-0.5, -0.5,  0.5),
+  vec3(-0.5, -0.5, -0.5), vec3(-0.5, -0.5,  0.5),
+  vec3( 0.5, -0.5, -0.5), vec3( 0.5, -0.5,  0.5),
+  vec3( 0.5,  0.5, -0.5), vec3( 0.5,  0.5,  0.5),
+  vec3(-0.5,  0.5, -0.5), vec3(-0.5,  0.5,  0.5));
+
+highp vec3 rotate(highp vec4 q, highp vec3 v)
+{
+  return v + (2.0 * cross(q.xyz, cross(q.xyz, v) + (q.w * v)));
+}
+
+void main()
+{
+  // The rotation is stored with 16 bits per component, so it is normalized again here.
+  highp vec4 q = normalize(g_rotation);
+
+  highp vec3 p = g_center + rotate(q, edges[gl_VertexID] * g_extent);
+
+  g_box_color = g_color;
+
+  gl_Position = mvp * vec4(p, 1.0);
+}
+)";
+
+const char* frag_source = R"(
+#version 300 es
+
+in lowp vec4 g_box_color;
+
+out lowp vec4 g_out_color;
+
+void main()
+{
+  g_out_color = g_box_color;
+}
+)";
+
+} // namespace box_shader
+
+/** @brief A box, as it is uploaded to the instance buffer.
+ * */
+struct BoxInstance final
+{
+  float center[3];
+
+  float extent[3];
+
+  int16_t rotation[4];
+
+  unsigned char rgba[4];
+};
+
+static_assert(sizeof(BoxInstance) == 36, "Box instances must match the box instance layout.");
+
+class BoxShaderProgram final
+{
+public:
+  bool init(ShaderCompiler& compiler)
+  {
+    if (!shader_program_.init(compiler, box_shader::vert_source, box_shader::frag_source))
+      return false;
+
+    return vertex_array_.init(box_instance_layout());
+  }
+
+  bool ready()
+  {
+    return shader_program_.ready([this]() {
+      mvp_location_ = shader_program_.get_uniform_location("mvp");
+    });
+  }
+
+  void cleanup()
+  {
+    shader_program_.cleanup();
+
+    vertex_array_.cleanup();
+  }
+
+  bool render_boxes(const dataviz_box_z* boxes, uint32_t count, const glm::mat4& mvp)
+  {
+    shader_program_.wait();
+
+    if (!ready())
+      return false;
+
+    instances_.resize(count);
+
+    for (uint32_t i = 0; i < count; i++)
+      pack(boxes[i], instances_[i]);
+
+    vertex_array_.bind();
+
+    shader_program_.bind();
+
+    vertex_array_.buffer_data(instances_.data(), count);
+
+    glUniformMatrix4fv(mvp_location_, 1, GL_FALSE, glm::value_ptr(mvp));
+
+    glDrawArraysInstanced(GL_LINES, 0, 24, count);
+
+    shader_program_.unbind();
+
+    vertex_array_.unbind();
+
+    return glGetError() == GL_NO_ERROR;
+  }
+
+private:
+  static void pack(const dataviz_box_z& box, BoxInstance& instance)
+  {
+    memcpy(instance.center, box.center, sizeof(instance.center));
+
+    memcpy(instance.extent, box.extent, sizeof(instance.extent));
+
+    const auto q = glm::vec4(box.rotation[0], box.rotation[1], box.rotation[2], box.rotation[3]);
+
+    const float length = glm::length(q);
+
+    const auto unit = length > 0 ? (q / length) : glm::vec4(0, 0, 0, 1);
+
+    for (int i = 0; i < 4; i++)
+      instance.rotation[i] = static_cast<int16_t>(unit[i] * 32767.0f);
+
+    instance.rgba[0] = box.r;
+    instance.rgba[1] = box.g;
+    instance.rgba[2] = box.b;
+    instance.rgba[3] = box.a;
+  }
+
+private:
+  ShaderProgram shader_program_;
+
+  VertexArray vertex_array_;
+
+  GLint mvp_location_ = -1;
+
+  /// Kept between frames, so that packing the boxes does not allocate.
+  std::vector<BoxInstance> instances_;
+};
+
+} // namespace
+
+//=====================//
+// Line Shader Program //
+//=====================//
+
+namespace {
+
+namespace line_shader {
+
+const char* vert_source = R"(
+#version 300 es
+
+uniform highp mat4 mvp;
+
+uniform highp vec2 viewport_size;
+
+uniform highp float line_width;
+
+// When set, each segment is expanded into a quad in screen space, instead of being drawn as a line.
+uniform bool wide;
+
+layout(location = 0) in highp vec3 g_position_a;
+
+layout(location = 1) in lowp vec4 g_color_a;
+
+layout(location = 2) in highp vec3 g_position_b;
+
+layout(location = 3) in lowp vec4 g_color_b;
+
+out lowp vec4 g_line_color;
+
+void main()
+{
+  highp vec4 a = mvp * vec4(g_position_a, 1.0);
+  highp vec4 b = mvp * vec4(g_position_b, 1.0);
+
+  // Thin lines use corners 0 and 1, wide lines use corners 0 to 3 of a triangle strip.
+  bool at_b = wide ? (gl_VertexID >= 2) : (gl_VertexID == 1);
+
+  highp vec4 p = at_b ? b : a;
+
+  g_line_color = at_b ? g_color_b : g_color_a;
+
+  if (wide) {
+    highp vec2 half_viewport = viewport_size * 0.5;
+
+    highp vec2 delta = ((b.xy / b.w) - (a.xy / a.w)) * half_viewport;
+
+    highp vec2 dir = dot(delta, delta) > 0.0 ? normalize(delta) : vec2(1.0, 0.0);
+
+    highp float side = (gl_VertexID % 2) == 0 ? -0.5 : 0.5;
+
+    p.xy += vec2(-dir.y, dir.x) * (side * line_width / half_viewport) * p.w;
+  }
+
+  gl_Position = p;
+}
+)";
+
+const char* frag_source = R"(
+#version 300 es
+
+in lowp vec4 g_line_color;
+
+out lowp vec4 g_out_color;
+
+void main()
+{
+  g_out_color = g_line_color;
+}
+)";
+
+} // namespace line_shader
+
+class LineShaderProgram final
+{
+public:
+  bool init(ShaderCompiler& compiler)
+  {
+    return shader_program_.init(compiler, line_shader::vert_source, line_shader::frag_source);
+  }
+
+  bool ready()
+  {
+    return shader_program_.ready([this]() {
+      mvp_location_ = shader_program_.get_uniform_location("mvp");
+
+      viewport_size_location_ = shader_program_.get_uniform_location("viewport_size");
+
+      line_width_location_ = shader_program_.get_uniform_location("line_width");
+
+      wide_location_ = shader_program_.get_uniform_location("wide");
+    });
+  }
+
+  void cleanup() { shader_program_.cleanup(); }
+
+  bool render_lines(LineBatch& batch, float width, const glm::mat4& mvp, const glm::ivec2& framebuffer_size)
+  {
+    shader_program_.wait();
+
+    if (!ready())
+      return false;
+
+    if (!batch.flush())
+      return false;
+
+    // Most drivers only rasterize lines that are one pixel wide, so anything wider is drawn with quads.
+    const bool wide = width > 1.0f;
+
+    batch.vertex_array().bind();
+
+    shader_program_.bind();
+
+    glUniformMatrix4fv(mvp_location_, 1, GL_FALSE, glm::value_ptr(mvp));
+
+    glUniform2f(viewport_size_location_, float(framebuffer_size.x), float(framebuffer_size.y));
+
+    glUniform1f(line_width_location_, width);
+
+    glUniform1i(wide_location_, wide ? 1 : 0);
+
+    if (wide)
+      glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, batch.segment_count());
+    else
+      glDrawArraysInstanced(GL_LINES, 0, 2, batch.segment_count());
+
+    shader_program_.unbind();
+
+    batch.vertex_array().unbind();
+
+    return glGetError() == GL_NO_ERROR;
+  }
+
+private:
+  ShaderProgram shader_program_;
+
+  GLint mvp_location_ = -1;
+
+  GLint viewport_size_location_ = -1;
+
+  GLint line_width_location_ = -1;
+
+  GLint wide_location_ = -1;
+};
+
+} // namespace
+
+//=====================//
+// Text Shader Program //
+//=====================//
+
+namespace {
+
+namespace text_shader {
+
+const char* vert_source = R"(
+#version 300 es
+
+uniform highp mat4 mvp;
+
+uniform highp vec2 viewport_size;
+
+// The size of a glyph cell, in font units.
+uniform highp vec2 cell_size;
+
+// The size of a glyph cell, in texture coordinates.
+uniform highp vec2 cell_uv_size;
+
+uniform highp float atlas_columns;
+
+layout(location = 0) in highp vec3 g_anchor;
+
+layout(location = 1) in highp float g_pixels_per_unit;
+
+layout(location = 2) in highp vec2 g_offset;
+
+layout(location = 3) in lowp vec4 g_color;
+
+layout(location = 4) in highp float g_glyph;
+
+out highp vec2 g_uv;
+
+out lowp vec4 g_glyph_color;
+
+void main()
+{
+  highp vec2 corner = vec2(float(gl_VertexID % 2), float(gl_VertexID / 2));
+
+  highp vec4 p = mvp * vec4(g_anchor, 1.0);
+
+  // The offset is in screen space, where Y points down.
+  highp vec2 pixels = (g_offset + (corner * cell_size)) * g_pixels_per_unit;
+
+  p.xy += vec2(pixels.x, -pixels.y) * (2.0 / viewport_size) * p.w;
+
+  // Labels behind the camera would otherwise be projected onto the screen upside down.
+  if (p.w <= 0.0)
+    p = vec4(0.0, 0.0, 2.0, 1.0);
+
+  highp vec2 cell = vec2(mod(g_glyph, atlas_columns), floor(g_glyph / atlas_columns));
+
+  g_uv = (cell + corner) * cell_uv_size;
+
+  g_glyph_color = g_color;
+
+  gl_Position = p;
+}
+)";
+
+const char* frag_source = R"(
+#version 300 es
+
+uniform sampler2D atlas;
+
+in highp vec2 g_uv;
+
+in lowp vec4 g_glyph_color;
+
+out lowp vec4 g_out_color;
+
+void main()
+{
+  highp float d = texture(atlas, g_uv).r;
+
+  // Smoothing over the screen space rate of change keeps the edges about one pixel wide at any text size.
+  highp float w = max(fwidth(d), 1.0e-4) * 0.5;
+
+  lowp float alpha = smoothstep(0.5 - w, 0.5 + w, d);
+
+  if (alpha <= 0.0)
+    discard;
+
+  g_out_color = vec4(g_glyph_color.rgb, g_glyph_color.a * alpha);
+}
+)";
+
+} // namespace text_shader
+
+/** @brief One character of a label, as it is uploaded to the instance buffer.
+ * */
+struct GlyphInstance final
+{
+  float anchor[3];
+
+  float pixels_per_unit;
+
+  /// The top left corner of the glyph cell relative to the anchor, in font units.
+  int16_t offset[2];
+
+  unsigned char rgba[4];
+
+  uint16_t glyph;
+
+  uint16_t padding;
+};
+
+static_assert(sizeof(GlyphInstance) == 28, "Glyph instances must match the glyph instance layout.");
+
+/** @brief Renders text labels that are anchored to points in the scene.
+ *
+ * @details The glyphs are drawn from a signed distance field atlas, which stays sharp when it is scaled, so one atlas
+ *          serves every text size. The atlas is generated when the program is initialized. Every glyph of every label
+ *          in a call becomes one instance of a quad, so the labels are drawn with a single draw call.
+ * */
+class TextShaderProgram final
+{
+public:
+  bool init(ShaderCompiler& compiler)
+  {
+    if (!shader_program_.init(compiler, text_shader::vert_source, text_shader::frag_source))
+      return false;
+
+    if (!init_atlas())
+      return false;
+
+    return vertex_array_.init(glyph_instance_layout());
+  }
+
+  bool ready()
+  {
+    return shader_program_.ready([this]() {
+      mvp_location_ = shader_program_.get_uniform_location("mvp");
+
+      viewport_size_location_ = shader_program_.get_uniform_location("viewport_size");
+
+      glUniform2f(shader_program_.get_uniform_location("cell_size"),
+                  float(g_glyph_width + (2 * g_glyph_padding)),
+                  float(g_glyph_height + (2 * g_glyph_padding)));
+
+      glUniform2f(shader_program_.get_uniform_location("cell_uv_size"),
+                  float(g_atlas_cell_width) / float(g_atlas_width),
+                  float(g_atlas_cell_height) / float(g_atlas_height));
+
+      glUniform1f(shader_program_.get_uniform_location("atlas_columns"), float(g_atlas_columns));
+
+      glUniform1i(shader_program_.get_uniform_location("atlas"), 0);
+    });
+  }
+
+  void cleanup()
+  {
+    shader_program_.cleanup();
+
+    vertex_array_.cleanup();
+
+    if (atlas_ != 0)
+      glDeleteTextures(1, &atlas_);
+
+    atlas_ = 0;
+  }
+
+  bool render_labels(const dataviz_label_z* labels,
+                     uint32_t count,
+                     const glm::mat4& mvp,
+                     const glm::ivec2& framebuffer_size)
+  {
+    shader_program_.wait();
+
+    if (!ready())
+      return false;
+
+    instances_.clear();
+
+    for (uint32_t i = 0; i < count; i++)
+      pack(labels[i]);
+
+    if (instances_.empty())
+      return true;
+
+    vertex_array_.bind();
+
+    shader_program_.bind();
+
+    vertex_array_.buffer_data(instances_.data(), uint32_t(instances_.size()));
+
+    glUniformMatrix4fv(mvp_location_, 1, GL_FALSE, glm::value_ptr(mvp));
+
+    glUniform2f(viewport_size_location_, float(framebuffer_size.x), float(framebuffer_size.y));
+
+    glActiveTexture(GL_TEXTURE0);
+
+    glBindTexture(GL_TEXTURE_2D, atlas_);
+
+    // Labels are drawn over the scene, so that they are not hidden by the points they describe.
+    const GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+
+    glDisable(GL_DEPTH_TEST);
+
+    glEnable(GL_BLEND);
+
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(instances_.size()));
+
+    glDisable(GL_BLEND);
+
+    if (depth_test)
+      glEnable(GL_DEPTH_TEST);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    shader_program_.unbind();
+
+    vertex_array_.unbind();
+
+    return glGetError() == GL_NO_ERROR;
+  }
+
+private:
+  bool init_atlas()
+  {
+    const auto texels = make_glyph_atlas();
+
+    glGenTextures(1, &atlas_);
+
+    glBindTexture(GL_TEXTURE_2D, atlas_);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, g_atlas_width, g_atlas_height, 0, GL_RED, GL_UNSIGNED_BYTE, texels.data());
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return glGetError() == GL_NO_ERROR;
+  }
+
+  /** @brief Lays out the glyphs of a label, with the first line of text sitting on the anchor.
+   * */
+  void pack(const dataviz_label_z& label)
+  {
+    if (!label.text)
+      return;
+
+    GlyphInstance instance{};
+
+    memcpy(instance.anchor, label.position, sizeof(instance.anchor));
+
+    instance.pixels_per_unit = label.size / float(g_glyph_height);
+
+    instance.rgba[0] = label.r;
+    instance.rgba[1] = label.g;
+    instance.rgba[2] = label.b;
+    instance.rgba[3] = label.a;
+
+    int column = 0;
+
+    int line = 0;
+
+    for (const char* c = label.text; *c; c++) {
+
+      if (*c == '\n') {
+        column = 0;
+        line++;
+        continue;
+      }
+
+      const int glyph = glyph_index(*c);
+
+      // Spaces, and characters without a glyph, only move the cursor.
+      if (glyph > 0) {
+        instance.offset[0] = static_cast<int16_t>((column * g_glyph_advance) - g_glyph_padding);
+        instance.offset[1] = static_cast<int16_t>((line * g_line_advance) - g_glyph_height - g_glyph_padding);
+        instance.glyph = static_cast<uint16_t>(glyph);
+        instances_.push_back(instance);
+      }
+
+      column++;
+    }
+  }
+
+private:
+  ShaderProgram shader_program_;
+
+  VertexArray vertex_array_;
+
+  GLuint atlas_ = 0;
+
+  GLint mvp_location_ = -1;
+
+  GLint viewport_size_location_ = -1;
+
+  /// Kept between frames, so that laying out the labels does not allocate.
+  std::vector<GlyphInstance> instances_;
+};
+
+} // namespace
+
+//======================//
+// Arrow Shader Program //
+//======================//
+
+namespace {
+
+namespace arrow_shader {
+
+const char* vert_source = R"(
+#version 300 es
+
+uniform highp mat4 mvp;
+
+uniform highp vec2 viewport_size;
+
+uniform highp float vector_scale;
+
+layout(location = 0) in highp vec3 g_position;
+
+layout(location = 1) in lowp vec4 g_color;
+
+layout(location = 2) in highp vec3 g_vector;
+
+out lowp vec4 g_arrow_color;
+
+void main()
+{
+  highp vec4 tail = mvp * vec4(g_position, 1.0);
+  highp vec4 tip = mvp * vec4(g_position + (g_vector * vector_scale), 1.0);
+
+  g_arrow_color = g_color;
+
+  // Arrows that cross the camera plane cannot be projected sensibly, so they are moved out of the view volume.
+  if ((tail.w <= 0.0) || (tip.w <= 0.0)) {
+    gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+    return;
+  }
+
+  // Vertices 0 and 1 are the shaft. Vertices 2 to 5 are the two barbs of the head, which start at the tip.
+  if (gl_VertexID == 0) {
+    gl_Position = tail;
+    return;
+  }
+
+  if (((gl_VertexID % 2) == 0) || (gl_VertexID == 1)) {
+    gl_Position = tip;
+    return;
+  }
+
+  // The barbs are laid out in screen space, so the head is visible from any direction.
+  highp vec2 half_viewport = viewport_size * 0.5;
+
+  highp vec2 back = ((tail.xy / tail.w) - (tip.xy / tip.w)) * half_viewport * 0.25;
+
+  highp float angle = (gl_VertexID == 3) ? 0.45 : -0.45;
+
+  highp vec2 barb = mat2(cos(angle), sin(angle), -sin(angle), cos(angle)) * back;
+
+  gl_Position = vec4(tip.xy + ((barb / half_viewport) * tip.w), tip.zw);
+}
+)";
+
+const char* frag_source = R"(
+#version 300 es
+
+in lowp vec4 g_arrow_color;
+
+out lowp vec4 g_out_color;
+
+void main()
+{
+  g_out_color = g_arrow_color;
+}
+)";
+
+} // namespace arrow_shader
+
+/** @brief A vector, as it is uploaded to the instance buffer.
+ * */
+struct ArrowInstance final
+{
+  dataviz_vertex_z origin;
+
+  float vector[3];
+};
+
+static_assert(sizeof(ArrowInstance) == 28, "Arrow instances must match the arrow instance layout.");
+
+class ArrowShaderProgram final
+{
+public:
+  bool init(ShaderCompiler& compiler)
+  {
+    if (!shader_program_.init(compiler, arrow_shader::vert_source, arrow_shader::frag_source))
+      return false;
+
+    return vertex_array_.init(arrow_instance_layout());
+  }
+
+  bool ready()
+  {
+    return shader_program_.ready([this]() {
+      mvp_location_ = shader_program_.get_uniform_location("mvp");
+
+      viewport_size_location_ = shader_program_.get_uniform_location("viewport_size");
+
+      vector_scale_location_ = shader_program_.get_uniform_location("vector_scale");
+    });
+  }
+
+  void cleanup()
+  {
+    shader_program_.cleanup();
+
+    vertex_array_.cleanup();
+  }
+
+  bool render_vector_field(const dataviz_vertex_z* points,
+                           const float* vectors,
+                           uint32_t count,
+                           uint32_t stride,
+                           float scale,
+                           const glm::mat4& mvp,
+                           const glm::ivec2& framebuffer_size)
+  {
+    shader_program_.wait();
+
+    if (!ready())
+      return false;
+
+    stride = std::max<uint32_t>(stride, 1);
+
+    const uint32_t arrow_count = (count / stride) + ((count % stride) != 0);
+
+    instances_.resize(arrow_count);
+
+    parallel_for(arrow_count, 65536, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        const size_t j = i * stride;
+        instances_[i].origin = points[j];
+        memcpy(instances_[i].vector, vectors + (j * 3), sizeof(instances_[i].vector));
+      }
+    });
+
+    vertex_array_.bind();
+
+    shader_program_.bind();
+
+    vertex_array_.buffer_data(instances_.data(), arrow_count);
+
+    glUniformMatrix4fv(mvp_location_, 1, GL_FALSE, glm::value_ptr(mvp));
+
+    glUniform2f(viewport_size_location_, float(framebuffer_size.x), float(framebuffer_size.y));
+
+    glUniform1f(vector_scale_location_, scale);
+
+    glDrawArraysInstanced(GL_LINES, 0, 6, arrow_count);
+
+    shader_program_.unbind();
+
+    vertex_array_.unbind();
+
+    return glGetError() == GL_NO_ERROR;
+  }
+
+private:
+  ShaderProgram shader_program_;
+
+  VertexArray vertex_array_;
+
+  GLint mvp_location_ = -1;
+
+  GLint viewport_size_location_ = -1;
+
+  GLint vector_scale_location_ = -1;
+
+  /// Kept between frames, so that interleaving the vectors does not allocate.
+  std::vector<ArrowInstance> instances_;
+};
+
+} // namespace
+
+//===================//
+// Density Rendering //
+//===================//
+
+namespace {
+
+bool
+has_extension(const char* name)
+{
+  GLint count = 0;
+
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+
+  for (GLint i = 0; i < count; i++) {
+
+    const auto* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, GLuint(i)));
+
+    if (extension && (strcmp(extension, name) == 0))
+      return true;
+  }
+
+  return false;
+}
+
+namespace density_shader {
+
+const char* vert_source = R"(
+#version 300 es
+
+void main()
+{
+  // A single triangle that covers the whole viewport.
+  highp vec2 p = vec2(float((gl_VertexID & 1) << 2), float((gl_VertexID & 2) << 1)) - 1.0;
+
+  gl_Position = vec4(p, 0.0, 1.0);
+}
+)";
+
+const char* frag_source = R"(
+#version 300 es
+
+uniform highp sampler2D density;
+
+uniform lowp sampler2D colormap;
+
+// Converts the values in the density target into numbers of points.
+uniform highp float count_scale;
+
+uniform highp float inv_log_saturation;
+
+out lowp vec4 g_out_color;
+
+void main()
+{
+  highp float count = texelFetch(density, ivec2(gl_FragCoord.xy), 0).r * count_scale;
+
+  if (count < 0.5)
+    discard;
+
+  highp float t = clamp(log(1.0 + count) * inv_log_saturation, 0.0, 1.0);
+
+  // The lookup is done at texel centers, so that both ends of the color map are reached.
+  g_out_color = texture(colormap, vec2((t * (255.0 / 256.0)) + (0.5 / 256.0), 0.5));
+}
+)";
+
+} // namespace density_shader
+
+/** @brief The offscreen target that points are counted in, by adding them up with blending.
+ * */
+class DensityTarget final
+{
+public:
+  bool init()
+  {
+    // Single precision counts are exact up to 2^24 points per pixel, but blending into them needs an extension.
+    // Half precision counts are exact up to 2048, and the fallback of 8 bit fixed point counts saturates at 255.
+    if (has_extension("GL_EXT_color_buffer_float"))
+      format_ = has_extension("GL_EXT_float_blend") ? GL_R32F : GL_R16F;
+
+    glGenFramebuffers(1, &framebuffer_);
+
+    glGenTextures(1, &texture_);
+
+    return glGetError() == GL_NO_ERROR;
+  }
+
+  void cleanup()
+  {
+    if (framebuffer_ != 0)
+      glDeleteFramebuffers(1, &framebuffer_);
+
+    if (texture_ != 0)
+      glDeleteTextures(1, &texture_);
+
+    framebuffer_ = 0;
+
+    texture_ = 0;
+
+    size_ = glm::ivec2(0, 0);
+  }
+
+  GLuint texture() const { return texture_; }
+
+  /// The value that one point adds to a pixel.
+  float splat_weight() const { return (format_ == GL_RGBA8) ? (1.0f / 255.0f) : 1.0f; }
+
+  /// Converts a pixel value back into a number of points.
+  float count_scale() const { return 1.0f / splat_weight(); }
+
+  /** @brief Resizes the target to match the framebuffer, if needed, and clears the counts.
+   * */
+  bool begin_frame(const glm::ivec2& size)
+  {
+    if ((size != size_) && !allocate(size))
+      return false;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+
+    glClearColor(0, 0, 0, 0);
+
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    return glGetError() == GL_NO_ERROR;
+  }
+
+  void bind()
+  {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+
+    // Every point counts, no matter what is in front of it.
+    depth_test_ = glIsEnabled(GL_DEPTH_TEST);
+
+    glDisable(GL_DEPTH_TEST);
+
+    glEnable(GL_BLEND);
+
+    glBlendFunc(GL_ONE, GL_ONE);
+  }
+
+  void unbind()
+  {
+    glDisable(GL_BLEND);
+
+    if (depth_test_)
+      glEnable(GL_DEPTH_TEST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  }
+
+private:
+  bool allocate(const glm::ivec2& size)
+  {
+    size_ = size;
+
+    glBindTexture(GL_TEXTURE_2D, texture_);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+
+    while (true) {
+
+      if (format_ == GL_RGBA8)
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+      else
+        glTexImage2D(GL_TEXTURE_2D, 0, format_, size.x, size.y, 0, GL_RED, GL_FLOAT, nullptr);
+
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_, 0);
+
+      // Some drivers advertise float targets that they cannot render to at every size.
+      if ((glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) || (format_ == GL_RGBA8))
+        break;
+
+      format_ = GL_RGBA8;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return glGetError() == GL_NO_ERROR;
+  }
+
+private:
+  GLuint framebuffer_ = 0;
+
+  GLuint texture_ = 0;
+
+  GLenum format_ = GL_RGBA8;
+
+  glm::ivec2 size_{ 0, 0 };
+
+  GLboolean depth_test_ = GL_FALSE;
+};
+
+/** @brief Draws the counts of a density target onto the framebuffer, through a color map.
+ * */
+class DensityShaderProgram final
+{
+public:
+  bool init(ShaderCompiler& compiler)
+  {
+    if (!shader_program_.init(compiler, density_shader::vert_source, density_shader::frag_source))
+      return false;
+
+    // The triangle is generated from the vertex index, but a vertex array must still be bound to draw it.
+    glGenVertexArrays(1, &vertex_array_);
+
+    glGenTextures(1, &colormap_texture_);
+
+    glBindTexture(GL_TEXTURE_2D, colormap_texture_);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return glGetError() == GL_NO_ERROR;
+  }
+
+  bool ready()
+  {
+    return shader_program_.ready([this]() {
+      count_scale_location_ = shader_program_.get_uniform_location("count_scale");
+
+      inv_log_saturation_location_ = shader_program_.get_uniform_location("inv_log_saturation");
+
+      glUniform1i(shader_program_.get_uniform_location("density"), 0);
+
+      glUniform1i(shader_program_.get_uniform_location("colormap"), 1);
+    });
+  }
+
+  void cleanup()
+  {
+    shader_program_.cleanup();
+
+    if (vertex_array_ != 0)
+      glDeleteVertexArrays(1, &vertex_array_);
+
+    if (colormap_texture_ != 0)
+      glDeleteTextures(1, &colormap_texture_);
+
+    vertex_array_ = 0;
+
+    colormap_texture_ = 0;
+
+    colormap_uploaded_ = false;
+  }
+
+  bool resolve(const DensityTarget& target, datviz_colormap colormap, float saturation)
+  {
+    if (!ready())
+      return false;
+
+    if (!colormap_uploaded_ || (colormap != colormap_))
+      upload_colormap(colormap);
+
+    glBindVertexArray(vertex_array_);
+
+    shader_program_.bind();
+
+    glUniform1f(count_scale_location_, target.count_scale());
+
+    glUniform1f(inv_log_saturation_location_, 1.0f / std::log(1.0f + std::max(saturation, 1.0f)));
+
+    glActiveTexture(GL_TEXTURE0);
+
+    glBindTexture(GL_TEXTURE_2D, target.texture());
+
+    glActiveTexture(GL_TEXTURE1);
+
+    glBindTexture(GL_TEXTURE_2D, colormap_texture_);
+
+    const GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+
+    glDisable(GL_DEPTH_TEST);
+
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    if (depth_test)
+      glEnable(GL_DEPTH_TEST);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glActiveTexture(GL_TEXTURE0);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    shader_program_.unbind();
+
+    glBindVertexArray(0);
+
+    return glGetError() == GL_NO_ERROR;
+  }
+
+private:
+  void upload_colormap(datviz_colormap colormap)
+  {
+    const auto table = make_colormap_table(colormap);
+
+    glBindTexture(GL_TEXTURE_2D, colormap_texture_);
+
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, g_colormap_size, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, table.data());
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    colormap_ = colormap;
+
+    colormap_uploaded_ = true;
+  }
+
+private:
+  ShaderProgram shader_program_;
+
+  GLuint vertex_array_ = 0;
+
+  GLuint colormap_texture_ = 0;
+
+  datviz_colormap colormap_ = DATVIZ_COLORMAP_VIRIDIS;
+
+  bool colormap_uploaded_ = false;
+
+  GLint count_scale_location_ = -1;
+
+  GLint inv_log_saturation_location_ = -1;
+};
+
+} // namespace
+
+//==========//
+// Tile Map //
+//==========//
+
+namespace {
+
+namespace map_shader {
+
+const char* vert_source = R"(
+#version 300 es
+
+uniform highp mat4 mvp;
+
+// The minimum and maximum corners of the tile on the XY plane.
+uniform highp vec4 rect;
+
+uniform highp float height;
+
+out highp vec2 g_uv;
+
+void main()
+{
+  highp vec2 corner = vec2(float(gl_VertexID % 2), float(gl_VertexID / 2));
+
+  g_uv = corner;
+
+  gl_Position = mvp * vec4(mix(rect.xy, rect.zw, corner), height, 1.0);
+}
+)";
+
+const char* frag_source = R"(
+#version 300 es
+
+uniform lowp sampler2D tile;
+
+in highp vec2 g_uv;
+
+out lowp vec4 g_out_color;
+
+void main()
+{
+  lowp vec4 color = texture(tile, g_uv);
+
+  // Cells without points are left out, so that whatever is below the map shows through.
+  if (color.a < 0.5)
+    discard;
+
+  g_out_color = color;
+}
+)";
+
+} // namespace map_shader
+
+/** @brief A tile pyramid, with textures for the tiles that have been drawn so far and the points sorted by tile.
+ * */
+class TileMap final
+{
+public:
+  bool init(BufferPool* pool, const dataviz_vertex_z* points, uint32_t count, float cell_size, const char* cache_path)
+  {
+    pyramid_.build(points, count, cell_size, cache_path);
+
+    for (const auto& level : pyramid_.levels())
+      textures_.emplace_back(level.tiles.size(), 0);
+
+    if (!cloud_.init(pool))
+      return false;
+
+    const bool success = cloud_.upload(pyramid_.sorted_points().data(), uint32_t(pyramid_.sorted_points().size()));
+
+    // The points are only drawn from the retained cloud from here on, so the copy on the host is not kept around.
+    pyramid_.release_points();
+
+    return success;
+  }
+
+  void cleanup()
+  {
+    for (auto& level : textures_) {
+      for (auto& texture : level) {
+        if (texture != 0)
+          glDeleteTextures(1, &texture);
+      }
+    }
+
+    textures_.clear();
+
+    cloud_.cleanup();
+  }
+
+  const TilePyramid& pyramid() const { return pyramid_; }
+
+  RetainedCloud& cloud() { return cloud_; }
+
+  /** @brief Gets the texture of a tile, uploading it the first time it is needed.
+   * */
+  GLuint texture(size_t level, size_t tile)
+  {
+    auto& texture = textures_[level][tile];
+
+    if (texture != 0)
+      return texture;
+
+    glGenTextures(1, &texture);
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    // The level is picked so that a cell covers about one pixel, and cells should stay crisp when they cover more.
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    const auto& colors = pyramid_.levels()[level].tiles[tile].colors;
+
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, g_tile_size, g_tile_size, 0, GL_RGBA, GL_UNSIGNED_BYTE, colors.data());
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return texture;
+  }
+
+private:
+  TilePyramid pyramid_;
+
+  RetainedCloud cloud_;
+
+  /// One texture per tile, by level, or zero for tiles that have not been uploaded yet.
+  std::vector<std::vector<GLuint>> textures_;
+};
+
+class MapShaderProgram final
+{
+public:
+  bool init(ShaderCompiler& compiler)
+  {
+    if (!shader_program_.init(compiler, map_shader::vert_source, map_shader::frag_source))
+      return false;
+
+    glGenVertexArrays(1, &vertex_array_);
+
+    return glGetError() == GL_NO_ERROR;
+  }
+
+  bool ready()
+  {
+    return shader_program_.ready([this]() {
+      mvp_location_ = shader_program_.get_uniform_location("mvp");
+
+      rect_location_ = shader_program_.get_uniform_location("rect");
+
+      height_location_ = shader_program_.get_uniform_location("height");
+
+      glUniform1i(shader_program_.get_uniform_location("tile"), 0);
+    });
+  }
+
+  void cleanup()
+  {
+    shader_program_.cleanup();
+
+    if (vertex_array_ != 0)
+      glDeleteVertexArrays(1, &vertex_array_);
+
+    vertex_array_ = 0;
+  }
+
+  /** @brief Draws the tiles of one level that overlap a rectangle on the XY plane.
+   *
+   * @param tile_count Set to the number of tiles that were drawn, each with one draw call.
+   * */
+  bool render_tiles(TileMap& map,
+                    size_t level,
+                    const glm::vec2& min,
+                    const glm::vec2& max,
+                    const glm::mat4& mvp,
+                    uint32_t& tile_count)
+  {
+    tile_count = 0;
+
+    shader_program_.wait();
+
+    if (!ready())
+      return false;
+
+    const auto& pyramid = map.pyramid();
+
+    const auto& tiles = pyramid.levels()[level];
+
+    const float tile_extent = pyramid.cell_size(level) * float(g_tile_size);
+
+    const glm::vec2 origin(pyramid.origin_x(), pyramid.origin_y());
+
+    const auto first = glm::max(glm::ivec2(glm::floor((min - origin) / tile_extent)), glm::ivec2(0, 0));
+    const auto last =
+      glm::min(glm::ivec2(glm::floor((max - origin) / tile_extent)), glm::ivec2(tiles.tiles_x - 1, tiles.tiles_y - 1));
+
+    glBindVertexArray(vertex_array_);
+
+    shader_program_.bind();
+
+    glUniformMatrix4fv(mvp_location_, 1, GL_FALSE, glm::value_ptr(mvp));
+
+    glUniform1f(height_location_, pyramid.top());
+
+    glActiveTexture(GL_TEXTURE0);
+
+    for (int y = first.y; y <= last.y; y++) {
+      for (int x = first.x; x <= last.x; x++) {
+
+        const int32_t tile = tiles.lookup[(size_t(y) * size_t(tiles.tiles_x)) + size_t(x)];
+        if (tile < 0)
+          continue;
+
+        const auto lo = origin + (glm::vec2(x, y) * tile_extent);
+
+        glUniform4f(rect_location_, lo.x, lo.y, lo.x + tile_extent, lo.y + tile_extent);
+
+        glBindTexture(GL_TEXTURE_2D, map.texture(level, size_t(tile)));
+
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+        tile_count++;
+      }
+    }
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    shader_program_.unbind();
+
+    glBindVertexArray(0);
+
+    return glGetError() == GL_NO_ERROR;
+  }
+
+private:
+  ShaderProgram shader_program_;
+
+  GLuint vertex_array_ = 0;
+
+  GLint mvp_location_ = -1;
+
+  GLint rect_location_ = -1;
+
+  GLint height_location_ = -1;
+};
+
+} // namespace
+
+//========//
+// Voxels //
+//========//
+
+namespace {
+
+namespace voxel_shader {
+
+const char* vert_source = R"(
+#version 300 es
+
+uniform highp mat4 mvp;
+
+uniform highp float voxel_size;
+
+layout(location = 0) in highp vec3 g_position;
+
+layout(location = 1) in lowp vec4 g_color;
+
+layout(location = 2) in highp float g_faces;
+
+out lowp vec4 g_voxel_color;
+
+// Two triangles for each face of a unit cube, in the order of the face bits.
+const highp vec3 corners[36] = vec3[36](
+  vec3(0.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0), vec3(0.0, 1.0, 1.0),
+  vec3(0.0, 0.0, 0.0), vec3(0.0, 1.0, 1.0), vec3(0.0, 0.0, 1.0),
+  vec3(1.0, 0.0, 0.0), vec3(1.0, 1.0, 0.0), vec3(1.0, 1.0, 1.0),
+  vec3(1.0, 0.0, 0.0), vec3(1.0, 1.0, 1.0), vec3(1.0, 0.0, 1.0),
+  vec3(0.0, 0.0, 0.0), vec3(0.0, 0.0, 1.0), vec3(1.0, 0.0, 1.0),
+  vec3(0.0, 0.0, 0.0), vec3(1.0, 0.0, 1.0), vec3(1.0, 0.0, 0.0),
+  vec3(0.0, 1.0, 0.0), vec3(0.0, 1.0, 1.0), vec3(1.0, 1.0, 1.0),
+  vec3(0.0, 1.0, 0.0), vec3(1.0, 1.0, 1.0), vec3(1.0, 1.0, 0.0),
+  vec3(0.0, 0.0, 0.0), vec3(1.0, 0.0, 0.0), vec3(1.0, 1.0, 0.0),
+  vec3(0.0, 0.0, 0.0), vec3(1.0, 1.0, 0.0), vec3(0.0, 1.0, 0.0),
+  vec3(0.0, 0.0, 1.0), vec3(1.0, 0.0, 1.0), vec3(1.0, 1.0, 1.0),
+  vec3(0.0, 0.0, 1.0), vec3(1.0, 1.0, 1.0), vec3(0.0, 1.0, 1.0));
+
+// Fixed shading per face, so that the shape of the voxels can be seen without normals.
+const lowp float shades[6] = float[6](0.7, 0.8, 0.65, 0.75, 0.55, 1.0);
+
+void main()
+{
+  int face = gl_VertexID / 6;
+
+  // Faces that are covered by a neighbor are moved out of the view volume, along with the rest of their triangles.
+  if (((int(g_faces + 0.5) >> face) & 1) == 0) {
+    gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+    return;
+  }
+
+  g_voxel_color = vec4(g_color.rgb * shades[face], g_color.a);
+
+  gl_Position = mvp * vec4(g_position + (corners[gl_VertexID] * voxel_size), 1.0);
+}
+)";
+
+const char* frag_source = R"(
+#version 300 es
+
+in lowp vec4 g_voxel_color;
+
+out lowp vec4 g_out_color;
+
+void main()
+{
+  g_out_color = g_voxel_color;
+}
+)";
+
+} // namespace voxel_shader
+
+/** @brief The visible voxels of a point cloud, kept on the GPU.
+ * */
+class VoxelSet final
+{
+public:
+  bool init(BufferPool* pool) { return vertex_array_.init(voxel_instance_layout(), pool); }
+
+  void cleanup()
+  {
+    vertex_array_.cleanup();
+
+    size_ = 0;
+  }
+
+  bool build(const dataviz_vertex_z* points, uint32_t count, float voxel_size)
+  {
+    if (!build_voxels(points, count, voxel_size, voxels_))
+      return false;
+
+    vertex_array_.bind();
+
+    const bool success = vertex_array_.buffer_data(voxels_.data(), uint32_t(voxels_.size()), GL_STATIC_DRAW);
+
+    vertex_array_.unbind();
+
+    size_ = success ? uint32_t(voxels_.size()) : 0;
+
+    voxel_size_ = voxel_size;
+
+    // The instances are on the GPU now, so only the capacity is kept for the next build.
+    voxels_.clear();
+
+    return success;
+  }
+
+  uint32_t size() const { return size_; }
+
+  float voxel_size() const { return voxel_size_; }
+
+  VertexArray& vertex_array() { return vertex_array_; }
+
+private:
+  VertexArray vertex_array_;
+
+  std::vector<VoxelInstance> voxels_;
+
+  uint32_t size_ = 0;
+
+  float voxel_size_ = 1;
+};
+
+class VoxelShaderProgram final
+{
+public:
+  bool init(ShaderCompiler& compiler)
+  {
+    return shader_program_.init(compiler, voxel_shader::vert_source, voxel_shader::frag_source);
+  }
+
+  bool ready()
+  {
+    return shader_program_.ready([this]() {
+      mvp_location_ = shader_program_.get_uniform_location("mvp");
+
+      voxel_size_location_ = shader_program_.get_uniform_location("voxel_size");
+    });
+  }
+
+  void cleanup() { shader_program_.cleanup(); }
+
+  bool render_voxels(VoxelSet& voxels, const glm::mat4& mvp)
+  {
+    shader_program_.wait();
+
+    if (!ready())
+      return false;
+
+    voxels.vertex_array().bind();
+
+    shader_program_.bind();
+
+    glUniformMatrix4fv(mvp_location_, 1, GL_FALSE, glm::value_ptr(mvp));
+
+    glUniform1f(voxel_size_location_, voxels.voxel_size());
+
+    // Unlike points, solid cubes need to hide each other.
+    const GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+
+    glEnable(GL_DEPTH_TEST);
+
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 36, voxels.size());
+
+    if (!depth_test)
+      glDisable(GL_DEPTH_TEST);
+
+    shader_program_.unbind();
+
+    voxels.vertex_array().unbind();
+
+    return glGetError() == GL_NO_ERROR;
+  }
+
+private:
+  ShaderProgram shader_program_;
+
+  GLint mvp_location_ = -1;
+
+  GLint voxel_size_location_ = -1;
+};
+
+} // namespace
+
+//=====================//
+// Performance Overlay //
+//=====================//
+
+namespace {
+
+/** @brief Counts the GL calls made in each frame, from the counters of the loader.
+ *
+ * @details The counters of the loader only ever grow, so the counts of a frame are the difference between the
+ *          counters at its end and the ones at the end of the frame before. Without GL instrumentation there are no
+ *          entry points, and every count stays zero.
+ * */
+class GLCallCounter final
+{
+public:
+  GLCallCounter()
+    : entry_point_count_(gl_entry_point_count())
+    , totals_(entry_point_count_ * 2)
+    , baseline_(entry_point_count_ * 2)
+    , frame_calls_(entry_point_count_)
+    , frame_bytes_(entry_point_count_)
+  {
+  }
+
+  void end_frame()
+  {
+    read_gl_counters(totals_.data(), totals_.data() + entry_point_count_);
+
+    calls_ = 0;
+    upload_bytes_ = 0;
+
+    for (size_t i = 0; i < entry_point_count_; i++) {
+
+      frame_calls_[i] = uint32_t(totals_[i] - baseline_[i]);
+      frame_bytes_[i] = totals_[entry_point_count_ + i] - baseline_[entry_point_count_ + i];
+
+      calls_ += frame_calls_[i];
+      upload_bytes_ += frame_bytes_[i];
+    }
+
+    baseline_.swap(totals_);
+  }
+
+  /** @brief Leaves the calls made since the end of the last frame out of the next one.
+   * */
+  void skip()
+  {
+    if (entry_point_count_ > 0)
+      read_gl_counters(baseline_.data(), baseline_.data() + entry_point_count_);
+  }
+
+  uint32_t calls() const { return calls_; }
+
+  uint64_t upload_bytes() const { return upload_bytes_; }
+
+  uint32_t get(dataviz_gl_call_stats_z* stats, uint32_t capacity) const
+  {
+    std::vector<uint32_t> called;
+
+    for (size_t i = 0; i < entry_point_count_; i++) {
+      if (frame_calls_[i] > 0)
+        called.push_back(uint32_t(i));
+    }
+
+    std::sort(called.begin(), called.end(), [this](uint32_t a, uint32_t b) {
+      return frame_calls_[a] > frame_calls_[b];
+    });
+
+    for (size_t i = 0; (i < called.size()) && (i < capacity) && stats; i++) {
+      const uint32_t index = called[i];
+      stats[i] = dataviz_gl_call_stats_z{ gl_entry_point_name(index), frame_calls_[index], frame_bytes_[index] };
+    }
+
+    return uint32_t(called.size());
+  }
+
+private:
+  size_t entry_point_count_;
+
+  /// The calls of each entry point, followed by the bytes of each.
+  std::vector<uint64_t> totals_;
+
+  /// The totals at the end of the last frame, in the same layout.
+  std::vector<uint64_t> baseline_;
+
+  std::vector<uint32_t> frame_calls_;
+
+  std::vector<uint64_t> frame_bytes_;
+
+  uint32_t calls_ = 0;
+
+  uint64_t upload_bytes_ = 0;
+};
+
+/** @brief Counts the work done in each frame, and times the frames.
+ * */
+class FrameStatistics final
+{
+public:
+  void count_draw(uint64_t points = 0)
+  {
+    draw_calls_++;
+    points_drawn_ += points;
+  }
+
+  void count_culled(uint64_t points) { points_culled_ += points; }
+
+  void count_upload(uint64_t bytes) { upload_bytes_ += bytes; }
+
+  /** @brief Closes the counts of a frame, timing it from the end of the frame before.
+   * */
+  void end_frame(uint64_t gpu_memory_bytes)
+  {
+    const double now = glfwGetTime();
+
+    const double seconds = (last_frame_end_ >= 0) ? (now - last_frame_end_) : 0.0;
+
+    last_frame_end_ = now;
+
+    if (seconds > 0) {
+
+      if (frame_times_.size() == g_frame_history)
+        frame_times_.erase(frame_times_.begin());
+
+      frame_times_.push_back(float(seconds * 1000.0));
+    }
+
+    float total_ms = 0;
+
+    for (const float ms : frame_times_)
+      total_ms += ms;
+
+    stats_.frame_time_ms = float(seconds * 1000.0);
+    stats_.frames_per_second = (total_ms > 0) ? (1000.0f * float(frame_times_.size()) / total_ms) : 0.0f;
+    stats_.points_drawn = points_drawn_;
+    stats_.points_culled = points_culled_;
+    stats_.draw_calls = draw_calls_;
+    stats_.upload_megabytes_per_second = (seconds > 0) ? float((double(upload_bytes_) / 1.0e6) / seconds) : 0.0f;
+    stats_.gpu_memory_bytes = gpu_memory_bytes;
+
+    gl_calls_.end_frame();
+
+    stats_.gl_calls = gl_calls_.calls();
+    stats_.gl_upload_bytes = gl_calls_.upload_bytes();
+
+    points_drawn_ = 0;
+    points_culled_ = 0;
+    draw_calls_ = 0;
+    upload_bytes_ = 0;
+  }
+
+  const dataviz_frame_stats_z& stats() const { return stats_; }
+
+  const GLCallCounter& gl_calls() const { return gl_calls_; }
+
+  /// Leaves the GL calls made since the end of the frame out of the next one, such as the ones of the overlay.
+  void skip_gl_calls() { gl_calls_.skip(); }
+
+  /// The times of the last frames in milliseconds, oldest first.
+  const std::vector<float>& frame_times() const { return frame_times_; }
+
+private:
+  dataviz_frame_stats_z stats_{};
+
+  std::vector<float> frame_times_;
+
+  double last_frame_end_ = -1;
+
+  uint64_t points_drawn_ = 0;
+
+  uint64_t points_culled_ = 0;
+
+  uint32_t draw_calls_ = 0;
+
+  uint64_t upload_bytes_ = 0;
+
+  GLCallCounter gl_calls_;
+};
+
+/** @brief Draws the statistics of the last frame, and a graph of the frame times, in the corner of the window.
+ *
+ * @details The overlay is drawn in normalized device coordinates with the text and line programs, so it costs one
+ *          instanced draw for the text, one for the graph, and a few kilobytes of uploads.
+ * */
+class PerformanceOverlay final
+{
+public:
+  bool init(BufferPool* pool) { return graph_.init(pool); }
+
+  void cleanup() { graph_.cleanup(); }
+
+  void render(const FrameStatistics& statistics,
+              TextShaderProgram& text_program,
+              LineShaderProgram& line_program,
+              const glm::ivec2& framebuffer_size)
+  {
+    if ((framebuffer_size.x <= 0) || (framebuffer_size.y <= 0))
+      return;
+
+    const auto& stats = statistics.stats();
+
+    snprintf(text_,
+             sizeof(text_),
+             "%.1f FPS  %.2f MS\n"
+             "POINTS %.2fM DRAWN  %.2fM CULLED\n"
+             "DRAW CALLS %u\n"
+             "UPLOAD %.1f MB/S\n"
+             "GPU MEMORY %.1f MB",
+             stats.frames_per_second,
+             stats.frame_time_ms,
+             double(stats.points_drawn) / 1.0e6,
+             double(stats.points_culled) / 1.0e6,
+             stats.draw_calls,
+             stats.upload_megabytes_per_second,
+             double(stats.gpu_memory_bytes) / 1.0e6);
+
+    const float line_height = g_overlay_text_size * float(g_line_advance) / float(g_glyph_height);
+
+    const auto text_anchor =
+      to_clip(framebuffer_size, glm::vec2(g_overlay_margin, g_overlay_margin + g_overlay_text_size));
+
+    dataviz_label_z label{ { text_anchor.x, text_anchor.y, 0 }, text_, g_overlay_text_size, 255, 255, 255, 255 };
+
+    const glm::mat4 identity(1.0f);
+
+    text_program.render_labels(&label, 1, identity, framebuffer_size);
+
+    // The graph goes under the five lines of text, with the budget at half of its height.
+    const float graph_top = g_overlay_margin + (5.0f * line_height) + g_overlay_margin;
+
+    const float graph_bottom = graph_top + g_overlay_graph_height;
+
+    const auto& frame_times = statistics.frame_times();
+
+    vertices_.clear();
+
+    for (size_t i = 0; i < frame_times.size(); i++) {
+
+      const float ms = frame_times[i];
+
+      const float height = std::min(ms / (2.0f * g_frame_budget_ms), 1.0f) * g_overlay_graph_height;
+
+      const float x = g_overlay_margin + (float(i) * g_overlay_graph_step);
+
+      const auto p = to_clip(framebuffer_size, glm::vec2(x, graph_bottom - height));
+
+      // Frames over the budget are drawn in red.
+      const unsigned char green = (ms > g_frame_budget_ms) ? 64 : 255;
+
+      vertices_.push_back(dataviz_vertex_z{ p.x, p.y, 0, 255, green, 64, 255 });
+    }
+
+    const float graph_width = float(g_frame_history - 1) * g_overlay_graph_step;
+
+    const float budget_y = graph_bottom - (0.5f * g_overlay_graph_height);
+
+    const auto budget_left = to_clip(framebuffer_size, glm::vec2(g_overlay_margin, budget_y));
+
+    const auto budget_right = to_clip(framebuffer_size, glm::vec2(g_overlay_margin + graph_width, budget_y));
+
+    const dataviz_vertex_z budget[2]{ { budget_left.x, budget_left.y, 0, 128, 128, 128, 255 },
+                                      { budget_right.x, budget_right.y, 0, 128, 128, 128, 255 } };
+
+    graph_.clear();
+
+    graph_.add_polyline(budget, 2);
+
+    graph_.add_polyline(vertices_.data(), uint32_t(vertices_.size()));
+
+    line_program.render_lines(graph_, 1.0f, identity, framebuffer_size);
+  }
+
+private:
+  /// Converts a position in pixels, from the top left corner of the window, into clip space.
+  static glm::vec2 to_clip(const glm::ivec2& framebuffer_size, const glm::vec2& pixel)
+  {
+    return glm::vec2(((2.0f * pixel.x) / float(framebuffer_size.x)) - 1.0f,
+                     1.0f - ((2.0f * pixel.y) / float(framebuffer_size.y)));
+  }
+
+  LineBatch graph_;
+
+  std::vector<dataviz_vertex_z> vertices_;
+
+  char text_[256]{};
+};
+
+} // namespace
+
+//=========//
+// Library //
+//=========//
+
+namespace {
+
+class Library final
+{
+public:
+  void add_logger(void* logger_data, datviz_logger_callback callback)
+  {
+    log_.add_logger(Logger{ logger_data, callback });
+  }
+
+  void get_window_size(int* w, int* h) { window_.get_window_size(w, h); }
+
+  void get_framebuffer_size(int* w, int* h) { window_.get_framebuffer_size(w, h); }
+
+  void cleanup() { cleanup_opengl_objects(); }
+
+  void make_context_current() { window_.make_context_current(); }
+
+  void set_camera_controller_enabled(bool enabled) { camera_controller_.set_enabled(enabled); }
+
+  void set_window_title(const char* title) { window_.set_title(title); }
+
+  void set_window_visible(bool visible) { window_.set_visible(visible); }
+
+  void set_vsync_enabled(bool enabled) { window_.set_vsync_enabled(enabled); }
+
+  void set_background_color(const glm::vec4& bg) { background_color_ = bg; }
+
+  void set_model_transform(const glm::mat4& transform) { model_transform_ = transform; }
+
+  void set_view_transform(const glm::mat4& transform)
+  {
+    view_transform_ = transform;
+    top_down_ = false;
+  }
+
+  void set_projection_transform(const glm::mat4& transform)
+  {
+    projection_transform_ = transform;
+    top_down_ = false;
+  }
+
+  glm::mat4 model_view_projection() const { return mvp(); }
+
+  void set_top_down_view(const glm::vec2& center, float units_per_pixel)
+  {
+    top_down_ = true;
+    top_down_center_ = center;
+    top_down_units_per_pixel_ = units_per_pixel;
+  }
+
+  void set_surfel_backface_culling(bool enabled) { surfel_backface_culling_ = enabled; }
+
+  void set_render_mode(datviz_render_mode mode) { render_mode_ = mode; }
+
+  void set_density_colormap(datviz_colormap colormap, float saturation)
+  {
+    density_colormap_ = colormap;
+    density_saturation_ = saturation;
+  }
+
+  void set_hud_enabled(bool enabled) { hud_enabled_ = enabled; }
+
+  const dataviz_frame_stats_z& frame_stats() const { return frame_stats_.stats(); }
+
+  uint32_t gl_call_stats(dataviz_gl_call_stats_z* stats, uint32_t capacity) const
+  {
+    return frame_stats_.gl_calls().get(stats, capacity);
+  }
+
+  /** @brief Counts vertex data that was uploaded outside of the render functions, such as into a retained cloud.
+   * */
+  void count_upload(uint64_t bytes) { frame_stats_.count_upload(bytes); }
+
+  bool begin_frame()
+  {
+    if (!window_.make_context_current())
+      return false;
+
+    if (!opengl_objects_initialized_)
+      init_opengl_objects();
+
+    glClearColor(background_color_[0], background_color_[1], background_color_[2], background_color_[3]);
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    int w = 0;
+    int h = 0;
+    window_.get_framebuffer_size(&w, &h);
+
+    glViewport(0, 0, w, h);
+
+    framebuffer_size_ = glm::ivec2(w, h);
+
+    // The top down view depends on the size of the framebuffer, so that the scale stays the same when it is resized.
+    if (top_down_) {
+      const auto half_extent = glm::vec2(framebuffer_size_) * (0.5f * top_down_units_per_pixel_);
+      view_transform_ = glm::translate(glm::mat4(1.0f), glm::vec3(-top_down_center_, 0.0f));
+      projection_transform_ =
+        glm::ortho(-half_extent.x, half_extent.x, -half_extent.y, half_extent.y, -g_top_down_depth, g_top_down_depth);
+    }
+
+    // The mode is latched for the whole frame, so that a change in the middle of a frame takes effect on the next one.
+    // Points are drawn with their colors until the density program has compiled.
+    frame_render_mode_ = density_shader_program_.ready() ? render_mode_ : DATVIZ_RENDER_MODE_POINTS;
+
+    if (frame_render_mode_ == DATVIZ_RENDER_MODE_DENSITY)
+      density_target_.begin_frame(framebuffer_size_);
+
+    return glGetError() == GL_NO_ERROR;
+  }
+
+  void end_frame()
+  {
+    if (frame_render_mode_ == DATVIZ_RENDER_MODE_DENSITY)
+      density_shader_program_.resolve(density_target_, density_colormap_, density_saturation_);
+
+    frame_stats_.end_frame(buffer_pool_.allocated_bytes());
+
+    // The overlay is drawn straight through the programs, so that it is not counted in the statistics it shows.
+    if (hud_enabled_) {
+      DATVIZ_PERF_SCOPE("hud");
+      overlay_.render(frame_stats_, text_shader_program_, line_shader_program_, framebuffer_size_);
+      frame_stats_.skip_gl_calls();
+    }
+
+    buffer_pool_.end_frame();
+
+    window_.swap_buffers();
+  }
+
+  void render_points(const dataviz_vertex_z* vertices, uint32_t vertex_count)
+  {
+    begin_points();
+    const bool drawn = point_shader_program_.render_points(vertices, vertex_count, mvp());
+    end_points();
+
+    if (!drawn)
+      return;
+
+    frame_stats_.count_draw(vertex_count);
+    frame_stats_.count_upload(uint64_t(vertex_count) * sizeof(dataviz_vertex_z));
+  }
+
+  void render_indexed_points(const dataviz_vertex_z* vertices,
+                             uint32_t vertex_count,
+                             const uint32_t* indices,
+                             uint32_t index_count)
+  {
+    begin_points();
+    const bool drawn = point_shader_program_.render_indexed_points(vertices, vertex_count, indices, index_count, mvp());
+    end_points();
+
+    if (!drawn)
+      return;
+
+    frame_stats_.count_draw(index_count);
+    frame_stats_.count_upload((uint64_t(vertex_count) * sizeof(dataviz_vertex_z)) +
+                              (uint64_t(index_count) * sizeof(uint32_t)));
+  }
+
+  void render_surfels(const dataviz_surfel_vertex_z* vertices, uint32_t count, float radius)
+  {
+    bool drawn = false;
+
+    // Surfels start with a position and a color, like points, so they are drawn as points until their program is ready.
+    if (!surfel_shader_program_.ready()) {
+      drawn = point_shader_program_.render_vertex_array(
+        surfel_shader_program_.upload(vertices, count), 0, count, mvp());
+    } else {
+      drawn = surfel_shader_program_.render_surfels(vertices,
+                                                    count,
+                                                    radius,
+                                                    surfel_backface_culling_,
+                                                    view_transform_ * model_transform_,
+                                                    projection_transform_,
+                                                    framebuffer_size_.y);
+    }
+
+    if (!drawn)
+      return;
+
+    frame_stats_.count_draw(count);
+    frame_stats_.count_upload(uint64_t(count) * sizeof(dataviz_surfel_vertex_z));
+  }
+
+  void render_boxes(const dataviz_box_z* boxes, uint32_t count)
+  {
+    if (!box_shader_program_.render_boxes(boxes, count, mvp()))
+      return;
+
+    frame_stats_.count_draw();
+    frame_stats_.count_upload(uint64_t(count) * sizeof(dataviz_box_z));
+  }
+
+  void render_lines(LineBatch& batch, float width)
+  {
+    // The pending segments are uploaded by the draw, which leaves none pending.
+    const uint64_t upload_bytes = uint64_t(batch.pending_count()) * sizeof(Segment);
+
+    if (!line_shader_program_.render_lines(batch, width, mvp(), framebuffer_size_))
+      return;
+
+    frame_stats_.count_draw();
+    frame_stats_.count_upload(upload_bytes);
+  }
+
+  void render_labels(const dataviz_label_z* labels, uint32_t count)
+  {
+    if (!text_shader_program_.render_labels(labels, count, mvp(), framebuffer_size_))
+      return;
+
+    frame_stats_.count_draw();
+  }
+
+  void render_vector_field(const dataviz_vertex_z* points,
+                           const float* vectors,
+                           uint32_t count,
+                           uint32_t stride,
+                           float scale)
+  {
+    if (!arrow_shader_program_.render_vector_field(points, vectors, count, stride, scale, mvp(), framebuffer_size_))
+      return;
+
+    frame_stats_.count_draw();
+  }
+
+  void render_map(TileMap& map)
+  {
+    const auto& pyramid = map.pyramid();
+
+    if (framebuffer_size_.x <= 0)
+      return;
+
+    // The part of the XY plane that is in view, from the corners of the view volume.
+    const auto inverse = glm::inverse(mvp());
+
+    glm::vec2 min(std::numeric_limits<float>::max());
+    glm::vec2 max(-std::numeric_limits<float>::max());
+
+    for (int i = 0; i < 8; i++) {
+      const glm::vec4 corner((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f, 1.0f);
+      const auto p = inverse * corner;
+      min = glm::min(min, glm::vec2(p) / p.w);
+      max = glm::max(max, glm::vec2(p) / p.w);
+    }
+
+    const float units_per_pixel = (max.x - min.x) / float(framebuffer_size_.x);
+
+    // Once the cells of the finest level would cover more than two pixels, the points themselves are drawn.
+    if (units_per_pixel < (0.5f * pyramid.cell_size())) {
+      render_map_points(map, min, max);
+      return;
+    }
+
+    const float level = std::floor(std::log2(units_per_pixel / pyramid.cell_size()));
+
+    const auto last_level = float(pyramid.levels().size() - 1);
+
+    uint32_t tile_count = 0;
+
+    map_shader_program_.render_tiles(
+      map, size_t(std::min(std::max(level, 0.0f), last_level)), min, max, mvp(), tile_count);
+
+    for (uint32_t i = 0; i < tile_count; i++)
+      frame_stats_.count_draw();
+  }
+
+  void render_voxels(VoxelSet& voxels)
+  {
+    if (!voxel_shader_program_.render_voxels(voxels, mvp()))
+      return;
+
+    frame_stats_.count_draw();
+  }
+
+  void render_cloud(RetainedCloud& cloud) { render_cloud_range(cloud, 0, cloud.size()); }
+
+  void render_cloud_range(RetainedCloud& cloud, uint32_t first, uint32_t count)
+  {
+    frame_stats_.count_culled(cloud.size() - count);
+
+    if (count == 0)
+      return;
+
+    begin_points();
+    const bool drawn = point_shader_program_.render_vertex_array(cloud.vertex_array(), first, count, mvp());
+    end_points();
+
+    if (drawn)
+      frame_stats_.count_draw(count);
+  }
+
+  bool should_close() { return window_.should_close(); }
+
+  BufferPool& buffer_pool() { return buffer_pool_; }
+
+private:
+  glm::mat4 mvp() const { return projection_transform_ * view_transform_ * model_transform_; }
+
+  /** @brief Draws the points under the tiles of the finest level that are in view.
+   *
+   * @details The points are sorted by tile, row by row, so each row of tiles in view is a single range of points.
+   * */
+  void render_map_points(TileMap& map, const glm::vec2& min, const glm::vec2& max)
+  {
+    const auto& pyramid = map.pyramid();
+
+    const auto& base = pyramid.levels()[0];
+
+    const auto& offsets = pyramid.tile_offsets();
+
+    const float tile_extent = pyramid.cell_size() * float(g_tile_size);
+
+    const glm::vec2 origin(pyramid.origin_x(), pyramid.origin_y());
+
+    const auto first = glm::max(glm::ivec2(glm::floor((min - origin) / tile_extent)), glm::ivec2(0, 0));
+    const auto last =
+      glm::min(glm::ivec2(glm::floor((max - origin) / tile_extent)), glm::ivec2(base.tiles_x - 1, base.tiles_y - 1));
+
+    uint64_t drawn = 0;
+
+    if ((first.x > last.x) || (first.y > last.y)) {
+      frame_stats_.count_culled(map.cloud().size());
+      return;
+    }
+
+    begin_points();
+
+    for (int y = first.y; y <= last.y; y++) {
+
+      const size_t row = size_t(y) * size_t(base.tiles_x);
+
+      const uint32_t begin = offsets[row + size_t(first.x)];
+      const uint32_t end = offsets[row + size_t(last.x) + 1];
+
+      if (end <= begin)
+        continue;
+
+      if (point_shader_program_.render_vertex_array(map.cloud().vertex_array(), begin, end - begin, mvp())) {
+        frame_stats_.count_draw(end - begin);
+        drawn += end - begin;
+      }
+    }
+
+    end_points();
+
+    frame_stats_.count_culled(map.cloud().size() - drawn);
+  }
+
+  /** @brief Redirects point rendering into the density target, when the frame is rendered in density mode.
+   * */
+  void begin_points()
+  {
+    if (frame_render_mode_ != DATVIZ_RENDER_MODE_DENSITY)
+      return;
+
+    density_target_.bind();
+
+    point_shader_program_.set_splat_weight(density_target_.splat_weight());
+  }
+
+  void end_points()
+  {
+    if (frame_render_mode_ != DATVIZ_RENDER_MODE_DENSITY)
+      return;
+
+    point_shader_program_.set_splat_weight(0);
+
+    density_target_.unbind();
+  }
+
+  /** @brief Creates the objects that the library draws with.
+   *
+   * @details Every program but the point program is only submitted to the shader compiler here, so that none of them
+   *          hold up the first frame. The point program is small, and is what everything falls back to while the other
+   *          programs are compiling, so it is compiled right away.
+   * */
+  void init_opengl_objects()
+  {
+    opengl_objects_initialized_ = true;
+
+    shader_compiler_.init(window_.handle());
+
+    if (!point_shader_program_.init())
+      log_.error("Failed to initialize the point shader program.");
+
+    if (!surfel_shader_program_.init(shader_compiler_))
+      log_.error("Failed to initialize the surfel shader program.");
+
+    if (!line_shader_program_.init(shader_compiler_))
+      log_.error("Failed to initialize the line shader program.");
+
+    if (!box_shader_program_.init(shader_compiler_))
+      log_.error("Failed to initialize the box shader program.");
+
+    if (!text_shader_program_.init(shader_compiler_))
+      log_.error("Failed to initialize the text shader program.");
+
+    if (!arrow_shader_program_.init(shader_compiler_))
+      log_.error("Failed to initialize the arrow shader program.");
+
+    if (!density_target_.init())
+      log_.error("Failed to initialize the density target.");
+
+    if (!density_shader_program_.init(shader_compiler_))
+      log_.error("Failed to initialize the density shader program.");
+
+    if (!map_shader_program_.init(shader_compiler_))
+      log_.error("Failed to initialize the map shader program.");
+
+    if (!voxel_shader_program_.init(shader_compiler_))
+      log_.error("Failed to initialize the voxel shader program.");
+
+    if (!overlay_.init(&buffer_pool_))
+      log_.error("Failed to initialize the performance overlay.");
+  }
+
+  void cleanup_opengl_objects()
+  {
+    if (!window_.is_created())
+      return;
+
+    if (!window_.make_context_current())
+      return;
+
+    // The worker may still be building a program, so it is stopped before any program is deleted.
+    shader_compiler_.cleanup();
+
+    point_shader_program_.cleanup();
+
+    surfel_shader_program_.cleanup();
+
+    line_shader_program_.cleanup();
+
+    box_shader_program_.cleanup();
+
+    text_shader_program_.cleanup();
+
+    arrow_shader_program_.cleanup();
+
+    density_target_.cleanup();
+
+    density_shader_program_.cleanup();
+
+    map_shader_program_.cleanup();
+
+    voxel_shader_program_.cleanup();
+
+    overlay_.cleanup();
+
+    buffer_pool_.cleanup();
+
+    opengl_objects_initialized_ = false;
+  }
+
+private:
+  LoggerProxy log_;
+
+  CameraController camera_controller_;
+
+  Window window_;
+
+  PointShaderProgram point_shader_program_;
+
+  SurfelShaderProgram surfel_shader_program_;
+
+  LineShaderProgram line_shader_program_;
+
+  BoxShaderProgram box_shader_program_;
+
+  TextShaderProgram text_shader_program_;
+
+  ArrowShaderProgram arrow_shader_program_;
+
+  DensityTarget density_target_;
+
+  DensityShaderProgram density_shader_program_;
+
+  MapShaderProgram map_shader_program_;
+
+  VoxelShaderProgram voxel_shader_program_;
+
+  ShaderCompiler shader_compiler_;
+
+  BufferPool buffer_pool_;
+
+  FrameStatistics frame_stats_;
+
+  PerformanceOverlay overlay_;
+
+  bool hud_enabled_ = false;
+
+  glm::vec4 background_color_{ 0, 0, 0, 1 };
+
+  glm::mat4 model_transform_{ glm::mat4(1.0f) };
+
+  glm::mat4 view_transform_{ glm::mat4(1.0f) };
+
+  glm::mat4 projection_transform_{ glm::mat4(1.0f) };
+
+  glm::ivec2 framebuffer_size_{ 0, 0 };
+
+  bool top_down_ = false;
+
+  glm::vec2 top_down_center_{ 0, 0 };
+
+  float top_down_units_per_pixel_ = 1;
+
+  bool surfel_backface_culling_ = false;
+
+  datviz_render_mode render_mode_ = DATVIZ_RENDER_MODE_POINTS;
+
+  datviz_render_mode frame_render_mode_ = DATVIZ_RENDER_MODE_POINTS;
+
+  datviz_colormap density_colormap_ = DATVIZ_COLORMAP_INFERNO;
+
+  float density_saturation_ = 1000.0f;
+
+  bool opengl_objects_initialized_ = false;
+};
+
+} // namespace
+
+//============//
+// Public API //
+//============//
+
+struct datviz_struct final
+{
+  Library library;
+#if 0
+  LoggerProxy log;
+
+  GLuint vertex_array = 0;
+
+  GLuint vertex_buffer = 0;
+
+  GLuint program = 0;
+
+  GLint mvp_location = -1;
+
+  glm::mat4 projection_transform = glm::perspective(glm::radians(45.0f), 1.0f, 0.01f, 100.0f);
+
+  glm::mat4 view_transform = glm::lookAt(glm::vec3(2, 2, 3), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+
+  glm::mat4 model_transform = glm::mat4(1.0f);
+
+  glm::mat4 mvp() const { return projection_transform * view_transform * model_transform; }
+#endif
+};
+
+struct datviz_cloud_struct final
+{
+  datviz_z* viz = nullptr;
+
+  RetainedCloud cloud;
+};
+
+struct datviz_map_struct final
+{
+  datviz_z* viz = nullptr;
+
+  TileMap map;
+};
+
+struct datviz_voxels_struct final
+{
+  datviz_z* viz = nullptr;
+
+  VoxelSet voxels;
+};
+
+struct datviz_lines_struct final
+{
+  datviz_z* viz = nullptr;
+
+  LineBatch batch;
+};
+
+namespace {
+
+#if 0
+void
+key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+  if ((key == GLFW_KEY_ESCAPE) && (action == GLFW_PRESS))
+    glfwSetWindowShouldClose(window, GLFW_TRUE);
+}
+#endif
+
+} // namespace
+
+datviz_struct*
+datviz_create(void)
+{
+  auto* viz = new datviz_struct();
+
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::create).new_object(viz));
+
+  return viz;
+}
+#if 0
+  glClearColor(0, 0, 0, 1);
+
+  glAttachShader(viz->program, vert_shader);
+  glAttachShader(viz->program, frag_shader);
+
+  glLinkProgram(viz->program);
+
+  glDetachShader(viz->program, frag_shader);
+  glDetachShader(viz->program, vert_shader);
+
+  glDeleteShader(vert_shader);
+  glDeleteShader(frag_shader);
+
+  GLint link_status = GL_FALSE;
+
+  glGetProgramiv(viz->program, GL_LINK_STATUS, &link_status);
+
+  if (link_status != GL_TRUE) {
+    glDeleteProgram(viz->program);
+    glfwDestroyWindow(viz->window);
+    delete viz;
+    return nullptr;
+  }
+
+  glUseProgram(viz->program);
+
+  viz->mvp_location = glGetUniformLocation(viz->program, "mvp");
+#endif
+
+void
+datviz_destroy(datviz_z* viz)
+{
+  if (!viz)
+    return;
+
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::destroy).destroyed_object(viz));
+
+  viz->library.cleanup();
+
+  delete viz;
+#if 0
+  glfwMakeContextCurrent(viz->window);
+
+  glDisable(GL_DEPTH);
+
+  glDeleteBuffers(1, &viz->vertex_buffer);
+
+  glDeleteVertexArrays(1, &viz->vertex_array);
+
+  glDeleteProgram(viz->program);
+
+  glfwDestroyWindow(viz->window);
+#endif
+}
+
+void
+datviz_add_logger(datviz_z* viz, void* logger_data, datviz_logger_callback callback)
+{
+  assert(viz != nullptr);
+  viz->library.add_logger(logger_data, callback);
+}
+
+void
+datviz_set_camera_controls_enabled(datviz_z* viz, int enabled)
+{
+  assert(viz != nullptr);
+
+  viz->library.set_camera_controller_enabled(!!enabled);
+}
+
+void
+datviz_set_window_title(datviz_z* viz, const char* title)
+{
+  assert(viz != nullptr);
+
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::set_window_title).object(viz).string(title));
+
+  viz->library.set_window_title(title);
+}
+
+void
+datviz_set_window_visible(datviz_z* viz, int visible)
+{
+  assert(viz != nullptr);
+
+  viz->library.set_window_visible(!!visible);
+}
+
+void
+datviz_set_vsync_enabled(datviz_z* viz, int enabled)
+{
+  assert(viz != nullptr);
+
+  viz->library.set_vsync_enabled(!!enabled);
+}
+
+void
+datviz_get_window_size(datviz_z* viz, int* w, int* h)
+{
+  assert(viz != nullptr);
+
+  viz->library.get_window_size(w, h);
+}
+
+void
+datviz_get_framebuffer_size(datviz_z* viz, int* w, int* h)
+{
+  assert(viz != nullptr);
+
+  viz->library.get_framebuffer_size(w, h);
+}
+
+void
+datviz_set_background(datviz_z* viz, float r, float g, float b, float a)
+{
+  assert(viz != nullptr);
+
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::set_background).object(viz).f32(r).f32(g).f32(b).f32(a));
+
+  viz->library.set_background_color(glm::vec4(r, g, b, a));
+}
+
+void
+datviz_set_top_down_view(datviz_z* viz, float center_x, float center_y, float units_per_pixel)
+{
+  assert(viz != nullptr);
+
+  if (capture_active()) {
+    capture_write(CaptureRecord(CaptureOp::set_top_down_view)
+                    .object(viz)
+                    .f32(center_x)
+                    .f32(center_y)
+                    .f32(units_per_pixel));
+  }
+
+  viz->library.set_top_down_view(glm::vec2(center_x, center_y), units_per_pixel);
+}
+
+void
+datviz_set_render_mode(datviz_z* viz, datviz_render_mode mode)
+{
+  assert(viz != nullptr);
+
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::set_render_mode).object(viz).u32(uint32_t(mode)));
+
+  viz->library.set_render_mode(mode);
+}
+
+void
+datviz_set_density_colormap(datviz_z* viz, datviz_colormap colormap, float saturation)
+{
+  assert(viz != nullptr);
+
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::set_density_colormap).object(viz).u32(uint32_t(colormap)).f32(saturation));
+
+  viz->library.set_density_colormap(colormap, saturation);
+}
+
+void
+datviz_set_model_transform(datviz_z* viz, const float* model_transform)
+{
+  assert(viz != nullptr);
+
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::set_model_transform).object(viz).floats(model_transform, 16));
+
+  viz->library.set_model_transform(glm::make_mat4x4(model_transform));
+}
+
+void
+datviz_set_view_transform(datviz_z* viz, const float* view_transform)
+{
+  assert(viz != nullptr);
+
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::set_view_transform).object(viz).floats(view_transform, 16));
+
+  viz->library.set_view_transform(glm::make_mat4x4(view_transform));
+}
+
+void
+datviz_look_at(datviz_z* viz, const float* eye, const float* center, const float* up)
+{
+  const auto view = glm::lookAt(glm::make_vec3(eye), glm::make_vec3(center), glm::make_vec3(up));
+
+  datviz_set_view_transform(viz, glm::value_ptr(view));
+}
+
+void
+datviz_set_projection_transform(datviz_z* viz, const float* projection_transform)
+{
+  assert(viz != nullptr);
+
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::set_projection_transform).object(viz).floats(projection_transform, 16));
+
+  viz->library.set_projection_transform(glm::make_mat4x4(projection_transform));
+}
+
+void
+datviz_get_model_view_projection(datviz_z* viz, float* mvp)
+{
+  assert(viz != nullptr);
+
+  const auto transform = viz->library.model_view_projection();
+
+  std::copy(glm::value_ptr(transform), glm::value_ptr(transform) + 16, mvp);
+}
+
+void
+datviz_set_perspective(datviz_z* viz, float fovy, float near, float far)
+{
+  int w = 0;
+  int h = 0;
+  datviz_get_framebuffer_size(viz, &w, &h);
+
+  const auto projection = glm::perspective(float(w) / float(h), fovy, near, far);
+
+  datviz_set_projection_transform(viz, glm::value_ptr(projection));
+}
+
+void
+datviz_begin_frame(datviz_z* viz)
+{
+  assert(viz != nullptr);
+
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::begin_frame).object(viz));
+
+  viz->library.begin_frame();
+}
+
+void
+datviz_render_points(datviz_z* viz, const dataviz_vertex_z* vertices, uint32_t count)
+{
+  assert(viz != nullptr);
+
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::render_points).object(viz).array(vertices, count));
+
+  viz->library.render_points(vertices, count);
+}
+
+void
+datviz_render_indexed_points(datviz_z* viz,
+                             const dataviz_vertex_z* vertices,
+                             uint32_t vertex_count,
+                             const uint32_t* indices,
+                             uint32_t index_count)
+{
+  assert(viz != nullptr);
+
+  if (capture_active()) {
+    capture_write(CaptureRecord(CaptureOp::render_indexed_points)
+                    .object(viz)
+                    .array(vertices, vertex_count)
+                    .array(indices, index_count));
+  }
+
+  viz->library.render_indexed_points(vertices, vertex_count, indices, index_count);
+}
+
+void
+datviz_render_surfels(datviz_z* viz, const dataviz_surfel_vertex_z* surfels, uint32_t count, float radius)
+{
+  assert(viz != nullptr);
+
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::render_surfels).object(viz).f32(radius).array(surfels, count));
+
+  viz->library.render_surfels(surfels, count, radius);
+}
+
+void
+datviz_set_surfel_backface_culling(datviz_z* viz, int enabled)
+{
+  assert(viz != nullptr);
+
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::set_surfel_backface_culling).object(viz).u32(uint32_t(enabled)));
+
+  viz->library.set_surfel_backface_culling(!!enabled);
+}
+
+datviz_cloud_z*
+datviz_cloud_create(datviz_z* viz)
+{
+  assert(viz != nullptr);
+
+  viz->library.make_context_current();
+
+  auto* cloud = new datviz_cloud_struct();
+
+  cloud->viz = viz;
+
+  if (!cloud->cloud.init(&viz->library.buffer_pool())) {
+    cloud->cloud.cleanup();
+    delete cloud;
+    return nullptr;
+  }
+
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::cloud_create).object(viz).new_object(cloud));
+
+  return cloud;
+}
+
+void
+datviz_cloud_destroy(datviz_cloud_z* cloud)
+{
+  if (!cloud)
+    return;
+
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::cloud_destroy).destroyed_object(cloud));
+
+  cloud->viz->library.make_context_current();
+
+  cloud->cloud.cleanup();
+
+  delete cloud;
+}
+
+int
+datviz_cloud_upload(datviz_cloud_z* cloud, const dataviz_vertex_z* vertices, uint32_t count)
+{
+  assert(cloud != nullptr);
+
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::cloud_upload).object(cloud).array(vertices, count));
+
+  cloud->viz->library.make_context_current();
+
+  if (!cloud->cloud.upload(vertices, count))
+    return -1;
+
+  cloud->viz->library.count_upload(uint64_t(count) * sizeof(dataviz_vertex_z));
+
+  return 0;
+}
+
+int
+datviz_cloud_upload_owned(datviz_cloud_z* cloud,
+                          dataviz_vertex_z* vertices,
+                          uint32_t count,
+                          datviz_release_callback release,
+                          void* user_data)
+{
+  const int result = datviz_cloud_upload(cloud, vertices, count);
+
+  // The buffer data has been copied by the driver once the upload returns, so the points are no longer needed.
+  if (release)
+    release(user_data, vertices, count);
+
+  return result;
+}
+
+namespace {
+
+/** @brief Captures columns of points packed next to each other, since the arrays they came from are not kept.
+ * */
+void
+capture_columns(CaptureOp op, const datviz_cloud_z* cloud, const dataviz_point_columns_z& columns, uint32_t count)
+{
+  CaptureRecord record(op);
+
+  record.object(cloud).u32(count).u32(columns.rgba ? 1 : 0);
+
+  record.strided(columns.x, sizeof(float), columns.x_stride ? columns.x_stride : sizeof(float), count);
+  record.strided(columns.y, sizeof(float), columns.y_stride ? columns.y_stride : sizeof(float), count);
+  record.strided(columns.z, sizeof(float), columns.z_stride ? columns.z_stride : sizeof(float), count);
+
+  if (columns.rgba)
+    record.strided(columns.rgba, 4, columns.rgba_stride ? columns.rgba_stride : 4, count);
+
+  capture_write(record);
+}
+
+} // namespace
+
+int
+datviz_cloud_upload_columns(datviz_cloud_z* cloud, const dataviz_point_columns_z* columns, uint32_t count)
+{
+  assert(cloud != nullptr);
+  assert(columns != nullptr);
+
+  if (capture_active())
+    capture_columns(CaptureOp::cloud_upload_columns, cloud, *columns, count);
+
+  cloud->viz->library.make_context_current();
 
-} // namespace
+  if (!cloud->cloud.upload_columns(*columns, count))
+    return -1;
 
-//=========//
-// Library //
-//=========//
+  cloud->viz->library.count_upload(uint64_t(count) * sizeof(dataviz_vertex_z));
 
-namespace {
+  return 0;
+}
 
-class Library final
+int
+datviz_cloud_append_columns(datviz_cloud_z* cloud, const dataviz_point_columns_z* columns, uint32_t count)
 {
-public:
-  void add_logger(void* logger_data, datviz_logger_callback callback)
-  {
-    log_.add_logger(Logger{ logger_data, callback });
-  }
+  assert(cloud != nullptr);
+  assert(columns != nullptr);
 
-  void get_window_size(int* w, int* h) { window_.get_window_size(w, h); }
+  if (capture_active())
+    capture_columns(CaptureOp::cloud_append_columns, cloud, *columns, count);
 
-  void get_framebuffer_size(int* w, int* h) { window_.get_framebuffer_size(w, h); }
+  cloud->viz->library.make_context_current();
 
-  void cleanup() { cleanup_opengl_objects(); }
+  if (!cloud->cloud.append_columns(*columns, count))
+    return -1;
 
-  void make_context_current() { window_.make_context_current(); }
+  cloud->viz->library.count_upload(uint64_t(count) * sizeof(dataviz_vertex_z));
 
-  void set_camera_controller_enabled(bool enabled) { camera_controller_.set_enabled(enabled); }
+  return 0;
+}
 
-  void set_window_title(const char* title) { window_.set_title(title); }
+int
+datviz_cloud_reserve(datviz_cloud_z* cloud, uint32_t capacity)
+{
+  assert(cloud != nullptr);
 
-  void set_background_color(const glm::vec4& bg) { background_color_ = bg; }
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::cloud_reserve).object(cloud).u32(capacity));
 
-  void set_model_transform(const glm::mat4& transform) { model_transform_ = transform; }
+  cloud->viz->library.make_context_current();
 
-  void set_view_transform(const glm::mat4& transform) { view_transform_ = transform; }
+  return cloud->cloud.reserve(capacity) ? 0 : -1;
+}
 
-  void set_projection_transform(const glm::mat4& transform) { projection_transform_ = transform; }
+int
+datviz_cloud_append(datviz_cloud_z* cloud, const dataviz_vertex_z* vertices, uint32_t count)
+{
+  assert(cloud != nullptr);
 
-  bool begin_frame()
-  {
-    if (!window_.make_context_current())
-      return false;
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::cloud_append).object(cloud).array(vertices, count));
 
-    glClearColor(background_color_[0], background_color_[1], background_color_[2], background_color_[3]);
+  cloud->viz->library.make_context_current();
 
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  if (!cloud->cloud.append(vertices, count))
+    return -1;
 
-    int w = 0;
-    int h = 0;
-    window_.get_framebuffer_size(&w, &h);
+  cloud->viz->library.count_upload(uint64_t(count) * sizeof(dataviz_vertex_z));
 
-    glViewport(0, 0, w, h);
+  return 0;
+}
 
-    return glGetError() == GL_NO_ERROR;
-  }
+void
+datviz_cloud_clear(datviz_cloud_z* cloud)
+{
+  assert(cloud != nullptr);
 
-  void end_frame() { window_.swap_buffers(); }
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::cloud_clear).object(cloud));
 
-  void render_points(const dataviz_vertex_z* vertices, uint32_t vertex_count)
-  {
-    point_shader_program_.render_points(vertices, vertex_count, mvp());
-  }
+  cloud->cloud.clear();
+}
 
-  bool should_close() { return window_.should_close(); }
+uint32_t
+datviz_cloud_size(const datviz_cloud_z* cloud)
+{
+  assert(cloud != nullptr);
 
-private:
-  glm::mat4 mvp() const { return projection_transform_ * view_transform_ * model_transform_; }
+  return cloud->cloud.size();
+}
 
-  void cleanup_opengl_objects()
-  {
-    if (!window_.is_created())
-      return;
+void
+datviz_render_cloud(datviz_z* viz, datviz_cloud_z* cloud)
+{
+  assert(viz != nullptr);
+  assert(cloud != nullptr);
 
-    if (!window_.make_context_current())
-      return;
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::render_cloud).object(viz).object(cloud));
 
-    point_shader_program_.cleanup();
+  viz->library.render_cloud(cloud->cloud);
+}
+
+int
+datviz_cloud_upload_sorted(datviz_cloud_z* cloud, const dataviz_vertex_z* vertices, uint32_t count, int axis)
+{
+  assert(cloud != nullptr);
+  assert((axis >= 0) && (axis < 3));
+
+  if (capture_active()) {
+    capture_write(CaptureRecord(CaptureOp::cloud_upload_sorted)
+                    .object(cloud)
+                    .u32(uint32_t(axis))
+                    .array(vertices, count));
   }
 
-private:
-  LoggerProxy log_;
+  cloud->viz->library.make_context_current();
 
-  CameraController camera_controller_;
+  if (!cloud->cloud.upload_sorted(vertices, count, axis))
+    return -1;
 
-  Window window_;
+  cloud->viz->library.count_upload(uint64_t(count) * sizeof(dataviz_vertex_z));
 
-  PointShaderProgram point_shader_program_;
+  return 0;
+}
 
-  glm::vec4 background_color_{ 0, 0, 0, 1 };
+int
+datviz_cloud_find_slab(const datviz_cloud_z* cloud, float min, float max, uint32_t* first, uint32_t* count)
+{
+  assert(cloud != nullptr);
+  assert(first != nullptr);
+  assert(count != nullptr);
 
-  glm::mat4 model_transform_{ glm::mat4(1.0f) };
+  return cloud->cloud.find_slab(min, max, *first, *count) ? 0 : -1;
+}
 
-  glm::mat4 view_transform_{ glm::mat4(1.0f) };
+void
+datviz_render_cloud_slab(datviz_z* viz, datviz_cloud_z* cloud, float min, float max)
+{
+  assert(viz != nullptr);
+  assert(cloud != nullptr);
 
-  glm::mat4 projection_transform_{ glm::mat4(1.0f) };
-};
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::render_cloud_slab).object(viz).object(cloud).f32(min).f32(max));
 
-} // namespace
+  uint32_t first = 0;
+  uint32_t count = 0;
 
-//============//
-// Public API //
-//============//
+  if (cloud->cloud.find_slab(min, max, first, count))
+    viz->library.render_cloud_range(cloud->cloud, first, count);
+}
 
-struct datviz_struct final
+void
+datviz_render_boxes(datviz_z* viz, const dataviz_box_z* boxes, uint32_t count)
 {
-  Library library;
-#if 0
-  LoggerProxy log;
+  assert(viz != nullptr);
 
-  GLuint vertex_array = 0;
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::render_boxes).object(viz).array(boxes, count));
 
-  GLuint vertex_buffer = 0;
+  viz->library.render_boxes(boxes, count);
+}
 
-  GLuint program = 0;
+void
+datviz_render_labels(datviz_z* viz, const dataviz_label_z* labels, uint32_t count)
+{
+  assert(viz != nullptr);
 
-  GLint mvp_location = -1;
+  if (capture_active()) {
 
-  glm::mat4 projection_transform = glm::perspective(glm::radians(45.0f), 1.0f, 0.01f, 100.0f);
+    CaptureRecord record(CaptureOp::render_labels);
 
-  glm::mat4 view_transform = glm::lookAt(glm::vec3(2, 2, 3), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+    record.object(viz).u32(count);
 
-  glm::mat4 model_transform = glm::mat4(1.0f);
+    for (uint32_t i = 0; i < count; i++) {
+      const auto& label = labels[i];
+      const uint32_t rgba = uint32_t(label.r) | (uint32_t(label.g) << 8) | (uint32_t(label.b) << 16) |
+                            (uint32_t(label.a) << 24);
+      record.floats(label.position, 3).f32(label.size).u32(rgba).string(label.text);
+    }
 
-  glm::mat4 mvp() const { return projection_transform * view_transform * model_transform; }
-#endif
-};
+    capture_write(record);
+  }
 
-namespace {
+  viz->library.render_labels(labels, count);
+}
 
-#if 0
 void
-key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+datviz_render_vector_field(datviz_z* viz,
+                           const dataviz_vertex_z* points,
+                           const float* vectors,
+                           uint32_t count,
+                           uint32_t stride,
+                           float scale)
 {
-  if ((key == GLFW_KEY_ESCAPE) && (action == GLFW_PRESS))
-    glfwSetWindowShouldClose(window, GLFW_TRUE);
-}
-#endif
+  assert(viz != nullptr);
 
-} // namespace
+  if (capture_active()) {
+    capture_write(CaptureRecord(CaptureOp::render_vector_field)
+                    .object(viz)
+                    .u32(stride)
+                    .f32(scale)
+                    .array(points, count)
+                    .floats(vectors, size_t(count) * 3));
+  }
 
-datviz_struct*
-datviz_create(void)
-{
-  return new datviz_struct();
+  viz->library.render_vector_field(points, vectors, count, stride, scale);
 }
-#if 0
-  glClearColor(0, 0, 0, 1);
-
-  glAttachShader(viz->program, vert_shader);
-  glAttachShader(viz->program, frag_shader);
 
-  glLinkProgram(viz->program);
+datviz_map_z*
+datviz_map_create(datviz_z* viz,
+                  const dataviz_vertex_z* points,
+                  uint32_t count,
+                  float cell_size,
+                  const char* cache_path)
+{
+  assert(viz != nullptr);
 
-  glDetachShader(viz->program, frag_shader);
-  glDetachShader(viz->program, vert_shader);
+  if (cell_size <= 0)
+    return nullptr;
 
-  glDeleteShader(vert_shader);
-  glDeleteShader(frag_shader);
+  viz->library.make_context_current();
 
-  GLint link_status = GL_FALSE;
+  auto* map = new datviz_map_struct();
 
-  glGetProgramiv(viz->program, GL_LINK_STATUS, &link_status);
+  map->viz = viz;
 
-  if (link_status != GL_TRUE) {
-    glDeleteProgram(viz->program);
-    glfwDestroyWindow(viz->window);
-    delete viz;
+  if (!map->map.init(&viz->library.buffer_pool(), points, count, cell_size, cache_path)) {
+    map->map.cleanup();
+    delete map;
     return nullptr;
   }
 
-  glUseProgram(viz->program);
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::map_create).object(viz).new_object(map).f32(cell_size).array(points, count));
 
-  viz->mvp_location = glGetUniformLocation(viz->program, "mvp");
-#endif
+  return map;
+}
 
 void
-datviz_destroy(datviz_z* viz)
+datviz_map_destroy(datviz_map_z* map)
 {
-  if (!viz)
+  if (!map)
     return;
 
-  viz->library.cleanup();
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::map_destroy).destroyed_object(map));
 
-  delete viz;
-#if 0
-  glfwMakeContextCurrent(viz->window);
+  map->viz->library.make_context_current();
 
-  glDisable(GL_DEPTH);
+  map->map.cleanup();
 
-  glDeleteBuffers(1, &viz->vertex_buffer);
+  delete map;
+}
 
-  glDeleteVertexArrays(1, &viz->vertex_array);
+void
+datviz_render_map(datviz_z* viz, datviz_map_z* map)
+{
+  assert(viz != nullptr);
+  assert(map != nullptr);
 
-  glDeleteProgram(viz->program);
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::render_map).object(viz).object(map));
 
-  glfwDestroyWindow(viz->window);
-#endif
+  viz->library.render_map(map->map);
 }
 
-void
-datviz_add_logger(datviz_z* viz, void* logger_data, datviz_logger_callback callback)
+datviz_voxels_z*
+datviz_voxels_create(datviz_z* viz)
 {
   assert(viz != nullptr);
-  viz->library.add_logger(logger_data, callback);
+
+  viz->library.make_context_current();
+
+  auto* voxels = new datviz_voxels_struct();
+
+  voxels->viz = viz;
+
+  if (!voxels->voxels.init(&viz->library.buffer_pool())) {
+    voxels->voxels.cleanup();
+    delete voxels;
+    return nullptr;
+  }
+
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::voxels_create).object(viz).new_object(voxels));
+
+  return voxels;
 }
 
 void
-datviz_set_camera_controls_enabled(datviz_z* viz, int enabled)
+datviz_voxels_destroy(datviz_voxels_z* voxels)
 {
-  assert(viz != nullptr);
+  if (!voxels)
+    return;
 
-  viz->library.set_camera_controller_enabled(!!enabled);
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::voxels_destroy).destroyed_object(voxels));
+
+  voxels->viz->library.make_context_current();
+
+  voxels->voxels.cleanup();
+
+  delete voxels;
 }
 
-void
-datviz_set_window_title(datviz_z* viz, const char* title)
+int
+datviz_voxels_build(datviz_voxels_z* voxels, const dataviz_vertex_z* points, uint32_t count, float voxel_size)
 {
-  assert(viz != nullptr);
+  assert(voxels != nullptr);
 
-  viz->library.set_window_title(title);
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::voxels_build).object(voxels).f32(voxel_size).array(points, count));
+
+  if (voxel_size <= 0)
+    return -1;
+
+  voxels->viz->library.make_context_current();
+
+  if (!voxels->voxels.build(points, count, voxel_size))
+    return -1;
+
+  voxels->viz->library.count_upload(uint64_t(voxels->voxels.size()) * sizeof(VoxelInstance));
+
+  return 0;
 }
 
-void
-datviz_get_window_size(datviz_z* viz, int* w, int* h)
+uint32_t
+datviz_voxels_size(const datviz_voxels_z* voxels)
 {
-  assert(viz != nullptr);
+  assert(voxels != nullptr);
 
-  viz->library.get_window_size(w, h);
+  return voxels->voxels.size();
 }
 
 void
-datviz_get_framebuffer_size(datviz_z* viz, int* w, int* h)
+datviz_render_voxels(datviz_z* viz, datviz_voxels_z* voxels)
 {
   assert(viz != nullptr);
+  assert(voxels != nullptr);
 
-  viz->library.get_framebuffer_size(w, h);
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::render_voxels).object(viz).object(voxels));
+
+  viz->library.render_voxels(voxels->voxels);
 }
 
-void
-datviz_set_background(datviz_z* viz, float r, float g, float b, float a)
+datviz_lines_z*
+datviz_lines_create(datviz_z* viz)
 {
   assert(viz != nullptr);
 
-  viz->library.set_background_color(glm::vec4(r, g, b, a));
+  viz->library.make_context_current();
+
+  auto* lines = new datviz_lines_struct();
+
+  lines->viz = viz;
+
+  if (!lines->batch.init(&viz->library.buffer_pool())) {
+    lines->batch.cleanup();
+    delete lines;
+    return nullptr;
+  }
+
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::lines_create).object(viz).new_object(lines));
+
+  return lines;
 }
 
 void
-datviz_set_model_transform(datviz_z* viz, const float* model_transform)
+datviz_lines_destroy(datviz_lines_z* lines)
 {
-  assert(viz != nullptr);
+  if (!lines)
+    return;
 
-  viz->library.set_model_transform(glm::make_mat4x4(model_transform));
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::lines_destroy).destroyed_object(lines));
+
+  lines->viz->library.make_context_current();
+
+  lines->batch.cleanup();
+
+  delete lines;
 }
 
-void
-datviz_set_view_transform(datviz_z* viz, const float* view_transform)
+uint32_t
+datviz_lines_add_polyline(datviz_lines_z* lines, const dataviz_vertex_z* vertices, uint32_t count)
 {
-  assert(viz != nullptr);
+  assert(lines != nullptr);
 
-  viz->library.set_view_transform(glm::make_mat4x4(view_transform));
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::lines_add_polyline).object(lines).array(vertices, count));
+
+  return lines->batch.add_polyline(vertices, count);
+}
+
+int
+datviz_lines_append(datviz_lines_z* lines, uint32_t polyline, const dataviz_vertex_z* vertices, uint32_t count)
+{
+  assert(lines != nullptr);
+
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::lines_append).object(lines).u32(polyline).array(vertices, count));
+
+  return lines->batch.append(polyline, vertices, count) ? 0 : -1;
 }
 
 void
-datviz_look_at(datviz_z* viz, const float* eye, const float* center, const float* up)
+datviz_lines_clear(datviz_lines_z* lines)
 {
-  const auto view = glm::lookAt(glm::make_vec3(eye), glm::make_vec3(center), glm::make_vec3(up));
+  assert(lines != nullptr);
 
-  datviz_set_view_transform(viz, glm::value_ptr(view));
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::lines_clear).object(lines));
+
+  lines->batch.clear();
 }
 
 void
-datviz_set_projection_transform(datviz_z* viz, const float* projection_transform)
+datviz_render_lines(datviz_z* viz, datviz_lines_z* lines, float width)
 {
   assert(viz != nullptr);
+  assert(lines != nullptr);
 
-  viz->library.set_projection_transform(glm::make_mat4x4(projection_transform));
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::render_lines).object(viz).object(lines).f32(width));
+
+  viz->library.render_lines(lines->batch, width);
 }
 
 void
-datviz_set_perspective(datviz_z* viz, float fovy, float near, float far)
+datviz_end_frame(datviz_z* viz)
 {
-  int w = 0;
-  int h = 0;
-  datviz_get_framebuffer_size(viz, &w, &h);
+  assert(viz != nullptr);
 
-  const auto projection = glm::perspective(float(w) / float(h), fovy, near, far);
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::end_frame).object(viz));
 
-  datviz_set_projection_transform(viz, glm::value_ptr(projection));
+  viz->library.end_frame();
 }
 
 void
-datviz_begin_frame(datviz_z* viz)
+datviz_get_frame_stats(datviz_z* viz, dataviz_frame_stats_z* stats)
 {
   assert(viz != nullptr);
+  assert(stats != nullptr);
 
-  viz->library.begin_frame();
+  *stats = viz->library.frame_stats();
 }
 
-void
-datviz_render_points(datviz_z* viz, const dataviz_vertex_z* vertices, uint32_t count)
+uint32_t
+datviz_get_gl_call_stats(datviz_z* viz, dataviz_gl_call_stats_z* stats, uint32_t capacity)
 {
   assert(viz != nullptr);
 
-  viz->library.render_points(vertices, count);
+  return viz->library.gl_call_stats(stats, capacity);
 }
 
 void
-datviz_end_frame(datviz_z* viz)
+datviz_set_hud_enabled(datviz_z* viz, int enabled)
 {
   assert(viz != nullptr);
 
-  viz->library.end_frame();
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::set_hud_enabled).object(viz).u32(uint32_t(enabled)));
+
+  viz->library.set_hud_enabled(!!enabled);
 }
 
 void
-datviz_poll_input(datviz_z*)
+datviz_poll_input(datviz_z* viz)
 {
+  if (capture_active())
+    capture_write(CaptureRecord(CaptureOp::poll_input).object(viz));
+
   glfwPollEvents();
 }
 
@@ -931,11 +5576,21 @@ datviz_should_close(datviz_z* viz)
 int
 datviz_global_init()
 {
-  return glfwInit() != 0 ? -1 : 0;
+  if (glfwInit() != GLFW_TRUE)
+    return -1;
+
+  capture_begin_from_environment();
+
+  return 0;
 }
 
 void
 datviz_global_cleanup()
 {
+  if (capture_active())
+    datviz_capture_end();
+
+  release_thread_pool();
+
   glfwTerminate();
 }
@@ -0,0 +1,1215 @@
+#include "datviz_capture.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(DATVIZ_CAPTURE_ZLIB)
+#include <zlib.h>
+#endif
+
+using namespace datviz_detail;
+
+//===========//
+// Constants //
+//===========//
+
+namespace {
+
+constexpr char g_capture_magic[8] = { 'D', 'V', 'Z', 'C', 'A', 'P', 'T', '\0' };
+
+/// Bumped whenever the layout of a record changes in a way that older replays cannot read.
+constexpr uint32_t g_capture_version = 1;
+
+/// Set in the header of captures whose records are compressed with zlib.
+constexpr uint32_t g_capture_compressed = 1;
+
+/// The size of the buffers that compressed data is passed through.
+constexpr size_t g_capture_buffer_size = 1 << 18;
+
+/// Records are never this large unless the file is damaged, so replays stop instead of allocating it.
+constexpr uint32_t g_max_record_size = 1u << 31;
+
+struct FileHeader final
+{
+  char magic[8];
+
+  uint32_t version;
+
+  uint32_t flags;
+};
+
+struct RecordHeader final
+{
+  uint16_t op;
+
+  uint16_t reserved;
+
+  uint32_t size;
+
+  /// The time since the capture began, in nanoseconds.
+  uint64_t time;
+};
+
+} // namespace
+
+//=============//
+// Capture I/O //
+//=============//
+
+namespace {
+
+/** @brief Writes the records of a capture to a file, compressing them if asked to.
+ * */
+class CaptureOutput final
+{
+public:
+  ~CaptureOutput() { close(); }
+
+  bool open(const char* path, bool compressed)
+  {
+    file_ = fopen(path, "wb");
+    if (!file_)
+      return false;
+
+#if defined(DATVIZ_CAPTURE_ZLIB)
+    if (compressed) {
+      // Speed matters more than size here, since the capture is made while the application is running.
+      compressed_ = deflateInit(&stream_, Z_BEST_SPEED) == Z_OK;
+      buffer_.resize(g_capture_buffer_size);
+    }
+#else
+    (void)compressed;
+#endif
+
+    FileHeader header{};
+    memcpy(header.magic, g_capture_magic, sizeof(header.magic));
+    header.version = g_capture_version;
+    header.flags = compressed_ ? g_capture_compressed : 0;
+
+    return fwrite(&header, sizeof(header), 1, file_) == 1;
+  }
+
+  bool write(const void* data, size_t size)
+  {
+    if (!file_ || failed_)
+      return false;
+
+#if defined(DATVIZ_CAPTURE_ZLIB)
+    if (compressed_) {
+      stream_.next_in = static_cast<Bytef*>(const_cast<void*>(data));
+      stream_.avail_in = uInt(size);
+      failed_ = !deflate_pending(Z_NO_FLUSH);
+      return !failed_;
+    }
+#endif
+
+    failed_ = fwrite(data, 1, size, file_) != size;
+
+    return !failed_;
+  }
+
+  /** @brief Marks the capture as incomplete, such as when a record is too large to be stored.
+   * */
+  void fail() { failed_ = true; }
+
+  /** @brief Finishes the file and closes it.
+   *
+   * @return False if any part of the capture could not be written.
+   * */
+  bool close()
+  {
+    if (!file_)
+      return false;
+
+#if defined(DATVIZ_CAPTURE_ZLIB)
+    if (compressed_) {
+      stream_.avail_in = 0;
+      failed_ = !deflate_pending(Z_FINISH) || failed_;
+      deflateEnd(&stream_);
+      compressed_ = false;
+    }
+#endif
+
+    const bool closed = fclose(file_) == 0;
+
+    file_ = nullptr;
+
+    return closed && !failed_;
+  }
+
+private:
+#if defined(DATVIZ_CAPTURE_ZLIB)
+  bool deflate_pending(int flush)
+  {
+    for (;;) {
+
+      stream_.next_out = buffer_.data();
+      stream_.avail_out = uInt(buffer_.size());
+
+      const int result = deflate(&stream_, flush);
+      if (result == Z_STREAM_ERROR)
+        return false;
+
+      const size_t produced = buffer_.size() - stream_.avail_out;
+
+      if (fwrite(buffer_.data(), 1, produced, file_) != produced)
+        return false;
+
+      // Deflate is done with the input once it leaves room in the output, unless it is finishing the stream.
+      if ((flush == Z_FINISH) ? (result == Z_STREAM_END) : (stream_.avail_out != 0))
+        return true;
+    }
+  }
+
+  z_stream stream_{};
+#endif
+
+  FILE* file_ = nullptr;
+
+  bool compressed_ = false;
+
+  bool failed_ = false;
+
+  std::vector<unsigned char> buffer_;
+};
+
+/** @brief Reads the records of a capture from a file, decompressing them if they were compressed.
+ * */
+class CaptureInput final
+{
+public:
+  ~CaptureInput()
+  {
+#if defined(DATVIZ_CAPTURE_ZLIB)
+    if (compressed_)
+      inflateEnd(&stream_);
+#endif
+
+    if (file_)
+      fclose(file_);
+  }
+
+  bool open(const char* path)
+  {
+    file_ = fopen(path, "rb");
+    if (!file_)
+      return false;
+
+    FileHeader header{};
+
+    if (fread(&header, sizeof(header), 1, file_) != 1)
+      return false;
+
+    if ((memcmp(header.magic, g_capture_magic, sizeof(header.magic)) != 0) || (header.version != g_capture_version))
+      return false;
+
+    if (header.flags & g_capture_compressed) {
+#if defined(DATVIZ_CAPTURE_ZLIB)
+      if (inflateInit(&stream_) != Z_OK)
+        return false;
+      compressed_ = true;
+      buffer_.resize(g_capture_buffer_size);
+#else
+      // Compressed captures can only be replayed by a library that was built with zlib.
+      return false;
+#endif
+    }
+
+    return true;
+  }
+
+  /** @brief Reads exactly a number of bytes.
+   *
+   * @return False at the end of the file, or if the file is damaged.
+   * */
+  bool read(void* data, size_t size)
+  {
+#if defined(DATVIZ_CAPTURE_ZLIB)
+    if (compressed_) {
+
+      stream_.next_out = static_cast<Bytef*>(data);
+      stream_.avail_out = uInt(size);
+
+      while (stream_.avail_out > 0) {
+
+        if (stream_.avail_in == 0) {
+          stream_.next_in = buffer_.data();
+          stream_.avail_in = uInt(fread(buffer_.data(), 1, buffer_.size(), file_));
+          if (stream_.avail_in == 0)
+            return false;
+        }
+
+        const int result = inflate(&stream_, Z_NO_FLUSH);
+
+        if ((result == Z_STREAM_END) && (stream_.avail_out > 0))
+          return false;
+
+        if ((result != Z_OK) && (result != Z_STREAM_END))
+          return false;
+      }
+
+      return true;
+    }
+#endif
+
+    return fread(data, 1, size, file_) == size;
+  }
+
+private:
+#if defined(DATVIZ_CAPTURE_ZLIB)
+  z_stream stream_{};
+#endif
+
+  FILE* file_ = nullptr;
+
+  bool compressed_ = false;
+
+  std::vector<unsigned char> buffer_;
+};
+
+} // namespace
+
+//===========//
+// Recording //
+//===========//
+
+namespace {
+
+/** @brief The capture that is running, if any.
+ *
+ * @details Calls may come from any thread that the application makes them on, so writes are serialized by a lock.
+ *          The flag is checked without the lock, so that calls made without a capture cost a single load.
+ * */
+class CaptureState final
+{
+public:
+  bool is_active() const { return active_.load(std::memory_order_acquire); }
+
+  bool begin(const char* path, bool compressed)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (output_)
+      return false;
+
+    std::unique_ptr<CaptureOutput> output(new CaptureOutput());
+
+    if (!output->open(path, compressed))
+      return false;
+
+    output_ = std::move(output);
+
+    ids_.clear();
+
+    next_id_ = 1;
+
+    start_ = std::chrono::steady_clock::now();
+
+    active_.store(true, std::memory_order_release);
+
+    return true;
+  }
+
+  bool end()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!output_)
+      return false;
+
+    active_.store(false, std::memory_order_release);
+
+    const bool success = output_->close();
+
+    output_.reset();
+
+    ids_.clear();
+
+    return success;
+  }
+
+  void write(const CaptureRecord& record)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!output_)
+      return;
+
+    // The replay would stop at a record this large anyway, so the rest of the capture is not worth writing.
+    if (record.payload().size() > g_max_record_size) {
+      output_->fail();
+      return;
+    }
+
+    const auto elapsed = std::chrono::steady_clock::now() - start_;
+
+    RecordHeader header{};
+    header.op = uint16_t(record.op());
+    header.size = uint32_t(record.payload().size());
+    header.time = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+
+    output_->write(&header, sizeof(header));
+
+    output_->write(record.payload().data(), record.payload().size());
+  }
+
+  uint32_t new_id(const void* object)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!object)
+      return 0;
+
+    const uint32_t id = next_id_++;
+
+    ids_[object] = id;
+
+    return id;
+  }
+
+  uint32_t find_id(const void* object, bool forget)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    const auto it = ids_.find(object);
+    if (it == ids_.end())
+      return 0;
+
+    const uint32_t id = it->second;
+
+    if (forget)
+      ids_.erase(it);
+
+    return id;
+  }
+
+private:
+  std::mutex mutex_;
+
+  std::atomic<bool> active_{ false };
+
+  std::unique_ptr<CaptureOutput> output_;
+
+  /// The ids of the objects that were created during the capture. Pointers are forgotten once they are destroyed, since
+  /// their memory may be reused by the next object.
+  std::unordered_map<const void*, uint32_t> ids_;
+
+  uint32_t next_id_ = 1;
+
+  std::chrono::steady_clock::time_point start_;
+};
+
+CaptureState&
+capture_state()
+{
+  static CaptureState state;
+
+  return state;
+}
+
+} // namespace
+
+namespace datviz_detail {
+
+bool
+capture_active()
+{
+  return capture_state().is_active();
+}
+
+CaptureRecord&
+CaptureRecord::new_object(const void* object)
+{
+  return u32(capture_state().new_id(object));
+}
+
+CaptureRecord&
+CaptureRecord::object(const void* object)
+{
+  return u32(capture_state().find_id(object, false));
+}
+
+CaptureRecord&
+CaptureRecord::destroyed_object(const void* object)
+{
+  return u32(capture_state().find_id(object, true));
+}
+
+CaptureRecord&
+CaptureRecord::string(const char* s)
+{
+  const uint32_t length = s ? uint32_t(strlen(s)) : 0;
+
+  u32(length);
+
+  bytes(s, length);
+
+  payload_.resize((payload_.size() + 3) & ~size_t(3), 0);
+
+  return *this;
+}
+
+CaptureRecord&
+CaptureRecord::bytes(const void* data, size_t size)
+{
+  if (size == 0)
+    return *this;
+
+  const auto* p = static_cast<const unsigned char*>(data);
+
+  payload_.insert(payload_.end(), p, p + size);
+
+  return *this;
+}
+
+CaptureRecord&
+CaptureRecord::strided(const void* data, size_t element_size, size_t stride, uint32_t count)
+{
+  const auto* p = static_cast<const unsigned char*>(data);
+
+  payload_.reserve(payload_.size() + (element_size * count));
+
+  for (uint32_t i = 0; i < count; i++)
+    bytes(p + (i * stride), element_size);
+
+  return *this;
+}
+
+void
+capture_write(const CaptureRecord& record)
+{
+  capture_state().write(record);
+}
+
+void
+capture_begin_from_environment()
+{
+  const char* path = getenv("DATAVIZ_CAPTURE");
+
+  if (path && *path)
+    datviz_capture_begin(path, DATVIZ_CAPTURE_COMPRESSED);
+}
+
+} // namespace datviz_detail
+
+//========//
+// Replay //
+//========//
+
+namespace {
+
+/** @brief Reads the arguments of a record back, in the order that they were added in.
+ *
+ * @details Reading past the end of the record marks it as damaged, and gives zeros and null arrays from then on, so
+ *          a call is only made once all of its arguments were read successfully.
+ * */
+class RecordReader final
+{
+public:
+  explicit RecordReader(const std::vector<unsigned char>& payload)
+    : data_(payload.data())
+    , size_(payload.size())
+  {
+  }
+
+  bool ok() const { return ok_; }
+
+  uint32_t u32()
+  {
+    uint32_t value = 0;
+    read(&value, sizeof(value));
+    return value;
+  }
+
+  float f32()
+  {
+    float value = 0;
+    read(&value, sizeof(value));
+    return value;
+  }
+
+  void floats(float* values, size_t count) { read(values, count * sizeof(float)); }
+
+  std::string string()
+  {
+    const uint32_t length = u32();
+
+    const auto* chars = static_cast<const char*>(take(length));
+
+    // The padding that keeps the next argument aligned.
+    take(((length + 3) & ~uint32_t(3)) - length);
+
+    return chars ? std::string(chars, length) : std::string();
+  }
+
+  /** @brief Gets an array from the record, without copying it.
+   *
+   * @details Every argument is padded to four bytes, so arrays of the API types are aligned well enough to be read in
+   *          place.
+   * */
+  template<typename T>
+  const T* array(uint32_t& count)
+  {
+    count = u32();
+
+    return static_cast<const T*>(take(sizeof(T) * count));
+  }
+
+  template<typename T>
+  const T* array_of(size_t count)
+  {
+    return static_cast<const T*>(take(sizeof(T) * count));
+  }
+
+private:
+  void read(void* out, size_t size)
+  {
+    const void* in = take(size);
+
+    if (in)
+      memcpy(out, in, size);
+    else
+      memset(out, 0, size);
+  }
+
+  const void* take(size_t size)
+  {
+    if (!ok_ || (size > (size_ - offset_))) {
+      ok_ = false;
+      return nullptr;
+    }
+
+    const void* p = data_ + offset_;
+
+    offset_ += size;
+
+    return p;
+  }
+
+  const unsigned char* data_ = nullptr;
+
+  size_t size_ = 0;
+
+  size_t offset_ = 0;
+
+  bool ok_ = true;
+};
+
+/** @brief The objects that a replay has made so far, by the ids that the capture gave them.
+ * */
+template<typename Object>
+class ObjectTable final
+{
+public:
+  Object* find(uint32_t id) const
+  {
+    const auto it = objects_.find(id);
+    return (it != objects_.end()) ? it->second : nullptr;
+  }
+
+  void add(uint32_t id, Object* object)
+  {
+    if ((id != 0) && object)
+      objects_[id] = object;
+  }
+
+  Object* remove(uint32_t id)
+  {
+    Object* object = find(id);
+    objects_.erase(id);
+    return object;
+  }
+
+  template<typename Destroy>
+  void clear(Destroy destroy)
+  {
+    for (auto& entry : objects_)
+      destroy(entry.second);
+    objects_.clear();
+  }
+
+private:
+  std::unordered_map<uint32_t, Object*> objects_;
+};
+
+/** @brief Makes the calls of a capture, one record at a time.
+ * */
+class Replayer final
+{
+public:
+  explicit Replayer(int flags)
+    : headless_((flags & DATVIZ_REPLAY_HEADLESS) != 0)
+  {
+  }
+
+  ~Replayer()
+  {
+    // Everything that a viewer owns must go before the viewer.
+    clouds_.clear(datviz_cloud_destroy);
+    maps_.clear(datviz_map_destroy);
+    voxels_.clear(datviz_voxels_destroy);
+    lines_.clear(datviz_lines_destroy);
+    viewers_.clear(datviz_destroy);
+  }
+
+  /** @brief Makes the call of one record.
+   *
+   * @return False if the record is damaged or of an unknown call.
+   * */
+  bool replay(CaptureOp op, const std::vector<unsigned char>& payload, dataviz_replay_stats_z& stats)
+  {
+    if ((uint16_t(op) < uint16_t(CaptureOp::create)) || (uint16_t(op) >= uint16_t(CaptureOp::end)))
+      return false;
+
+    RecordReader r(payload);
+
+    const bool made = dispatch(op, r);
+
+    if (!r.ok())
+      return false;
+
+    if (made)
+      stats.calls++;
+    else
+      stats.skipped_calls++;
+
+    return true;
+  }
+
+  /// Whether the last call was the start of a frame.
+  bool began_frame() const { return began_frame_; }
+
+private:
+  /** @return False if the call was skipped, for being made on an object that the replay does not have.
+   * */
+  bool dispatch(CaptureOp op, RecordReader& r)
+  {
+    began_frame_ = false;
+
+    if (op == CaptureOp::create) {
+
+      const uint32_t id = r.u32();
+
+      auto* viz = datviz_create();
+
+      if (viz && headless_) {
+        datviz_set_window_visible(viz, 0);
+        datviz_set_vsync_enabled(viz, 0);
+      }
+
+      viewers_.add(id, viz);
+
+      return viz != nullptr;
+    }
+
+    // Every other call starts with the object that it is made on.
+    const uint32_t id = r.u32();
+
+    switch (op) {
+      case CaptureOp::destroy:
+        return destroy(viewers_, id, datviz_destroy);
+      case CaptureOp::cloud_destroy:
+        return destroy(clouds_, id, datviz_cloud_destroy);
+      case CaptureOp::map_destroy:
+        return destroy(maps_, id, datviz_map_destroy);
+      case CaptureOp::voxels_destroy:
+        return destroy(voxels_, id, datviz_voxels_destroy);
+      case CaptureOp::lines_destroy:
+        return destroy(lines_, id, datviz_lines_destroy);
+      case CaptureOp::cloud_upload:
+      case CaptureOp::cloud_upload_columns:
+      case CaptureOp::cloud_append_columns:
+      case CaptureOp::cloud_reserve:
+      case CaptureOp::cloud_append:
+      case CaptureOp::cloud_clear:
+      case CaptureOp::cloud_upload_sorted:
+        return replay_cloud(op, clouds_.find(id), r);
+      case CaptureOp::voxels_build:
+        return replay_voxels(voxels_.find(id), r);
+      case CaptureOp::lines_add_polyline:
+      case CaptureOp::lines_append:
+      case CaptureOp::lines_clear:
+        return replay_lines(op, lines_.find(id), r);
+      default:
+        return replay_viewer(op, viewers_.find(id), r);
+    }
+  }
+
+  template<typename Object, typename Destroy>
+  static bool destroy(ObjectTable<Object>& table, uint32_t id, Destroy destroy)
+  {
+    Object* object = table.remove(id);
+
+    if (!object)
+      return false;
+
+    destroy(object);
+
+    return true;
+  }
+
+  bool replay_viewer(CaptureOp op, datviz_z* viz, RecordReader& r)
+  {
+    float m[16]{};
+
+    switch (op) {
+      case CaptureOp::set_window_title: {
+        const auto title = r.string();
+        if (!viz || !r.ok())
+          return false;
+        datviz_set_window_title(viz, title.c_str());
+        return true;
+      }
+      case CaptureOp::set_background:
+        r.floats(m, 4);
+        if (!viz || !r.ok())
+          return false;
+        datviz_set_background(viz, m[0], m[1], m[2], m[3]);
+        return true;
+      case CaptureOp::set_top_down_view:
+        r.floats(m, 3);
+        if (!viz || !r.ok())
+          return false;
+        datviz_set_top_down_view(viz, m[0], m[1], m[2]);
+        return true;
+      case CaptureOp::set_render_mode: {
+        const auto mode = datviz_render_mode(r.u32());
+        if (!viz || !r.ok())
+          return false;
+        datviz_set_render_mode(viz, mode);
+        return true;
+      }
+      case CaptureOp::set_density_colormap: {
+        const auto colormap = datviz_colormap(r.u32());
+        const float saturation = r.f32();
+        if (!viz || !r.ok())
+          return false;
+        datviz_set_density_colormap(viz, colormap, saturation);
+        return true;
+      }
+      case CaptureOp::set_model_transform:
+      case CaptureOp::set_view_transform:
+      case CaptureOp::set_projection_transform:
+        r.floats(m, 16);
+        if (!viz || !r.ok())
+          return false;
+        if (op == CaptureOp::set_model_transform)
+          datviz_set_model_transform(viz, m);
+        else if (op == CaptureOp::set_view_transform)
+          datviz_set_view_transform(viz, m);
+        else
+          datviz_set_projection_transform(viz, m);
+        return true;
+      case CaptureOp::set_surfel_backface_culling:
+      case CaptureOp::set_hud_enabled: {
+        const int enabled = int(r.u32());
+        if (!viz || !r.ok())
+          return false;
+        if (op == CaptureOp::set_surfel_backface_culling)
+          datviz_set_surfel_backface_culling(viz, enabled);
+        else
+          datviz_set_hud_enabled(viz, enabled);
+        return true;
+      }
+      case CaptureOp::begin_frame:
+        if (!viz)
+          return false;
+        datviz_begin_frame(viz);
+        began_frame_ = true;
+        return true;
+      case CaptureOp::end_frame:
+        if (!viz)
+          return false;
+        datviz_end_frame(viz);
+        return true;
+      case CaptureOp::poll_input:
+        if (!viz)
+          return false;
+        datviz_poll_input(viz);
+        return true;
+      default:
+        return replay_render(op, viz, r);
+    }
+  }
+
+  bool replay_render(CaptureOp op, datviz_z* viz, RecordReader& r)
+  {
+    uint32_t count = 0;
+
+    switch (op) {
+      case CaptureOp::render_points: {
+        const auto* points = r.array<dataviz_vertex_z>(count);
+        if (!viz || !r.ok())
+          return false;
+        datviz_render_points(viz, points, count);
+        return true;
+      }
+      case CaptureOp::render_indexed_points: {
+        uint32_t index_count = 0;
+        const auto* points = r.array<dataviz_vertex_z>(count);
+        const auto* indices = r.array<uint32_t>(index_count);
+        if (!viz || !r.ok())
+          return false;
+        datviz_render_indexed_points(viz, points, count, indices, index_count);
+        return true;
+      }
+      case CaptureOp::render_surfels: {
+        const float radius = r.f32();
+        const auto* surfels = r.array<dataviz_surfel_vertex_z>(count);
+        if (!viz || !r.ok())
+          return false;
+        datviz_render_surfels(viz, surfels, count, radius);
+        return true;
+      }
+      case CaptureOp::render_boxes: {
+        const auto* boxes = r.array<dataviz_box_z>(count);
+        if (!viz || !r.ok())
+          return false;
+        datviz_render_boxes(viz, boxes, count);
+        return true;
+      }
+      case CaptureOp::render_labels:
+        return replay_labels(viz, r);
+      case CaptureOp::render_vector_field: {
+        const uint32_t stride = r.u32();
+        const float scale = r.f32();
+        const auto* points = r.array<dataviz_vertex_z>(count);
+        const auto* vectors = r.array_of<float>(size_t(count) * 3);
+        if (!viz || !r.ok())
+          return false;
+        datviz_render_vector_field(viz, points, vectors, count, stride, scale);
+        return true;
+      }
+      case CaptureOp::cloud_create:
+      case CaptureOp::lines_create:
+      case CaptureOp::voxels_create:
+        return replay_create(op, viz, r);
+      case CaptureOp::map_create: {
+        const uint32_t id = r.u32();
+        const float cell_size = r.f32();
+        const auto* points = r.array<dataviz_vertex_z>(count);
+        if (!viz || !r.ok())
+          return false;
+        maps_.add(id, datviz_map_create(viz, points, count, cell_size, nullptr));
+        return true;
+      }
+      case CaptureOp::render_cloud:
+      case CaptureOp::render_cloud_slab: {
+        auto* cloud = clouds_.find(r.u32());
+        const float min = (op == CaptureOp::render_cloud_slab) ? r.f32() : 0.0f;
+        const float max = (op == CaptureOp::render_cloud_slab) ? r.f32() : 0.0f;
+        if (!viz || !cloud || !r.ok())
+          return false;
+        if (op == CaptureOp::render_cloud)
+          datviz_render_cloud(viz, cloud);
+        else
+          datviz_render_cloud_slab(viz, cloud, min, max);
+        return true;
+      }
+      case CaptureOp::render_map: {
+        auto* map = maps_.find(r.u32());
+        if (!viz || !map || !r.ok())
+          return false;
+        datviz_render_map(viz, map);
+        return true;
+      }
+      case CaptureOp::render_voxels: {
+        auto* voxels = voxels_.find(r.u32());
+        if (!viz || !voxels || !r.ok())
+          return false;
+        datviz_render_voxels(viz, voxels);
+        return true;
+      }
+      case CaptureOp::render_lines: {
+        auto* lines = lines_.find(r.u32());
+        const float width = r.f32();
+        if (!viz || !lines || !r.ok())
+          return false;
+        datviz_render_lines(viz, lines, width);
+        return true;
+      }
+      default:
+        return false;
+    }
+  }
+
+  bool replay_create(CaptureOp op, datviz_z* viz, RecordReader& r)
+  {
+    const uint32_t id = r.u32();
+
+    if (!viz || !r.ok())
+      return false;
+
+    if (op == CaptureOp::cloud_create)
+      clouds_.add(id, datviz_cloud_create(viz));
+    else if (op == CaptureOp::lines_create)
+      lines_.add(id, datviz_lines_create(viz));
+    else
+      voxels_.add(id, datviz_voxels_create(viz));
+
+    return true;
+  }
+
+  bool replay_labels(datviz_z* viz, RecordReader& r)
+  {
+    const uint32_t count = r.u32();
+
+    std::vector<std::string> texts;
+
+    std::vector<dataviz_label_z> labels;
+
+    for (uint32_t i = 0; (i < count) && r.ok(); i++) {
+
+      dataviz_label_z label{};
+
+      r.floats(label.position, 3);
+
+      label.size = r.f32();
+
+      const uint32_t rgba = r.u32();
+
+      label.r = static_cast<unsigned char>(rgba);
+      label.g = static_cast<unsigned char>(rgba >> 8);
+      label.b = static_cast<unsigned char>(rgba >> 16);
+      label.a = static_cast<unsigned char>(rgba >> 24);
+
+      texts.push_back(r.string());
+
+      labels.push_back(label);
+    }
+
+    if (!viz || !r.ok())
+      return false;
+
+    // The texts are only pointed to once they are all read, since reading them may move them.
+    for (size_t i = 0; i < labels.size(); i++)
+      labels[i].text = texts[i].c_str();
+
+    datviz_render_labels(viz, labels.data(), uint32_t(labels.size()));
+
+    return true;
+  }
+
+  bool replay_cloud(CaptureOp op, datviz_cloud_z* cloud, RecordReader& r)
+  {
+    uint32_t count = 0;
+
+    switch (op) {
+      case CaptureOp::cloud_upload:
+      case CaptureOp::cloud_append: {
+        const auto* points = r.array<dataviz_vertex_z>(count);
+        if (!cloud || !r.ok())
+          return false;
+        if (op == CaptureOp::cloud_upload)
+          datviz_cloud_upload(cloud, points, count);
+        else
+          datviz_cloud_append(cloud, points, count);
+        return true;
+      }
+      case CaptureOp::cloud_upload_sorted: {
+        const int axis = int(r.u32());
+        const auto* points = r.array<dataviz_vertex_z>(count);
+        if (!cloud || !r.ok() || (axis < 0) || (axis > 2))
+          return false;
+        datviz_cloud_upload_sorted(cloud, points, count, axis);
+        return true;
+      }
+      case CaptureOp::cloud_upload_columns:
+      case CaptureOp::cloud_append_columns: {
+        dataviz_point_columns_z columns{};
+        count = r.u32();
+        const bool has_rgba = r.u32() != 0;
+        columns.x = r.array_of<float>(count);
+        columns.y = r.array_of<float>(count);
+        columns.z = r.array_of<float>(count);
+        columns.rgba = has_rgba ? r.array_of<unsigned char>(size_t(count) * 4) : nullptr;
+        if (!cloud || !r.ok())
+          return false;
+        if (op == CaptureOp::cloud_upload_columns)
+          datviz_cloud_upload_columns(cloud, &columns, count);
+        else
+          datviz_cloud_append_columns(cloud, &columns, count);
+        return true;
+      }
+      case CaptureOp::cloud_reserve: {
+        const uint32_t capacity = r.u32();
+        if (!cloud || !r.ok())
+          return false;
+        datviz_cloud_reserve(cloud, capacity);
+        return true;
+      }
+      case CaptureOp::cloud_clear:
+        if (!cloud)
+          return false;
+        datviz_cloud_clear(cloud);
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  bool replay_voxels(datviz_voxels_z* voxels, RecordReader& r)
+  {
+    uint32_t count = 0;
+
+    const float voxel_size = r.f32();
+
+    const auto* points = r.array<dataviz_vertex_z>(count);
+
+    if (!voxels || !r.ok())
+      return false;
+
+    datviz_voxels_build(voxels, points, count, voxel_size);
+
+    return true;
+  }
+
+  bool replay_lines(CaptureOp op, datviz_lines_z* lines, RecordReader& r)
+  {
+    uint32_t count = 0;
+
+    if (op == CaptureOp::lines_clear) {
+      if (!lines)
+        return false;
+      datviz_lines_clear(lines);
+      return true;
+    }
+
+    const uint32_t polyline = (op == CaptureOp::lines_append) ? r.u32() : 0;
+
+    const auto* vertices = r.array<dataviz_vertex_z>(count);
+
+    if (!lines || !r.ok())
+      return false;
+
+    if (op == CaptureOp::lines_append)
+      datviz_lines_append(lines, polyline, vertices, count);
+    else
+      datviz_lines_add_polyline(lines, vertices, count);
+
+    return true;
+  }
+
+  bool headless_ = false;
+
+  bool began_frame_ = false;
+
+  ObjectTable<datviz_z> viewers_;
+
+  ObjectTable<datviz_cloud_z> clouds_;
+
+  ObjectTable<datviz_map_z> maps_;
+
+  ObjectTable<datviz_voxels_z> voxels_;
+
+  ObjectTable<datviz_lines_z> lines_;
+};
+
+} // namespace
+
+//============//
+// Public API //
+//============//
+
+int
+datviz_capture_begin(const char* path, int flags)
+{
+  assert(path != nullptr);
+
+  return capture_state().begin(path, (flags & DATVIZ_CAPTURE_COMPRESSED) != 0) ? 0 : -1;
+}
+
+int
+datviz_capture_end(void)
+{
+  return capture_state().end() ? 0 : -1;
+}
+
+int
+datviz_replay_capture(const char* path, int flags, dataviz_replay_stats_z* stats)
+{
+  assert(path != nullptr);
+
+  dataviz_replay_stats_z local_stats{};
+
+  dataviz_replay_stats_z& s = stats ? *stats : local_stats;
+
+  s = dataviz_replay_stats_z{};
+
+  CaptureInput input;
+
+  if (!input.open(path))
+    return -1;
+
+  Replayer replayer(flags);
+
+  std::vector<unsigned char> payload;
+
+  using clock = std::chrono::steady_clock;
+
+  const auto start = clock::now();
+
+  auto last_frame = start;
+
+  double total_frame_ms = 0;
+
+  RecordHeader header{};
+
+  bool success = true;
+
+  while (input.read(&header, sizeof(header))) {
+
+    if (header.size > g_max_record_size) {
+      success = false;
+      break;
+    }
+
+    payload.resize(header.size);
+
+    if (!input.read(payload.data(), payload.size())) {
+      success = false;
+      break;
+    }
+
+    if (flags & DATVIZ_REPLAY_REAL_TIME)
+      std::this_thread::sleep_until(start + std::chrono::nanoseconds(header.time));
+
+    const auto call_start = clock::now();
+
+    if (!replayer.replay(CaptureOp(header.op), payload, s)) {
+      success = false;
+      break;
+    }
+
+    if (replayer.began_frame()) {
+
+      if (s.frames > 0) {
+        const float ms = std::chrono::duration<float, std::milli>(call_start - last_frame).count();
+        total_frame_ms += ms;
+        s.max_frame_ms = std::max(s.max_frame_ms, ms);
+      }
+
+      last_frame = call_start;
+
+      s.frames++;
+    }
+  }
+
+  s.seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+  s.mean_frame_ms = (s.frames > 1) ? float(total_frame_ms / double(s.frames - 1)) : 0.0f;
+
+  return success ? 0 : -1;
+}
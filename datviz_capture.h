@@ -0,0 +1,154 @@
+/// @file datviz_capture.h
+///
+/// @brief Internal helpers for recording public API calls to a capture file, to be replayed later.
+
+#pragma once
+
+#include "datviz.h"
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace datviz_detail {
+
+/** @brief The calls that are recorded in a capture.
+ *
+ * @details The values are stored in capture files, so new calls are only ever added at the end.
+ * */
+enum class CaptureOp : uint16_t
+{
+  create = 1,
+  destroy,
+  set_window_title,
+  set_background,
+  set_top_down_view,
+  set_render_mode,
+  set_density_colormap,
+  set_model_transform,
+  set_view_transform,
+  set_projection_transform,
+  set_surfel_backface_culling,
+  set_hud_enabled,
+  begin_frame,
+  end_frame,
+  poll_input,
+  render_points,
+  render_indexed_points,
+  render_surfels,
+  render_boxes,
+  render_labels,
+  render_vector_field,
+  cloud_create,
+  cloud_destroy,
+  cloud_upload,
+  cloud_upload_columns,
+  cloud_append_columns,
+  cloud_reserve,
+  cloud_append,
+  cloud_clear,
+  cloud_upload_sorted,
+  render_cloud,
+  render_cloud_slab,
+  map_create,
+  map_destroy,
+  render_map,
+  voxels_create,
+  voxels_destroy,
+  voxels_build,
+  render_voxels,
+  lines_create,
+  lines_destroy,
+  lines_add_polyline,
+  lines_append,
+  lines_clear,
+  render_lines,
+  /// One past the last call, for telling calls that a newer version recorded apart from damaged records.
+  end
+};
+
+/** @brief Checks whether calls are being captured, without taking a lock.
+ *
+ * @details Records are only worth building when this is true, since building them copies their point payloads.
+ * */
+bool
+capture_active();
+
+/** @brief The arguments of one call, encoded the way that they are stored in a capture file.
+ *
+ * @details Objects that the API returns, such as viewers and clouds, are stored by an id that the capture gives
+ *          them when they are created. Objects that were created before the capture began have no id, and are stored
+ *          as zero, which the replay skips the calls of.
+ * */
+class CaptureRecord final
+{
+public:
+  explicit CaptureRecord(CaptureOp op)
+    : op_(op)
+  {
+  }
+
+  CaptureOp op() const { return op_; }
+
+  const std::vector<unsigned char>& payload() const { return payload_; }
+
+  /** @brief Adds an object that was just created, giving it a new id.
+   * */
+  CaptureRecord& new_object(const void* object);
+
+  /** @brief Adds an object by the id that it was given when it was created.
+   * */
+  CaptureRecord& object(const void* object);
+
+  /** @brief Adds an object that is being destroyed, and forgets its id.
+   * */
+  CaptureRecord& destroyed_object(const void* object);
+
+  CaptureRecord& u32(uint32_t value) { return bytes(&value, sizeof(value)); }
+
+  CaptureRecord& f32(float value) { return bytes(&value, sizeof(value)); }
+
+  CaptureRecord& floats(const float* values, size_t count) { return bytes(values, count * sizeof(float)); }
+
+  /** @brief Adds a null terminated string, along with its length. Null strings are stored as empty ones.
+   *
+   * @details The string is padded to a multiple of four bytes, so that the arrays after it stay aligned.
+   * */
+  CaptureRecord& string(const char* s);
+
+  /** @brief Adds raw bytes, such as an array of vertices. The size is not stored, so it must follow from the rest.
+   * */
+  CaptureRecord& bytes(const void* data, size_t size);
+
+  /** @brief Adds elements that are a stride apart, packed next to each other.
+   * */
+  CaptureRecord& strided(const void* data, size_t element_size, size_t stride, uint32_t count);
+
+  /** @brief Adds an array, preceded by the number of elements in it.
+   * */
+  template<typename T>
+  CaptureRecord& array(const T* data, uint32_t count)
+  {
+    return u32(count).bytes(data, sizeof(T) * size_t(count));
+  }
+
+private:
+  CaptureOp op_;
+
+  std::vector<unsigned char> payload_;
+};
+
+/** @brief Writes a record to the capture, along with the time since the capture began.
+ *
+ * @details Records are written in the order that this is called in, and nothing is written when no capture is active.
+ * */
+void
+capture_write(const CaptureRecord& record);
+
+/** @brief Starts a capture if the DATAVIZ_CAPTURE environment variable holds a path.
+ * */
+void
+capture_begin_from_environment();
+
+} // namespace datviz_detail
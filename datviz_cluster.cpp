@@ -0,0 +1,329 @@
+#include "datviz.h"
+
+#include "datviz_grid.h"
+#include "datviz_parallel.h"
+#include "datviz_perf.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+#include <assert.h>
+
+using namespace datviz_detail;
+
+//===========//
+// Constants //
+//===========//
+
+namespace {
+
+/// The number of grid buckets that a thread takes at a time.
+constexpr size_t g_bucket_grain = 4096;
+
+constexpr size_t g_point_grain = 65536;
+
+/// The label of points that are not in any cluster.
+constexpr uint32_t g_no_cluster = UINT32_MAX;
+
+} // namespace
+
+//============//
+// Union Find //
+//============//
+
+namespace {
+
+/** @brief A disjoint set forest that many threads can merge sets in at once.
+ *
+ * @details Roots are always linked under the smaller of the two indices, so the root of a set ends up being its lowest
+ *          index, no matter the order in which threads merge them. Finds halve the paths they walk with a
+ *          compare-and-swap, which is safe to race since a parent only ever moves closer to its root.
+ * */
+class ConcurrentUnionFind final
+{
+public:
+  explicit ConcurrentUnionFind(size_t count)
+    : parents_(count)
+  {
+    parallel_for(count, g_point_grain, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++)
+        parents_[i].store(uint32_t(i), std::memory_order_relaxed);
+    });
+  }
+
+  uint32_t find(uint32_t i)
+  {
+    for (;;) {
+
+      uint32_t parent = parents_[i].load(std::memory_order_relaxed);
+
+      if (parent == i)
+        return i;
+
+      const uint32_t grandparent = parents_[parent].load(std::memory_order_relaxed);
+
+      if (grandparent != parent)
+        parents_[i].compare_exchange_weak(parent, grandparent, std::memory_order_relaxed);
+
+      i = grandparent;
+    }
+  }
+
+  void unite(uint32_t a, uint32_t b)
+  {
+    for (;;) {
+
+      a = find(a);
+      b = find(b);
+
+      if (a == b)
+        return;
+
+      if (a < b)
+        std::swap(a, b);
+
+      // Another thread may have linked this root in the meantime, in which case the roots are found again.
+      uint32_t expected = a;
+
+      if (parents_[a].compare_exchange_strong(expected, b, std::memory_order_relaxed))
+        return;
+    }
+  }
+
+private:
+  std::vector<std::atomic<uint32_t>> parents_;
+};
+
+} // namespace
+
+//==================//
+// Cell Connections //
+//==================//
+
+namespace {
+
+/** @brief A point, along with the grid cell that it is in.
+ * */
+struct CellPoint final
+{
+  glm::ivec3 cell;
+
+  uint32_t index = 0;
+
+  bool operator<(const CellPoint& other) const
+  {
+    if (cell.z != other.cell.z)
+      return cell.z < other.cell.z;
+    if (cell.y != other.cell.y)
+      return cell.y < other.cell.y;
+    if (cell.x != other.cell.x)
+      return cell.x < other.cell.x;
+    return index < other.index;
+  }
+};
+
+/** @brief Gets the offsets to the cells that may hold points within the tolerance of a cell, in one direction only.
+ *
+ * @details Cells are a tolerance over the square root of three wide, so cells two apart on every axis can still be
+ *          within the tolerance, while cells three apart on any axis cannot. Only half of the offsets are returned,
+ *          since each pair of cells only needs to be connected once.
+ * */
+std::vector<glm::ivec3>
+forward_offsets()
+{
+  std::vector<glm::ivec3> offsets;
+
+  for (int z = -2; z <= 2; z++) {
+    for (int y = -2; y <= 2; y++) {
+      for (int x = -2; x <= 2; x++) {
+        if ((z > 0) || ((z == 0) && (y > 0)) || ((z == 0) && (y == 0) && (x > 0)))
+          offsets.emplace_back(x, y, z);
+      }
+    }
+  }
+
+  return offsets;
+}
+
+/** @brief Merges the clusters of grid cells whose points are within the tolerance of each other.
+ * */
+class CellConnector final
+{
+public:
+  CellConnector(const PointGrid& grid, ConcurrentUnionFind& sets, float tolerance)
+    : grid_(grid)
+    , sets_(sets)
+    , tolerance_squared_(tolerance * tolerance)
+    , offsets_(forward_offsets())
+  {
+  }
+
+  /** @brief Merges the points of each cell in a bucket, then merges each cell with its neighbors.
+   *
+   * @param scratch Reused between calls, to avoid allocating for every bucket.
+   * */
+  void connect_bucket(size_t bucket, std::vector<CellPoint>& scratch, std::vector<uint32_t>& neighbors) const
+  {
+    const auto& order = grid_.order();
+
+    scratch.clear();
+
+    for (uint32_t i = grid_.bucket_begin(bucket); i < grid_.bucket_end(bucket); i++)
+      scratch.push_back(CellPoint{ grid_.cell_of(grid_.position(order[i])), order[i] });
+
+    // Different cells may share a bucket, so the points are grouped by cell first.
+    std::sort(scratch.begin(), scratch.end());
+
+    for (size_t first = 0; first < scratch.size();) {
+
+      size_t last = first + 1;
+
+      while ((last < scratch.size()) && (scratch[last].cell == scratch[first].cell))
+        last++;
+
+      // Any two points in one cell are within the tolerance of each other.
+      for (size_t i = first + 1; i < last; i++)
+        sets_.unite(scratch[first].index, scratch[i].index);
+
+      for (const auto& offset : offsets_)
+        connect_cells(&scratch[first], last - first, scratch[first].cell + offset, neighbors);
+
+      first = last;
+    }
+  }
+
+private:
+  void connect_cells(const CellPoint* points,
+                     size_t count,
+                     const glm::ivec3& cell,
+                     std::vector<uint32_t>& neighbors) const
+  {
+    const auto& order = grid_.order();
+
+    const size_t bucket = grid_.bucket_of(cell);
+
+    neighbors.clear();
+
+    for (uint32_t i = grid_.bucket_begin(bucket); i < grid_.bucket_end(bucket); i++) {
+
+      const uint32_t index = order[i];
+
+      if (grid_.cell_of(grid_.position(index)) != cell)
+        continue;
+
+      // Once the cells are known to be in one cluster, their points do not need to be compared.
+      if (neighbors.empty() && (sets_.find(index) == sets_.find(points[0].index)))
+        return;
+
+      neighbors.push_back(index);
+    }
+
+    for (const uint32_t neighbor : neighbors) {
+
+      const auto p = grid_.position(neighbor);
+
+      for (size_t i = 0; i < count; i++) {
+
+        const auto delta = grid_.position(points[i].index) - p;
+
+        if (glm::dot(delta, delta) <= tolerance_squared_) {
+          sets_.unite(points[i].index, neighbor);
+          return;
+        }
+      }
+    }
+  }
+
+  const PointGrid& grid_;
+
+  ConcurrentUnionFind& sets_;
+
+  float tolerance_squared_ = 0;
+
+  std::vector<glm::ivec3> offsets_;
+};
+
+} // namespace
+
+//============//
+// Clustering //
+//============//
+
+uint32_t
+datviz_cluster_euclidean(const dataviz_vertex_z* points,
+                         uint32_t point_count,
+                         float tolerance,
+                         uint32_t min_cluster_size,
+                         uint32_t* out_labels)
+{
+  DATVIZ_PERF_SCOPE("cluster_euclidean");
+
+  assert(tolerance > 0);
+  assert(out_labels != nullptr);
+
+  if (point_count == 0)
+    return 0;
+
+  PointGrid grid;
+
+  grid.build(points, point_count, tolerance / std::sqrt(3.0f));
+
+  ConcurrentUnionFind sets(point_count);
+
+  const CellConnector connector(grid, sets, tolerance);
+
+  parallel_for(grid.bucket_count(), g_bucket_grain, [&](size_t begin, size_t end) {
+    std::vector<CellPoint> scratch;
+
+    std::vector<uint32_t> neighbors;
+
+    for (size_t bucket = begin; bucket < end; bucket++)
+      connector.connect_bucket(bucket, scratch, neighbors);
+  });
+
+  // The labels hold the root of each point until the clusters are numbered.
+  std::vector<std::atomic<uint32_t>> sizes(point_count);
+
+  parallel_for(point_count, g_point_grain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      out_labels[i] = sets.find(uint32_t(i));
+      sizes[out_labels[i]].fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+
+  struct Cluster final
+  {
+    uint32_t size = 0;
+
+    uint32_t root = 0;
+  };
+
+  std::vector<Cluster> clusters;
+
+  for (uint32_t i = 0; i < point_count; i++) {
+    const uint32_t size = sizes[i].load(std::memory_order_relaxed);
+    if ((size > 0) && (size >= min_cluster_size))
+      clusters.push_back(Cluster{ size, i });
+  }
+
+  // The largest clusters get the lowest labels, and so the first colors of the palette.
+  std::sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+    return (a.size != b.size) ? (a.size > b.size) : (a.root < b.root);
+  });
+
+  std::vector<uint32_t> labels(point_count, g_no_cluster);
+
+  for (size_t i = 0; i < clusters.size(); i++)
+    labels[clusters[i].root] = uint32_t(i);
+
+  parallel_for(point_count, g_point_grain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++)
+      out_labels[i] = labels[out_labels[i]];
+  });
+
+  return uint32_t(clusters.size());
+}
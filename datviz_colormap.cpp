@@ -0,0 +1,166 @@
+#include "datviz.h"
+
+#include "datviz_colormap.h"
+#include "datviz_parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace datviz_detail {
+
+namespace {
+
+/// The number of evenly spaced colors that each color map is interpolated from.
+constexpr int g_control_points = 9;
+
+using ControlPoints = unsigned char[g_control_points][3];
+
+const ControlPoints g_viridis = {
+  { 0x44, 0x01, 0x54 }, { 0x47, 0x2c, 0x7a }, { 0x3b, 0x51, 0x8b },
+  { 0x2c, 0x71, 0x8e }, { 0x21, 0x90, 0x8d }, { 0x27, 0xad, 0x81 },
+  { 0x5c, 0xc8, 0x63 }, { 0xaa, 0xdc, 0x32 }, { 0xfd, 0xe7, 0x25 }
+};
+
+const ControlPoints g_inferno = {
+  { 0x00, 0x00, 0x04 }, { 0x1f, 0x0c, 0x48 }, { 0x55, 0x0f, 0x6d },
+  { 0x88, 0x22, 0x6a }, { 0xba, 0x36, 0x55 }, { 0xe3, 0x59, 0x33 },
+  { 0xf9, 0x8c, 0x0a }, { 0xf9, 0xc9, 0x32 }, { 0xfc, 0xff, 0xa4 }
+};
+
+const ControlPoints g_turbo = {
+  { 0x30, 0x12, 0x3b }, { 0x46, 0x62, 0xd7 }, { 0x36, 0xaa, 0xf9 },
+  { 0x1a, 0xe4, 0xb6 }, { 0x72, 0xfe, 0x5e }, { 0xc8, 0xef, 0x34 },
+  { 0xfa, 0xba, 0x39 }, { 0xf6, 0x6b, 0x19 }, { 0x7a, 0x04, 0x03 }
+};
+
+const ControlPoints g_grayscale = {
+  { 0x00, 0x00, 0x00 }, { 0x20, 0x20, 0x20 }, { 0x40, 0x40, 0x40 },
+  { 0x60, 0x60, 0x60 }, { 0x80, 0x80, 0x80 }, { 0x9f, 0x9f, 0x9f },
+  { 0xbf, 0xbf, 0xbf }, { 0xdf, 0xdf, 0xdf }, { 0xff, 0xff, 0xff }
+};
+
+/// Distinct colors for labeled points, with the strongest colors first.
+const unsigned char g_palette[][3] = {
+  { 0x1f, 0x77, 0xb4 }, { 0xff, 0x7f, 0x0e }, { 0x2c, 0xa0, 0x2c }, { 0xd6, 0x27, 0x28 }, { 0x94, 0x67, 0xbd },
+  { 0x8c, 0x56, 0x4b }, { 0xe3, 0x77, 0xc2 }, { 0xbc, 0xbd, 0x22 }, { 0x17, 0xbe, 0xcf }, { 0xae, 0xc7, 0xe8 },
+  { 0xff, 0xbb, 0x78 }, { 0x98, 0xdf, 0x8a }, { 0xff, 0x98, 0x96 }, { 0xc5, 0xb0, 0xd5 }, { 0xc4, 0x9c, 0x94 },
+  { 0xf7, 0xb6, 0xd2 }, { 0xdb, 0xdb, 0x8d }, { 0x9e, 0xda, 0xe5 }
+};
+
+constexpr uint32_t g_palette_size = sizeof(g_palette) / sizeof(g_palette[0]);
+
+/// The gray that unlabeled points are colored with, which is darker than any color of the palette.
+constexpr unsigned char g_unlabeled_gray = 0x50;
+
+const ControlPoints&
+control_points(datviz_colormap colormap)
+{
+  switch (colormap) {
+    case DATVIZ_COLORMAP_VIRIDIS:
+      break;
+    case DATVIZ_COLORMAP_INFERNO:
+      return g_inferno;
+    case DATVIZ_COLORMAP_TURBO:
+      return g_turbo;
+    case DATVIZ_COLORMAP_GRAYSCALE:
+      return g_grayscale;
+  }
+
+  return g_viridis;
+}
+
+} // namespace
+
+void
+colormap_lookup(datviz_colormap colormap, float t, unsigned char* rgb)
+{
+  const auto& points = control_points(colormap);
+
+  // NaN fails both comparisons, so it ends up at the bottom of the map.
+  const float x = (t > 0.0f) ? (std::min(t, 1.0f) * float(g_control_points - 1)) : 0.0f;
+
+  const int i = std::min(static_cast<int>(x), g_control_points - 2);
+
+  const float f = x - float(i);
+
+  for (int c = 0; c < 3; c++) {
+    const float value = (float(points[i][c]) * (1.0f - f)) + (float(points[i + 1][c]) * f);
+    rgb[c] = static_cast<unsigned char>(std::lround(value));
+  }
+}
+
+std::vector<unsigned char>
+make_colormap_table(datviz_colormap colormap)
+{
+  std::vector<unsigned char> table(g_colormap_size * 4);
+
+  for (int i = 0; i < g_colormap_size; i++) {
+    colormap_lookup(colormap, float(i) / float(g_colormap_size - 1), &table[i * 4]);
+    table[(i * 4) + 3] = 255;
+  }
+
+  return table;
+}
+
+} // namespace datviz_detail
+
+using namespace datviz_detail;
+
+//==========//
+// Coloring //
+//==========//
+
+void
+datviz_apply_colormap(const float* values,
+                      uint32_t count,
+                      float min_value,
+                      float max_value,
+                      datviz_colormap colormap,
+                      dataviz_vertex_z* points)
+{
+  const float range = max_value - min_value;
+
+  const float scale = (range != 0.0f) ? (1.0f / range) : 0.0f;
+
+  // The table is precise enough for 8 bit colors and saves interpolating for every point.
+  const auto table = make_colormap_table(colormap);
+
+  parallel_for(count, 65536, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+
+      const float t = (values[i] - min_value) * scale;
+
+      const float x = (t > 0.0f) ? (std::min(t, 1.0f) * float(g_colormap_size - 1)) : 0.0f;
+
+      const auto* rgb = &table[std::lround(x) * 4];
+
+      points[i].r = rgb[0];
+      points[i].g = rgb[1];
+      points[i].b = rgb[2];
+    }
+  });
+}
+
+void
+datviz_apply_palette(const uint32_t* labels, uint32_t count, dataviz_vertex_z* points)
+{
+  parallel_for(count, 65536, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+
+      auto& p = points[i];
+
+      if (labels[i] == UINT32_MAX) {
+        p.r = g_unlabeled_gray;
+        p.g = g_unlabeled_gray;
+        p.b = g_unlabeled_gray;
+        continue;
+      }
+
+      const auto* rgb = g_palette[labels[i] % g_palette_size];
+
+      p.r = rgb[0];
+      p.g = rgb[1];
+      p.b = rgb[2];
+    }
+  });
+}
@@ -0,0 +1,28 @@
+/// @file datviz_colormap.h
+///
+/// @brief Internal color map tables, shared by the density rendering mode and the scalar coloring functions.
+
+#pragma once
+
+#include "datviz.h"
+
+#include <vector>
+
+namespace datviz_detail {
+
+/// The number of entries in a color map lookup table.
+constexpr int g_colormap_size = 256;
+
+/** @brief Looks up the color for a value between zero and one. Values outside of that range are clamped.
+ *
+ * @param rgb The red, green and blue channels of the color.
+ * */
+void
+colormap_lookup(datviz_colormap colormap, float t, unsigned char* rgb);
+
+/** @brief Builds a lookup table for a color map, with @ref g_colormap_size RGBA entries that are fully opaque.
+ * */
+std::vector<unsigned char>
+make_colormap_table(datviz_colormap colormap);
+
+} // namespace datviz_detail
@@ -0,0 +1,211 @@
+#include "datviz.h"
+
+#include "datviz_grid.h"
+#include "datviz_parallel.h"
+#include "datviz_perf.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <assert.h>
+
+using namespace datviz_detail;
+
+//===========//
+// Constants //
+//===========//
+
+namespace {
+
+constexpr size_t g_grain = 16384;
+
+/// The number of reference points that the point spacing is estimated from.
+constexpr size_t g_spacing_samples = 256;
+
+/// The most cell shells that a query may need to visit to reach the maximum distance.
+constexpr float g_max_query_rings = 8;
+
+/// The number of bits per axis in the keys that the query points are ordered by.
+constexpr int g_order_bits = 10;
+
+} // namespace
+
+//===============//
+// Grid Building //
+//===============//
+
+namespace {
+
+/** @brief Estimates the typical distance between neighboring points.
+ *
+ * @details A first guess at the cell size assumes that the points fill their bounds, which is far too large for scans
+ *          of surfaces. So the guess is only used for a grid that finds the nearest neighbor of a small sample of the
+ *          points, and the median of those distances is returned.
+ * */
+float
+estimate_spacing(const dataviz_vertex_z* points, size_t count)
+{
+  glm::vec3 lo(points[0].x, points[0].y, points[0].z);
+  glm::vec3 hi = lo;
+
+  const size_t stride = std::max<size_t>(count / 4096, 1);
+
+  for (size_t i = 0; i < count; i += stride) {
+    const glm::vec3 p(points[i].x, points[i].y, points[i].z);
+    lo = glm::min(lo, p);
+    hi = glm::max(hi, p);
+  }
+
+  const auto extent = glm::max(hi - lo, glm::vec3(1.0e-6f));
+
+  const float guess = std::cbrt((extent.x * extent.y * extent.z * 8.0f) / float(count));
+
+  PointGrid grid;
+
+  grid.build(points, count, std::max(guess, 1.0e-6f));
+
+  std::vector<float> distances;
+
+  std::vector<Neighbor> neighbors;
+
+  const size_t sample_stride = std::max<size_t>(count / g_spacing_samples, 1);
+
+  for (size_t i = 0; i < count; i += sample_stride) {
+
+    grid.find_nearest(grid.position(uint32_t(i)), 1, uint32_t(i), 2, neighbors);
+
+    if (!neighbors.empty())
+      distances.push_back(std::sqrt(neighbors[0].distance_squared));
+  }
+
+  if (distances.empty())
+    return guess;
+
+  std::nth_element(distances.begin(), distances.begin() + (distances.size() / 2), distances.end());
+
+  return distances[distances.size() / 2];
+}
+
+/// Spreads the lower 10 bits of a value out so that there are two zero bits between each of them.
+uint32_t
+spread_bits(uint32_t v)
+{
+  v = (v | (v << 16)) & 0x030000ffu;
+  v = (v | (v << 8)) & 0x0300f00fu;
+  v = (v | (v << 4)) & 0x030c30c3u;
+  v = (v | (v << 2)) & 0x09249249u;
+  return v;
+}
+
+/** @brief Orders points along a Z-order curve over their bounds.
+ *
+ * @details Queries made in this order visit the same grid cells as the queries before them, so the cells and their
+ *          points are usually still in the cache. Clouds that are already coherent in memory gain little from this,
+ *          but clouds in any other order would miss the cache on nearly every cell.
+ * */
+std::vector<uint32_t>
+spatial_order(const dataviz_vertex_z* points, size_t count)
+{
+  glm::vec3 lo(points[0].x, points[0].y, points[0].z);
+  glm::vec3 hi = lo;
+
+  for (size_t i = 0; i < count; i += std::max<size_t>(count / 4096, 1)) {
+    const glm::vec3 p(points[i].x, points[i].y, points[i].z);
+    lo = glm::min(lo, p);
+    hi = glm::max(hi, p);
+  }
+
+  const float cells = float((1 << g_order_bits) - 1);
+
+  const auto scale = cells / glm::max(hi - lo, glm::vec3(1.0e-6f));
+
+  std::vector<uint32_t> keys(count);
+
+  std::vector<uint32_t> order(count);
+
+  // The bounds come from a sample, so points outside of them are clamped to the edge.
+  auto coordinate = [&](float value, int axis) {
+    return uint32_t(std::min(std::max((value - lo[axis]) * scale[axis], 0.0f), cells));
+  };
+
+  parallel_for(count, g_grain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      const auto& p = points[i];
+      keys[i] = spread_bits(coordinate(p.x, 0)) | (spread_bits(coordinate(p.y, 1)) << 1) |
+                (spread_bits(coordinate(p.z, 2)) << 2);
+      order[i] = uint32_t(i);
+    }
+  });
+
+  parallel_sort_by_key(keys, order);
+
+  return order;
+}
+
+} // namespace
+
+//================//
+// Cloud Distance //
+//================//
+
+int
+datviz_compute_cloud_distances(const dataviz_vertex_z* reference,
+                               uint32_t reference_count,
+                               const dataviz_vertex_z* points,
+                               uint32_t point_count,
+                               float max_distance,
+                               float* out_distances)
+{
+  DATVIZ_PERF_SCOPE("cloud_distances");
+
+  assert(out_distances != nullptr);
+  assert(std::isfinite(max_distance));
+
+  if ((reference_count == 0) || (max_distance <= 0))
+    return -1;
+
+  // A few points per cell keeps each query to a handful of distance tests, while the lower bound keeps queries in
+  // regions that changed from searching more shells than the maximum distance is worth.
+  const float spacing = estimate_spacing(reference, reference_count);
+
+  const float cell_size = std::max({ spacing * 2.0f, max_distance / g_max_query_rings, 1.0e-6f });
+
+  // Only distances are needed, so the grid is built over a copy of the reference points that is ordered like the
+  // queries, which keeps the points of neighboring cells near each other in memory.
+  const auto reference_order = spatial_order(reference, reference_count);
+
+  std::vector<dataviz_vertex_z> sorted_reference(reference_count);
+
+  parallel_for(reference_count, g_grain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++)
+      sorted_reference[i] = reference[reference_order[i]];
+  });
+
+  PointGrid grid;
+
+  grid.build(sorted_reference.data(), reference_count, cell_size);
+
+  if (point_count == 0)
+    return 0;
+
+  const auto order = spatial_order(points, point_count);
+
+  parallel_for(point_count, g_grain, [&](size_t begin, size_t end) {
+    for (size_t j = begin; j < end; j++) {
+
+      const uint32_t i = order[j];
+
+      const glm::vec3 p(points[i].x, points[i].y, points[i].z);
+
+      Neighbor nearest;
+
+      out_distances[i] = grid.find_nearest_one(p, max_distance, nearest) ? std::sqrt(nearest.distance_squared)
+                                                                         : max_distance;
+    }
+  });
+
+  return 0;
+}
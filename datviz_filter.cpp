@@ -0,0 +1,665 @@
+#include "datviz.h"
+
+#include "datviz_filter.h"
+#include "datviz_grid.h"
+#include "datviz_parallel.h"
+#include "datviz_perf.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <assert.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define DATVIZ_HAVE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+using namespace datviz_detail;
+
+//===========//
+// Constants //
+//===========//
+
+namespace {
+
+constexpr size_t g_grain = 16384;
+
+/// The number of points that share a bounding box in polygon selection.
+constexpr size_t g_selection_run = 1024;
+
+/// The number of cell shells that the k nearest neighbor search may visit before it gives up on a point.
+constexpr int g_max_search_rings = 8;
+
+} // namespace
+
+//============//
+// Compaction //
+//============//
+
+namespace {
+
+/** @brief Writes out the points that were marked to be kept, preserving their order.
+ *
+ * @details Each block counts its kept points first, so that the blocks can write their output in parallel after a
+ *          prefix sum over the counts.
+ * */
+uint32_t
+compact(const dataviz_vertex_z* points,
+        size_t count,
+        const std::vector<unsigned char>& keep,
+        dataviz_vertex_z* out_points,
+        uint32_t* out_indices)
+{
+  std::vector<uint32_t> offsets(block_count(count, g_grain) + 1, 0);
+
+  parallel_for(count, g_grain, [&](size_t begin, size_t end) {
+    uint32_t kept = 0;
+    for (size_t i = begin; i < end; i++)
+      kept += keep[i];
+    offsets[(begin / g_grain) + 1] = kept;
+  });
+
+  for (size_t i = 1; i < offsets.size(); i++)
+    offsets[i] += offsets[i - 1];
+
+  if (!out_points && !out_indices)
+    return offsets.back();
+
+  parallel_for(count, g_grain, [&](size_t begin, size_t end) {
+    uint32_t out = offsets[begin / g_grain];
+    for (size_t i = begin; i < end; i++) {
+
+      if (!keep[i])
+        continue;
+
+      if (out_points)
+        out_points[out] = points[i];
+
+      if (out_indices)
+        out_indices[out] = uint32_t(i);
+
+      out++;
+    }
+  });
+
+  return offsets.back();
+}
+
+glm::vec3
+position_of(const dataviz_vertex_z& v)
+{
+  return glm::vec3(v.x, v.y, v.z);
+}
+
+/** @brief Picks a grid cell size that puts roughly @p k points in a cell, assuming the points fill their bounds.
+ *
+ * @details The bounds are taken from the 1st and 99th percentile of a sample of the points, since the far away points
+ *          that outlier removal is meant for would otherwise inflate them. Clouds that lie on surfaces get larger
+ *          cells than they need from this, which makes queries slower but does not change their results.
+ * */
+float
+estimate_cell_size(const dataviz_vertex_z* points, size_t count, size_t k)
+{
+  const size_t max_samples = 4096;
+
+  const size_t stride = std::max<size_t>(count / max_samples, 1);
+
+  std::vector<float> samples[3];
+
+  for (size_t i = 0; i < count; i += stride) {
+    samples[0].push_back(points[i].x);
+    samples[1].push_back(points[i].y);
+    samples[2].push_back(points[i].z);
+  }
+
+  float extent[3];
+
+  for (int axis = 0; axis < 3; axis++) {
+
+    auto& s = samples[axis];
+
+    const size_t lo = s.size() / 100;
+    const size_t hi = s.size() - 1 - lo;
+
+    std::nth_element(s.begin(), s.begin() + lo, s.end());
+    const float min = s[lo];
+
+    std::nth_element(s.begin(), s.begin() + hi, s.end());
+    const float max = s[hi];
+
+    extent[axis] = max - min;
+  }
+
+  const float largest = std::max({ extent[0], extent[1], extent[2], 1.0e-6f });
+
+  // Flat clouds would otherwise get a volume of zero.
+  for (auto& e : extent)
+    e = std::max(e, largest * 1.0e-3f);
+
+  const float volume = extent[0] * extent[1] * extent[2];
+
+  return std::cbrt((volume * float(k)) / float(count));
+}
+
+} // namespace
+
+//==========//
+// Cropping //
+//==========//
+
+uint32_t
+datviz_crop_box(const dataviz_vertex_z* points,
+                uint32_t point_count,
+                const float* box_min,
+                const float* box_max,
+                const float* box_transform,
+                int invert,
+                dataviz_vertex_z* out_points,
+                uint32_t* out_indices)
+{
+  DATVIZ_PERF_SCOPE("crop_box");
+
+  assert(box_min != nullptr);
+  assert(box_max != nullptr);
+
+  const CropBox box(box_min, box_max, box_transform);
+
+  const bool outside = !!invert;
+
+  std::vector<unsigned char> keep(point_count);
+
+  parallel_for(point_count, g_grain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++)
+      keep[i] = box.contains(position_of(points[i])) != outside;
+  });
+
+  return compact(points, point_count, keep, out_points, out_indices);
+}
+
+uint32_t
+datviz_crop_polygon(const dataviz_vertex_z* points,
+                    uint32_t point_count,
+                    const float* polygon_xy,
+                    uint32_t polygon_size,
+                    float z_min,
+                    float z_max,
+                    int invert,
+                    dataviz_vertex_z* out_points,
+                    uint32_t* out_indices)
+{
+  DATVIZ_PERF_SCOPE("crop_polygon");
+
+  assert((polygon_xy != nullptr) || (polygon_size == 0));
+
+  const CropPolygon polygon(polygon_xy, polygon_size, z_min, z_max);
+
+  const bool outside = !!invert;
+
+  std::vector<unsigned char> keep(point_count);
+
+  parallel_for(point_count, g_grain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++)
+      keep[i] = polygon.contains(position_of(points[i])) != outside;
+  });
+
+  return compact(points, point_count, keep, out_points, out_indices);
+}
+
+//===========//
+// Selection //
+//===========//
+
+namespace {
+
+/** @brief Tests projected points against a polygon in normalized device coordinates.
+ *
+ * @details The polygon is kept as a list of edges with their slopes, so that the even-odd test of a point needs no
+ *          division and can be done for four points at a time.
+ * */
+class ScreenSelection final
+{
+public:
+  ScreenSelection(const float* mvp, int width, int height, const float* polygon_xy, uint32_t polygon_size)
+    : mvp_(glm::make_mat4x4(mvp))
+  {
+    const float sx = 2.0f / float(std::max(width, 1));
+    const float sy = 2.0f / float(std::max(height, 1));
+
+    // The polygon is given with Y pointing down, as with cursor positions.
+    auto vertex = [&](uint32_t i) {
+      return glm::vec2((polygon_xy[(i * 2) + 0] * sx) - 1.0f, 1.0f - (polygon_xy[(i * 2) + 1] * sy));
+    };
+
+    for (uint32_t j = 0, k = polygon_size - 1; j < polygon_size; k = j++) {
+
+      const auto a = vertex(j);
+      const auto b = vertex(k);
+
+      min_ = glm::min(min_, a);
+      max_ = glm::max(max_, a);
+
+      // Horizontal edges are never crossed by the +X ray.
+      if (a.y == b.y)
+        continue;
+
+      edges_.push_back(Edge{ a.x, a.y, b.y, (b.x - a.x) / (b.y - a.y) });
+    }
+  }
+
+  /** @brief Tests whether any point in a box could project inside of the polygon.
+   *
+   * @details The box is rejected if all of its corners are behind the camera, beyond one of the depth planes, or if
+   *          the rectangle around the corners misses the bounds of the polygon. A box that is partly behind the camera
+   *          is never rejected by its rectangle, since its projection is not bounded by its corners.
+   * */
+  bool may_contain(const glm::vec3& lo, const glm::vec3& hi) const
+  {
+    glm::vec2 rect_min(std::numeric_limits<float>::max());
+    glm::vec2 rect_max(-std::numeric_limits<float>::max());
+
+    int behind = 0;
+    int too_near = 0;
+    int too_far = 0;
+
+    for (int i = 0; i < 8; i++) {
+
+      const glm::vec3 corner((i & 1) ? hi.x : lo.x, (i & 2) ? hi.y : lo.y, (i & 4) ? hi.z : lo.z);
+
+      const auto clip = mvp_ * glm::vec4(corner, 1.0f);
+
+      too_near += clip.z < -clip.w;
+      too_far += clip.z > clip.w;
+
+      if (clip.w <= 0) {
+        behind++;
+        continue;
+      }
+
+      const glm::vec2 ndc(clip.x / clip.w, clip.y / clip.w);
+
+      rect_min = glm::min(rect_min, ndc);
+      rect_max = glm::max(rect_max, ndc);
+    }
+
+    if ((behind == 8) || (too_near == 8) || (too_far == 8))
+      return false;
+
+    if (behind > 0)
+      return true;
+
+    return (rect_max.x >= min_.x) && (rect_max.y >= min_.y) && (rect_min.x <= max_.x) && (rect_min.y <= max_.y);
+  }
+
+  /** @brief Appends the indices of the points in a run that project inside of the polygon.
+   * */
+  void select(const dataviz_vertex_z* points, size_t begin, size_t end, std::vector<uint32_t>& out) const
+  {
+    size_t i = begin;
+
+#ifdef DATVIZ_HAVE_SSE
+    const float* m = glm::value_ptr(mvp_);
+
+    __m128 columns[16];
+
+    for (int k = 0; k < 16; k++)
+      columns[k] = _mm_set1_ps(m[k]);
+
+    const __m128 zero = _mm_setzero_ps();
+
+    const __m128 min_x = _mm_set1_ps(min_.x);
+    const __m128 min_y = _mm_set1_ps(min_.y);
+    const __m128 max_x = _mm_set1_ps(max_.x);
+    const __m128 max_y = _mm_set1_ps(max_.y);
+
+    static_assert(sizeof(dataviz_vertex_z) == 16, "The vertex must be four floats wide to be transposed.");
+
+    for (; (i + 4) <= end; i += 4) {
+
+      // The fourth column holds the color bits, which are ignored.
+      __m128 x = _mm_loadu_ps(&points[i + 0].x);
+      __m128 y = _mm_loadu_ps(&points[i + 1].x);
+      __m128 z = _mm_loadu_ps(&points[i + 2].x);
+      __m128 c = _mm_loadu_ps(&points[i + 3].x);
+
+      _MM_TRANSPOSE4_PS(x, y, z, c);
+
+      auto row = [&](int r) {
+        const __m128 xy = _mm_add_ps(_mm_mul_ps(columns[r], x), _mm_mul_ps(columns[4 + r], y));
+        return _mm_add_ps(xy, _mm_add_ps(_mm_mul_ps(columns[8 + r], z), columns[12 + r]));
+      };
+
+      const __m128 clip_z = row(2);
+      const __m128 clip_w = row(3);
+
+      __m128 mask = _mm_cmpgt_ps(clip_w, zero);
+      mask = _mm_and_ps(mask, _mm_cmple_ps(clip_z, clip_w));
+      mask = _mm_and_ps(mask, _mm_cmpge_ps(clip_z, _mm_sub_ps(zero, clip_w)));
+
+      if (!_mm_movemask_ps(mask))
+        continue;
+
+      const __m128 inv_w = _mm_div_ps(_mm_set1_ps(1.0f), clip_w);
+
+      const __m128 px = _mm_mul_ps(row(0), inv_w);
+      const __m128 py = _mm_mul_ps(row(1), inv_w);
+
+      mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(px, min_x), _mm_cmple_ps(px, max_x)));
+      mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(py, min_y), _mm_cmple_ps(py, max_y)));
+
+      if (!_mm_movemask_ps(mask))
+        continue;
+
+      __m128 inside = zero;
+
+      for (const auto& e : edges_) {
+
+        const __m128 above_a = _mm_cmpgt_ps(_mm_set1_ps(e.ay), py);
+        const __m128 above_b = _mm_cmpgt_ps(_mm_set1_ps(e.by), py);
+
+        const __m128 dy = _mm_sub_ps(py, _mm_set1_ps(e.ay));
+        const __m128 crossing_x = _mm_add_ps(_mm_set1_ps(e.ax), _mm_mul_ps(_mm_set1_ps(e.slope), dy));
+
+        inside = _mm_xor_ps(inside, _mm_and_ps(_mm_xor_ps(above_a, above_b), _mm_cmplt_ps(px, crossing_x)));
+      }
+
+      for (int bits = _mm_movemask_ps(_mm_and_ps(mask, inside)), lane = 0; bits; bits >>= 1, lane++) {
+        if (bits & 1)
+          out.push_back(uint32_t(i + size_t(lane)));
+      }
+    }
+#endif
+
+    for (; i < end; i++) {
+
+      const auto clip = mvp_ * glm::vec4(points[i].x, points[i].y, points[i].z, 1.0f);
+
+      if ((clip.w <= 0) || (clip.z < -clip.w) || (clip.z > clip.w))
+        continue;
+
+      if (contains(glm::vec2(clip.x / clip.w, clip.y / clip.w)))
+        out.push_back(uint32_t(i));
+    }
+  }
+
+private:
+  /** @brief A polygon edge that is not horizontal.
+   * */
+  struct Edge final
+  {
+    float ax = 0;
+
+    float ay = 0;
+
+    float by = 0;
+
+    /// The change in X for each unit of Y along the edge.
+    float slope = 0;
+  };
+
+  /** @brief Tests one point with the even-odd rule, counting the edges that a ray in the +X direction crosses.
+   * */
+  bool contains(const glm::vec2& p) const
+  {
+    if ((p.x < min_.x) || (p.y < min_.y) || (p.x > max_.x) || (p.y > max_.y))
+      return false;
+
+    bool inside = false;
+
+    for (const auto& e : edges_) {
+      if (((e.ay > p.y) != (e.by > p.y)) && (p.x < e.ax + (e.slope * (p.y - e.ay))))
+        inside = !inside;
+    }
+
+    return inside;
+  }
+
+  glm::mat4 mvp_;
+
+  std::vector<Edge> edges_;
+
+  glm::vec2 min_{ std::numeric_limits<float>::max() };
+
+  glm::vec2 max_{ -std::numeric_limits<float>::max() };
+};
+
+/** @brief Computes the bounding box of a run of points.
+ * */
+void
+bounds_of(const dataviz_vertex_z* points, size_t begin, size_t end, glm::vec3& lo, glm::vec3& hi)
+{
+#ifdef DATVIZ_HAVE_SSE
+  __m128 min = _mm_loadu_ps(&points[begin].x);
+  __m128 max = min;
+
+  for (size_t i = begin + 1; i < end; i++) {
+    const __m128 p = _mm_loadu_ps(&points[i].x);
+    min = _mm_min_ps(min, p);
+    max = _mm_max_ps(max, p);
+  }
+
+  alignas(16) float a[4];
+  alignas(16) float b[4];
+
+  _mm_store_ps(a, min);
+  _mm_store_ps(b, max);
+
+  lo = glm::vec3(a[0], a[1], a[2]);
+  hi = glm::vec3(b[0], b[1], b[2]);
+#else
+  lo = position_of(points[begin]);
+  hi = lo;
+
+  for (size_t i = begin + 1; i < end; i++) {
+    const auto p = position_of(points[i]);
+    lo = glm::min(lo, p);
+    hi = glm::max(hi, p);
+  }
+#endif
+}
+
+} // namespace
+
+uint32_t
+datviz_select_polygon(const float* mvp,
+                      int width,
+                      int height,
+                      const float* polygon_xy,
+                      uint32_t polygon_size,
+                      const dataviz_vertex_z* points,
+                      uint32_t point_count,
+                      uint32_t* out_indices)
+{
+  DATVIZ_PERF_SCOPE("select_polygon");
+
+  assert(mvp != nullptr);
+  assert((polygon_xy != nullptr) || (polygon_size == 0));
+
+  if (polygon_size < 3)
+    return 0;
+
+  const ScreenSelection selection(mvp, width, height, polygon_xy, polygon_size);
+
+  // Selections are usually a small part of the cloud, so each block gathers its own indices.
+  std::vector<std::vector<uint32_t>> selected(block_count(point_count, g_grain));
+
+  parallel_for(point_count, g_grain, [&](size_t begin, size_t end) {
+    auto& out = selected[begin / g_grain];
+
+    for (size_t run = begin; run < end; run += g_selection_run) {
+
+      const size_t run_end = std::min(run + g_selection_run, end);
+
+      glm::vec3 lo;
+      glm::vec3 hi;
+
+      bounds_of(points, run, run_end, lo, hi);
+
+      if (selection.may_contain(lo, hi))
+        selection.select(points, run, run_end, out);
+    }
+  });
+
+  std::vector<uint32_t> offsets(selected.size() + 1, 0);
+
+  for (size_t i = 0; i < selected.size(); i++)
+    offsets[i + 1] = offsets[i] + uint32_t(selected[i].size());
+
+  if (out_indices) {
+    parallel_for(selected.size(), 1, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++)
+        std::copy(selected[i].begin(), selected[i].end(), out_indices + offsets[i]);
+    });
+  }
+
+  return offsets.back();
+}
+
+//=================//
+// Outlier Removal //
+//=================//
+
+uint32_t
+datviz_remove_radius_outliers(const dataviz_vertex_z* points,
+                              uint32_t point_count,
+                              float radius,
+                              uint32_t min_neighbors,
+                              dataviz_vertex_z* out_points,
+                              uint32_t* out_indices)
+{
+  DATVIZ_PERF_SCOPE("radius_outliers");
+
+  assert(radius > 0);
+
+  PointGrid grid;
+
+  grid.build(points, point_count, radius);
+
+  const auto& order = grid.order();
+
+  std::vector<unsigned char> keep(point_count);
+
+  // Walking the points in grid order keeps each block of work spatially coherent.
+  parallel_for(point_count, g_grain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+
+      const uint32_t index = order[i];
+
+      uint32_t neighbors = 0;
+
+      grid.for_each_near(grid.position(index), radius, [&](uint32_t other, float) {
+        if (other != index)
+          neighbors++;
+        return neighbors < min_neighbors;
+      });
+
+      keep[index] = neighbors >= min_neighbors;
+    }
+  });
+
+  return compact(points, point_count, keep, out_points, out_indices);
+}
+
+uint32_t
+datviz_remove_statistical_outliers(const dataviz_vertex_z* points,
+                                   uint32_t point_count,
+                                   uint32_t k,
+                                   float stddev_multiplier,
+                                   dataviz_vertex_z* out_points,
+                                   uint32_t* out_indices)
+{
+  DATVIZ_PERF_SCOPE("statistical_outliers");
+
+  assert(k > 0);
+
+  if (point_count == 0)
+    return 0;
+
+  PointGrid grid;
+
+  grid.build(points, point_count, estimate_cell_size(points, point_count, k));
+
+  const auto& order = grid.order();
+
+  const float infinity = std::numeric_limits<float>::infinity();
+
+  std::vector<float> mean_distances(point_count);
+
+  parallel_for(point_count, g_grain, [&](size_t begin, size_t end) {
+    std::vector<Neighbor> neighbors;
+
+    for (size_t i = begin; i < end; i++) {
+
+      const uint32_t index = order[i];
+
+      grid.find_nearest(grid.position(index), k, index, g_max_search_rings, neighbors);
+
+      // Points without a full set of neighbors nearby are too isolated to be anything but outliers.
+      if (neighbors.size() < k) {
+        mean_distances[index] = infinity;
+        continue;
+      }
+
+      float sum = 0;
+
+      for (const auto& n : neighbors)
+        sum += std::sqrt(n.distance_squared);
+
+      mean_distances[index] = sum / float(k);
+    }
+  });
+
+  struct Moments final
+  {
+    double sum = 0;
+
+    double sum_squared = 0;
+
+    size_t count = 0;
+  };
+
+  std::vector<Moments> partial(block_count(point_count, g_grain));
+
+  parallel_for(point_count, g_grain, [&](size_t begin, size_t end) {
+    Moments m;
+    for (size_t i = begin; i < end; i++) {
+      const double d = mean_distances[i];
+      if (d == infinity)
+        continue;
+      m.sum += d;
+      m.sum_squared += d * d;
+      m.count++;
+    }
+    partial[begin / g_grain] = m;
+  });
+
+  Moments total;
+
+  for (const auto& m : partial) {
+    total.sum += m.sum;
+    total.sum_squared += m.sum_squared;
+    total.count += m.count;
+  }
+
+  std::vector<unsigned char> keep(point_count, 0);
+
+  if (total.count > 0) {
+
+    const double mean = total.sum / double(total.count);
+
+    const double variance = std::max((total.sum_squared / double(total.count)) - (mean * mean), 0.0);
+
+    const auto threshold = static_cast<float>(mean + (stddev_multiplier * std::sqrt(variance)));
+
+    parallel_for(point_count, g_grain, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++)
+        keep[i] = mean_distances[i] <= threshold;
+    });
+  }
+
+  return compact(points, point_count, keep, out_points, out_indices);
+}
@@ -0,0 +1,96 @@
+/// @file datviz_filter.h
+///
+/// @brief Internal point tests shared by the filtering functions and the processing pipeline.
+
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <limits>
+#include <vector>
+
+#include <stdint.h>
+
+namespace datviz_detail {
+
+/** @brief Tests whether points are inside of a (possibly transformed) box.
+ * */
+class CropBox final
+{
+public:
+  CropBox(const float* box_min, const float* box_max, const float* box_transform)
+    : min_(glm::make_vec3(box_min))
+    , max_(glm::make_vec3(box_max))
+    , transform_(box_transform ? glm::make_mat4x4(box_transform) : glm::mat4(1.0f))
+  {
+  }
+
+  bool contains(const glm::vec3& position) const
+  {
+    const auto p = glm::vec3(transform_ * glm::vec4(position, 1.0f));
+
+    return (p.x >= min_.x) && (p.y >= min_.y) && (p.z >= min_.z) && (p.x <= max_.x) && (p.y <= max_.y) &&
+           (p.z <= max_.z);
+  }
+
+private:
+  glm::vec3 min_;
+
+  glm::vec3 max_;
+
+  glm::mat4 transform_;
+};
+
+/** @brief Tests whether points are inside of a polygon on the XY plane, extruded between two Z values.
+ * */
+class CropPolygon final
+{
+public:
+  CropPolygon(const float* polygon_xy, uint32_t polygon_size, float z_min, float z_max)
+    : z_min_(z_min)
+    , z_max_(z_max)
+  {
+    for (uint32_t i = 0; i < polygon_size; i++) {
+      const auto v = glm::make_vec2(polygon_xy + (i * 2));
+      vertices_.push_back(v);
+      min_ = glm::min(min_, v);
+      max_ = glm::max(max_, v);
+    }
+  }
+
+  bool contains(const glm::vec3& p) const
+  {
+    if ((p.z < z_min_) || (p.z > z_max_) || (p.x < min_.x) || (p.y < min_.y) || (p.x > max_.x) || (p.y > max_.y))
+      return false;
+
+    // Even-odd rule, counting the polygon edges that a ray in the +X direction crosses.
+    bool inside = false;
+
+    const size_t n = vertices_.size();
+
+    for (size_t j = 0, k = n - 1; j < n; k = j++) {
+
+      const auto& a = vertices_[j];
+      const auto& b = vertices_[k];
+
+      if (((a.y > p.y) != (b.y > p.y)) && (p.x < (((b.x - a.x) * (p.y - a.y)) / (b.y - a.y)) + a.x))
+        inside = !inside;
+    }
+
+    return inside;
+  }
+
+private:
+  std::vector<glm::vec2> vertices_;
+
+  glm::vec2 min_{ std::numeric_limits<float>::max() };
+
+  glm::vec2 max_{ -std::numeric_limits<float>::max() };
+
+  float z_min_ = 0;
+
+  float z_max_ = 0;
+};
+
+} // namespace datviz_detail
@@ -0,0 +1,239 @@
+#include "datviz_font.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace datviz_detail {
+
+namespace {
+
+/// One byte per row, top to bottom, with the leftmost column in bit four.
+const unsigned char g_glyph_bitmaps[g_glyph_count][g_glyph_height] = {
+  { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // ' '
+  { 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04 }, // '!'
+  { 0x0a, 0x0a, 0x0a, 0x00, 0x00, 0x00, 0x00 }, // '"'
+  { 0x0a, 0x0a, 0x1f, 0x0a, 0x1f, 0x0a, 0x0a }, // '#'
+  { 0x04, 0x0f, 0x14, 0x0e, 0x05, 0x1e, 0x04 }, // '$'
+  { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 }, // '%'
+  { 0x0c, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0d }, // '&'
+  { 0x0c, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00 }, // '\''
+  { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 }, // '('
+  { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 }, // ')'
+  { 0x00, 0x04, 0x15, 0x0e, 0x15, 0x04, 0x00 }, // '*'
+  { 0x00, 0x04, 0x04, 0x1f, 0x04, 0x04, 0x00 }, // '+'
+  { 0x00, 0x00, 0x00, 0x00, 0x0c, 0x04, 0x08 }, // ','
+  { 0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00 }, // '-'
+  { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c }, // '.'
+  { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 }, // '/'
+  { 0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e }, // '0'
+  { 0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e }, // '1'
+  { 0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f }, // '2'
+  { 0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e }, // '3'
+  { 0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02 }, // '4'
+  { 0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e }, // '5'
+  { 0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e }, // '6'
+  { 0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 }, // '7'
+  { 0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e }, // '8'
+  { 0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c }, // '9'
+  { 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00 }, // ':'
+  { 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x04, 0x08 }, // ';'
+  { 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 }, // '<'
+  { 0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00 }, // '='
+  { 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 }, // '>'
+  { 0x0e, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, // '?'
+  { 0x0e, 0x11, 0x01, 0x0d, 0x15, 0x15, 0x0e }, // '@'
+  { 0x0e, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 }, // 'A'
+  { 0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e }, // 'B'
+  { 0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e }, // 'C'
+  { 0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c }, // 'D'
+  { 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f }, // 'E'
+  { 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10 }, // 'F'
+  { 0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f }, // 'G'
+  { 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 }, // 'H'
+  { 0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e }, // 'I'
+  { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c }, // 'J'
+  { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 }, // 'K'
+  { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f }, // 'L'
+  { 0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11 }, // 'M'
+  { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 }, // 'N'
+  { 0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e }, // 'O'
+  { 0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10 }, // 'P'
+  { 0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d }, // 'Q'
+  { 0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11 }, // 'R'
+  { 0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e }, // 'S'
+  { 0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, // 'T'
+  { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e }, // 'U'
+  { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04 }, // 'V'
+  { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a }, // 'W'
+  { 0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11 }, // 'X'
+  { 0x11, 0x11, 0x11, 0x0a, 0x04, 0x04, 0x04 }, // 'Y'
+  { 0x1f, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1f }, // 'Z'
+  { 0x0e, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0e }, // '['
+  { 0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00 }, // '\\'
+  { 0x0e, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0e }, // ']'
+  { 0x04, 0x0a, 0x11, 0x00, 0x00, 0x00, 0x00 }, // '^'
+  { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f }, // '_'
+  { 0x08, 0x04, 0x02, 0x00, 0x00, 0x00, 0x00 }, // '`'
+  { 0x00, 0x00, 0x0e, 0x01, 0x0f, 0x11, 0x0f }, // 'a'
+  { 0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x1e }, // 'b'
+  { 0x00, 0x00, 0x0e, 0x10, 0x10, 0x11, 0x0e }, // 'c'
+  { 0x01, 0x01, 0x0d, 0x13, 0x11, 0x11, 0x0f }, // 'd'
+  { 0x00, 0x00, 0x0e, 0x11, 0x1f, 0x10, 0x0e }, // 'e'
+  { 0x06, 0x09, 0x08, 0x1c, 0x08, 0x08, 0x08 }, // 'f'
+  { 0x00, 0x0f, 0x11, 0x11, 0x0f, 0x01, 0x0e }, // 'g'
+  { 0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x11 }, // 'h'
+  { 0x04, 0x00, 0x0c, 0x04, 0x04, 0x04, 0x0e }, // 'i'
+  { 0x02, 0x00, 0x06, 0x02, 0x02, 0x12, 0x0c }, // 'j'
+  { 0x10, 0x10, 0x12, 0x14, 0x18, 0x14, 0x12 }, // 'k'
+  { 0x0c, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e }, // 'l'
+  { 0x00, 0x00, 0x1a, 0x15, 0x15, 0x11, 0x11 }, // 'm'
+  { 0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11 }, // 'n'
+  { 0x00, 0x00, 0x0e, 0x11, 0x11, 0x11, 0x0e }, // 'o'
+  { 0x00, 0x00, 0x1e, 0x11, 0x1e, 0x10, 0x10 }, // 'p'
+  { 0x00, 0x00, 0x0d, 0x13, 0x0f, 0x01, 0x01 }, // 'q'
+  { 0x00, 0x00, 0x16, 0x19, 0x10, 0x10, 0x10 }, // 'r'
+  { 0x00, 0x00, 0x0e, 0x10, 0x0e, 0x01, 0x1e }, // 's'
+  { 0x08, 0x08, 0x1c, 0x08, 0x08, 0x09, 0x06 }, // 't'
+  { 0x00, 0x00, 0x11, 0x11, 0x11, 0x13, 0x0d }, // 'u'
+  { 0x00, 0x00, 0x11, 0x11, 0x11, 0x0a, 0x04 }, // 'v'
+  { 0x00, 0x00, 0x11, 0x11, 0x15, 0x15, 0x0a }, // 'w'
+  { 0x00, 0x00, 0x11, 0x0a, 0x04, 0x0a, 0x11 }, // 'x'
+  { 0x00, 0x00, 0x11, 0x11, 0x0f, 0x01, 0x0e }, // 'y'
+  { 0x00, 0x00, 0x1f, 0x02, 0x04, 0x08, 0x1f }, // 'z'
+  { 0x02, 0x04, 0x04, 0x08, 0x04, 0x04, 0x02 }, // '{'
+  { 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, // '|'
+  { 0x08, 0x04, 0x04, 0x02, 0x04, 0x04, 0x08 }, // '}'
+  { 0x00, 0x00, 0x08, 0x15, 0x02, 0x00, 0x00 }, // '~'
+};
+
+/// Stands in for an infinite distance. It is finite so that the parabola intersections stay well defined.
+constexpr float g_far = 1.0e20f;
+
+/** @brief Computes the squared distance transform of a row or column in place.
+ *
+ * @details This is the lower envelope of parabolas from Felzenszwalb and Huttenlocher, which is exact and linear in
+ *          the number of samples. The scratch buffers must hold @p n and @p n + 1 elements.
+ * */
+void
+distance_transform_1d(float* f, int n, int stride, float* d, int* v, float* z)
+{
+  int k = 0;
+
+  v[0] = 0;
+  z[0] = -g_far;
+  z[1] = g_far;
+
+  for (int q = 1; q < n; q++) {
+
+    const float fq = f[q * stride] + float(q * q);
+
+    float s = 0;
+
+    while (true) {
+      const int p = v[k];
+      s = (fq - (f[p * stride] + float(p * p))) / float(2 * (q - p));
+      if ((s > z[k]) || (k == 0))
+        break;
+      k--;
+    }
+
+    if (s > z[k])
+      k++;
+
+    v[k] = q;
+    z[k] = (k == 0) ? -g_far : s;
+    z[k + 1] = g_far;
+  }
+
+  k = 0;
+
+  for (int q = 0; q < n; q++) {
+
+    while (z[k + 1] < float(q))
+      k++;
+
+    const int p = v[k];
+
+    d[q] = (float(q - p) * float(q - p)) + f[p * stride];
+  }
+
+  for (int q = 0; q < n; q++)
+    f[q * stride] = d[q];
+}
+
+/** @brief Computes the squared distance from every texel to the nearest texel that is set in a mask.
+ * */
+std::vector<float>
+distance_transform(const std::vector<unsigned char>& mask, int width, int height, unsigned char feature)
+{
+  std::vector<float> f(mask.size());
+
+  for (size_t i = 0; i < mask.size(); i++)
+    f[i] = (mask[i] == feature) ? 0.0f : g_far;
+
+  const int n = std::max(width, height);
+
+  std::vector<float> d(n);
+  std::vector<int> v(n);
+  std::vector<float> z(n + 1);
+
+  for (int x = 0; x < width; x++)
+    distance_transform_1d(f.data() + x, height, width, d.data(), v.data(), z.data());
+
+  for (int y = 0; y < height; y++)
+    distance_transform_1d(f.data() + (y * width), width, 1, d.data(), v.data(), z.data());
+
+  return f;
+}
+
+} // namespace
+
+std::vector<unsigned char>
+make_glyph_atlas()
+{
+  // Rasterize the bitmaps at the atlas resolution first.
+  std::vector<unsigned char> mask(g_atlas_width * g_atlas_height, 0);
+
+  for (int glyph = 0; glyph < g_glyph_count; glyph++) {
+
+    const int cell_x = (glyph % g_atlas_columns) * g_atlas_cell_width;
+    const int cell_y = (glyph / g_atlas_columns) * g_atlas_cell_height;
+
+    for (int y = 0; y < (g_glyph_height * g_atlas_texels_per_unit); y++) {
+      for (int x = 0; x < (g_glyph_width * g_atlas_texels_per_unit); x++) {
+
+        const int row = g_glyph_bitmaps[glyph][y / g_atlas_texels_per_unit];
+
+        const int bit = (g_glyph_width - 1) - (x / g_atlas_texels_per_unit);
+
+        const int atlas_x = cell_x + x + (g_glyph_padding * g_atlas_texels_per_unit);
+        const int atlas_y = cell_y + y + (g_glyph_padding * g_atlas_texels_per_unit);
+
+        mask[(atlas_y * g_atlas_width) + atlas_x] = (row >> bit) & 1;
+      }
+    }
+  }
+
+  const auto to_inside = distance_transform(mask, g_atlas_width, g_atlas_height, 1);
+
+  const auto to_outside = distance_transform(mask, g_atlas_width, g_atlas_height, 0);
+
+  const float spread = float(g_glyph_padding * g_atlas_texels_per_unit);
+
+  std::vector<unsigned char> atlas(mask.size());
+
+  for (size_t i = 0; i < atlas.size(); i++) {
+
+    // The edge lies halfway between the centers of an inside and an outside texel.
+    const float distance =
+      mask[i] ? (std::sqrt(to_outside[i]) - 0.5f) : (0.5f - std::sqrt(to_inside[i]));
+
+    const float value = 0.5f + (0.5f * distance / spread);
+
+    atlas[i] = static_cast<unsigned char>(std::round(std::min(std::max(value, 0.0f), 1.0f) * 255.0f));
+  }
+
+  return atlas;
+}
+
+} // namespace datviz_detail
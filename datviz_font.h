@@ -0,0 +1,67 @@
+/// @file datviz_font.h
+///
+/// @brief An internal bitmap font and the signed distance field atlas that text is rendered from.
+
+#pragma once
+
+#include <vector>
+
+namespace datviz_detail {
+
+/// The first character in the font. Characters before it, and after the last one, are drawn as spaces.
+constexpr int g_first_glyph = 32;
+
+/// The number of glyphs in the font, which covers printable ASCII.
+constexpr int g_glyph_count = 95;
+
+/// The size of a glyph bitmap, in font units.
+constexpr int g_glyph_width = 5;
+
+constexpr int g_glyph_height = 7;
+
+/// The distance between the origins of adjacent glyphs and lines, in font units.
+constexpr int g_glyph_advance = 6;
+
+constexpr int g_line_advance = 9;
+
+/// The border around each glyph in the atlas, in font units. The distance field fades out across it.
+constexpr int g_glyph_padding = 1;
+
+constexpr int g_atlas_texels_per_unit = 4;
+
+constexpr int g_atlas_cell_width = (g_glyph_width + (2 * g_glyph_padding)) * g_atlas_texels_per_unit;
+
+constexpr int g_atlas_cell_height = (g_glyph_height + (2 * g_glyph_padding)) * g_atlas_texels_per_unit;
+
+constexpr int g_atlas_columns = 16;
+
+constexpr int g_atlas_rows = (g_glyph_count + g_atlas_columns - 1) / g_atlas_columns;
+
+constexpr int g_atlas_width = g_atlas_columns * g_atlas_cell_width;
+
+constexpr int g_atlas_height = g_atlas_rows * g_atlas_cell_height;
+
+/** @brief Gets the glyph that a character is drawn with.
+ *
+ * @return The index of the glyph in the atlas, or a negative number if the character has no glyph.
+ * */
+inline int
+glyph_index(char c)
+{
+  const int code = static_cast<unsigned char>(c);
+
+  return ((code >= g_first_glyph) && (code < (g_first_glyph + g_glyph_count))) ? (code - g_first_glyph) : -1;
+}
+
+/** @brief Generates the signed distance field of every glyph in the font.
+ *
+ * @details Each glyph is stored in a cell of @ref g_atlas_cell_width by @ref g_atlas_cell_height texels, laid out
+ *          in rows of @ref g_atlas_columns cells. A texel value of 128 lies on the edge of a glyph, values above it
+ *          are inside, and the values fall off to zero and 255 over one font unit.
+ *
+ * @return The atlas, with one byte per texel and the first row at the top of the glyphs.
+ * */
+std::vector<unsigned char>
+make_glyph_atlas();
+
+} // namespace datviz_detail
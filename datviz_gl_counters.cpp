@@ -0,0 +1,599 @@
+#include "datviz_gl_counters.h"
+
+#include "datviz_glad.h"
+
+#if defined(DATVIZ_GL_INSTRUMENTATION)
+#include <atomic>
+#endif
+
+using namespace datviz_detail;
+
+#if defined(DATVIZ_GL_INSTRUMENTATION)
+
+//==============//
+// Entry Points //
+//==============//
+
+namespace {
+
+/// Every entry point of the loader, which is every function of OpenGL ES 3.0.
+#define DATVIZ_GL_ENTRY_POINTS(X)                                                                                      \
+  X(glActiveTexture)                                                                                                   \
+  X(glAttachShader)                                                                                                    \
+  X(glBeginQuery)                                                                                                      \
+  X(glBeginTransformFeedback)                                                                                          \
+  X(glBindAttribLocation)                                                                                              \
+  X(glBindBuffer)                                                                                                      \
+  X(glBindBufferBase)                                                                                                  \
+  X(glBindBufferRange)                                                                                                 \
+  X(glBindFramebuffer)                                                                                                 \
+  X(glBindRenderbuffer)                                                                                                \
+  X(glBindSampler)                                                                                                     \
+  X(glBindTexture)                                                                                                     \
+  X(glBindTransformFeedback)                                                                                           \
+  X(glBindVertexArray)                                                                                                 \
+  X(glBlendColor)                                                                                                      \
+  X(glBlendEquation)                                                                                                   \
+  X(glBlendEquationSeparate)                                                                                           \
+  X(glBlendFunc)                                                                                                       \
+  X(glBlendFuncSeparate)                                                                                               \
+  X(glBlitFramebuffer)                                                                                                 \
+  X(glBufferData)                                                                                                      \
+  X(glBufferSubData)                                                                                                   \
+  X(glCheckFramebufferStatus)                                                                                          \
+  X(glClear)                                                                                                           \
+  X(glClearBufferfi)                                                                                                   \
+  X(glClearBufferfv)                                                                                                   \
+  X(glClearBufferiv)                                                                                                   \
+  X(glClearBufferuiv)                                                                                                  \
+  X(glClearColor)                                                                                                      \
+  X(glClearDepthf)                                                                                                     \
+  X(glClearStencil)                                                                                                    \
+  X(glClientWaitSync)                                                                                                  \
+  X(glColorMask)                                                                                                       \
+  X(glCompileShader)                                                                                                   \
+  X(glCompressedTexImage2D)                                                                                            \
+  X(glCompressedTexImage3D)                                                                                            \
+  X(glCompressedTexSubImage2D)                                                                                         \
+  X(glCompressedTexSubImage3D)                                                                                         \
+  X(glCopyBufferSubData)                                                                                               \
+  X(glCopyTexImage2D)                                                                                                  \
+  X(glCopyTexSubImage2D)                                                                                               \
+  X(glCopyTexSubImage3D)                                                                                               \
+  X(glCreateProgram)                                                                                                   \
+  X(glCreateShader)                                                                                                    \
+  X(glCullFace)                                                                                                        \
+  X(glDeleteBuffers)                                                                                                   \
+  X(glDeleteFramebuffers)                                                                                              \
+  X(glDeleteProgram)                                                                                                   \
+  X(glDeleteQueries)                                                                                                   \
+  X(glDeleteRenderbuffers)                                                                                             \
+  X(glDeleteSamplers)                                                                                                  \
+  X(glDeleteShader)                                                                                                    \
+  X(glDeleteSync)                                                                                                      \
+  X(glDeleteTextures)                                                                                                  \
+  X(glDeleteTransformFeedbacks)                                                                                        \
+  X(glDeleteVertexArrays)                                                                                              \
+  X(glDepthFunc)                                                                                                       \
+  X(glDepthMask)                                                                                                       \
+  X(glDepthRangef)                                                                                                     \
+  X(glDetachShader)                                                                                                    \
+  X(glDisable)                                                                                                         \
+  X(glDisableVertexAttribArray)                                                                                        \
+  X(glDrawArrays)                                                                                                      \
+  X(glDrawArraysInstanced)                                                                                             \
+  X(glDrawBuffers)                                                                                                     \
+  X(glDrawElements)                                                                                                    \
+  X(glDrawElementsInstanced)                                                                                           \
+  X(glDrawRangeElements)                                                                                               \
+  X(glEnable)                                                                                                          \
+  X(glEnableVertexAttribArray)                                                                                         \
+  X(glEndQuery)                                                                                                        \
+  X(glEndTransformFeedback)                                                                                            \
+  X(glFenceSync)                                                                                                       \
+  X(glFinish)                                                                                                          \
+  X(glFlush)                                                                                                           \
+  X(glFlushMappedBufferRange)                                                                                          \
+  X(glFramebufferRenderbuffer)                                                                                         \
+  X(glFramebufferTexture2D)                                                                                            \
+  X(glFramebufferTextureLayer)                                                                                         \
+  X(glFrontFace)                                                                                                       \
+  X(glGenBuffers)                                                                                                      \
+  X(glGenFramebuffers)                                                                                                 \
+  X(glGenQueries)                                                                                                      \
+  X(glGenRenderbuffers)                                                                                                \
+  X(glGenSamplers)                                                                                                     \
+  X(glGenTextures)                                                                                                     \
+  X(glGenTransformFeedbacks)                                                                                           \
+  X(glGenVertexArrays)                                                                                                 \
+  X(glGenerateMipmap)                                                                                                  \
+  X(glGetActiveAttrib)                                                                                                 \
+  X(glGetActiveUniform)                                                                                                \
+  X(glGetActiveUniformBlockName)                                                                                       \
+  X(glGetActiveUniformBlockiv)                                                                                         \
+  X(glGetActiveUniformsiv)                                                                                             \
+  X(glGetAttachedShaders)                                                                                              \
+  X(glGetAttribLocation)                                                                                               \
+  X(glGetBooleanv)                                                                                                     \
+  X(glGetBufferParameteri64v)                                                                                          \
+  X(glGetBufferParameteriv)                                                                                            \
+  X(glGetBufferPointerv)                                                                                               \
+  X(glGetError)                                                                                                        \
+  X(glGetFloatv)                                                                                                       \
+  X(glGetFragDataLocation)                                                                                             \
+  X(glGetFramebufferAttachmentParameteriv)                                                                             \
+  X(glGetInteger64i_v)                                                                                                 \
+  X(glGetInteger64v)                                                                                                   \
+  X(glGetIntegeri_v)                                                                                                   \
+  X(glGetIntegerv)                                                                                                     \
+  X(glGetInternalformativ)                                                                                             \
+  X(glGetProgramBinary)                                                                                                \
+  X(glGetProgramInfoLog)                                                                                               \
+  X(glGetProgramiv)                                                                                                    \
+  X(glGetQueryObjectuiv)                                                                                               \
+  X(glGetQueryiv)                                                                                                      \
+  X(glGetRenderbufferParameteriv)                                                                                      \
+  X(glGetSamplerParameterfv)                                                                                           \
+  X(glGetSamplerParameteriv)                                                                                           \
+  X(glGetShaderInfoLog)                                                                                                \
+  X(glGetShaderPrecisionFormat)                                                                                        \
+  X(glGetShaderSource)                                                                                                 \
+  X(glGetShaderiv)                                                                                                     \
+  X(glGetString)                                                                                                       \
+  X(glGetStringi)                                                                                                      \
+  X(glGetSynciv)                                                                                                       \
+  X(glGetTexParameterfv)                                                                                               \
+  X(glGetTexParameteriv)                                                                                               \
+  X(glGetTransformFeedbackVarying)                                                                                     \
+  X(glGetUniformBlockIndex)                                                                                            \
+  X(glGetUniformIndices)                                                                                               \
+  X(glGetUniformLocation)                                                                                              \
+  X(glGetUniformfv)                                                                                                    \
+  X(glGetUniformiv)                                                                                                    \
+  X(glGetUniformuiv)                                                                                                   \
+  X(glGetVertexAttribIiv)                                                                                              \
+  X(glGetVertexAttribIuiv)                                                                                             \
+  X(glGetVertexAttribPointerv)                                                                                         \
+  X(glGetVertexAttribfv)                                                                                               \
+  X(glGetVertexAttribiv)                                                                                               \
+  X(glHint)                                                                                                            \
+  X(glInvalidateFramebuffer)                                                                                           \
+  X(glInvalidateSubFramebuffer)                                                                                        \
+  X(glIsBuffer)                                                                                                        \
+  X(glIsEnabled)                                                                                                       \
+  X(glIsFramebuffer)                                                                                                   \
+  X(glIsProgram)                                                                                                       \
+  X(glIsQuery)                                                                                                         \
+  X(glIsRenderbuffer)                                                                                                  \
+  X(glIsSampler)                                                                                                       \
+  X(glIsShader)                                                                                                        \
+  X(glIsSync)                                                                                                          \
+  X(glIsTexture)                                                                                                       \
+  X(glIsTransformFeedback)                                                                                             \
+  X(glIsVertexArray)                                                                                                   \
+  X(glLineWidth)                                                                                                       \
+  X(glLinkProgram)                                                                                                     \
+  X(glMapBufferRange)                                                                                                  \
+  X(glPauseTransformFeedback)                                                                                          \
+  X(glPixelStorei)                                                                                                     \
+  X(glPolygonOffset)                                                                                                   \
+  X(glProgramBinary)                                                                                                   \
+  X(glProgramParameteri)                                                                                               \
+  X(glReadBuffer)                                                                                                      \
+  X(glReadPixels)                                                                                                      \
+  X(glReleaseShaderCompiler)                                                                                           \
+  X(glRenderbufferStorage)                                                                                             \
+  X(glRenderbufferStorageMultisample)                                                                                  \
+  X(glResumeTransformFeedback)                                                                                         \
+  X(glSampleCoverage)                                                                                                  \
+  X(glSamplerParameterf)                                                                                               \
+  X(glSamplerParameterfv)                                                                                              \
+  X(glSamplerParameteri)                                                                                               \
+  X(glSamplerParameteriv)                                                                                              \
+  X(glScissor)                                                                                                         \
+  X(glShaderBinary)                                                                                                    \
+  X(glShaderSource)                                                                                                    \
+  X(glStencilFunc)                                                                                                     \
+  X(glStencilFuncSeparate)                                                                                             \
+  X(glStencilMask)                                                                                                     \
+  X(glStencilMaskSeparate)                                                                                             \
+  X(glStencilOp)                                                                                                       \
+  X(glStencilOpSeparate)                                                                                               \
+  X(glTexImage2D)                                                                                                      \
+  X(glTexImage3D)                                                                                                      \
+  X(glTexParameterf)                                                                                                   \
+  X(glTexParameterfv)                                                                                                  \
+  X(glTexParameteri)                                                                                                   \
+  X(glTexParameteriv)                                                                                                  \
+  X(glTexStorage2D)                                                                                                    \
+  X(glTexStorage3D)                                                                                                    \
+  X(glTexSubImage2D)                                                                                                   \
+  X(glTexSubImage3D)                                                                                                   \
+  X(glTransformFeedbackVaryings)                                                                                       \
+  X(glUniform1f)                                                                                                       \
+  X(glUniform1fv)                                                                                                      \
+  X(glUniform1i)                                                                                                       \
+  X(glUniform1iv)                                                                                                      \
+  X(glUniform1ui)                                                                                                      \
+  X(glUniform1uiv)                                                                                                     \
+  X(glUniform2f)                                                                                                       \
+  X(glUniform2fv)                                                                                                      \
+  X(glUniform2i)                                                                                                       \
+  X(glUniform2iv)                                                                                                      \
+  X(glUniform2ui)                                                                                                      \
+  X(glUniform2uiv)                                                                                                     \
+  X(glUniform3f)                                                                                                       \
+  X(glUniform3fv)                                                                                                      \
+  X(glUniform3i)                                                                                                       \
+  X(glUniform3iv)                                                                                                      \
+  X(glUniform3ui)                                                                                                      \
+  X(glUniform3uiv)                                                                                                     \
+  X(glUniform4f)                                                                                                       \
+  X(glUniform4fv)                                                                                                      \
+  X(glUniform4i)                                                                                                       \
+  X(glUniform4iv)                                                                                                      \
+  X(glUniform4ui)                                                                                                      \
+  X(glUniform4uiv)                                                                                                     \
+  X(glUniformBlockBinding)                                                                                             \
+  X(glUniformMatrix2fv)                                                                                                \
+  X(glUniformMatrix2x3fv)                                                                                              \
+  X(glUniformMatrix2x4fv)                                                                                              \
+  X(glUniformMatrix3fv)                                                                                                \
+  X(glUniformMatrix3x2fv)                                                                                              \
+  X(glUniformMatrix3x4fv)                                                                                              \
+  X(glUniformMatrix4fv)                                                                                                \
+  X(glUniformMatrix4x2fv)                                                                                              \
+  X(glUniformMatrix4x3fv)                                                                                              \
+  X(glUnmapBuffer)                                                                                                     \
+  X(glUseProgram)                                                                                                      \
+  X(glValidateProgram)                                                                                                 \
+  X(glVertexAttrib1f)                                                                                                  \
+  X(glVertexAttrib1fv)                                                                                                 \
+  X(glVertexAttrib2f)                                                                                                  \
+  X(glVertexAttrib2fv)                                                                                                 \
+  X(glVertexAttrib3f)                                                                                                  \
+  X(glVertexAttrib3fv)                                                                                                 \
+  X(glVertexAttrib4f)                                                                                                  \
+  X(glVertexAttrib4fv)                                                                                                 \
+  X(glVertexAttribDivisor)                                                                                             \
+  X(glVertexAttribI4i)                                                                                                 \
+  X(glVertexAttribI4iv)                                                                                                \
+  X(glVertexAttribI4ui)                                                                                                \
+  X(glVertexAttribI4uiv)                                                                                               \
+  X(glVertexAttribIPointer)                                                                                            \
+  X(glVertexAttribPointer)                                                                                             \
+  X(glViewport)                                                                                                        \
+  X(glWaitSync)
+
+enum EntryPoint : size_t
+{
+#define DATVIZ_GL_ENTRY_POINT_ENUM(name) entry_##name,
+  DATVIZ_GL_ENTRY_POINTS(DATVIZ_GL_ENTRY_POINT_ENUM)
+#undef DATVIZ_GL_ENTRY_POINT_ENUM
+    entry_count
+};
+
+const char* const g_entry_point_names[entry_count]{
+#define DATVIZ_GL_ENTRY_POINT_NAME(name) #name,
+  DATVIZ_GL_ENTRY_POINTS(DATVIZ_GL_ENTRY_POINT_NAME)
+#undef DATVIZ_GL_ENTRY_POINT_NAME
+};
+
+std::atomic<uint64_t> g_call_counts[entry_count];
+
+std::atomic<uint64_t> g_byte_counts[entry_count];
+
+} // namespace
+
+//==============//
+// Upload Sizes //
+//==============//
+
+namespace {
+
+/** @brief Gets the number of bytes in one pixel that is passed to a texture.
+ *
+ * @details Rows are taken to be tightly packed, so this can fall a little short of the bytes that the driver reads when
+ *          the unpack alignment pads them.
+ * */
+uint64_t
+pixel_size(GLenum format, GLenum type)
+{
+  switch (type) {
+    case GL_UNSIGNED_SHORT_5_6_5:
+    case GL_UNSIGNED_SHORT_4_4_4_4:
+    case GL_UNSIGNED_SHORT_5_5_5_1:
+      return 2;
+    case GL_UNSIGNED_INT_2_10_10_10_REV:
+    case GL_UNSIGNED_INT_10F_11F_11F_REV:
+    case GL_UNSIGNED_INT_5_9_9_9_REV:
+    case GL_UNSIGNED_INT_24_8:
+      return 4;
+    case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+      return 8;
+    default:
+      break;
+  }
+
+  uint64_t component_size = 1;
+
+  switch (type) {
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+    case GL_HALF_FLOAT:
+      component_size = 2;
+      break;
+    case GL_INT:
+    case GL_UNSIGNED_INT:
+    case GL_FLOAT:
+      component_size = 4;
+      break;
+    default:
+      break;
+  }
+
+  switch (format) {
+    case GL_RG:
+    case GL_RG_INTEGER:
+    case GL_LUMINANCE_ALPHA:
+      return 2 * component_size;
+    case GL_RGB:
+    case GL_RGB_INTEGER:
+      return 3 * component_size;
+    case GL_RGBA:
+    case GL_RGBA_INTEGER:
+      return 4 * component_size;
+    default:
+      return component_size;
+  }
+}
+
+uint64_t
+image_size(GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type)
+{
+  if ((width <= 0) || (height <= 0) || (depth <= 0))
+    return 0;
+
+  return uint64_t(width) * uint64_t(height) * uint64_t(depth) * pixel_size(format, type);
+}
+
+/** @brief Gets the number of bytes that a call passes to the driver.
+ *
+ * @details Only the calls that upload buffers and textures pass any. Allocating storage without any data does not
+ *          count as an upload.
+ * */
+template<size_t Index>
+struct UploadSize final
+{
+  template<typename... Args>
+  static uint64_t of(Args...)
+  {
+    return 0;
+  }
+};
+
+template<>
+struct UploadSize<entry_glBufferData> final
+{
+  static uint64_t of(GLenum, GLsizeiptr size, const void* data, GLenum) { return data ? uint64_t(size) : 0; }
+};
+
+template<>
+struct UploadSize<entry_glBufferSubData> final
+{
+  static uint64_t of(GLenum, GLintptr, GLsizeiptr size, const void*) { return uint64_t(size); }
+};
+
+template<>
+struct UploadSize<entry_glTexImage2D> final
+{
+  static uint64_t of(GLenum, GLint, GLint, GLsizei w, GLsizei h, GLint, GLenum format, GLenum type, const void* data)
+  {
+    return data ? image_size(w, h, 1, format, type) : 0;
+  }
+};
+
+template<>
+struct UploadSize<entry_glTexImage3D> final
+{
+  static uint64_t of(GLenum,
+                     GLint,
+                     GLint,
+                     GLsizei w,
+                     GLsizei h,
+                     GLsizei d,
+                     GLint,
+                     GLenum format,
+                     GLenum type,
+                     const void* data)
+  {
+    return data ? image_size(w, h, d, format, type) : 0;
+  }
+};
+
+template<>
+struct UploadSize<entry_glTexSubImage2D> final
+{
+  static uint64_t of(GLenum, GLint, GLint, GLint, GLsizei w, GLsizei h, GLenum format, GLenum type, const void*)
+  {
+    return image_size(w, h, 1, format, type);
+  }
+};
+
+template<>
+struct UploadSize<entry_glTexSubImage3D> final
+{
+  static uint64_t of(GLenum,
+                     GLint,
+                     GLint,
+                     GLint,
+                     GLint,
+                     GLsizei w,
+                     GLsizei h,
+                     GLsizei d,
+                     GLenum format,
+                     GLenum type,
+                     const void*)
+  {
+    return image_size(w, h, d, format, type);
+  }
+};
+
+template<>
+struct UploadSize<entry_glCompressedTexImage2D> final
+{
+  static uint64_t of(GLenum, GLint, GLenum, GLsizei, GLsizei, GLint, GLsizei size, const void* data)
+  {
+    return (data && (size > 0)) ? uint64_t(size) : 0;
+  }
+};
+
+template<>
+struct UploadSize<entry_glCompressedTexImage3D> final
+{
+  static uint64_t of(GLenum, GLint, GLenum, GLsizei, GLsizei, GLsizei, GLint, GLsizei size, const void* data)
+  {
+    return (data && (size > 0)) ? uint64_t(size) : 0;
+  }
+};
+
+template<>
+struct UploadSize<entry_glCompressedTexSubImage2D> final
+{
+  static uint64_t of(GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLsizei size, const void*)
+  {
+    return (size > 0) ? uint64_t(size) : 0;
+  }
+};
+
+template<>
+struct UploadSize<entry_glCompressedTexSubImage3D> final
+{
+  static uint64_t of(GLenum, GLint, GLint, GLint, GLint, GLsizei, GLsizei, GLsizei, GLenum, GLsizei size, const void*)
+  {
+    return (size > 0) ? uint64_t(size) : 0;
+  }
+};
+
+} // namespace
+
+//==================//
+// Counting Wrapper //
+//==================//
+
+namespace {
+
+/** @brief An entry point that counts its calls, and then calls the one that the loader found.
+ *
+ * @details The wrapper is typed after the pointer of the loader, so that its arguments are passed on as they are.
+ * */
+template<size_t Index, typename Function>
+struct CountingWrapper;
+
+template<size_t Index, typename Result, typename... Args>
+struct CountingWrapper<Index, Result(APIENTRYP)(Args...)> final
+{
+  using Function = Result(APIENTRYP)(Args...);
+
+  static Function& original()
+  {
+    static Function f = nullptr;
+
+    return f;
+  }
+
+  static Result APIENTRY call(Args... args)
+  {
+    g_call_counts[Index].fetch_add(1, std::memory_order_relaxed);
+
+    const uint64_t bytes = UploadSize<Index>::of(args...);
+    if (bytes > 0)
+      g_byte_counts[Index].fetch_add(bytes, std::memory_order_relaxed);
+
+    return original()(args...);
+  }
+};
+
+template<size_t Index, typename Function>
+void
+install(Function& entry_point)
+{
+  using Wrapper = CountingWrapper<Index, Function>;
+
+  // Entry points that the driver lacks stay null, and ones that are already wrapped must not wrap themselves.
+  if (!entry_point || (entry_point == &Wrapper::call))
+    return;
+
+  Wrapper::original() = entry_point;
+
+  entry_point = &Wrapper::call;
+}
+
+} // namespace
+
+//============//
+// Public API //
+//============//
+
+namespace datviz_detail {
+
+void
+install_gl_counters()
+{
+#define DATVIZ_GL_ENTRY_POINT_INSTALL(name) install<entry_##name>(glad_##name);
+  DATVIZ_GL_ENTRY_POINTS(DATVIZ_GL_ENTRY_POINT_INSTALL)
+#undef DATVIZ_GL_ENTRY_POINT_INSTALL
+}
+
+size_t
+gl_entry_point_count()
+{
+  return entry_count;
+}
+
+const char*
+gl_entry_point_name(size_t index)
+{
+  return (index < entry_count) ? g_entry_point_names[index] : "";
+}
+
+void
+read_gl_counters(uint64_t* calls, uint64_t* bytes)
+{
+  for (size_t i = 0; i < entry_count; i++) {
+    calls[i] = g_call_counts[i].load(std::memory_order_relaxed);
+    bytes[i] = g_byte_counts[i].load(std::memory_order_relaxed);
+  }
+}
+
+} // namespace datviz_detail
+
+#else
+
+namespace datviz_detail {
+
+void
+install_gl_counters()
+{
+}
+
+size_t
+gl_entry_point_count()
+{
+  return 0;
+}
+
+const char*
+gl_entry_point_name(size_t)
+{
+  return "";
+}
+
+void
+read_gl_counters(uint64_t*, uint64_t*)
+{
+}
+
+} // namespace datviz_detail
+
+#endif
@@ -0,0 +1,40 @@
+/// @file datviz_gl_counters.h
+///
+/// @brief Internal helpers for counting the calls made through the GL loader, and the bytes that they upload.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace datviz_detail {
+
+/** @brief Replaces the entry points of the loader with ones that count their calls before calling the driver.
+ *
+ * @details This has to be called after every time the loader is run, since loading replaces the entry points again. It
+ *          does nothing unless the library is built with GL instrumentation.
+ * */
+void
+install_gl_counters();
+
+/** @brief Gets the number of entry points that are counted, which is zero unless the library is built with GL
+ *         instrumentation.
+ * */
+size_t
+gl_entry_point_count();
+
+/** @brief Gets the name of an entry point, such as "glBufferData".
+ * */
+const char*
+gl_entry_point_name(size_t index);
+
+/** @brief Reads the number of calls made to each entry point, and the bytes uploaded through each, since the library
+ *         was loaded.
+ *
+ * @details Both arrays have one element for each entry point. The calls of every thread are counted, including the
+ *          ones that compile shaders in the background.
+ * */
+void
+read_gl_counters(uint64_t* calls, uint64_t* bytes);
+
+} // namespace datviz_detail
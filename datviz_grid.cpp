@@ -0,0 +1,185 @@
+#include "datviz_grid.h"
+
+#include "datviz_parallel.h"
+
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+namespace datviz_detail {
+
+namespace {
+
+constexpr size_t g_grain = 16384;
+
+size_t
+next_power_of_two(size_t n)
+{
+  size_t p = 1;
+  while (p < n)
+    p <<= 1;
+  return p;
+}
+
+} // namespace
+
+VisitedBuckets&
+PointGrid::visited_scratch()
+{
+  thread_local VisitedBuckets visited;
+  return visited;
+}
+
+void
+PointGrid::build(const dataviz_vertex_z* points, size_t count, float cell_size)
+{
+  points_ = points;
+
+  cell_size_ = cell_size;
+
+  inv_cell_size_ = 1.0f / cell_size;
+
+  const size_t table_size = next_power_of_two(std::max<size_t>(count, 1024));
+
+  mask_ = table_size - 1;
+
+  std::vector<uint32_t> buckets(count);
+
+  std::vector<std::atomic<uint32_t>> counts(table_size);
+
+  parallel_for(count, g_grain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      const auto bucket = static_cast<uint32_t>(bucket_of(cell_of(position(uint32_t(i)))));
+      buckets[i] = bucket;
+      counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+
+  offsets_.resize(table_size + 1);
+
+  uint32_t sum = 0;
+
+  for (size_t i = 0; i < table_size; i++) {
+    offsets_[i] = sum;
+    sum += counts[i].load(std::memory_order_relaxed);
+    counts[i].store(offsets_[i], std::memory_order_relaxed);
+  }
+
+  offsets_[table_size] = sum;
+
+  order_.resize(count);
+
+  parallel_for(count, g_grain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++)
+      order_[counts[buckets[i]].fetch_add(1, std::memory_order_relaxed)] = uint32_t(i);
+  });
+}
+
+void
+PointGrid::search(const glm::vec3& p,
+                  size_t k,
+                  uint32_t exclude,
+                  int max_rings,
+                  float max_distance_squared,
+                  std::vector<Neighbor>& heap) const
+{
+  heap.clear();
+
+  if (order_.empty() || (k == 0))
+    return;
+
+  VisitedBuckets& visited = visited_scratch();
+
+  visited.clear();
+
+  const auto center = cell_of(p);
+
+  // The distance from the query position to the nearest face of its own cell.
+  const auto lo = glm::vec3(center) * cell_size_;
+  const auto hi = lo + glm::vec3(cell_size_);
+  const auto to_lo = p - lo;
+  const auto to_hi = hi - p;
+  const float margin = std::min({ to_lo.x, to_lo.y, to_lo.z, to_hi.x, to_hi.y, to_hi.z });
+
+  auto visit = [&](const glm::ivec3& cell) {
+    const size_t bucket = bucket_of(cell);
+
+    if (!visited.insert(bucket))
+      return;
+
+    for (uint32_t i = offsets_[bucket]; i < offsets_[bucket + 1]; i++) {
+
+      const uint32_t index = order_[i];
+      if (index == exclude)
+        continue;
+
+      const auto delta = position(index) - p;
+
+      const float d2 = glm::dot(delta, delta);
+
+      if (d2 > max_distance_squared)
+        continue;
+
+      if (heap.size() < k) {
+        heap.push_back(Neighbor{ index, d2 });
+        std::push_heap(heap.begin(), heap.end());
+      } else if (d2 < heap.front().distance_squared) {
+        std::pop_heap(heap.begin(), heap.end());
+        heap.back() = Neighbor{ index, d2 };
+        std::push_heap(heap.begin(), heap.end());
+      }
+    }
+  };
+
+  for (int r = 0; r <= max_rings; r++) {
+
+    for (int z = -r; z <= r; z++) {
+      for (int y = -r; y <= r; y++) {
+
+        const bool on_face = (std::abs(z) == r) || (std::abs(y) == r);
+
+        // Only the outer shell of the cube is new, so interior rows only need their two end cells.
+        const int step = on_face ? 1 : std::max(2 * r, 1);
+
+        for (int x = -r; x <= r; x += step)
+          visit(center + glm::ivec3(x, y, z));
+      }
+    }
+
+    // Every point that has not been visited is at least this far away.
+    const float reach = (float(r) * cell_size_) + margin;
+
+    if (reach * reach >= max_distance_squared)
+      break;
+
+    if ((heap.size() == k) && (heap.front().distance_squared <= reach * reach))
+      break;
+  }
+
+  std::sort_heap(heap.begin(), heap.end());
+}
+
+void
+PointGrid::find_nearest(const glm::vec3& p, size_t k, uint32_t exclude, int max_rings, std::vector<Neighbor>& out) const
+{
+  search(p, k, exclude, max_rings, std::numeric_limits<float>::infinity(), out);
+}
+
+bool
+PointGrid::find_nearest_one(const glm::vec3& p, float max_distance, Neighbor& out) const
+{
+  thread_local std::vector<Neighbor> heap;
+
+  const int max_rings = static_cast<int>(std::ceil(max_distance * inv_cell_size_));
+
+  search(p, 1, UINT32_MAX, max_rings, max_distance * max_distance, heap);
+
+  if (heap.empty())
+    return false;
+
+  out = heap.front();
+
+  return true;
+}
+
+} // namespace datviz_detail
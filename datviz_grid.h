@@ -0,0 +1,249 @@
+/// @file datviz_grid.h
+///
+/// @brief An internal spatial hash grid, used for neighbor queries by the point processing functions.
+
+#pragma once
+
+#include "datviz.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace datviz_detail {
+
+/** @brief A neighboring point found by a grid query.
+ * */
+struct Neighbor final
+{
+  uint32_t index = 0;
+
+  float distance_squared = 0;
+
+  bool operator<(const Neighbor& other) const { return distance_squared < other.distance_squared; }
+};
+
+/** @brief A set of bucket indices that is cleared in constant time, used to skip buckets that a query already visited.
+ *
+ * @details Queries that visit many cells would spend most of their time keeping a sorted list of buckets, so this is
+ *          an open addressing table instead. Slots are stamped with the generation of the query that filled them,
+ *          which makes clearing the set a matter of starting a new generation.
+ * */
+class VisitedBuckets final
+{
+public:
+  void clear()
+  {
+    size_ = 0;
+
+    if (++generation_ == 0) {
+      std::fill(slots_.begin(), slots_.end(), Slot{});
+      generation_ = 1;
+    }
+  }
+
+  /** @brief Adds a bucket to the set.
+   *
+   * @return True if the bucket was not in the set before, false otherwise.
+   * */
+  bool insert(size_t bucket)
+  {
+    if (((size_ + 1) * 2) > slots_.size())
+      grow();
+
+    const size_t mask = slots_.size() - 1;
+
+    for (size_t i = (bucket * 2654435761u) & mask;; i = (i + 1) & mask) {
+
+      auto& slot = slots_[i];
+
+      if (slot.generation != generation_) {
+        slot = Slot{ generation_, uint32_t(bucket) };
+        size_++;
+        return true;
+      }
+
+      if (slot.bucket == uint32_t(bucket))
+        return false;
+    }
+  }
+
+private:
+  struct Slot final
+  {
+    uint32_t generation = 0;
+
+    uint32_t bucket = 0;
+  };
+
+  void grow()
+  {
+    std::vector<Slot> old(std::max<size_t>(slots_.size() * 2, 64));
+
+    old.swap(slots_);
+
+    size_ = 0;
+
+    for (const auto& slot : old) {
+      if (slot.generation == generation_)
+        insert(slot.bucket);
+    }
+  }
+
+  std::vector<Slot> slots_;
+
+  size_t size_ = 0;
+
+  uint32_t generation_ = 1;
+};
+
+/** @brief Buckets points by the grid cell that they fall into.
+ *
+ * @details Cells are hashed into a table that is sized by the number of points, so memory does not depend on the
+ *          extent of the point cloud. Different cells may share a bucket, which only costs a few extra distance
+ *          tests. The point indices are stored in bucket order, which keeps points that are near each other in space
+ *          near each other in memory as well.
+ * */
+class PointGrid final
+{
+public:
+  /** @brief Builds the grid, using all available threads.
+   *
+   * @param points The points to build the grid from. They must outlive the grid.
+   *
+   * @param count The number of points.
+   *
+   * @param cell_size The edge length of a grid cell. Queries are fastest when this is close to the query radius.
+   * */
+  void build(const dataviz_vertex_z* points, size_t count, float cell_size);
+
+  size_t size() const { return order_.size(); }
+
+  size_t bucket_count() const { return offsets_.empty() ? 0 : offsets_.size() - 1; }
+
+  float cell_size() const { return cell_size_; }
+
+  /** @brief The point indices, sorted by bucket.
+   * */
+  const std::vector<uint32_t>& order() const { return order_; }
+
+  /** @brief The position in @ref order of the first point in a bucket.
+   * */
+  uint32_t bucket_begin(size_t bucket) const { return offsets_[bucket]; }
+
+  /** @brief The position in @ref order one past the last point in a bucket.
+   * */
+  uint32_t bucket_end(size_t bucket) const { return offsets_[bucket + 1]; }
+
+  glm::vec3 position(uint32_t index) const
+  {
+    const auto& p = points_[index];
+    return glm::vec3(p.x, p.y, p.z);
+  }
+
+  glm::ivec3 cell_of(const glm::vec3& p) const { return glm::ivec3(glm::floor(p * inv_cell_size_)); }
+
+  size_t bucket_of(const glm::ivec3& c) const
+  {
+    const uint32_t h = (uint32_t(c.x) * 73856093u) ^ (uint32_t(c.y) * 19349663u) ^ (uint32_t(c.z) * 83492791u);
+    return h & mask_;
+  }
+
+  /** @brief Calls a function for every point within a radius of a position.
+   *
+   * @param fn Called with the index of each point and its squared distance.
+   *           Returning false stops the query early.
+   * */
+  template<typename Fn>
+  void for_each_near(const glm::vec3& p, float radius, Fn fn) const
+  {
+    if (order_.empty())
+      return;
+
+    const auto lo = cell_of(p - glm::vec3(radius));
+    const auto hi = cell_of(p + glm::vec3(radius));
+
+    const float radius_squared = radius * radius;
+
+    VisitedBuckets& visited = visited_scratch();
+
+    visited.clear();
+
+    for (int z = lo.z; z <= hi.z; z++) {
+      for (int y = lo.y; y <= hi.y; y++) {
+        for (int x = lo.x; x <= hi.x; x++) {
+
+          const size_t bucket = bucket_of(glm::ivec3(x, y, z));
+
+          if (!visited.insert(bucket))
+            continue;
+
+          for (uint32_t i = offsets_[bucket]; i < offsets_[bucket + 1]; i++) {
+
+            const uint32_t index = order_[i];
+
+            const auto delta = position(index) - p;
+
+            const float d2 = glm::dot(delta, delta);
+
+            if (d2 <= radius_squared && !fn(index, d2))
+              return;
+          }
+        }
+      }
+    }
+  }
+
+  /** @brief Finds the nearest points to a position.
+   *
+   * @details The search visits shells of cells around the position, growing outward until the nearest @p k points
+   *          are known to have been found or @p max_rings shells have been visited.
+   *
+   * @param p The position to search around.
+   *
+   * @param k The maximum number of neighbors to find.
+   *
+   * @param exclude A point index to leave out of the results, usually the index of the query point itself.
+   *                Pass UINT32_MAX to not exclude any point.
+   *
+   * @param max_rings The maximum number of cell shells to visit beyond the cell containing @p p.
+   *
+   * @param out The neighbors, sorted by distance. The previous contents are discarded.
+   * */
+  void find_nearest(const glm::vec3& p, size_t k, uint32_t exclude, int max_rings, std::vector<Neighbor>& out) const;
+
+  /** @brief Finds the single nearest point within a maximum distance.
+   *
+   * @return True if a point was found, false otherwise.
+   * */
+  bool find_nearest_one(const glm::vec3& p, float max_distance, Neighbor& out) const;
+
+private:
+  static VisitedBuckets& visited_scratch();
+
+  void search(const glm::vec3& p,
+              size_t k,
+              uint32_t exclude,
+              int max_rings,
+              float max_distance_squared,
+              std::vector<Neighbor>& heap) const;
+
+private:
+  const dataviz_vertex_z* points_ = nullptr;
+
+  float cell_size_ = 1;
+
+  float inv_cell_size_ = 1;
+
+  size_t mask_ = 0;
+
+  std::vector<uint32_t> offsets_;
+
+  std::vector<uint32_t> order_;
+};
+
+} // namespace datviz_detail
@@ -0,0 +1,806 @@
+#include "datviz_io.h"
+
+#include "datviz.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define DATVIZ_POSIX_IO 1
+#endif
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define DATVIZ_IO_URING 1
+#endif
+#endif
+
+using namespace datviz_detail;
+
+//===========//
+// Constants //
+//===========//
+
+namespace {
+
+/// The alignment of the buffers, offsets and sizes of direct reads, which covers the sectors of any common device.
+constexpr size_t g_direct_alignment = 4096;
+
+/// The most threads that read a file when io_uring is not available. More than this rarely helps a single device.
+constexpr uint32_t g_max_read_threads = 8;
+
+constexpr uint32_t g_max_queue_depth = 256;
+
+} // namespace
+
+#if defined(DATVIZ_POSIX_IO)
+
+//======//
+// File //
+//======//
+
+namespace {
+
+/** @brief A file that is open for reading at any offset.
+ * */
+class File final
+{
+public:
+  File() = default;
+
+  ~File()
+  {
+    if (fd_ >= 0)
+      close(fd_);
+  }
+
+  File(const File&) = delete;
+
+  File& operator=(const File&) = delete;
+
+  /** @brief Opens a file, past the page cache if asked to and if the file system supports it.
+   * */
+  bool open(const char* path, bool direct)
+  {
+#if defined(O_DIRECT)
+    // File systems such as tmpfs refuse direct reads, in which case the file is read through the page cache.
+    if (direct) {
+      fd_ = ::open(path, O_RDONLY | O_CLOEXEC | O_DIRECT);
+      direct_ = fd_ >= 0;
+    }
+#else
+    (void)direct;
+#endif
+
+    if (fd_ < 0)
+      fd_ = ::open(path, O_RDONLY | O_CLOEXEC);
+
+    struct stat info;
+
+    if ((fd_ < 0) || (fstat(fd_, &info) != 0))
+      return false;
+
+    size_ = uint64_t(info.st_size);
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+    if (!direct_)
+      posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    return true;
+  }
+
+  int fd() const { return fd_; }
+
+  uint64_t size() const { return size_; }
+
+  bool direct() const { return direct_; }
+
+  /** @brief Reads until the buffer is full or the file ends, retrying reads that were interrupted or came up short.
+   *
+   * @return The number of bytes read, or -1 on failure.
+   * */
+  int64_t read_at(unsigned char* data, size_t size, uint64_t offset) const
+  {
+    size_t total = 0;
+
+    while ((total < size) && ((offset + total) < size_)) {
+
+      const ssize_t n = pread(fd_, data + total, size - total, off_t(offset + total));
+
+      if ((n < 0) && (errno == EINTR))
+        continue;
+
+      if (n < 0)
+        return -1;
+
+      if (n == 0)
+        break;
+
+      total += size_t(n);
+    }
+
+    return int64_t(total);
+  }
+
+private:
+  int fd_ = -1;
+
+  uint64_t size_ = 0;
+
+  bool direct_ = false;
+};
+
+/** @brief The buffers of the reads in flight, allocated together and aligned for direct reads.
+ * */
+class BlockBuffers final
+{
+public:
+  BlockBuffers() = default;
+
+  ~BlockBuffers() { free(data_); }
+
+  BlockBuffers(const BlockBuffers&) = delete;
+
+  BlockBuffers& operator=(const BlockBuffers&) = delete;
+
+  bool allocate(size_t block_size, uint32_t count)
+  {
+    block_size_ = block_size;
+
+    void* data = nullptr;
+
+    if (posix_memalign(&data, g_direct_alignment, block_size * count) != 0)
+      return false;
+
+    data_ = static_cast<unsigned char*>(data);
+
+    return true;
+  }
+
+  unsigned char* block(size_t index) { return data_ + (index * block_size_); }
+
+  /** @brief Gives up the buffers without freeing them, for when the kernel may still be writing to them.
+   * */
+  void abandon() { data_ = nullptr; }
+
+private:
+  unsigned char* data_ = nullptr;
+
+  size_t block_size_ = 0;
+};
+
+/** @brief Where each block of a file lies, and how much of it is read at a time.
+ * */
+struct BlockLayout final
+{
+  BlockLayout(uint64_t size, size_t block, bool direct_reads)
+    : file_size(size)
+    , block_size(block)
+    , block_count((size + block - 1) / block)
+    , direct(direct_reads)
+  {
+  }
+
+  uint64_t offset(uint64_t block) const { return block * block_size; }
+
+  /// The bytes of the file that are in a block, which is less than the block size for the last one.
+  size_t length(uint64_t block) const { return size_t(std::min<uint64_t>(block_size, file_size - offset(block))); }
+
+  /// Direct reads must span whole sectors, so they ask for the whole block and come up short at the end of the file.
+  size_t request(uint64_t block) const { return direct ? block_size : length(block); }
+
+  uint64_t file_size;
+
+  size_t block_size;
+
+  uint64_t block_count;
+
+  bool direct;
+};
+
+} // namespace
+
+//==========//
+// io_uring //
+//==========//
+
+#if defined(DATVIZ_IO_URING)
+
+namespace {
+
+/** @brief A submission and completion queue that are shared with the kernel.
+ *
+ * @details This talks to the kernel through the system calls and the mapped rings directly, rather than through
+ *          liburing, so that it adds no dependency. Only the calls that reading needs are here.
+ * */
+class Ring final
+{
+public:
+  Ring() = default;
+
+  ~Ring()
+  {
+    if (sqes_)
+      munmap(sqes_, sqes_size_);
+
+    if (cq_ring_ && (cq_ring_ != sq_ring_))
+      munmap(cq_ring_, cq_ring_size_);
+
+    if (sq_ring_)
+      munmap(sq_ring_, sq_ring_size_);
+
+    if (fd_ >= 0)
+      close(fd_);
+  }
+
+  Ring(const Ring&) = delete;
+
+  Ring& operator=(const Ring&) = delete;
+
+  /** @brief Sets up a ring with room for a number of submissions.
+   *
+   * @return False if the kernel does not support io_uring, or does not allow this process to use it.
+   * */
+  bool init(uint32_t entries)
+  {
+    io_uring_params params;
+
+    memset(&params, 0, sizeof(params));
+
+    fd_ = int(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd_ < 0)
+      return false;
+
+    sq_ring_size_ = params.sq_off.array + (params.sq_entries * sizeof(uint32_t));
+
+    cq_ring_size_ = params.cq_off.cqes + (params.cq_entries * sizeof(io_uring_cqe));
+
+    bool single_mmap = false;
+
+#if defined(IORING_FEAT_SINGLE_MMAP)
+    single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+#endif
+
+    if (single_mmap)
+      sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+
+    sq_ring_ = map(sq_ring_size_, IORING_OFF_SQ_RING);
+    if (!sq_ring_)
+      return false;
+
+    cq_ring_ = single_mmap ? sq_ring_ : map(cq_ring_size_, IORING_OFF_CQ_RING);
+    if (!cq_ring_)
+      return false;
+
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+
+    sqes_ = static_cast<io_uring_sqe*>(map(sqes_size_, IORING_OFF_SQES));
+    if (!sqes_)
+      return false;
+
+    sq_entries_ = params.sq_entries;
+    sq_head_ = field(sq_ring_, params.sq_off.head);
+    sq_tail_ = field(sq_ring_, params.sq_off.tail);
+    sq_mask_ = *field(sq_ring_, params.sq_off.ring_mask);
+    sq_array_ = field(sq_ring_, params.sq_off.array);
+
+    cq_head_ = field(cq_ring_, params.cq_off.head);
+    cq_tail_ = field(cq_ring_, params.cq_off.tail);
+    cq_mask_ = *field(cq_ring_, params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(static_cast<unsigned char*>(cq_ring_) + params.cq_off.cqes);
+
+    return true;
+  }
+
+  /** @brief Queues a read, which the kernel only sees once @ref enter is called.
+   *
+   * @param vector The buffer to read into. It must stay valid until the read completes.
+   * */
+  bool queue_read(int fd, const iovec* vector, uint64_t offset, uint64_t user_data)
+  {
+    const uint32_t tail = *sq_tail_;
+
+    if ((tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE)) >= sq_entries_)
+      return false;
+
+    const uint32_t index = tail & sq_mask_;
+
+    io_uring_sqe& sqe = sqes_[index];
+
+    memset(&sqe, 0, sizeof(sqe));
+
+    // Vectored reads are the oldest read that io_uring has, so they work on every kernel that has io_uring at all.
+    sqe.opcode = IORING_OP_READV;
+    sqe.fd = fd;
+    sqe.addr = uint64_t(reinterpret_cast<uintptr_t>(vector));
+    sqe.len = 1;
+    sqe.off = offset;
+    sqe.user_data = user_data;
+
+    sq_array_[index] = index;
+
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+    queued_++;
+
+    return true;
+  }
+
+  /** @brief Hands the queued reads to the kernel, and waits for a number of reads to complete.
+   * */
+  bool enter(uint32_t min_complete)
+  {
+    for (;;) {
+
+      const uint32_t flags = (min_complete > 0) ? IORING_ENTER_GETEVENTS : 0;
+
+      const long n = syscall(__NR_io_uring_enter, fd_, queued_, min_complete, flags, nullptr, 0);
+
+      if (n >= 0) {
+        queued_ -= std::min(queued_, uint32_t(n));
+        return true;
+      }
+
+      if ((errno != EINTR) && (errno != EAGAIN) && (errno != EBUSY))
+        return false;
+    }
+  }
+
+  /** @brief Takes the next completed read, if there is one.
+   * */
+  bool pop_completion(uint64_t& user_data, int32_t& result)
+  {
+    const uint32_t head = *cq_head_;
+
+    if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+      return false;
+
+    const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+
+    user_data = cqe.user_data;
+    result = cqe.res;
+
+    __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+
+    return true;
+  }
+
+private:
+  void* map(size_t size, off_t offset) const
+  {
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, offset);
+
+    return (p == MAP_FAILED) ? nullptr : p;
+  }
+
+  static uint32_t* field(void* ring, uint32_t offset)
+  {
+    return reinterpret_cast<uint32_t*>(static_cast<unsigned char*>(ring) + offset);
+  }
+
+  int fd_ = -1;
+
+  void* sq_ring_ = nullptr;
+
+  void* cq_ring_ = nullptr;
+
+  io_uring_sqe* sqes_ = nullptr;
+
+  size_t sq_ring_size_ = 0;
+
+  size_t cq_ring_size_ = 0;
+
+  size_t sqes_size_ = 0;
+
+  uint32_t sq_entries_ = 0;
+
+  uint32_t* sq_head_ = nullptr;
+
+  uint32_t* sq_tail_ = nullptr;
+
+  uint32_t sq_mask_ = 0;
+
+  uint32_t* sq_array_ = nullptr;
+
+  uint32_t* cq_head_ = nullptr;
+
+  uint32_t* cq_tail_ = nullptr;
+
+  uint32_t cq_mask_ = 0;
+
+  io_uring_cqe* cqes_ = nullptr;
+
+  uint32_t queued_ = 0;
+};
+
+/** @brief Streams a file through an io_uring.
+ *
+ * @details Each buffer always holds the block that is a whole queue ahead of the last one that it held, so blocks are
+ *          handed to the callback in order while the reads after them are already in flight.
+ *
+ * @param ring_ready Set to false if the ring could not be set up, in which case nothing was read.
+ * */
+bool
+stream_io_uring(const File& file,
+                const BlockLayout& layout,
+                uint32_t depth,
+                BlockBuffers& buffers,
+                const BlockCallback& callback,
+                bool& ring_ready)
+{
+  Ring ring;
+
+  ring_ready = ring.init(depth);
+  if (!ring_ready)
+    return false;
+
+  struct Slot final
+  {
+    iovec vector;
+
+    int32_t result;
+
+    bool done;
+  };
+
+  std::vector<Slot> slots(depth);
+
+  uint64_t next_read = 0;
+
+  uint32_t in_flight = 0;
+
+  auto queue = [&](uint64_t block) {
+    Slot& slot = slots[block % depth];
+    slot.vector.iov_base = buffers.block(block % depth);
+    slot.vector.iov_len = layout.request(block);
+    slot.done = false;
+    if (!ring.queue_read(file.fd(), &slot.vector, layout.offset(block), block))
+      return false;
+    in_flight++;
+    return true;
+  };
+
+  bool success = true;
+
+  while (success && (next_read < layout.block_count) && (next_read < depth))
+    success = queue(next_read++);
+
+  success = success && ring.enter(0);
+
+  for (uint64_t block = 0; success && (block < layout.block_count); block++) {
+
+    Slot& slot = slots[block % depth];
+
+    while (success && !slot.done) {
+
+      uint64_t completed = 0;
+
+      int32_t result = 0;
+
+      if (!ring.pop_completion(completed, result)) {
+        success = ring.enter(1);
+        continue;
+      }
+
+      slots[completed % depth].result = result;
+      slots[completed % depth].done = true;
+      in_flight--;
+    }
+
+    if (!success)
+      break;
+
+    const size_t length = layout.length(block);
+
+    unsigned char* data = buffers.block(block % depth);
+
+    // A read that comes up short, such as one that a signal cut off, is finished without the ring. Direct reads must
+    // start on a sector, so the rest is read from the start of the sector that the short read ended in.
+    size_t read = (slot.result > 0) ? size_t(slot.result) : 0;
+
+    if ((slot.result >= 0) && (read < length)) {
+
+      const size_t resume = layout.direct ? ((read / g_direct_alignment) * g_direct_alignment) : read;
+
+      const int64_t rest =
+        file.read_at(data + resume, layout.request(block) - resume, layout.offset(block) + resume);
+
+      read = (rest >= 0) ? (resume + size_t(rest)) : read;
+    }
+
+    success = (read >= length) && callback(data, length, layout.offset(block));
+
+    if (success && (next_read < layout.block_count))
+      success = queue(next_read++) && ring.enter(0);
+  }
+
+  // The kernel may still write to the buffers of reads in flight, so they are waited for before the buffers go away.
+  while (in_flight > 0) {
+
+    uint64_t completed = 0;
+
+    int32_t result = 0;
+
+    if (ring.pop_completion(completed, result))
+      in_flight--;
+    else if (!ring.enter(1))
+      break;
+  }
+
+  // Interrupted waits are retried by the ring, so this is only reached if the kernel refuses to wait at all. The ring is
+  // closed on return, which cancels the reads, but they may not be done by then, so their buffers are never freed.
+  if (in_flight > 0)
+    buffers.abandon();
+
+  return success && (in_flight == 0);
+}
+
+} // namespace
+
+#endif
+
+//=======//
+// pread //
+//=======//
+
+namespace {
+
+/** @brief Streams a file through threads that each wait on a blocking read.
+ *
+ * @details The threads are started for the stream, rather than taken from the executor of the library, since they
+ *          spend their time waiting on the device and would hold up the CPU work that the executor is meant for.
+ * */
+bool
+stream_pread(const File& file,
+             const BlockLayout& layout,
+             uint32_t depth,
+             BlockBuffers& buffers,
+             const BlockCallback& callback)
+{
+  struct Slot final
+  {
+    int64_t result = 0;
+
+    bool ready = false;
+  };
+
+  std::vector<Slot> slots(depth);
+
+  std::mutex mutex;
+
+  std::condition_variable slot_freed;
+
+  std::condition_variable slot_ready;
+
+  uint64_t consumed = 0;
+
+  bool cancelled = false;
+
+  std::atomic<uint64_t> next_block{ 0 };
+
+  auto reader = [&]() {
+    for (;;) {
+
+      const uint64_t block = next_block.fetch_add(1);
+      if (block >= layout.block_count)
+        break;
+
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        slot_freed.wait(lock, [&]() { return cancelled || (block < (consumed + depth)); });
+        if (cancelled)
+          break;
+      }
+
+      const int64_t result =
+        file.read_at(buffers.block(block % depth), layout.request(block), layout.offset(block));
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        slots[block % depth].result = result;
+        slots[block % depth].ready = true;
+      }
+
+      slot_ready.notify_all();
+    }
+  };
+
+  const size_t reader_count = size_t(std::min<uint64_t>(std::min(depth, g_max_read_threads), layout.block_count));
+
+  std::vector<std::thread> readers;
+
+  for (size_t i = 0; i < reader_count; i++)
+    readers.emplace_back(reader);
+
+  bool success = true;
+
+  for (uint64_t block = 0; block < layout.block_count; block++) {
+
+    Slot& slot = slots[block % depth];
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      slot_ready.wait(lock, [&]() { return slot.ready; });
+    }
+
+    const size_t length = layout.length(block);
+
+    success = (slot.result >= int64_t(length)) && callback(buffers.block(block % depth), length, layout.offset(block));
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      slot.ready = false;
+      consumed++;
+      cancelled = !success;
+    }
+
+    slot_freed.notify_all();
+
+    if (!success)
+      break;
+  }
+
+  for (auto& r : readers)
+    r.join();
+
+  return success;
+}
+
+} // namespace
+
+#endif
+
+//===========//
+// Streaming //
+//===========//
+
+namespace datviz_detail {
+
+bool
+stream_file(const char* path, const StreamOptions& options, const BlockCallback& callback, IOBackend* backend)
+{
+  assert(path != nullptr);
+
+  const uint32_t depth = std::min(std::max<uint32_t>(options.queue_depth, 1), g_max_queue_depth);
+
+  // Every block size is rounded up to whole sectors, so that the offsets of direct reads stay aligned.
+  const size_t block_size = std::max<size_t>(
+    ((options.block_size + g_direct_alignment - 1) / g_direct_alignment) * g_direct_alignment, g_direct_alignment);
+
+#if defined(DATVIZ_POSIX_IO)
+  File file;
+
+  if (!file.open(path, options.direct))
+    return false;
+
+  const BlockLayout layout(file.size(), block_size, file.direct());
+
+  BlockBuffers buffers;
+
+  if (!buffers.allocate(block_size, depth))
+    return false;
+
+#if defined(DATVIZ_IO_URING)
+  if (options.allow_io_uring) {
+
+    bool ring_ready = false;
+
+    const bool success = stream_io_uring(file, layout, depth, buffers, callback, ring_ready);
+
+    if (ring_ready) {
+      if (backend)
+        *backend = IOBackend::io_uring;
+      return success;
+    }
+  }
+#endif
+
+  if (backend)
+    *backend = IOBackend::pread;
+
+  return stream_pread(file, layout, depth, buffers, callback);
+#else
+  FILE* file = fopen(path, "rb");
+  if (!file)
+    return false;
+
+  if (backend)
+    *backend = IOBackend::stdio;
+
+  std::vector<unsigned char> block(block_size);
+
+  uint64_t offset = 0;
+
+  bool success = true;
+
+  for (;;) {
+
+    const size_t n = fread(block.data(), 1, block.size(), file);
+
+    if (n > 0)
+      success = callback(block.data(), n, offset);
+
+    offset += n;
+
+    if (!success || (n < block.size()))
+      break;
+  }
+
+  success = success && !ferror(file);
+
+  fclose(file);
+
+  return success;
+#endif
+}
+
+bool
+read_file(const char* path, std::vector<unsigned char>& data)
+{
+  data.clear();
+
+#if defined(DATVIZ_POSIX_IO)
+  struct stat info;
+
+  if (stat(path, &info) == 0)
+    data.reserve(size_t(info.st_size));
+#endif
+
+  return stream_file(path, StreamOptions(), [&data](const unsigned char* block, size_t size, uint64_t) {
+    data.insert(data.end(), block, block + size);
+    return true;
+  });
+}
+
+} // namespace datviz_detail
+
+//============//
+// Public API //
+//============//
+
+int
+datviz_stream_file(const char* path,
+                   uint32_t block_size,
+                   uint32_t queue_depth,
+                   int flags,
+                   datviz_stream_callback callback,
+                   void* user_data)
+{
+  assert(path != nullptr);
+  assert(callback != nullptr);
+
+  StreamOptions options;
+
+  if (block_size > 0)
+    options.block_size = block_size;
+
+  if (queue_depth > 0)
+    options.queue_depth = queue_depth;
+
+  options.direct = (flags & DATVIZ_STREAM_DIRECT) != 0;
+  options.allow_io_uring = (flags & DATVIZ_STREAM_NO_IO_URING) == 0;
+
+  const bool success = stream_file(path, options, [&](const unsigned char* data, size_t size, uint64_t offset) {
+    return callback(user_data, data, uint64_t(size), offset) == 0;
+  });
+
+  return success ? 0 : -1;
+}
@@ -0,0 +1,68 @@
+/// @file datviz_io.h
+///
+/// @brief Internal helpers for reading large files with many reads in flight.
+
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace datviz_detail {
+
+/** @brief The ways that a file can be read.
+ * */
+enum class IOBackend
+{
+  /// Reads are queued on an io_uring, and the kernel works through them without a thread for each.
+  io_uring,
+  /// A few threads each wait on a blocking pread.
+  pread,
+  /// A single stdio stream, where neither of the others are available.
+  stdio
+};
+
+struct StreamOptions final
+{
+  /// The size of each read, which is rounded up to the alignment that direct reads need.
+  size_t block_size = size_t(4) << 20;
+
+  /// The number of reads that are kept in flight, each with a buffer of its own.
+  uint32_t queue_depth = 16;
+
+  /// Reads past the page cache, where the file system allows it, so that a large scan does not evict everything else.
+  bool direct = false;
+
+  /// Whether io_uring may be used. When it cannot be set up, such as when the kernel or a sandbox does not allow it,
+  /// the pread threads are used instead.
+  bool allow_io_uring = true;
+};
+
+/** @brief Receives the blocks of a file, in the order of the file.
+ *
+ * @details The data is only valid until the callback returns, since its buffer is reused for a later read.
+ *
+ * @return True to keep reading, false to stop.
+ * */
+using BlockCallback = std::function<bool(const unsigned char* data, size_t size, uint64_t offset)>;
+
+/** @brief Reads a file from start to end, keeping the queue of reads full while the blocks are handed to a callback.
+ *
+ * @param backend Set to the way that the file was read. May be null.
+ *
+ * @return True if every block was read and the callback never stopped the stream.
+ * */
+bool
+stream_file(const char* path,
+            const StreamOptions& options,
+            const BlockCallback& callback,
+            IOBackend* backend = nullptr);
+
+/** @brief Reads all of a file into memory, through @ref stream_file.
+ * */
+bool
+read_file(const char* path, std::vector<unsigned char>& data);
+
+} // namespace datviz_detail
@@ -0,0 +1,328 @@
+#include "datviz.h"
+
+#include "datviz_grid.h"
+#include "datviz_parallel.h"
+#include "datviz_perf.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <assert.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define DATVIZ_HAVE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+using namespace datviz_detail;
+
+//===========//
+// Constants //
+//===========//
+
+namespace {
+
+constexpr size_t g_grain = 4096;
+
+constexpr int g_max_search_rings = 8;
+
+} // namespace
+
+//============//
+// Covariance //
+//============//
+
+namespace {
+
+/** @brief The six unique entries of a symmetric 3x3 matrix.
+ * */
+struct SymmetricMatrix final
+{
+  float xx = 0;
+  float xy = 0;
+  float xz = 0;
+  float yy = 0;
+  float yz = 0;
+  float zz = 0;
+};
+
+/** @brief Computes the covariance of a point and its neighbors.
+ *
+ * @details The positions are taken relative to the query point, which keeps the single pass sums accurate for clouds
+ *          that are far from the origin. With SSE, the mean and the six products are accumulated four lanes at a time.
+ * */
+SymmetricMatrix
+compute_covariance(const PointGrid& grid, const glm::vec3& center, const std::vector<Neighbor>& neighbors)
+{
+  const float inv_n = 1.0f / float(neighbors.size() + 1);
+
+  SymmetricMatrix c;
+
+#ifdef DATVIZ_HAVE_SSE
+  const __m128 origin = _mm_setr_ps(center.x, center.y, center.z, 0.0f);
+
+  __m128 sum = _mm_setzero_ps();
+  __m128 products_a = _mm_setzero_ps(); // xx, xy, xz, yy
+  __m128 products_b = _mm_setzero_ps(); // yz, zz, -, -
+
+  for (const auto& n : neighbors) {
+
+    const auto q = grid.position(n.index);
+
+    const __m128 p = _mm_sub_ps(_mm_setr_ps(q.x, q.y, q.z, 0.0f), origin);
+
+    sum = _mm_add_ps(sum, p);
+
+    const __m128 lhs_a = _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 0, 0, 0));
+    const __m128 rhs_a = _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 2, 1, 0));
+    products_a = _mm_add_ps(products_a, _mm_mul_ps(lhs_a, rhs_a));
+
+    const __m128 lhs_b = _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 2, 1));
+    const __m128 rhs_b = _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 2, 2));
+    products_b = _mm_add_ps(products_b, _mm_mul_ps(lhs_b, rhs_b));
+  }
+
+  alignas(16) float m[4];
+  alignas(16) float a[4];
+  alignas(16) float b[4];
+
+  _mm_store_ps(m, _mm_mul_ps(sum, _mm_set1_ps(inv_n)));
+  _mm_store_ps(a, _mm_mul_ps(products_a, _mm_set1_ps(inv_n)));
+  _mm_store_ps(b, _mm_mul_ps(products_b, _mm_set1_ps(inv_n)));
+
+  c.xx = a[0] - (m[0] * m[0]);
+  c.xy = a[1] - (m[0] * m[1]);
+  c.xz = a[2] - (m[0] * m[2]);
+  c.yy = a[3] - (m[1] * m[1]);
+  c.yz = b[0] - (m[1] * m[2]);
+  c.zz = b[1] - (m[2] * m[2]);
+#else
+  glm::vec3 sum(0, 0, 0);
+
+  SymmetricMatrix s;
+
+  for (const auto& n : neighbors) {
+
+    const auto p = grid.position(n.index) - center;
+
+    sum += p;
+
+    s.xx += p.x * p.x;
+    s.xy += p.x * p.y;
+    s.xz += p.x * p.z;
+    s.yy += p.y * p.y;
+    s.yz += p.y * p.z;
+    s.zz += p.z * p.z;
+  }
+
+  const auto m = sum * inv_n;
+
+  c.xx = (s.xx * inv_n) - (m.x * m.x);
+  c.xy = (s.xy * inv_n) - (m.x * m.y);
+  c.xz = (s.xz * inv_n) - (m.x * m.z);
+  c.yy = (s.yy * inv_n) - (m.y * m.y);
+  c.yz = (s.yz * inv_n) - (m.y * m.z);
+  c.zz = (s.zz * inv_n) - (m.z * m.z);
+#endif
+
+  return c;
+}
+
+/** @brief Finds the eigenvector of the smallest eigenvalue of a symmetric 3x3 matrix.
+ *
+ * @details The eigenvalue is found in closed form with the trigonometric solution of the characteristic cubic.
+ *          The eigenvector is the largest cross product of two rows of the shifted matrix, which is more stable than
+ *          picking a fixed pair of rows.
+ * */
+glm::vec3
+smallest_eigenvector(const SymmetricMatrix& a)
+{
+  // Scaling keeps the cubic well conditioned for clouds at any scale.
+  const float scale = std::max({ std::abs(a.xx), std::abs(a.xy), std::abs(a.xz), std::abs(a.yy), std::abs(a.yz),
+                                 std::abs(a.zz), 1.0e-30f });
+
+  const float inv_scale = 1.0f / scale;
+
+  const float xx = a.xx * inv_scale;
+  const float xy = a.xy * inv_scale;
+  const float xz = a.xz * inv_scale;
+  const float yy = a.yy * inv_scale;
+  const float yz = a.yz * inv_scale;
+  const float zz = a.zz * inv_scale;
+
+  const float q = (xx + yy + zz) / 3.0f;
+
+  const float off_diagonal = (xy * xy) + (xz * xz) + (yz * yz);
+
+  const float p2 = ((xx - q) * (xx - q)) + ((yy - q) * (yy - q)) + ((zz - q) * (zz - q)) + (2.0f * off_diagonal);
+
+  const float p = std::sqrt(p2 / 6.0f);
+
+  if (p < 1.0e-12f)
+    return glm::vec3(0, 0, 1); // The neighborhood is isotropic, so any direction is as good as another.
+
+  const float inv_p = 1.0f / p;
+
+  const float bxx = (xx - q) * inv_p;
+  const float byy = (yy - q) * inv_p;
+  const float bzz = (zz - q) * inv_p;
+  const float bxy = xy * inv_p;
+  const float bxz = xz * inv_p;
+  const float byz = yz * inv_p;
+
+  const float det = (bxx * ((byy * bzz) - (byz * byz))) - (bxy * ((bxy * bzz) - (byz * bxz))) +
+                    (bxz * ((bxy * byz) - (byy * bxz)));
+
+  const float r = std::min(std::max(det * 0.5f, -1.0f), 1.0f);
+
+  const float phi = std::acos(r) / 3.0f;
+
+  // The eigenvalues are ordered so that this one is the smallest.
+  const float lambda = q + (2.0f * p * std::cos(phi + (2.0943951f)));
+
+  const glm::vec3 row0(xx - lambda, xy, xz);
+  const glm::vec3 row1(xy, yy - lambda, yz);
+  const glm::vec3 row2(xz, yz, zz - lambda);
+
+  const auto c01 = glm::cross(row0, row1);
+  const auto c02 = glm::cross(row0, row2);
+  const auto c12 = glm::cross(row1, row2);
+
+  const float d01 = glm::dot(c01, c01);
+  const float d02 = glm::dot(c02, c02);
+  const float d12 = glm::dot(c12, c12);
+
+  if ((d01 >= d02) && (d01 >= d12))
+    return c01 / std::sqrt(d01);
+
+  if (d02 >= d12)
+    return c02 / std::sqrt(d02);
+
+  if (d12 > 0)
+    return c12 / std::sqrt(d12);
+
+  return glm::vec3(0, 0, 1);
+}
+
+} // namespace
+
+//===================//
+// Normal Estimation //
+//===================//
+
+int
+datviz_estimate_normals(const dataviz_vertex_z* points,
+                        uint32_t point_count,
+                        uint32_t k,
+                        const float* viewpoint,
+                        float* out_normals)
+{
+  DATVIZ_PERF_SCOPE("estimate_normals");
+
+  assert(out_normals != nullptr);
+
+  if ((point_count == 0) || (k < 2))
+    return -1;
+
+  // Aim for a few times k points per cell, based on the average spacing of the points.
+  glm::vec3 lo(points[0].x, points[0].y, points[0].z);
+  glm::vec3 hi = lo;
+
+  for (uint32_t i = 0; i < point_count; i += std::max<uint32_t>(point_count / 4096, 1)) {
+    const glm::vec3 p(points[i].x, points[i].y, points[i].z);
+    lo = glm::min(lo, p);
+    hi = glm::max(hi, p);
+  }
+
+  const auto extent = glm::max(hi - lo, glm::vec3(1.0e-6f));
+
+  const float cell_size = std::cbrt((extent.x * extent.y * extent.z * float(k)) / float(point_count));
+
+  PointGrid grid;
+
+  grid.build(points, point_count, std::max(cell_size, 1.0e-6f));
+
+  const auto eye = viewpoint ? glm::make_vec3(viewpoint) : glm::vec3(0, 0, 0);
+
+  const auto& order = grid.order();
+
+  parallel_for(point_count, g_grain, [&](size_t begin, size_t end) {
+    std::vector<Neighbor> neighbors;
+
+    for (size_t i = begin; i < end; i++) {
+
+      const uint32_t index = order[i];
+
+      const auto center = grid.position(index);
+
+      grid.find_nearest(center, k, index, g_max_search_rings, neighbors);
+
+      glm::vec3 normal(0, 0, 1);
+
+      if (neighbors.size() >= 2)
+        normal = smallest_eigenvector(compute_covariance(grid, center, neighbors));
+
+      // The sign of an eigenvector is arbitrary, so orient it toward the viewpoint.
+      if (glm::dot(normal, eye - center) < 0)
+        normal = -normal;
+
+      out_normals[(index * 3) + 0] = normal.x;
+      out_normals[(index * 3) + 1] = normal.y;
+      out_normals[(index * 3) + 2] = normal.z;
+    }
+  });
+
+  return 0;
+}
+
+//================//
+// Normal Packing //
+//================//
+
+void
+datviz_pack_normal(const float* normal, int16_t* packed)
+{
+  const float sum = std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]);
+
+  float x = sum > 0 ? normal[0] / sum : 0.0f;
+  float y = sum > 0 ? normal[1] / sum : 0.0f;
+
+  // The lower hemisphere is folded over the diagonals of the octahedron.
+  if (normal[2] < 0) {
+    const float fx = (1.0f - std::abs(y)) * (x >= 0 ? 1.0f : -1.0f);
+    const float fy = (1.0f - std::abs(x)) * (y >= 0 ? 1.0f : -1.0f);
+    x = fx;
+    y = fy;
+  }
+
+  packed[0] = static_cast<int16_t>(std::round(std::min(std::max(x, -1.0f), 1.0f) * 32767.0f));
+  packed[1] = static_cast<int16_t>(std::round(std::min(std::max(y, -1.0f), 1.0f) * 32767.0f));
+}
+
+void
+datviz_make_surfels(const dataviz_vertex_z* points,
+                    const float* normals,
+                    uint32_t point_count,
+                    dataviz_surfel_vertex_z* out_surfels)
+{
+  parallel_for(point_count, 65536, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+
+      auto& s = out_surfels[i];
+
+      s.x = points[i].x;
+      s.y = points[i].y;
+      s.z = points[i].z;
+      s.r = points[i].r;
+      s.g = points[i].g;
+      s.b = points[i].b;
+      s.a = points[i].a;
+
+      datviz_pack_normal(normals + (i * 3), s.normal);
+    }
+  });
+}
@@ -0,0 +1,563 @@
+#include "datviz_parallel.h"
+
+#include "datviz.h"
+#include "datviz_perf.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace datviz_detail;
+
+//=============//
+// Thread Pool //
+//=============//
+
+namespace {
+
+/** @brief A pool of threads that each keep their own queue of tasks, and steal from the others when it runs dry.
+ *
+ * @details Tasks that a worker submits go to the back of its own queue, and it takes them back from the back, which
+ *          keeps nested work on the thread whose cache already holds its data. Idle workers steal from the front of
+ *          the other queues, where the oldest and usually largest tasks are. Tasks from other threads go to a shared
+ *          queue. Each queue has its own lock, so workers only contend when they steal.
+ * */
+class ThreadPool final
+{
+public:
+  explicit ThreadPool(size_t worker_count)
+  {
+    workers_.reserve(worker_count);
+
+    for (size_t i = 0; i < worker_count; i++)
+      workers_.emplace_back(new Worker());
+
+    for (size_t i = 0; i < worker_count; i++)
+      workers_[i]->thread = std::thread([this, i]() { run_worker(i); });
+  }
+
+  /// Runs the tasks that are left, then stops the workers.
+  ~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      stopping_ = true;
+    }
+
+    wake_.notify_all();
+
+    for (auto& w : workers_)
+      w->thread.join();
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /// The number of threads that run tasks, counting the one that submits them.
+  size_t concurrency() const { return workers_.size() + 1; }
+
+  void submit(datviz_task_callback run, void* task)
+  {
+    // A pool for a single thread has no workers, and nothing would ever take the task from a queue.
+    if (workers_.empty()) {
+      run(task);
+      return;
+    }
+
+    if (t_pool == this) {
+      Worker& w = *workers_[t_worker_index];
+      std::lock_guard<std::mutex> lock(w.mutex);
+      w.tasks.push_back(Task{ run, task });
+    } else {
+      std::lock_guard<std::mutex> lock(shared_mutex_);
+      shared_tasks_.push_back(Task{ run, task });
+    }
+
+    pending_.fetch_add(1);
+
+    // The lock orders the count before the check of a worker that is about to sleep, so that no wake up is lost.
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+    }
+
+    wake_.notify_one();
+  }
+
+  static void submit_callback(void* user_data, datviz_task_callback run, void* task)
+  {
+    static_cast<ThreadPool*>(user_data)->submit(run, task);
+  }
+
+private:
+  struct Task final
+  {
+    datviz_task_callback run;
+
+    void* task;
+  };
+
+  struct Worker final
+  {
+    std::mutex mutex;
+
+    std::deque<Task> tasks;
+
+    std::thread thread;
+  };
+
+  bool pop_own(size_t index, Task& task)
+  {
+    Worker& w = *workers_[index];
+    std::lock_guard<std::mutex> lock(w.mutex);
+    if (w.tasks.empty())
+      return false;
+    task = w.tasks.back();
+    w.tasks.pop_back();
+    return true;
+  }
+
+  bool pop_shared(Task& task)
+  {
+    std::lock_guard<std::mutex> lock(shared_mutex_);
+    if (shared_tasks_.empty())
+      return false;
+    task = shared_tasks_.front();
+    shared_tasks_.pop_front();
+    return true;
+  }
+
+  bool steal(size_t index, Task& task)
+  {
+    // Each worker starts looking at its neighbor, so that thieves spread over the queues.
+    for (size_t i = 1; i < workers_.size(); i++) {
+
+      Worker& victim = *workers_[(index + i) % workers_.size()];
+
+      std::lock_guard<std::mutex> lock(victim.mutex);
+
+      if (!victim.tasks.empty()) {
+        task = victim.tasks.front();
+        victim.tasks.pop_front();
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void run_worker(size_t index)
+  {
+    t_pool = this;
+    t_worker_index = index;
+
+    for (;;) {
+
+      Task task{};
+
+      if (pop_own(index, task) || pop_shared(task) || steal(index, task)) {
+        pending_.fetch_sub(1);
+        task.run(task.task);
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(sleep_mutex_);
+
+      wake_.wait(lock, [this]() { return stopping_ || (pending_.load() > 0); });
+
+      if (stopping_ && (pending_.load() == 0))
+        break;
+    }
+
+    t_pool = nullptr;
+  }
+
+  static thread_local ThreadPool* t_pool;
+
+  static thread_local size_t t_worker_index;
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  std::mutex shared_mutex_;
+
+  std::deque<Task> shared_tasks_;
+
+  /// The number of tasks that are queued and not yet taken.
+  std::atomic<size_t> pending_{ 0 };
+
+  std::mutex sleep_mutex_;
+
+  std::condition_variable wake_;
+
+  bool stopping_ = false;
+};
+
+thread_local ThreadPool* ThreadPool::t_pool = nullptr;
+
+thread_local size_t ThreadPool::t_worker_index = 0;
+
+} // namespace
+
+//==========//
+// Executor //
+//==========//
+
+namespace {
+
+/** @brief Holds the executor that the application set, or else the thread pool of the library.
+ * */
+class ExecutorRegistry final
+{
+public:
+  dataviz_executor_z get()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (custom_.submit)
+      return custom_;
+
+    if (!pool_) {
+      const size_t threads = (pool_thread_count_ > 0) ? pool_thread_count_ : hardware_thread_count();
+      pool_.reset(new ThreadPool(threads - 1));
+    }
+
+    return dataviz_executor_z{ &ThreadPool::submit_callback, pool_.get(), uint32_t(pool_->concurrency()) };
+  }
+
+  void set_custom(const dataviz_executor_z* executor)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    custom_ = (executor && executor->submit) ? *executor : dataviz_executor_z{};
+
+    custom_.concurrency = std::max<uint32_t>(custom_.concurrency, 1);
+  }
+
+  void set_pool_thread_count(size_t thread_count)
+  {
+    std::unique_ptr<ThreadPool> pool;
+
+    // The old pool is stopped after the lock is released, since its tasks may look up the executor while it waits for
+    // them to finish.
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pool_thread_count_ = thread_count;
+      pool.swap(pool_);
+    }
+  }
+
+  void release_pool()
+  {
+    std::unique_ptr<ThreadPool> pool;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pool.swap(pool_);
+    }
+  }
+
+private:
+  static size_t hardware_thread_count()
+  {
+    const unsigned int n = std::thread::hardware_concurrency();
+
+    return n > 0 ? n : 1;
+  }
+
+  std::mutex mutex_;
+
+  dataviz_executor_z custom_{};
+
+  size_t pool_thread_count_ = 0;
+
+  std::unique_ptr<ThreadPool> pool_;
+};
+
+ExecutorRegistry&
+executors()
+{
+  static ExecutorRegistry r;
+
+  return r;
+}
+
+} // namespace
+
+//============//
+// Task Group //
+//============//
+
+namespace datviz_detail {
+
+class TaskGroupState final : public std::enable_shared_from_this<TaskGroupState>
+{
+public:
+  explicit TaskGroupState(const dataviz_executor_z& executor)
+    : executor_(executor)
+  {
+  }
+
+  void add(std::function<void()> fn)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queued_.push_back(Task{ std::move(fn), current_perf_region() });
+    }
+
+    executor_.submit(executor_.user_data, &run_callback, new std::shared_ptr<TaskGroupState>(shared_from_this()));
+  }
+
+  void wait()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    for (;;) {
+
+      if (!queued_.empty()) {
+        run_next(lock);
+        continue;
+      }
+
+      if (running_ == 0)
+        break;
+
+      finished_.wait(lock);
+    }
+  }
+
+private:
+  struct Task final
+  {
+    std::function<void()> fn;
+
+    uint32_t region;
+  };
+
+  /** @brief Runs the next queued task, if the waiting thread has not already taken it.
+   * */
+  static void run_callback(void* task)
+  {
+    std::unique_ptr<std::shared_ptr<TaskGroupState>> state(static_cast<std::shared_ptr<TaskGroupState>*>(task));
+
+    TaskGroupState& self = **state;
+
+    std::unique_lock<std::mutex> lock(self.mutex_);
+
+    if (!self.queued_.empty())
+      self.run_next(lock);
+  }
+
+  void run_next(std::unique_lock<std::mutex>& lock)
+  {
+    Task task = std::move(queued_.front());
+
+    queued_.pop_front();
+
+    running_++;
+
+    lock.unlock();
+
+    {
+      const PerfHelperScope scope(task.region);
+      task.fn();
+    }
+
+    lock.lock();
+
+    running_--;
+
+    if ((running_ == 0) && queued_.empty())
+      finished_.notify_all();
+  }
+
+  dataviz_executor_z executor_;
+
+  std::mutex mutex_;
+
+  std::condition_variable finished_;
+
+  std::deque<Task> queued_;
+
+  size_t running_ = 0;
+};
+
+TaskGroup::TaskGroup()
+  : state_(std::make_shared<TaskGroupState>(executors().get()))
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+  wait();
+}
+
+void
+TaskGroup::run(std::function<void()> task)
+{
+  state_->add(std::move(task));
+}
+
+void
+TaskGroup::wait()
+{
+  state_->wait();
+}
+
+} // namespace datviz_detail
+
+//=====================//
+// Parallel Algorithms //
+//=====================//
+
+namespace datviz_detail {
+
+size_t
+thread_count()
+{
+  return executors().get().concurrency;
+}
+
+void
+release_thread_pool()
+{
+  executors().release_pool();
+}
+
+void
+parallel_for(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& fn)
+{
+  if (count == 0)
+    return;
+
+  grain = std::max<size_t>(grain, 1);
+
+  const size_t blocks = block_count(count, grain);
+
+  const size_t threads = std::min(thread_count(), blocks);
+
+  if (threads <= 1) {
+    fn(0, count);
+    return;
+  }
+
+  std::atomic<size_t> next_block{ 0 };
+
+  auto worker = [&]() {
+    for (;;) {
+
+      const size_t block = next_block.fetch_add(1);
+      if (block >= blocks)
+        break;
+
+      const size_t begin = block * grain;
+
+      fn(begin, std::min(begin + grain, count));
+    }
+  };
+
+  TaskGroup helpers;
+
+  for (size_t i = 1; i < threads; i++)
+    helpers.run(worker);
+
+  worker();
+
+  // Helpers that have not started by now find no blocks left, so waiting only lasts as long as the last block.
+  helpers.wait();
+}
+
+void
+parallel_sort_by_key(std::vector<uint32_t>& keys, std::vector<uint32_t>& values)
+{
+  DATVIZ_PERF_SCOPE("radix_sort");
+
+  const size_t count = keys.size();
+
+  const size_t grain = 65536;
+
+  const size_t radix = 256;
+
+  const size_t blocks = block_count(count, grain);
+
+  std::vector<uint32_t> histograms(blocks * radix);
+
+  std::vector<uint32_t> sorted_keys(count);
+
+  std::vector<uint32_t> sorted_values(count);
+
+  // Blocks may be handed out more than one at a time, so each call walks its range in steps of the grain.
+  auto for_each_block = [&](const std::function<void(size_t block, size_t begin, size_t end)>& fn) {
+    parallel_for(count, grain, [&](size_t begin, size_t end) {
+      for (size_t block_begin = begin; block_begin < end; block_begin += grain)
+        fn(block_begin / grain, block_begin, std::min(block_begin + grain, end));
+    });
+  };
+
+  for (uint32_t shift = 0; shift < 32; shift += 8) {
+
+    std::fill(histograms.begin(), histograms.end(), 0);
+
+    for_each_block([&](size_t block, size_t begin, size_t end) {
+      uint32_t* histogram = &histograms[block * radix];
+      for (size_t i = begin; i < end; i++)
+        histogram[(keys[i] >> shift) & 0xff]++;
+    });
+
+    // The offsets are ordered by digit first and block second, which keeps the sort stable.
+    uint32_t sum = 0;
+
+    bool skip = false;
+
+    for (size_t digit = 0; digit < radix; digit++) {
+
+      const uint32_t digit_begin = sum;
+
+      for (size_t block = 0; block < blocks; block++) {
+        const uint32_t n = histograms[(block * radix) + digit];
+        histograms[(block * radix) + digit] = sum;
+        sum += n;
+      }
+
+      if ((sum - digit_begin) == count)
+        skip = true;
+    }
+
+    if (skip)
+      continue;
+
+    for_each_block([&](size_t block, size_t begin, size_t end) {
+      uint32_t* offsets = &histograms[block * radix];
+      for (size_t i = begin; i < end; i++) {
+        const uint32_t out = offsets[(keys[i] >> shift) & 0xff]++;
+        sorted_keys[out] = keys[i];
+        sorted_values[out] = values[i];
+      }
+    });
+
+    keys.swap(sorted_keys);
+
+    values.swap(sorted_values);
+  }
+}
+
+} // namespace datviz_detail
+
+//============//
+// Public API //
+//============//
+
+void
+datviz_set_executor(const dataviz_executor_z* executor)
+{
+  executors().set_custom(executor);
+}
+
+void
+datviz_set_thread_count(uint32_t thread_count)
+{
+  executors().set_pool_thread_count(thread_count);
+}
@@ -0,0 +1,115 @@
+/// @file datviz_parallel.h
+///
+/// @brief Internal helpers for running CPU work across multiple threads.
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace datviz_detail {
+
+/** @brief Gets the number of threads that the parallel helpers will use.
+ *
+ * @return The concurrency of the executor that the application set, or else the size of the thread pool of the
+ *         library, which is the number of hardware threads unless the application set it. Never less than one.
+ * */
+size_t
+thread_count();
+
+/** @brief Stops the threads of the thread pool of the library, if it was started.
+ *
+ * @details The pool is started again the next time that it is needed.
+ * */
+void
+release_thread_pool();
+
+class TaskGroupState;
+
+/** @brief Runs tasks on the executor of the library, and waits for them to finish.
+ *
+ * @details Tasks are queued in the group and the executor is only asked to run the next one, so any task that the
+ *          executor has not started by the time @ref wait is called is run by the waiting thread instead. Tasks are
+ *          measured as part of the performance region that was current when they were added.
+ * */
+class TaskGroup final
+{
+public:
+  TaskGroup();
+
+  /// Waits for the tasks that are left.
+  ~TaskGroup();
+
+  TaskGroup(const TaskGroup&) = delete;
+
+  TaskGroup& operator=(const TaskGroup&) = delete;
+
+  /** @brief Adds a task to the group, and asks the executor to run it.
+   * */
+  void run(std::function<void()> task);
+
+  /** @brief Returns once every task that was added has finished, running the ones that have not started.
+   * */
+  void wait();
+
+private:
+  /// Shared with the tasks that were handed to the executor, which may outlive the group.
+  std::shared_ptr<TaskGroupState> state_;
+};
+
+/** @brief Calls a function over a range of indices, using all available threads.
+ *
+ * @details The range is split into blocks of @p grain indices.
+ *          Threads take blocks until there are none left, so the order in which blocks are processed is unspecified.
+ *          The calling thread participates in the work and the function returns once every block is done. The other
+ *          threads are tasks of a @ref TaskGroup, so calls may be nested inside of the blocks of other calls.
+ *
+ * @param count The number of indices in the range.
+ *
+ * @param grain The number of indices to give a thread at a time.
+ *
+ * @param fn The function to call with the first index and one past the last index of each block.
+ * */
+void
+parallel_for(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& fn);
+
+/** @brief Gets the number of blocks that @ref parallel_for will split a range into.
+ *
+ * @details This is useful for allocating per-block results, such as counts for a prefix sum.
+ * */
+inline size_t
+block_count(size_t count, size_t grain)
+{
+  return (count + grain - 1) / grain;
+}
+
+/** @brief Sorts values by their keys, using all available threads.
+ *
+ * @details This is a stable least significant digit radix sort, eight bits per pass. Each block of the input counts
+ *          its digits first, so that every block can scatter its elements in parallel. Passes where all keys share the
+ *          same digit are skipped, which makes keys with a narrow range cheaper to sort.
+ *
+ * @param keys The keys to sort by. These are sorted along with the values.
+ *
+ * @param values The values to sort, which must be as many as the keys.
+ * */
+void
+parallel_sort_by_key(std::vector<uint32_t>& keys, std::vector<uint32_t>& values);
+
+/** @brief Maps a float to an unsigned integer that sorts in the same order.
+ * */
+inline uint32_t
+orderable_key(float value)
+{
+  uint32_t bits = 0;
+  memcpy(&bits, &value, sizeof(bits));
+  // Negative values sort in reverse, so all of their bits are flipped, while positive ones only need the sign bit.
+  return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+} // namespace datviz_detail
@@ -0,0 +1,486 @@
+#include "datviz_perf.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(DATVIZ_PERF_COUNTERS) && defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define DATVIZ_HARDWARE_COUNTERS 1
+#endif
+
+using namespace datviz_detail;
+
+//===========//
+// Constants //
+//===========//
+
+namespace {
+
+constexpr uint32_t g_max_perf_regions = 64;
+
+/// The number of hardware counters in a group: cycles, instructions, cache misses and branch misses.
+constexpr size_t g_counter_count = 4;
+
+/// The number of values summed for each region: calls, time, and the hardware counters.
+constexpr size_t g_region_value_count = 2 + g_counter_count;
+
+} // namespace
+
+//===============//
+// Counter Group //
+//===============//
+
+namespace {
+
+/** @brief The hardware counters of one thread, opened as a group so that they are always scheduled together.
+ *
+ * @details The counters only count the thread that opened them, and only in user space, which is what a process is
+ *          allowed to count by default.
+ * */
+class CounterGroup final
+{
+public:
+  CounterGroup() { open(); }
+
+  ~CounterGroup() { close(); }
+
+  CounterGroup(const CounterGroup&) = delete;
+
+  CounterGroup& operator=(const CounterGroup&) = delete;
+
+  bool is_open() const { return fds_[0] >= 0; }
+
+  /** @brief Reads the running totals of the counters.
+   *
+   * @details If the kernel had to share the hardware with other groups, the totals are scaled up by the fraction of
+   *          the time that the group was counting.
+   *
+   * @return False if the counters are not open or could not be read, in which case the values are zero.
+   * */
+  bool read(uint64_t* values) const
+  {
+    memset(values, 0, g_counter_count * sizeof(uint64_t));
+
+#if defined(DATVIZ_HARDWARE_COUNTERS)
+    if (!is_open())
+      return false;
+
+    struct GroupReading final
+    {
+      uint64_t count;
+
+      uint64_t time_enabled;
+
+      uint64_t time_running;
+
+      uint64_t values[g_counter_count];
+    };
+
+    GroupReading reading{};
+
+    if (::read(fds_[0], &reading, sizeof(reading)) != ssize_t(sizeof(reading)))
+      return false;
+
+    const double scale = ((reading.time_running > 0) && (reading.time_running < reading.time_enabled))
+                           ? (double(reading.time_enabled) / double(reading.time_running))
+                           : 1.0;
+
+    for (size_t i = 0; i < g_counter_count; i++)
+      values[i] = uint64_t(double(reading.values[i]) * scale);
+
+    return true;
+#else
+    return false;
+#endif
+  }
+
+private:
+  void open()
+  {
+#if defined(DATVIZ_HARDWARE_COUNTERS)
+    const uint64_t events[g_counter_count]{ PERF_COUNT_HW_CPU_CYCLES,
+                                            PERF_COUNT_HW_INSTRUCTIONS,
+                                            PERF_COUNT_HW_CACHE_MISSES,
+                                            PERF_COUNT_HW_BRANCH_MISSES };
+
+    for (size_t i = 0; i < g_counter_count; i++) {
+
+      perf_event_attr attr;
+
+      memset(&attr, 0, sizeof(attr));
+
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.size = sizeof(attr);
+      attr.config = events[i];
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+      const int group = (i == 0) ? -1 : fds_[0];
+
+      fds_[i] = int(syscall(SYS_perf_event_open, &attr, 0, -1, group, PERF_FLAG_FD_CLOEXEC));
+
+      // A group that is missing an event would shift the values of the ones after it, so it is all or nothing.
+      if (fds_[i] < 0) {
+        close();
+        return;
+      }
+    }
+#endif
+  }
+
+  void close()
+  {
+#if defined(DATVIZ_HARDWARE_COUNTERS)
+    for (int& fd : fds_) {
+      if (fd >= 0)
+        ::close(fd);
+      fd = -1;
+    }
+#endif
+  }
+
+  int fds_[g_counter_count]{ -1, -1, -1, -1 };
+};
+
+/** @brief Gets the counters of the calling thread, opening them the first time.
+ * */
+CounterGroup&
+thread_counters()
+{
+  thread_local CounterGroup counters;
+
+  return counters;
+}
+
+thread_local uint32_t t_current_region = g_no_perf_region;
+
+uint64_t
+now_nanoseconds()
+{
+  const auto now = std::chrono::steady_clock::now().time_since_epoch();
+
+  return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+}
+
+} // namespace
+
+//=================//
+// Region Registry //
+//=================//
+
+namespace {
+
+/** @brief Holds the names and the summed counts of every region.
+ *
+ * @details Regions are never removed, so they live in a fixed array and are added to without a lock. Only adding a
+ *          region takes the lock, and the count of regions is published after the name is written.
+ * */
+class RegionRegistry final
+{
+public:
+  uint32_t find(const char* name)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    const uint32_t count = count_.load(std::memory_order_relaxed);
+
+    for (uint32_t i = 0; i < count; i++) {
+      if (regions_[i].name == name)
+        return i;
+    }
+
+    if (count == g_max_perf_regions)
+      return g_no_perf_region;
+
+    regions_[count].name = name;
+
+    count_.store(count + 1, std::memory_order_release);
+
+    return count;
+  }
+
+  void add(uint32_t region, const uint64_t* values)
+  {
+    auto& r = regions_[region];
+
+    for (size_t i = 0; i < g_region_value_count; i++)
+      r.values[i].fetch_add(values[i], std::memory_order_relaxed);
+  }
+
+  uint32_t get(dataviz_perf_counters_z* counters, uint32_t capacity) const
+  {
+    const uint32_t count = count_.load(std::memory_order_acquire);
+
+    for (uint32_t i = 0; (i < count) && (i < capacity) && counters; i++) {
+
+      const auto& r = regions_[i];
+
+      counters[i].name = r.name.c_str();
+      counters[i].calls = r.values[0].load(std::memory_order_relaxed);
+      counters[i].nanoseconds = r.values[1].load(std::memory_order_relaxed);
+      counters[i].cycles = r.values[2].load(std::memory_order_relaxed);
+      counters[i].instructions = r.values[3].load(std::memory_order_relaxed);
+      counters[i].cache_misses = r.values[4].load(std::memory_order_relaxed);
+      counters[i].branch_misses = r.values[5].load(std::memory_order_relaxed);
+    }
+
+    return count;
+  }
+
+  void reset()
+  {
+    const uint32_t count = count_.load(std::memory_order_acquire);
+
+    for (uint32_t i = 0; i < count; i++) {
+      for (auto& value : regions_[i].values)
+        value.store(0, std::memory_order_relaxed);
+    }
+  }
+
+private:
+  struct Region final
+  {
+    std::string name;
+
+    std::atomic<uint64_t> values[g_region_value_count]{};
+  };
+
+  std::mutex mutex_;
+
+  Region regions_[g_max_perf_regions];
+
+  std::atomic<uint32_t> count_{ 0 };
+};
+
+RegionRegistry&
+registry()
+{
+  static RegionRegistry r;
+
+  return r;
+}
+
+#if defined(DATVIZ_PERF_COUNTERS)
+
+/** @brief Writes a string as a JSON string, escaping the characters that JSON does not allow as they are.
+ * */
+void
+write_json_string(FILE* file, const char* s)
+{
+  fputc('"', file);
+
+  for (; *s; s++) {
+
+    const auto c = static_cast<unsigned char>(*s);
+
+    if ((c == '"') || (c == '\\'))
+      fprintf(file, "\\%c", c);
+    else if (c < 0x20)
+      fprintf(file, "\\u%04x", c);
+    else
+      fputc(c, file);
+  }
+
+  fputc('"', file);
+}
+
+#endif
+
+} // namespace
+
+//=============//
+// Perf Scopes //
+//=============//
+
+namespace datviz_detail {
+
+uint32_t
+find_perf_region(const char* name)
+{
+#if defined(DATVIZ_PERF_COUNTERS)
+  return registry().find(name);
+#else
+  (void)name;
+  return g_no_perf_region;
+#endif
+}
+
+uint32_t
+current_perf_region()
+{
+  return t_current_region;
+}
+
+void
+begin_perf_scope(uint32_t region, dataviz_perf_scope_z& scope)
+{
+  scope.region = region;
+  scope.outer_region = t_current_region;
+
+  if (region == g_no_perf_region)
+    return;
+
+  t_current_region = region;
+
+  thread_counters().read(&scope.start[1]);
+
+  // The time is taken last, so that it does not include opening or reading the counters.
+  scope.start[0] = now_nanoseconds();
+}
+
+void
+end_perf_scope(const dataviz_perf_scope_z& scope)
+{
+  if (scope.region == g_no_perf_region)
+    return;
+
+  const uint64_t end_time = now_nanoseconds();
+
+  uint64_t end[g_counter_count];
+
+  const bool counted = thread_counters().read(end);
+
+  uint64_t values[g_region_value_count]{ 1, end_time - scope.start[0] };
+
+  for (size_t i = 0; counted && (i < g_counter_count); i++)
+    values[2 + i] = end[i] - scope.start[1 + i];
+
+  registry().add(scope.region, values);
+
+  t_current_region = scope.outer_region;
+}
+
+void
+begin_perf_helper_scope(uint32_t region, dataviz_perf_scope_z& scope)
+{
+  begin_perf_scope((region == t_current_region) ? g_no_perf_region : region, scope);
+}
+
+void
+end_perf_helper_scope(const dataviz_perf_scope_z& scope)
+{
+  if (scope.region == g_no_perf_region)
+    return;
+
+  uint64_t end[g_counter_count];
+
+  if (thread_counters().read(end)) {
+
+    uint64_t values[g_region_value_count]{};
+
+    for (size_t i = 0; i < g_counter_count; i++)
+      values[2 + i] = end[i] - scope.start[1 + i];
+
+    registry().add(scope.region, values);
+  }
+
+  t_current_region = scope.outer_region;
+}
+
+} // namespace datviz_detail
+
+//============//
+// Public API //
+//============//
+
+int
+datviz_perf_counters_available(void)
+{
+#if defined(DATVIZ_HARDWARE_COUNTERS)
+  return thread_counters().is_open() ? 1 : 0;
+#else
+  return 0;
+#endif
+}
+
+uint32_t
+datviz_perf_region(const char* name)
+{
+  return name ? find_perf_region(name) : g_no_perf_region;
+}
+
+void
+datviz_perf_begin(uint32_t region, dataviz_perf_scope_z* scope)
+{
+  if (scope)
+    begin_perf_scope(region, *scope);
+}
+
+void
+datviz_perf_end(const dataviz_perf_scope_z* scope)
+{
+  if (scope)
+    end_perf_scope(*scope);
+}
+
+uint32_t
+datviz_get_perf_counters(dataviz_perf_counters_z* counters, uint32_t capacity)
+{
+  return registry().get(counters, capacity);
+}
+
+void
+datviz_reset_perf_counters(void)
+{
+  registry().reset();
+}
+
+int
+datviz_write_perf_counters_json(const char* path)
+{
+  assert(path != nullptr);
+
+#if !defined(DATVIZ_PERF_COUNTERS)
+  (void)path;
+  return 0;
+#else
+  dataviz_perf_counters_z counters[g_max_perf_regions];
+
+  const uint32_t count = registry().get(counters, g_max_perf_regions);
+
+  FILE* file = fopen(path, "w");
+  if (!file)
+    return -1;
+
+  const char* available = datviz_perf_counters_available() ? "true" : "false";
+
+  fprintf(file, "{\n  \"hardware_counters\": %s,\n  \"regions\": [", available);
+
+  for (uint32_t i = 0; i < count; i++) {
+
+    const auto& c = counters[i];
+
+    const double ipc = (c.cycles > 0) ? (double(c.instructions) / double(c.cycles)) : 0.0;
+
+    fprintf(file, "%s\n    { \"name\": ", (i > 0) ? "," : "");
+
+    write_json_string(file, c.name);
+
+    fprintf(file,
+            ", \"calls\": %" PRIu64 ", \"nanoseconds\": %" PRIu64 ", \"cycles\": %" PRIu64
+            ", \"instructions\": %" PRIu64 ", \"ipc\": %.3f, \"cache_misses\": %" PRIu64
+            ", \"branch_misses\": %" PRIu64 " }",
+            c.calls,
+            c.nanoseconds,
+            c.cycles,
+            c.instructions,
+            ipc,
+            c.cache_misses,
+            c.branch_misses);
+  }
+
+  fprintf(file, "%s]\n}\n", (count > 0) ? "\n  " : "");
+
+  return (fclose(file) == 0) ? 0 : -1;
+#endif
+}
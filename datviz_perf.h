@@ -0,0 +1,108 @@
+/// @file datviz_perf.h
+///
+/// @brief Internal helpers for measuring regions of CPU work with hardware performance counters.
+
+#pragma once
+
+#include "datviz.h"
+
+#include <stdint.h>
+
+namespace datviz_detail {
+
+/// The region of a thread that is not in any measured region.
+constexpr uint32_t g_no_perf_region = UINT32_MAX;
+
+/** @brief Finds the region with a name, adding it if there is none.
+ *
+ * @return The index of the region, or @ref g_no_perf_region if there is no room for another region.
+ * */
+uint32_t
+find_perf_region(const char* name);
+
+/** @brief Gets the region that the calling thread is currently measuring.
+ *
+ * @details Work that is handed to other threads is measured as part of this region, so that the counts of a region
+ *          cover every thread that worked on it.
+ * */
+uint32_t
+current_perf_region();
+
+/** @brief Starts measuring the calling thread as part of a region.
+ *
+ * @details Each thread opens its own group of counters the first time it is measured. If the counters cannot be
+ *          opened, such as when the kernel does not allow it, only the calls and the time of the region are counted.
+ *          Scopes can be nested, in which case the counts of the inner region are also part of the outer one.
+ * */
+void
+begin_perf_scope(uint32_t region, dataviz_perf_scope_z& scope);
+
+/** @brief Adds the counts since @ref begin_perf_scope to the region of the scope.
+ * */
+void
+end_perf_scope(const dataviz_perf_scope_z& scope);
+
+/** @brief Starts measuring work that the calling thread does for a region that another thread has open.
+ *
+ * @details The calls and the time of a region are those of the thread that opened it, so a helper only adds its
+ *          hardware counters. Nothing is measured if the calling thread already has the region open, such as when the
+ *          thread that waits on some work runs part of it, since its own scope already counts that work.
+ * */
+void
+begin_perf_helper_scope(uint32_t region, dataviz_perf_scope_z& scope);
+
+/** @brief Adds the hardware counts since @ref begin_perf_helper_scope to the region of the scope.
+ * */
+void
+end_perf_helper_scope(const dataviz_perf_scope_z& scope);
+
+/** @brief Measures the calling thread for as long as it is in scope.
+ * */
+class PerfScope final
+{
+public:
+  explicit PerfScope(uint32_t region) { begin_perf_scope(region, scope_); }
+
+  ~PerfScope() { end_perf_scope(scope_); }
+
+  PerfScope(const PerfScope&) = delete;
+
+  PerfScope& operator=(const PerfScope&) = delete;
+
+private:
+  dataviz_perf_scope_z scope_;
+};
+
+/** @brief Measures the work that a helper thread does for another thread's region, for as long as it is in scope.
+ * */
+class PerfHelperScope final
+{
+public:
+  explicit PerfHelperScope(uint32_t region) { begin_perf_helper_scope(region, scope_); }
+
+  ~PerfHelperScope() { end_perf_helper_scope(scope_); }
+
+  PerfHelperScope(const PerfHelperScope&) = delete;
+
+  PerfHelperScope& operator=(const PerfHelperScope&) = delete;
+
+private:
+  dataviz_perf_scope_z scope_;
+};
+
+} // namespace datviz_detail
+
+/** @brief Measures the rest of the enclosing block as a named region.
+ *
+ * @details The region is only looked up once per call site. This expands to nothing unless the library is built with
+ *          performance counters, so it can be left in the hottest paths.
+ * */
+#if defined(DATVIZ_PERF_COUNTERS)
+#define DATVIZ_PERF_CONCAT_(a, b) a##b
+#define DATVIZ_PERF_CONCAT(a, b) DATVIZ_PERF_CONCAT_(a, b)
+#define DATVIZ_PERF_SCOPE(name)                                                                                        \
+  static const uint32_t DATVIZ_PERF_CONCAT(perf_region_, __LINE__) = ::datviz_detail::find_perf_region(name);          \
+  const ::datviz_detail::PerfScope DATVIZ_PERF_CONCAT(perf_scope_, __LINE__)(DATVIZ_PERF_CONCAT(perf_region_, __LINE__))
+#else
+#define DATVIZ_PERF_SCOPE(name)
+#endif
@@ -0,0 +1,536 @@
+#include "datviz.h"
+
+#include "datviz_filter.h"
+#include "datviz_parallel.h"
+#include "datviz_perf.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <assert.h>
+#include <string.h>
+
+using namespace datviz_detail;
+
+//===========//
+// Constants //
+//===========//
+
+namespace {
+
+constexpr uint32_t g_default_chunk_size = 65536;
+
+/// The number of finished chunks that may wait for the consumer, per worker thread.
+constexpr size_t g_slots_per_thread = 2;
+
+} // namespace
+
+//========//
+// Stages //
+//========//
+
+namespace {
+
+glm::vec3
+position_of(const dataviz_vertex_z& v)
+{
+  return glm::vec3(v.x, v.y, v.z);
+}
+
+/** @brief A step in the pipeline that only looks at one point at a time.
+ *
+ * @details Since a stage never needs to see other points, stages can run one after another on a chunk while it is
+ *          still in cache, and no stage needs its own output array.
+ * */
+class Stage
+{
+public:
+  virtual ~Stage() = default;
+
+  /** @brief Processes a chunk of points in place.
+   *
+   * @param points The points to process. Points that are removed are compacted out of the chunk.
+   *
+   * @param first_index The index of the first point of the chunk within the whole input.
+   *
+   * @return The number of points that remain in the chunk.
+   * */
+  virtual size_t process(dataviz_vertex_z* points, size_t count, size_t first_index) const = 0;
+};
+
+template<typename Predicate>
+size_t
+remove_if_not(dataviz_vertex_z* points, size_t count, Predicate predicate)
+{
+  size_t out = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    if (predicate(points[i], i))
+      points[out++] = points[i];
+  }
+
+  return out;
+}
+
+class CropBoxStage final : public Stage
+{
+public:
+  CropBoxStage(const float* box_min, const float* box_max, const float* box_transform, bool invert)
+    : box_(box_min, box_max, box_transform)
+    , invert_(invert)
+  {
+  }
+
+  size_t process(dataviz_vertex_z* points, size_t count, size_t) const override
+  {
+    return remove_if_not(points, count, [this](const dataviz_vertex_z& p, size_t) {
+      return box_.contains(position_of(p)) != invert_;
+    });
+  }
+
+private:
+  CropBox box_;
+
+  bool invert_ = false;
+};
+
+class CropPolygonStage final : public Stage
+{
+public:
+  CropPolygonStage(const float* polygon_xy, uint32_t polygon_size, float z_min, float z_max, bool invert)
+    : polygon_(polygon_xy, polygon_size, z_min, z_max)
+    , invert_(invert)
+  {
+  }
+
+  size_t process(dataviz_vertex_z* points, size_t count, size_t) const override
+  {
+    return remove_if_not(points, count, [this](const dataviz_vertex_z& p, size_t) {
+      return polygon_.contains(position_of(p)) != invert_;
+    });
+  }
+
+private:
+  CropPolygon polygon_;
+
+  bool invert_ = false;
+};
+
+class TransformStage final : public Stage
+{
+public:
+  explicit TransformStage(const float* transform)
+    : transform_(glm::make_mat4x4(transform))
+  {
+  }
+
+  size_t process(dataviz_vertex_z* points, size_t count, size_t) const override
+  {
+    for (size_t i = 0; i < count; i++) {
+      const auto p = transform_ * glm::vec4(position_of(points[i]), 1.0f);
+      points[i].x = p.x;
+      points[i].y = p.y;
+      points[i].z = p.z;
+    }
+
+    return count;
+  }
+
+private:
+  glm::mat4 transform_;
+};
+
+/** @brief Keeps a random fraction of the points.
+ *
+ * @details The decision for each point is made from a hash of its index in the input, so the result does not depend
+ *          on how the input was split into chunks or on the order that the chunks were processed in.
+ * */
+class SubsampleStage final : public Stage
+{
+public:
+  explicit SubsampleStage(float keep_fraction)
+    : threshold_(static_cast<uint32_t>(std::min(std::max(keep_fraction, 0.0f), 1.0f) * 4294967295.0))
+  {
+  }
+
+  size_t process(dataviz_vertex_z* points, size_t count, size_t first_index) const override
+  {
+    return remove_if_not(points, count, [this, first_index](const dataviz_vertex_z&, size_t i) {
+      return hash(uint32_t(first_index + i)) <= threshold_;
+    });
+  }
+
+private:
+  static uint32_t hash(uint32_t x)
+  {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+  }
+
+private:
+  uint32_t threshold_ = 0;
+};
+
+/** @brief Colors points with a gradient along an axis.
+ * */
+class ColorizeAxisStage final : public Stage
+{
+public:
+  ColorizeAxisStage(int axis, float min, float max, const unsigned char* low_rgba, const unsigned char* high_rgba)
+    : axis_(axis)
+    , min_(min)
+    , scale_(max > min ? 1.0f / (max - min) : 0.0f)
+  {
+    memcpy(low_, low_rgba, 4);
+    memcpy(high_, high_rgba, 4);
+  }
+
+  size_t process(dataviz_vertex_z* points, size_t count, size_t) const override
+  {
+    for (size_t i = 0; i < count; i++) {
+
+      const float value = (&points[i].x)[axis_];
+
+      const float t = std::min(std::max((value - min_) * scale_, 0.0f), 1.0f);
+
+      points[i].r = mix(low_[0], high_[0], t);
+      points[i].g = mix(low_[1], high_[1], t);
+      points[i].b = mix(low_[2], high_[2], t);
+      points[i].a = mix(low_[3], high_[3], t);
+    }
+
+    return count;
+  }
+
+private:
+  static unsigned char mix(unsigned char a, unsigned char b, float t)
+  {
+    return static_cast<unsigned char>(float(a) + ((float(b) - float(a)) * t) + 0.5f);
+  }
+
+private:
+  int axis_ = 2;
+
+  float min_ = 0;
+
+  float scale_ = 0;
+
+  unsigned char low_[4]{};
+
+  unsigned char high_[4]{};
+};
+
+} // namespace
+
+//==========//
+// Pipeline //
+//==========//
+
+namespace {
+
+/** @brief Receives processed chunks, in the order of the input.
+ * */
+using ChunkSink = std::function<bool(const dataviz_vertex_z* points, size_t count)>;
+
+class Pipeline final
+{
+public:
+  template<typename StageType, typename... Args>
+  void add_stage(Args... args)
+  {
+    stages_.emplace_back(new StageType(args...));
+  }
+
+  void set_chunk_size(uint32_t chunk_size) { chunk_size_ = std::max<uint32_t>(chunk_size, 1); }
+
+  /** @brief Runs the stages over the input, one chunk at a time.
+   *
+   * @details Worker tasks each take the next unprocessed chunk, copy it into a slot and run every stage on it.
+   *          The calling thread hands the finished slots to the sink in input order, which is what allows the sink
+   *          to make GL calls. Workers wait when all slots are full, so at most a few chunks per thread are ever
+   *          held in memory, regardless of the size of the input. When the next chunk has not been taken by any
+   *          worker, such as when the executor is busy with other work, the calling thread processes it itself.
+   *
+   * @return True on success, false if the sink reported a failure.
+   * */
+  bool run(const dataviz_vertex_z* points, size_t count, const ChunkSink& sink) const
+  {
+    const size_t chunk_count = block_count(count, chunk_size_);
+
+    const size_t worker_count = std::min(thread_count(), chunk_count);
+
+    if (worker_count <= 1)
+      return run_serial(points, count, sink);
+
+    struct Slot final
+    {
+      std::vector<dataviz_vertex_z> points;
+
+      bool ready = false;
+    };
+
+    std::vector<Slot> slots(worker_count * g_slots_per_thread);
+
+    std::mutex mutex;
+
+    std::condition_variable slot_freed;
+
+    std::condition_variable slot_ready;
+
+    size_t consumed = 0;
+
+    bool cancelled = false;
+
+    std::atomic<size_t> next_chunk{ 0 };
+
+    auto fill_slot = [&](size_t chunk) {
+      Slot& slot = slots[chunk % slots.size()];
+
+      const size_t first = chunk * chunk_size_;
+
+      const size_t size = std::min<size_t>(chunk_size_, count - first);
+
+      slot.points.assign(points + first, points + first + size);
+
+      slot.points.resize(process(slot.points.data(), size, first));
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        slot.ready = true;
+      }
+
+      slot_ready.notify_one();
+    };
+
+    auto worker = [&]() {
+      for (;;) {
+
+        const size_t chunk = next_chunk.fetch_add(1);
+        if (chunk >= chunk_count)
+          break;
+
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          slot_freed.wait(lock, [&]() { return cancelled || (chunk < (consumed + slots.size())); });
+          if (cancelled)
+            break;
+        }
+
+        fill_slot(chunk);
+      }
+    };
+
+    TaskGroup workers;
+
+    for (size_t i = 0; i < worker_count; i++)
+      workers.run(worker);
+
+    bool success = true;
+
+    for (size_t chunk = 0; chunk < chunk_count; chunk++) {
+
+      Slot& slot = slots[chunk % slots.size()];
+
+      // Every chunk before this one has been consumed, so its slot is free and the chunk can be taken right away.
+      size_t expected = chunk;
+      if (next_chunk.compare_exchange_strong(expected, chunk + 1))
+        fill_slot(chunk);
+
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        slot_ready.wait(lock, [&]() { return slot.ready; });
+      }
+
+      success = sink(slot.points.data(), slot.points.size());
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        slot.ready = false;
+        consumed++;
+        cancelled = !success;
+      }
+
+      slot_freed.notify_all();
+
+      if (!success)
+        break;
+    }
+
+    workers.wait();
+
+    return success;
+  }
+
+private:
+  size_t process(dataviz_vertex_z* points, size_t count, size_t first_index) const
+  {
+    // Chunks are measured on whichever thread processes them, which leaves out the time that the sink takes.
+    DATVIZ_PERF_SCOPE("pipeline_stages");
+
+    for (const auto& stage : stages_) {
+      if (count == 0)
+        break;
+      count = stage->process(points, count, first_index);
+    }
+
+    return count;
+  }
+
+  bool run_serial(const dataviz_vertex_z* points, size_t count, const ChunkSink& sink) const
+  {
+    std::vector<dataviz_vertex_z> chunk;
+
+    for (size_t first = 0; first < count; first += chunk_size_) {
+
+      const size_t size = std::min<size_t>(chunk_size_, count - first);
+
+      chunk.assign(points + first, points + first + size);
+
+      if (!sink(chunk.data(), process(chunk.data(), size, first)))
+        return false;
+    }
+
+    return true;
+  }
+
+private:
+  std::vector<std::unique_ptr<Stage>> stages_;
+
+  uint32_t chunk_size_ = g_default_chunk_size;
+};
+
+} // namespace
+
+//============//
+// Public API //
+//============//
+
+struct datviz_pipeline_struct final
+{
+  Pipeline pipeline;
+};
+
+datviz_pipeline_z*
+datviz_pipeline_create(void)
+{
+  return new datviz_pipeline_struct();
+}
+
+void
+datviz_pipeline_destroy(datviz_pipeline_z* pipeline)
+{
+  delete pipeline;
+}
+
+void
+datviz_pipeline_set_chunk_size(datviz_pipeline_z* pipeline, uint32_t chunk_size)
+{
+  assert(pipeline != nullptr);
+
+  pipeline->pipeline.set_chunk_size(chunk_size);
+}
+
+void
+datviz_pipeline_add_crop_box(datviz_pipeline_z* pipeline,
+                             const float* box_min,
+                             const float* box_max,
+                             const float* box_transform,
+                             int invert)
+{
+  assert(pipeline != nullptr);
+
+  pipeline->pipeline.add_stage<CropBoxStage>(box_min, box_max, box_transform, !!invert);
+}
+
+void
+datviz_pipeline_add_crop_polygon(datviz_pipeline_z* pipeline,
+                                 const float* polygon_xy,
+                                 uint32_t polygon_size,
+                                 float z_min,
+                                 float z_max,
+                                 int invert)
+{
+  assert(pipeline != nullptr);
+
+  pipeline->pipeline.add_stage<CropPolygonStage>(polygon_xy, polygon_size, z_min, z_max, !!invert);
+}
+
+void
+datviz_pipeline_add_transform(datviz_pipeline_z* pipeline, const float* transform)
+{
+  assert(pipeline != nullptr);
+
+  pipeline->pipeline.add_stage<TransformStage>(transform);
+}
+
+void
+datviz_pipeline_add_subsample(datviz_pipeline_z* pipeline, float keep_fraction)
+{
+  assert(pipeline != nullptr);
+
+  pipeline->pipeline.add_stage<SubsampleStage>(keep_fraction);
+}
+
+void
+datviz_pipeline_add_colorize_axis(datviz_pipeline_z* pipeline,
+                                  int axis,
+                                  float min,
+                                  float max,
+                                  const unsigned char* low_rgba,
+                                  const unsigned char* high_rgba)
+{
+  assert(pipeline != nullptr);
+  assert((axis >= 0) && (axis < 3));
+
+  pipeline->pipeline.add_stage<ColorizeAxisStage>(axis, min, max, low_rgba, high_rgba);
+}
+
+uint32_t
+datviz_pipeline_run(const datviz_pipeline_z* pipeline,
+                    const dataviz_vertex_z* points,
+                    uint32_t point_count,
+                    dataviz_vertex_z* out_points)
+{
+  assert(pipeline != nullptr);
+
+  uint32_t written = 0;
+
+  pipeline->pipeline.run(points, point_count, [&](const dataviz_vertex_z* chunk, size_t count) {
+    memcpy(out_points + written, chunk, count * sizeof(dataviz_vertex_z));
+    written += uint32_t(count);
+    return true;
+  });
+
+  return written;
+}
+
+int
+datviz_pipeline_run_to_cloud(const datviz_pipeline_z* pipeline,
+                             const dataviz_vertex_z* points,
+                             uint32_t point_count,
+                             datviz_cloud_z* cloud)
+{
+  assert(pipeline != nullptr);
+
+  datviz_cloud_clear(cloud);
+
+  auto append = [cloud](const dataviz_vertex_z* chunk, size_t count) {
+    return (count == 0) || (datviz_cloud_append(cloud, chunk, uint32_t(count)) == 0);
+  };
+
+  const bool success = pipeline->pipeline.run(points, point_count, append);
+
+  return success ? 0 : -1;
+}
@@ -0,0 +1,675 @@
+#include "datviz.h"
+
+#include "datviz_io.h"
+#include "datviz_parallel.h"
+#include "datviz_perf.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define DATVIZ_HAVE_MMAP 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define DATVIZ_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+using namespace datviz_detail;
+
+//===========//
+// Constants //
+//===========//
+
+namespace {
+
+/// The number of bytes that each thread takes at a time, before it is moved up to the next line.
+constexpr size_t g_chunk_size = size_t(1) << 20;
+
+/// The most columns that a line may have: a position, a color and an intensity.
+constexpr int g_max_columns = 7;
+
+/// The most digits that are gathered into a 64 bit mantissa without overflowing it.
+constexpr int g_max_mantissa_digits = 19;
+
+/// The largest power of ten that a double holds exactly, which is as far as the fast path of the parser goes.
+constexpr int g_max_exact_power = 22;
+
+/// The largest mantissa that a double holds exactly.
+constexpr uint64_t g_max_exact_mantissa = uint64_t(1) << 53;
+
+constexpr double g_powers_of_ten[g_max_exact_power + 1]{ 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                                         1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                                         1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+} // namespace
+
+//===============//
+// Number Parser //
+//===============//
+
+namespace {
+
+inline bool
+is_digit(char c)
+{
+  return static_cast<unsigned char>(c - '0') < 10;
+}
+
+inline bool
+is_separator(char c)
+{
+  return (c == ' ') || (c == '\t') || (c == ',') || (c == ';') || (c == '\r');
+}
+
+inline uint32_t
+count_trailing_zeros(uint32_t v)
+{
+#if defined(_MSC_VER)
+  unsigned long index = 0;
+  _BitScanForward(&index, v);
+  return uint32_t(index);
+#else
+  return uint32_t(__builtin_ctz(v));
+#endif
+}
+
+/** @brief Counts the digits at the start of a string.
+ *
+ * @details With SSE2, sixteen bytes are classified at a time, which covers nearly every number in one step.
+ * */
+inline size_t
+digit_run(const char* p, const char* end)
+{
+  size_t n = 0;
+
+#if defined(DATVIZ_HAVE_SSE2)
+  const __m128i zero = _mm_set1_epi8('0');
+
+  const __m128i nine = _mm_set1_epi8(9);
+
+  while ((end - (p + n)) >= 16) {
+
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + n));
+
+    const __m128i values = _mm_sub_epi8(bytes, zero);
+
+    // Bytes below '0' wrap around to large values, so a single unsigned comparison finds the digits.
+    const __m128i digits = _mm_cmpeq_epi8(_mm_min_epu8(values, nine), values);
+
+    const uint32_t others = ~uint32_t(_mm_movemask_epi8(digits)) & 0xffffu;
+
+    if (others != 0)
+      return n + count_trailing_zeros(others);
+
+    n += 16;
+  }
+#endif
+
+  while (((p + n) < end) && is_digit(p[n]))
+    n++;
+
+  return n;
+}
+
+/** @brief Converts eight digits to their value at once, with the bytes of a 64 bit integer as the lanes.
+ * */
+inline uint64_t
+eight_digits(const char* p)
+{
+  uint64_t v = 0;
+
+  memcpy(&v, p, sizeof(v));
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+  v = __builtin_bswap64(v);
+#endif
+
+  // Each step joins neighboring lanes into one of twice the width: pairs of digits, then fours, then all eight.
+  v = ((v & 0x0f0f0f0f0f0f0f0full) * ((10ull << 8) + 1)) >> 8;
+  v = ((v & 0x00ff00ff00ff00ffull) * ((100ull << 16) + 1)) >> 16;
+  v = ((v & 0x0000ffff0000ffffull) * ((10000ull << 32) + 1)) >> 32;
+
+  return v;
+}
+
+/** @brief Adds a run of digits to a mantissa.
+ * */
+inline uint64_t
+accumulate_digits(uint64_t mantissa, const char* p, size_t count)
+{
+  for (; count >= 8; p += 8, count -= 8)
+    mantissa = (mantissa * 100000000ull) + eight_digits(p);
+
+  for (; count > 0; p++, count--)
+    mantissa = (mantissa * 10) + uint64_t(*p - '0');
+
+  return mantissa;
+}
+
+/** @brief Parses a number with the C library, for the ones that the fast path cannot convert exactly.
+ *
+ * @details The number has to be copied to be terminated, so the copy is sized from the characters that can be part of a
+ *          decimal number. Those are nearly always short enough for the stack, but any length is handled.
+ * */
+const char*
+parse_float_slow(const char* p, const char* end, float& value)
+{
+  size_t length = 0;
+
+  while (((p + length) < end) && (is_digit(p[length]) || (strchr("+-.eE", p[length]) && (p[length] != 0))))
+    length++;
+
+  char small[64];
+
+  std::string large;
+
+  char* buffer = small;
+
+  if (length < sizeof(small)) {
+    memcpy(small, p, length);
+    small[length] = 0;
+  } else {
+    large.assign(p, length);
+    buffer = &large[0];
+  }
+
+  char* parsed_end = nullptr;
+
+  value = strtof(buffer, &parsed_end);
+
+  return (parsed_end == buffer) ? nullptr : (p + (parsed_end - buffer));
+}
+
+/** @brief Whether a double could round to a different float than the exact number that it was rounded from.
+ *
+ * @details The double is the nearest one to the exact number, so if a float halfway point were between the two, it
+ *          would be nearer still. The two can therefore only round apart when the double is itself halfway between two
+ *          floats. Floats outside of the normal range have their halfway points elsewhere, so those are ruled out too.
+ * */
+inline bool
+may_round_apart(double d)
+{
+  const double magnitude = std::fabs(d);
+
+  if ((magnitude != 0.0) &&
+      ((magnitude < double(std::numeric_limits<float>::min())) ||
+       (magnitude > double(std::numeric_limits<float>::max()))))
+    return true;
+
+  uint64_t bits = 0;
+
+  memcpy(&bits, &d, sizeof(bits));
+
+  // A double has 29 more bits of mantissa than a float, and a halfway point has only the highest of them set.
+  constexpr uint64_t g_extra_bits = (uint64_t(1) << 29) - 1;
+
+  return (bits & g_extra_bits) == (uint64_t(1) << 28);
+}
+
+/** @brief Parses a decimal number, such as "-12.5e3".
+ *
+ * @details Numbers with up to 19 digits and small exponents are gathered into an integer mantissa and scaled by an
+ *          exact power of ten, which gives the nearest double. Rounding that to a float gives what strtof gives,
+ *          unless the double is halfway between two floats. Those, and any other number, are handed to strtof.
+ *
+ * @return The end of the number, or null if there is no number at the start of the string.
+ * */
+const char*
+parse_float(const char* p, const char* end, float& value)
+{
+  const char* start = p;
+
+  const bool negative = (p < end) && (*p == '-');
+
+  if ((p < end) && ((*p == '-') || (*p == '+')))
+    p++;
+
+  const size_t integer_digits = digit_run(p, end);
+
+  uint64_t mantissa = accumulate_digits(0, p, std::min<size_t>(integer_digits, g_max_mantissa_digits));
+
+  p += integer_digits;
+
+  size_t fraction_digits = 0;
+
+  if ((p < end) && (*p == '.')) {
+    p++;
+    fraction_digits = digit_run(p, end);
+    const size_t room = g_max_mantissa_digits - std::min<size_t>(integer_digits, g_max_mantissa_digits);
+    mantissa = accumulate_digits(mantissa, p, std::min(fraction_digits, room));
+    p += fraction_digits;
+  }
+
+  if ((integer_digits + fraction_digits) == 0)
+    return nullptr;
+
+  int exponent = -int(fraction_digits);
+
+  if ((p < end) && ((*p == 'e') || (*p == 'E'))) {
+
+    const char* q = p + 1;
+
+    const bool negative_exponent = (q < end) && (*q == '-');
+
+    if ((q < end) && ((*q == '-') || (*q == '+')))
+      q++;
+
+    const size_t exponent_digits = digit_run(q, end);
+
+    if ((exponent_digits == 0) || (exponent_digits > 4))
+      return parse_float_slow(start, end, value);
+
+    const int e = int(accumulate_digits(0, q, exponent_digits));
+
+    exponent += negative_exponent ? -e : e;
+
+    p = q + exponent_digits;
+  }
+
+  if (((integer_digits + fraction_digits) > size_t(g_max_mantissa_digits)) || (mantissa > g_max_exact_mantissa) ||
+      (exponent < -g_max_exact_power) || (exponent > g_max_exact_power))
+    return parse_float_slow(start, end, value);
+
+  double d = double(mantissa);
+
+  d = (exponent < 0) ? (d / g_powers_of_ten[-exponent]) : (d * g_powers_of_ten[exponent]);
+
+  if (may_round_apart(d))
+    return parse_float_slow(start, end, value);
+
+  value = float(negative ? -d : d);
+
+  return p;
+}
+
+/** @brief Parses the numbers of one line, stopping at its end.
+ *
+ * @param count Set to the number of values on the line.
+ *
+ * @return False if the line has something other than numbers on it, or more of them than any layout has.
+ * */
+bool
+parse_line(const char*& p, const char* end, float* values, int& count)
+{
+  count = 0;
+
+  for (;;) {
+
+    while ((p < end) && is_separator(*p))
+      p++;
+
+    if ((p == end) || (*p == '\n'))
+      break;
+
+    if (count == g_max_columns)
+      return false;
+
+    const char* next = parse_float(p, end, values[count]);
+
+    // A number must be followed by a separator, so that text such as "1x" is not read as a number.
+    if (!next || ((next < end) && !is_separator(*next) && (*next != '\n')))
+      return false;
+
+    count++;
+
+    p = next;
+  }
+
+  return true;
+}
+
+const char*
+next_line(const char* p, const char* end)
+{
+  const void* newline = memchr(p, '\n', size_t(end - p));
+
+  return newline ? (static_cast<const char*>(newline) + 1) : end;
+}
+
+} // namespace
+
+//===========//
+// Text File //
+//===========//
+
+namespace {
+
+/** @brief The contents of a file, mapped into memory where possible and read into it otherwise.
+ * */
+class FileContents final
+{
+public:
+  FileContents() = default;
+
+  ~FileContents()
+  {
+#if defined(DATVIZ_HAVE_MMAP)
+    if (mapping_)
+      munmap(mapping_, size_);
+#endif
+  }
+
+  FileContents(const FileContents&) = delete;
+
+  FileContents& operator=(const FileContents&) = delete;
+
+  bool open(const char* path)
+  {
+#if defined(DATVIZ_HAVE_MMAP)
+    const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      return false;
+
+    struct stat info;
+
+    bool success = fstat(fd, &info) == 0;
+
+    size_ = success ? size_t(info.st_size) : 0;
+
+    if (success && (size_ > 0)) {
+
+      void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+
+      success = mapping != MAP_FAILED;
+
+      if (success) {
+        mapping_ = mapping;
+        madvise(mapping_, size_, MADV_SEQUENTIAL);
+      }
+    }
+
+    close(fd);
+
+    return success;
+#else
+    if (!read_file(path, buffer_))
+      return false;
+
+    size_ = buffer_.size();
+
+    return true;
+#endif
+  }
+
+  const char* data() const
+  {
+#if defined(DATVIZ_HAVE_MMAP)
+    return static_cast<const char*>(mapping_);
+#else
+    return reinterpret_cast<const char*>(buffer_.data());
+#endif
+  }
+
+  size_t size() const { return size_; }
+
+private:
+  size_t size_ = 0;
+
+#if defined(DATVIZ_HAVE_MMAP)
+  void* mapping_ = nullptr;
+#else
+  std::vector<unsigned char> buffer_;
+#endif
+};
+
+/** @brief The points of one chunk of the file, before they are joined with the others.
+ * */
+struct ChunkPoints final
+{
+  std::vector<dataviz_vertex_z> vertices;
+
+  std::vector<float> intensities;
+
+  uint64_t skipped_lines = 0;
+};
+
+unsigned char
+to_channel(float value)
+{
+  return static_cast<unsigned char>(std::min(std::max(value, 0.0f), 255.0f) + 0.5f);
+}
+
+/** @brief Whether the lines of a layout end with an intensity, which is the case for four and seven columns.
+ * */
+inline bool
+has_intensity_column(int columns)
+{
+  return (columns == 4) || (columns == 7);
+}
+
+/** @brief Parses the lines of a chunk that match the layout of the file.
+ * */
+void
+parse_chunk(const char* p, const char* end, int columns, ChunkPoints& out)
+{
+  const bool has_color = columns >= 6;
+
+  const bool has_intensity = has_intensity_column(columns);
+
+  out.vertices.reserve(size_t(end - p) / 24);
+
+  if (has_intensity)
+    out.intensities.reserve(out.vertices.capacity());
+
+  float values[g_max_columns];
+
+  while (p < end) {
+
+    const char* line = p;
+
+    int count = 0;
+
+    const bool valid = parse_line(p, end, values, count);
+
+    if (valid && (count == columns)) {
+
+      dataviz_vertex_z v{ values[0], values[1], values[2], 255, 255, 255, 255 };
+
+      if (has_color) {
+        v.r = to_channel(values[3]);
+        v.g = to_channel(values[4]);
+        v.b = to_channel(values[5]);
+      }
+
+      out.vertices.push_back(v);
+
+      if (has_intensity)
+        out.intensities.push_back(values[columns - 1]);
+
+      p = (p < end) ? (p + 1) : end;
+
+      continue;
+    }
+
+    // Blank lines are not counted, since many files end with one.
+    if (!valid || (count > 0))
+      out.skipped_lines++;
+
+    p = next_line(valid ? p : line, end);
+  }
+}
+
+/** @brief Finds the number of columns of the file from the first line that is made of numbers.
+ *
+ * @details Lines before it, such as a header with the names of the columns, are skipped.
+ *
+ * @return The number of columns, or zero if no line has a number of columns that fits a layout.
+ * */
+int
+detect_columns(const char* p, const char* end)
+{
+  float values[g_max_columns];
+
+  while (p < end) {
+
+    const char* line = p;
+
+    int count = 0;
+
+    const bool valid = parse_line(p, end, values, count);
+
+    if (valid && ((count == 3) || (count == 4) || (count == 6) || (count == 7)))
+      return count;
+
+    p = next_line(valid ? p : line, end);
+  }
+
+  return 0;
+}
+
+} // namespace
+
+//============//
+// Public API //
+//============//
+
+struct datviz_text_points_struct final
+{
+  std::vector<dataviz_vertex_z> vertices;
+
+  std::vector<float> intensities;
+
+  uint64_t skipped_lines = 0;
+};
+
+datviz_text_points_z*
+datviz_text_points_load(const char* path)
+{
+  DATVIZ_PERF_SCOPE("text_load");
+
+  assert(path != nullptr);
+
+  FileContents file;
+
+  if (!file.open(path))
+    return nullptr;
+
+  const char* begin = file.data();
+
+  const char* end = begin + file.size();
+
+  const int columns = detect_columns(begin, end);
+
+  if (columns == 0)
+    return nullptr;
+
+  // Each chunk starts at the first line after its nominal start, so that every line belongs to exactly one chunk.
+  std::vector<const char*> boundaries;
+
+  boundaries.push_back(begin);
+
+  for (size_t offset = g_chunk_size; offset < file.size(); offset += g_chunk_size) {
+
+    const char* boundary = next_line(std::max(begin + offset - 1, boundaries.back()), end);
+
+    if (boundary > boundaries.back())
+      boundaries.push_back(boundary);
+  }
+
+  boundaries.push_back(end);
+
+  const size_t chunk_count = boundaries.size() - 1;
+
+  std::vector<ChunkPoints> chunks(chunk_count);
+
+  parallel_for(chunk_count, 1, [&](size_t first, size_t last) {
+    for (size_t c = first; c < last; c++)
+      parse_chunk(boundaries[c], boundaries[c + 1], columns, chunks[c]);
+  });
+
+  std::vector<size_t> offsets(chunk_count + 1, 0);
+
+  uint64_t skipped_lines = 0;
+
+  for (size_t c = 0; c < chunk_count; c++) {
+    offsets[c + 1] = offsets[c] + chunks[c].vertices.size();
+    skipped_lines += chunks[c].skipped_lines;
+  }
+
+  if (offsets.back() > std::numeric_limits<uint32_t>::max())
+    return nullptr;
+
+  auto* points = new datviz_text_points_struct();
+
+  points->vertices.resize(offsets.back());
+
+  const bool has_intensity = has_intensity_column(columns);
+
+  if (has_intensity)
+    points->intensities.resize(offsets.back());
+
+  points->skipped_lines = skipped_lines;
+
+  parallel_for(chunk_count, 1, [&](size_t first, size_t last) {
+    for (size_t c = first; c < last; c++) {
+
+      auto& chunk = chunks[c];
+
+      std::copy(chunk.vertices.begin(), chunk.vertices.end(), points->vertices.begin() + offsets[c]);
+
+      if (has_intensity)
+        std::copy(chunk.intensities.begin(), chunk.intensities.end(), points->intensities.begin() + offsets[c]);
+
+      std::vector<dataviz_vertex_z>().swap(chunk.vertices);
+
+      std::vector<float>().swap(chunk.intensities);
+    }
+  });
+
+  return points;
+}
+
+void
+datviz_text_points_destroy(datviz_text_points_z* points)
+{
+  delete points;
+}
+
+uint32_t
+datviz_text_points_count(const datviz_text_points_z* points)
+{
+  assert(points != nullptr);
+
+  return uint32_t(points->vertices.size());
+}
+
+const dataviz_vertex_z*
+datviz_text_points_vertices(const datviz_text_points_z* points)
+{
+  assert(points != nullptr);
+
+  return points->vertices.data();
+}
+
+const float*
+datviz_text_points_intensities(const datviz_text_points_z* points)
+{
+  assert(points != nullptr);
+
+  return points->intensities.empty() ? nullptr : points->intensities.data();
+}
+
+uint64_t
+datviz_text_points_skipped_lines(const datviz_text_points_z* points)
+{
+  assert(points != nullptr);
+
+  return points->skipped_lines;
+}
@@ -0,0 +1,531 @@
+#include "datviz_tiles.h"
+
+#include "datviz_io.h"
+#include "datviz_parallel.h"
+#include "datviz_perf.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+#include <stdio.h>
+#include <string.h>
+
+namespace datviz_detail {
+
+namespace {
+
+constexpr size_t g_grain = 65536;
+
+constexpr size_t g_cells_per_tile = size_t(g_tile_size) * size_t(g_tile_size);
+
+constexpr uint64_t g_fnv_offset = 14695981039346656037ull;
+
+constexpr uint64_t g_fnv_prime = 1099511628211ull;
+
+/** @brief Identifies the points and parameters that a cache file was made for.
+ * */
+struct CacheHeader final
+{
+  char magic[8];
+
+  uint32_t version;
+
+  uint32_t tile_size;
+
+  uint64_t point_count;
+
+  uint64_t checksum;
+
+  float cell_size;
+
+  float origin[2];
+
+  float top;
+
+  int32_t tiles_x;
+
+  int32_t tiles_y;
+
+  uint32_t level_count;
+
+  uint32_t reserved;
+};
+
+const char g_cache_magic[8] = { 'D', 'V', 'Z', 'T', 'I', 'L', 'E', 'S' };
+
+constexpr uint32_t g_cache_version = 1;
+
+/** @brief Hashes the points in parallel blocks, then hashes the block hashes in order.
+ * */
+uint64_t
+hash_points(const dataviz_vertex_z* points, size_t count)
+{
+  std::vector<uint64_t> hashes(block_count(count, g_grain));
+
+  parallel_for(count, g_grain, [&](size_t begin, size_t end) {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(points + begin);
+    const size_t size = (end - begin) * sizeof(dataviz_vertex_z);
+    uint64_t h = g_fnv_offset;
+    for (size_t i = 0; i < size; i++)
+      h = (h ^ bytes[i]) * g_fnv_prime;
+    hashes[begin / g_grain] = h;
+  });
+
+  uint64_t h = g_fnv_offset ^ uint64_t(count);
+
+  for (const auto block : hashes)
+    h = (h ^ block) * g_fnv_prime;
+
+  return h;
+}
+
+struct Bounds final
+{
+  float min[3]{ std::numeric_limits<float>::max(),
+                std::numeric_limits<float>::max(),
+                std::numeric_limits<float>::max() };
+
+  float max[3]{ -std::numeric_limits<float>::max(),
+                -std::numeric_limits<float>::max(),
+                -std::numeric_limits<float>::max() };
+
+  void add(const Bounds& other)
+  {
+    for (int i = 0; i < 3; i++) {
+      min[i] = std::min(min[i], other.min[i]);
+      max[i] = std::max(max[i], other.max[i]);
+    }
+  }
+};
+
+Bounds
+compute_bounds(const dataviz_vertex_z* points, size_t count)
+{
+  std::vector<Bounds> partial(block_count(count, g_grain));
+
+  parallel_for(count, g_grain, [&](size_t begin, size_t end) {
+    Bounds b;
+    for (size_t i = begin; i < end; i++) {
+      const float p[3]{ points[i].x, points[i].y, points[i].z };
+      for (int j = 0; j < 3; j++) {
+        b.min[j] = std::min(b.min[j], p[j]);
+        b.max[j] = std::max(b.max[j], p[j]);
+      }
+    }
+    partial[begin / g_grain] = b;
+  });
+
+  Bounds total;
+
+  for (const auto& b : partial)
+    total.add(b);
+
+  return total;
+}
+
+int
+tiles_needed(float extent, float cell_size)
+{
+  const double cells = std::floor(double(extent) / double(cell_size)) + 1.0;
+
+  return static_cast<int>(std::ceil(cells / double(g_tile_size)));
+}
+
+void
+release_heights(TileLevel& level)
+{
+  for (auto& tile : level.tiles) {
+    tile.heights.clear();
+    tile.heights.shrink_to_fit();
+  }
+}
+
+} // namespace
+
+void
+TilePyramid::build(const dataviz_vertex_z* points, size_t count, float cell_size, const char* cache_path)
+{
+  DATVIZ_PERF_SCOPE("map_build");
+
+  levels_.clear();
+
+  const auto bounds = count ? compute_bounds(points, count) : Bounds();
+
+  origin_[0] = count ? bounds.min[0] : 0.0f;
+  origin_[1] = count ? bounds.min[1] : 0.0f;
+
+  top_ = count ? bounds.max[2] : 0.0f;
+
+  cell_size_ = cell_size;
+
+  const float extent_x = count ? (bounds.max[0] - bounds.min[0]) : 0.0f;
+  const float extent_y = count ? (bounds.max[1] - bounds.min[1]) : 0.0f;
+
+  while ((size_t(tiles_needed(extent_x, cell_size_)) * size_t(tiles_needed(extent_y, cell_size_))) > g_max_base_tiles)
+    cell_size_ *= 2.0f;
+
+  TileLevel base;
+
+  base.tiles_x = tiles_needed(extent_x, cell_size_);
+  base.tiles_y = tiles_needed(extent_y, cell_size_);
+
+  levels_.push_back(std::move(base));
+
+  sort_points(points, count);
+
+  uint64_t checksum = 0;
+
+  if (cache_path) {
+
+    checksum = hash_points(points, count);
+
+    if (load(cache_path, checksum))
+      return;
+  }
+
+  rasterize_base_level();
+
+  // The heights are only needed to pick between cells while building the next level, so each level drops them as soon
+  // as the one after it is done, and at most two levels of them are held at once.
+  while ((levels_.back().tiles_x > 1) || (levels_.back().tiles_y > 1)) {
+
+    add_level();
+
+    release_heights(levels_[levels_.size() - 2]);
+  }
+
+  release_heights(levels_.back());
+
+  if (cache_path)
+    save(cache_path, checksum);
+}
+
+void
+TilePyramid::release_points()
+{
+  sorted_points_.clear();
+  sorted_points_.shrink_to_fit();
+}
+
+void
+TilePyramid::sort_points(const dataviz_vertex_z* points, size_t count)
+{
+  const auto& base = levels_[0];
+
+  const size_t tile_count = size_t(base.tiles_x) * size_t(base.tiles_y);
+
+  const float inv_cell_size = 1.0f / cell_size_;
+
+  const int max_x = (base.tiles_x * g_tile_size) - 1;
+  const int max_y = (base.tiles_y * g_tile_size) - 1;
+
+  std::vector<uint32_t> tiles(count);
+
+  std::vector<std::atomic<uint32_t>> counts(tile_count);
+
+  parallel_for(count, g_grain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      const int x = std::min(std::max(static_cast<int>((points[i].x - origin_[0]) * inv_cell_size), 0), max_x);
+      const int y = std::min(std::max(static_cast<int>((points[i].y - origin_[1]) * inv_cell_size), 0), max_y);
+      const auto tile = static_cast<uint32_t>(((y / g_tile_size) * base.tiles_x) + (x / g_tile_size));
+      tiles[i] = tile;
+      counts[tile].fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+
+  tile_offsets_.resize(tile_count + 1);
+
+  uint32_t sum = 0;
+
+  for (size_t i = 0; i < tile_count; i++) {
+    tile_offsets_[i] = sum;
+    sum += counts[i].load(std::memory_order_relaxed);
+    counts[i].store(tile_offsets_[i], std::memory_order_relaxed);
+  }
+
+  tile_offsets_[tile_count] = sum;
+
+  sorted_points_.resize(count);
+
+  parallel_for(count, g_grain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++)
+      sorted_points_[counts[tiles[i]].fetch_add(1, std::memory_order_relaxed)] = points[i];
+  });
+}
+
+void
+TilePyramid::rasterize_base_level()
+{
+  auto& base = levels_[0];
+
+  const size_t tile_count = size_t(base.tiles_x) * size_t(base.tiles_y);
+
+  const float inv_cell_size = 1.0f / cell_size_;
+
+  std::vector<Tile> slots(tile_count);
+
+  parallel_for(tile_count, 1, [&](size_t begin, size_t end) {
+    for (size_t t = begin; t < end; t++) {
+
+      if (tile_offsets_[t] == tile_offsets_[t + 1])
+        continue;
+
+      auto& tile = slots[t];
+
+      tile.x = int(t % size_t(base.tiles_x));
+      tile.y = int(t / size_t(base.tiles_x));
+
+      tile.colors.assign(g_cells_per_tile * 4, 0);
+      tile.heights.assign(g_cells_per_tile, -std::numeric_limits<float>::infinity());
+
+      const int first_x = tile.x * g_tile_size;
+      const int first_y = tile.y * g_tile_size;
+
+      for (uint32_t i = tile_offsets_[t]; i < tile_offsets_[t + 1]; i++) {
+
+        const auto& p = sorted_points_[i];
+
+        const int x = static_cast<int>((p.x - origin_[0]) * inv_cell_size) - first_x;
+        const int y = static_cast<int>((p.y - origin_[1]) * inv_cell_size) - first_y;
+
+        // Points on the far edge of the cloud are clamped into the last cell, like they were when sorting.
+        const size_t cell = (size_t(std::min(std::max(y, 0), g_tile_size - 1)) * g_tile_size) +
+                            size_t(std::min(std::max(x, 0), g_tile_size - 1));
+
+        if (p.z <= tile.heights[cell])
+          continue;
+
+        tile.heights[cell] = p.z;
+        tile.colors[(cell * 4) + 0] = p.r;
+        tile.colors[(cell * 4) + 1] = p.g;
+        tile.colors[(cell * 4) + 2] = p.b;
+        tile.colors[(cell * 4) + 3] = 255;
+      }
+    }
+  });
+
+  base.lookup.assign(tile_count, -1);
+
+  for (size_t t = 0; t < tile_count; t++) {
+    if (slots[t].colors.empty())
+      continue;
+    base.lookup[t] = int32_t(base.tiles.size());
+    base.tiles.push_back(std::move(slots[t]));
+  }
+}
+
+void
+TilePyramid::add_level()
+{
+  const auto& fine = levels_.back();
+
+  TileLevel coarse;
+
+  coarse.tiles_x = (fine.tiles_x + 1) / 2;
+  coarse.tiles_y = (fine.tiles_y + 1) / 2;
+
+  const size_t tile_count = size_t(coarse.tiles_x) * size_t(coarse.tiles_y);
+
+  std::vector<Tile> slots(tile_count);
+
+  constexpr int half = g_tile_size / 2;
+
+  parallel_for(tile_count, 1, [&](size_t begin, size_t end) {
+    for (size_t t = begin; t < end; t++) {
+
+      const int tile_x = int(t % size_t(coarse.tiles_x));
+      const int tile_y = int(t / size_t(coarse.tiles_x));
+
+      const Tile* children[2][2] = { { fine.find(tile_x * 2, tile_y * 2), fine.find((tile_x * 2) + 1, tile_y * 2) },
+                                     { fine.find(tile_x * 2, (tile_y * 2) + 1),
+                                       fine.find((tile_x * 2) + 1, (tile_y * 2) + 1) } };
+
+      if (!children[0][0] && !children[0][1] && !children[1][0] && !children[1][1])
+        continue;
+
+      auto& tile = slots[t];
+
+      tile.x = tile_x;
+      tile.y = tile_y;
+
+      tile.colors.assign(g_cells_per_tile * 4, 0);
+      tile.heights.assign(g_cells_per_tile, -std::numeric_limits<float>::infinity());
+
+      for (int y = 0; y < g_tile_size; y++) {
+        for (int x = 0; x < g_tile_size; x++) {
+
+          const Tile* child = children[y / half][x / half];
+          if (!child)
+            continue;
+
+          const size_t cell = (size_t(y) * g_tile_size) + size_t(x);
+
+          // Each cell takes the highest of the four cells that it covers on the finer level.
+          for (int dy = 0; dy < 2; dy++) {
+            for (int dx = 0; dx < 2; dx++) {
+
+              const size_t child_cell =
+                (size_t(((y % half) * 2) + dy) * g_tile_size) + size_t(((x % half) * 2) + dx);
+
+              if ((child->colors[(child_cell * 4) + 3] == 0) || (child->heights[child_cell] <= tile.heights[cell]))
+                continue;
+
+              tile.heights[cell] = child->heights[child_cell];
+
+              memcpy(&tile.colors[cell * 4], &child->colors[child_cell * 4], 4);
+            }
+          }
+        }
+      }
+    }
+  });
+
+  coarse.lookup.assign(tile_count, -1);
+
+  for (size_t t = 0; t < tile_count; t++) {
+    if (slots[t].colors.empty())
+      continue;
+    coarse.lookup[t] = int32_t(coarse.tiles.size());
+    coarse.tiles.push_back(std::move(slots[t]));
+  }
+
+  levels_.push_back(std::move(coarse));
+}
+
+bool
+TilePyramid::load(const char* path, uint64_t checksum)
+{
+  // The whole file is read up front through the streaming reader, which keeps many large reads in flight instead of
+  // making one small read per tile.
+  std::vector<unsigned char> contents;
+
+  if (!read_file(path, contents))
+    return false;
+
+  size_t cursor = 0;
+
+  auto read = [&](void* out, size_t size) {
+    if ((contents.size() - cursor) < size)
+      return false;
+    memcpy(out, contents.data() + cursor, size);
+    cursor += size;
+    return true;
+  };
+
+  CacheHeader header;
+
+  bool valid = read(&header, sizeof(header)) &&
+               (memcmp(header.magic, g_cache_magic, sizeof(g_cache_magic)) == 0) &&
+               (header.version == g_cache_version) && (header.tile_size == uint32_t(g_tile_size)) &&
+               (header.point_count == uint64_t(sorted_points_.size())) &&
+               (header.checksum == checksum) && (header.cell_size == cell_size_) &&
+               (header.tiles_x == levels_[0].tiles_x) && (header.tiles_y == levels_[0].tiles_y) &&
+               (header.level_count > 0) && (header.level_count <= 32);
+
+  std::vector<TileLevel> levels(valid ? header.level_count : 0);
+
+  for (size_t l = 0; valid && (l < levels.size()); l++) {
+
+    auto& level = levels[l];
+
+    level.tiles_x = (l == 0) ? header.tiles_x : ((levels[l - 1].tiles_x + 1) / 2);
+    level.tiles_y = (l == 0) ? header.tiles_y : ((levels[l - 1].tiles_y + 1) / 2);
+
+    level.lookup.assign(size_t(level.tiles_x) * size_t(level.tiles_y), -1);
+
+    uint32_t tile_count = 0;
+
+    valid = read(&tile_count, sizeof(tile_count)) && (tile_count <= level.lookup.size());
+
+    for (uint32_t i = 0; valid && (i < tile_count); i++) {
+
+      Tile tile;
+
+      int32_t position[2];
+
+      valid = read(position, sizeof(position));
+
+      tile.x = position[0];
+      tile.y = position[1];
+
+      valid = valid && (tile.x >= 0) && (tile.y >= 0) && (tile.x < level.tiles_x) && (tile.y < level.tiles_y);
+
+      if (!valid)
+        break;
+
+      auto& slot = level.lookup[(size_t(tile.y) * size_t(level.tiles_x)) + size_t(tile.x)];
+
+      // A tile that is listed twice would leave the first copy unreachable, so the file is damaged.
+      if (slot >= 0) {
+        valid = false;
+        break;
+      }
+
+      tile.colors.resize(g_cells_per_tile * 4);
+
+      valid = read(tile.colors.data(), tile.colors.size());
+
+      slot = int32_t(level.tiles.size());
+
+      level.tiles.push_back(std::move(tile));
+    }
+  }
+
+  if (valid) {
+    levels_ = std::move(levels);
+    origin_[0] = header.origin[0];
+    origin_[1] = header.origin[1];
+    top_ = header.top;
+  }
+
+  return valid;
+}
+
+void
+TilePyramid::save(const char* path, uint64_t checksum) const
+{
+  FILE* file = fopen(path, "wb");
+  if (!file)
+    return;
+
+  CacheHeader header{};
+
+  memcpy(header.magic, g_cache_magic, sizeof(g_cache_magic));
+
+  header.version = g_cache_version;
+  header.tile_size = g_tile_size;
+  header.point_count = sorted_points_.size();
+  header.checksum = checksum;
+  header.cell_size = cell_size_;
+  header.origin[0] = origin_[0];
+  header.origin[1] = origin_[1];
+  header.top = top_;
+  header.tiles_x = levels_[0].tiles_x;
+  header.tiles_y = levels_[0].tiles_y;
+  header.level_count = uint32_t(levels_.size());
+
+  bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+
+  for (const auto& level : levels_) {
+
+    const auto tile_count = uint32_t(level.tiles.size());
+
+    success = success && (fwrite(&tile_count, sizeof(tile_count), 1, file) == 1);
+
+    for (const auto& tile : level.tiles) {
+      const int32_t position[2]{ tile.x, tile.y };
+      success = success && (fwrite(position, sizeof(position), 1, file) == 1);
+      success = success && (fwrite(tile.colors.data(), tile.colors.size(), 1, file) == 1);
+    }
+  }
+
+  fclose(file);
+
+  // A partial file would only be rejected when it is loaded, so it is removed right away.
+  if (!success)
+    remove(path);
+}
+
+} // namespace datviz_detail
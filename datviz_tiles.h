@@ -0,0 +1,126 @@
+/// @file datviz_tiles.h
+///
+/// @brief An internal pyramid of raster tiles, used to draw large point clouds from above.
+
+#pragma once
+
+#include "datviz.h"
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace datviz_detail {
+
+/// The number of cells along each side of a tile.
+constexpr int g_tile_size = 256;
+
+/// The most tiles that the finest level may have. The cell size is increased until the cloud fits in this many.
+constexpr int g_max_base_tiles = 4096;
+
+/** @brief A square of cells, each holding the color of the highest point that falls into it.
+ * */
+struct Tile final
+{
+  int x = 0;
+
+  int y = 0;
+
+  /// RGBA per cell, row by row. Cells without points have an alpha of zero.
+  std::vector<unsigned char> colors;
+
+  /// The height of the point that each cell got its color from. Only kept until the next level has been built.
+  std::vector<float> heights;
+};
+
+/** @brief The tiles that cover the cloud at one cell size. Tiles without any points are not stored.
+ * */
+struct TileLevel final
+{
+  int tiles_x = 0;
+
+  int tiles_y = 0;
+
+  /// The position of each tile in @ref tiles, by tile, or -1 for tiles without points.
+  std::vector<int32_t> lookup;
+
+  std::vector<Tile> tiles;
+
+  const Tile* find(int x, int y) const
+  {
+    if ((x < 0) || (y < 0) || (x >= tiles_x) || (y >= tiles_y))
+      return nullptr;
+
+    const int32_t i = lookup[(size_t(y) * size_t(tiles_x)) + size_t(x)];
+
+    return (i < 0) ? nullptr : &tiles[i];
+  }
+};
+
+/** @brief Rasterizes a point cloud into a pyramid of tiles, as seen from above.
+ *
+ * @details The finest level has the requested cell size, and each following level halves the resolution of the one
+ *          before it, until one tile covers the whole cloud. The points are also sorted by the tile of the finest
+ *          level that they fall into, so that the points under a part of the map can be drawn on their own.
+ * */
+class TilePyramid final
+{
+public:
+  /** @brief Builds the pyramid, or loads it from a cache file that was made for the same points.
+   *
+   * @param cache_path The file to load the pyramid from, and to save it to after building it. May be null.
+   * */
+  void build(const dataviz_vertex_z* points, size_t count, float cell_size, const char* cache_path);
+
+  float origin_x() const { return origin_[0]; }
+
+  float origin_y() const { return origin_[1]; }
+
+  float top() const { return top_; }
+
+  float cell_size() const { return cell_size_; }
+
+  /// The size of a cell on a level, which doubles with every level.
+  float cell_size(size_t level) const { return cell_size_ * float(size_t(1) << level); }
+
+  const std::vector<TileLevel>& levels() const { return levels_; }
+
+  /// The points, sorted by the tile of the finest level that they are in. Empty after @ref release_points.
+  const std::vector<dataviz_vertex_z>& sorted_points() const { return sorted_points_; }
+
+  /** @brief Frees the sorted points, once they have been copied to where they are drawn from.
+   *
+   * @details The tile offsets are kept, since they still describe where each tile is in that copy.
+   * */
+  void release_points();
+
+  /// The offset of the first point of each tile of the finest level in @ref sorted_points, with one extra at the end.
+  const std::vector<uint32_t>& tile_offsets() const { return tile_offsets_; }
+
+private:
+  void sort_points(const dataviz_vertex_z* points, size_t count);
+
+  void rasterize_base_level();
+
+  void add_level();
+
+  bool load(const char* path, uint64_t checksum);
+
+  void save(const char* path, uint64_t checksum) const;
+
+private:
+  float origin_[2]{ 0, 0 };
+
+  float top_ = 0;
+
+  float cell_size_ = 1;
+
+  std::vector<TileLevel> levels_;
+
+  std::vector<dataviz_vertex_z> sorted_points_;
+
+  std::vector<uint32_t> tile_offsets_;
+};
+
+} // namespace datviz_detail
@@ -0,0 +1,292 @@
+#include "datviz_voxels.h"
+
+#include "datviz_parallel.h"
+#include "datviz_perf.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+namespace datviz_detail {
+
+namespace {
+
+constexpr size_t g_grain = 16384;
+
+constexpr uint64_t g_empty_key = ~uint64_t(0);
+
+constexpr uint32_t g_max_coordinate = (uint32_t(1) << g_voxel_key_bits) - 1;
+
+/// Spreads the lower 21 bits of a value out so that there are two zero bits between each of them.
+uint64_t
+spread_bits(uint64_t v)
+{
+  v &= 0x1fffff;
+  v = (v | (v << 32)) & 0x1f00000000ffffull;
+  v = (v | (v << 16)) & 0x1f0000ff0000ffull;
+  v = (v | (v << 8)) & 0x100f00f00f00f00full;
+  v = (v | (v << 4)) & 0x10c30c30c30c30c3ull;
+  v = (v | (v << 2)) & 0x1249249249249249ull;
+  return v;
+}
+
+uint32_t
+compact_bits(uint64_t v)
+{
+  v &= 0x1249249249249249ull;
+  v = (v ^ (v >> 2)) & 0x10c30c30c30c30c3ull;
+  v = (v ^ (v >> 4)) & 0x100f00f00f00f00full;
+  v = (v ^ (v >> 8)) & 0x1f0000ff0000ffull;
+  v = (v ^ (v >> 16)) & 0x1f00000000ffffull;
+  v = (v ^ (v >> 32)) & 0x1fffff;
+  return static_cast<uint32_t>(v);
+}
+
+uint64_t
+morton_key(uint32_t x, uint32_t y, uint32_t z)
+{
+  return spread_bits(x) | (spread_bits(y) << 1) | (spread_bits(z) << 2);
+}
+
+size_t
+next_power_of_two(size_t n)
+{
+  size_t p = 1;
+  while (p < n)
+    p <<= 1;
+  return p;
+}
+
+/** @brief An open addressing set of voxel keys that many threads may insert into at once.
+ * */
+class VoxelTable final
+{
+public:
+  explicit VoxelTable(size_t capacity)
+    : keys_(next_power_of_two(std::max<size_t>(capacity * 2, 1024)))
+    , colors_(keys_.size())
+    , mask_(keys_.size() - 1)
+  {
+    for (auto& key : keys_)
+      key.store(g_empty_key, std::memory_order_relaxed);
+  }
+
+  /** @brief Adds a key, unless it is already in the table. The thread that adds it also sets its color.
+   * */
+  void insert(uint64_t key, uint32_t rgba)
+  {
+    for (size_t slot = hash(key);; slot = (slot + 1) & mask_) {
+
+      uint64_t existing = keys_[slot].load(std::memory_order_relaxed);
+
+      if (existing == key)
+        return;
+
+      if ((existing == g_empty_key) &&
+          keys_[slot].compare_exchange_strong(existing, key, std::memory_order_relaxed)) {
+        colors_[slot] = rgba;
+        return;
+      }
+
+      // Another thread may have claimed the slot for the same key.
+      if (existing == key)
+        return;
+    }
+  }
+
+  /** @brief Checks for a key. This may only be called once all insertions are done.
+   * */
+  bool contains(uint64_t key) const
+  {
+    for (size_t slot = hash(key);; slot = (slot + 1) & mask_) {
+
+      const uint64_t existing = keys_[slot].load(std::memory_order_relaxed);
+
+      if (existing == key)
+        return true;
+
+      if (existing == g_empty_key)
+        return false;
+    }
+  }
+
+  size_t size() const { return keys_.size(); }
+
+  uint64_t key(size_t slot) const { return keys_[slot].load(std::memory_order_relaxed); }
+
+  uint32_t color(size_t slot) const { return colors_[slot]; }
+
+private:
+  size_t hash(uint64_t key) const { return static_cast<size_t>((key * 0x9e3779b97f4a7c15ull) >> 17) & mask_; }
+
+private:
+  std::vector<std::atomic<uint64_t>> keys_;
+
+  std::vector<uint32_t> colors_;
+
+  size_t mask_ = 0;
+};
+
+} // namespace
+
+bool
+build_voxels(const dataviz_vertex_z* points, size_t count, float voxel_size, std::vector<VoxelInstance>& voxels)
+{
+  DATVIZ_PERF_SCOPE("voxel_build");
+
+  voxels.clear();
+
+  if (count == 0)
+    return true;
+
+  struct Bounds final
+  {
+    float min[3]{ std::numeric_limits<float>::max(),
+                  std::numeric_limits<float>::max(),
+                  std::numeric_limits<float>::max() };
+
+    float max[3]{ -std::numeric_limits<float>::max(),
+                  -std::numeric_limits<float>::max(),
+                  -std::numeric_limits<float>::max() };
+  };
+
+  std::vector<Bounds> partial(block_count(count, g_grain));
+
+  parallel_for(count, g_grain, [&](size_t begin, size_t end) {
+    Bounds b;
+    for (size_t i = begin; i < end; i++) {
+      const float p[3]{ points[i].x, points[i].y, points[i].z };
+      for (int j = 0; j < 3; j++) {
+        b.min[j] = std::min(b.min[j], p[j]);
+        b.max[j] = std::max(b.max[j], p[j]);
+      }
+    }
+    partial[begin / g_grain] = b;
+  });
+
+  Bounds bounds;
+
+  for (const auto& b : partial) {
+    for (int j = 0; j < 3; j++) {
+      bounds.min[j] = std::min(bounds.min[j], b.min[j]);
+      bounds.max[j] = std::max(bounds.max[j], b.max[j]);
+    }
+  }
+
+  const float inv_voxel_size = 1.0f / voxel_size;
+
+  // The table never needs more room than there are voxels in the bounds.
+  double voxels_in_bounds = 1;
+
+  for (int j = 0; j < 3; j++) {
+
+    const double cells = std::floor(double(bounds.max[j] - bounds.min[j]) * double(inv_voxel_size)) + 1.0;
+
+    if (cells > double(g_max_coordinate) + 1.0)
+      return false;
+
+    voxels_in_bounds *= cells;
+  }
+
+  VoxelTable table(static_cast<size_t>(std::min(voxels_in_bounds, double(count))));
+
+  const float* origin = bounds.min;
+
+  auto coordinate = [&](float v, int axis) {
+    return std::min(static_cast<uint32_t>((v - origin[axis]) * inv_voxel_size), g_max_coordinate);
+  };
+
+  parallel_for(count, g_grain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+
+      const auto& p = points[i];
+
+      const uint64_t key = morton_key(coordinate(p.x, 0), coordinate(p.y, 1), coordinate(p.z, 2));
+
+      const uint32_t rgba = uint32_t(p.r) | (uint32_t(p.g) << 8) | (uint32_t(p.b) << 16) | (uint32_t(p.a) << 24);
+
+      table.insert(key, rgba);
+    }
+  });
+
+  // Find the open faces of each voxel, and count the voxels that have any, so they can be written out in parallel.
+  std::vector<unsigned char> faces(table.size(), 0);
+
+  const size_t slot_grain = 65536;
+
+  std::vector<size_t> offsets(block_count(table.size(), slot_grain) + 1, 0);
+
+  parallel_for(table.size(), slot_grain, [&](size_t begin, size_t end) {
+    size_t visible = 0;
+
+    for (size_t slot = begin; slot < end; slot++) {
+
+      const uint64_t key = table.key(slot);
+      if (key == g_empty_key)
+        continue;
+
+      const uint32_t c[3]{ compact_bits(key), compact_bits(key >> 1), compact_bits(key >> 2) };
+
+      unsigned char mask = 0;
+
+      for (int axis = 0; axis < 3; axis++) {
+        for (int side = 0; side < 2; side++) {
+
+          uint32_t n[3]{ c[0], c[1], c[2] };
+
+          const bool at_edge = side ? (n[axis] == g_max_coordinate) : (n[axis] == 0);
+
+          n[axis] = side ? (n[axis] + 1) : (n[axis] - 1);
+
+          if (at_edge || !table.contains(morton_key(n[0], n[1], n[2])))
+            mask |= static_cast<unsigned char>(1 << ((axis * 2) + side));
+        }
+      }
+
+      faces[slot] = mask;
+
+      visible += (mask != 0);
+    }
+
+    offsets[(begin / slot_grain) + 1] = visible;
+  });
+
+  for (size_t i = 1; i < offsets.size(); i++)
+    offsets[i] += offsets[i - 1];
+
+  voxels.resize(offsets.back());
+
+  parallel_for(table.size(), slot_grain, [&](size_t begin, size_t end) {
+    size_t out = offsets[begin / slot_grain];
+
+    for (size_t slot = begin; slot < end; slot++) {
+
+      if (faces[slot] == 0)
+        continue;
+
+      const uint64_t key = table.key(slot);
+
+      const uint32_t rgba = table.color(slot);
+
+      auto& v = voxels[out++];
+
+      v.position[0] = origin[0] + (float(compact_bits(key)) * voxel_size);
+      v.position[1] = origin[1] + (float(compact_bits(key >> 1)) * voxel_size);
+      v.position[2] = origin[2] + (float(compact_bits(key >> 2)) * voxel_size);
+
+      for (int j = 0; j < 4; j++)
+        v.rgba[j] = static_cast<unsigned char>(rgba >> (j * 8));
+
+      v.faces = faces[slot];
+
+      v.padding[0] = 0;
+      v.padding[1] = 0;
+      v.padding[2] = 0;
+    }
+  });
+
+  return true;
+}
+
+} // namespace datviz_detail
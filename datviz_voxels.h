@@ -0,0 +1,47 @@
+/// @file datviz_voxels.h
+///
+/// @brief Internal construction of sparse voxel sets from point clouds.
+
+#pragma once
+
+#include "datviz.h"
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace datviz_detail {
+
+/// The number of bits per axis in a voxel key, which limits a voxel set to this many voxels along each axis.
+constexpr int g_voxel_key_bits = 21;
+
+/** @brief An occupied voxel, as it is uploaded to the instance buffer.
+ * */
+struct VoxelInstance final
+{
+  /// The corner of the voxel with the lowest coordinates.
+  float position[3];
+
+  unsigned char rgba[4];
+
+  /// One bit per face, set when the face is not covered by a neighboring voxel.
+  /// The bits are ordered -X, +X, -Y, +Y, -Z, +Z, starting from the least significant bit.
+  unsigned char faces;
+
+  unsigned char padding[3];
+};
+
+static_assert(sizeof(VoxelInstance) == 20, "Voxel instances must be tightly packed.");
+
+/** @brief Finds the voxels that contain points, along with the faces of each voxel that could be visible.
+ *
+ * @details The voxels are found with a parallel hash table of Morton keys. Each voxel takes the color of one of the
+ *          points in it. Voxels that are surrounded on all six sides cannot be seen and are left out.
+ *
+ * @return False if the points span more than 2^21 voxels along an axis.
+ * */
+bool
+build_voxels(const dataviz_vertex_z* points, size_t count, float voxel_size, std::vector<VoxelInstance>& voxels);
+
+} // namespace datviz_detail
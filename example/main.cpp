@@ -4,6 +4,8 @@
 
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <random>
 #include <vector>
@@ -42,15 +44,26 @@ public:
 
   const dataviz_vertex_z* data() const { return particles_.data(); }
 
+  const float* velocity() const { return glm::value_ptr(velocity_[0]); }
+
+  float max_speed() const
+  {
+    float max_speed_squared = 0;
+    for (const auto& v : velocity_)
+      max_speed_squared = std::max(max_speed_squared, glm::dot(v, v));
+    return std::sqrt(max_speed_squared);
+  }
+
   size_t size() const { return particles_.size() / 6; }
 
   void step(float time_delta, const float gravity = 1.0e-9, const float smooth = 1.0e-3)
   {
     const std::size_t particle_count = size();
 
-    std::vector<dataviz_vertex_z> next_particles(particle_count);
+    // Only the first particles are simulated, the rest keep their state.
+    std::vector<dataviz_vertex_z> next_particles(particles_);
 
-    std::vector<glm::vec3> next_velocity(particle_count);
+    std::vector<glm::vec3> next_velocity(velocity_);
 
     for (size_t i = 0; i < particle_count; i++) {
 
@@ -147,17 +160,40 @@ main()
 
   datviz_set_perspective(viewer, glm::radians(45.0f), 0.01f, 10.0f);
 
+  // The force kernel is measured like the kernels of the library, when it is built with performance counters.
+  const std::uint32_t step_region = datviz_perf_region("example_force_kernel");
+
   while (!datviz_should_close(viewer)) {
 
     datviz_begin_frame(viewer);
 
     datviz_render_points(viewer, major_system.data(), point_count);
 
+    // The velocities are tiny, so the arrows are scaled for the fastest particle to be 0.2 units long, which is a tenth
+    // of the width of the cube that the particles start in.
+    const float max_speed = major_system.max_speed();
+
+    if (max_speed > 0)
+      datviz_render_vector_field(
+        viewer, major_system.data(), major_system.velocity(), point_count, 1, 0.2f / max_speed);
+
     datviz_end_frame(viewer);
 
     datviz_poll_input(viewer);
 
+    dataviz_perf_scope_z step_scope;
+
+    datviz_perf_begin(step_region, &step_scope);
+
     major_system.step(1);
+
+    datviz_perf_end(&step_scope);
+  }
+
+  // Setting DATAVIZ_PERF_JSON to a path writes the counts of every measured region there on exit.
+  if (const char* perf_path = std::getenv("DATAVIZ_PERF_JSON")) {
+    if (datviz_write_perf_counters_json(perf_path) != 0)
+      std::cerr << "Failed to write performance counters to " << perf_path << std::endl;
   }
 
   datviz_destroy(viewer);
@@ -0,0 +1,417 @@
+#include <dataviz_raii.hpp>
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+
+#include <stdexcept>
+#include <string>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace py = pybind11;
+
+//================//
+// Array Checking //
+//================//
+
+namespace {
+
+/// A structured array of vertices. Arrays are never converted, since converting them would mean copying them.
+using PointArray = py::array_t<dataviz_vertex, py::array::c_style>;
+
+using FloatArray = py::array_t<float>;
+
+using ByteArray = py::array_t<uint8_t>;
+
+uint32_t
+checked_count(size_t count)
+{
+  if (count > UINT32_MAX)
+    throw py::value_error("too many points, the limit is " + std::to_string(UINT32_MAX));
+
+  return uint32_t(count);
+}
+
+/** @brief Gets the byte stride between the points of an array, in the form that @ref dataviz_point_columns takes.
+ *
+ * @details The first dimension of the array must be the points. Any others are left to the caller to check.
+ * */
+uint32_t
+point_stride(const py::array& column, size_t count, const char* name)
+{
+  if (size_t(column.shape(0)) != count)
+    throw py::value_error(std::string(name) + " must have as many elements as x");
+
+  // The stride of a column with less than two elements is never used.
+  if (count < 2)
+    return 0;
+
+  if ((column.strides(0) <= 0) || (column.strides(0) > py::ssize_t(UINT32_MAX)))
+    throw py::value_error(std::string(name) + " must have a positive stride");
+
+  return uint32_t(column.strides(0));
+}
+
+/** @brief Gets the byte stride of a one dimensional column.
+ * */
+uint32_t
+column_stride(const py::array& column, size_t count, const char* name)
+{
+  if (column.ndim() != 1)
+    throw py::value_error(std::string(name) + " must be one dimensional");
+
+  return point_stride(column, count, name);
+}
+
+/** @brief Describes NumPy columns of points to the library, without copying them.
+ *
+ * @param rgba Either None, or an array of bytes with four channels per point.
+ * */
+dataviz_point_columns
+borrow_columns(const FloatArray& x, const FloatArray& y, const FloatArray& z, const py::object& rgba, uint32_t& count)
+{
+  count = checked_count(size_t(x.size()));
+
+  dataviz_point_columns columns{};
+
+  columns.x = x.data();
+  columns.y = y.data();
+  columns.z = z.data();
+  columns.x_stride = column_stride(x, count, "x");
+  columns.y_stride = column_stride(y, count, "y");
+  columns.z_stride = column_stride(z, count, "z");
+
+  if (rgba.is_none())
+    return columns;
+
+  if (!py::isinstance<ByteArray>(rgba))
+    throw py::type_error("rgba must be None or an array of uint8");
+
+  const auto colors = py::reinterpret_borrow<ByteArray>(rgba);
+
+  if ((colors.ndim() != 2) || (colors.shape(1) != 4) || (colors.strides(1) != 1))
+    throw py::value_error("rgba must have a shape of (n, 4), with the channels of each point next to each other");
+
+  columns.rgba = colors.data();
+  columns.rgba_stride = point_stride(colors, count, "rgba");
+
+  return columns;
+}
+
+} // namespace
+
+//==================//
+// Library Lifetime //
+//==================//
+
+namespace {
+
+/** @brief Defers the global cleanup of the library until every viewer and cloud made from Python is gone.
+ *
+ * @details Objects held by module globals are only destroyed after the exit handlers have run, and destroying them
+ *          makes GL calls that must come before the cleanup. These are only touched with the GIL held.
+ * */
+struct LibraryLifetime final
+{
+  size_t live_handles = 0;
+
+  bool exiting = false;
+
+  void release_handle()
+  {
+    live_handles--;
+
+    if (exiting && (live_handles == 0))
+      datviz_global_cleanup();
+  }
+
+  void exit()
+  {
+    exiting = true;
+
+    if (live_handles == 0)
+      datviz_global_cleanup();
+  }
+};
+
+LibraryLifetime g_lifetime;
+
+/** @brief Keeps the library from being cleaned up while it is alive.
+ *
+ * @details This must be the first member of the object that holds it, so that it is destroyed last.
+ * */
+class LibraryHandle final
+{
+public:
+  LibraryHandle() { g_lifetime.live_handles++; }
+
+  ~LibraryHandle() { g_lifetime.release_handle(); }
+
+  LibraryHandle(const LibraryHandle&) = delete;
+
+  LibraryHandle& operator=(const LibraryHandle&) = delete;
+};
+
+} // namespace
+
+//==========//
+// Bindings //
+//==========//
+
+namespace {
+
+/** @brief A viewer window, as it is seen from Python.
+ *
+ * @details Columns of points can only be drawn from a retained cloud, so the viewer keeps one around for drawing
+ *          columns that are passed to @ref render_points.
+ * */
+class ViewerBinding final
+{
+public:
+  ViewerBinding()
+  {
+    if (!viewer_)
+      throw std::runtime_error("failed to create the viewer");
+  }
+
+  dataviz::Viewer& viewer() { return viewer_; }
+
+  bool should_close() const { return viewer_.should_close(); }
+
+  void poll_input()
+  {
+    py::gil_scoped_release release;
+
+    viewer_.poll_input();
+  }
+
+  void begin_frame()
+  {
+    py::gil_scoped_release release;
+
+    viewer_.begin_frame();
+  }
+
+  void end_frame()
+  {
+    // Swapping buffers may block until the next vertical blank, which other Python threads should not wait on.
+    py::gil_scoped_release release;
+
+    viewer_.end_frame();
+  }
+
+  void render_points(const PointArray& points)
+  {
+    const auto* data = points.data();
+
+    const uint32_t count = checked_count(size_t(points.size()));
+
+    py::gil_scoped_release release;
+
+    viewer_.render_points(dataviz::VertexSpan(data, count));
+  }
+
+  void render_columns(const FloatArray& x, const FloatArray& y, const FloatArray& z, const py::object& rgba)
+  {
+    uint32_t count = 0;
+
+    const auto columns = borrow_columns(x, y, z, rgba, count);
+
+    if (!scratch_)
+      scratch_ = dataviz::Cloud(viewer_);
+
+    py::gil_scoped_release release;
+
+    if (scratch_.upload(columns, count))
+      scratch_.render();
+  }
+
+  void set_window_title(const std::string& title) { datviz_set_window_title(viewer_.get(), title.c_str()); }
+
+  void set_background(float r, float g, float b, float a) { datviz_set_background(viewer_.get(), r, g, b, a); }
+
+  void set_perspective(float fovy, float near, float far) { datviz_set_perspective(viewer_.get(), fovy, near, far); }
+
+private:
+  LibraryHandle handle_;
+
+  dataviz::Viewer viewer_;
+
+  dataviz::Cloud scratch_;
+};
+
+/** @brief A retained point cloud, as it is seen from Python.
+ * */
+class CloudBinding final
+{
+public:
+  explicit CloudBinding(ViewerBinding& viewer)
+    : cloud_(viewer.viewer())
+  {
+    if (!cloud_)
+      throw std::runtime_error("failed to create the cloud");
+  }
+
+  void upload(const PointArray& points)
+  {
+    const auto* data = points.data();
+
+    const uint32_t count = checked_count(size_t(points.size()));
+
+    bool success = false;
+
+    {
+      py::gil_scoped_release release;
+
+      success = cloud_.upload(dataviz::VertexSpan(data, count));
+    }
+
+    if (!success)
+      throw std::runtime_error("failed to upload the points");
+  }
+
+  void upload_columns(const FloatArray& x, const FloatArray& y, const FloatArray& z, const py::object& rgba)
+  {
+    uint32_t count = 0;
+
+    const auto columns = borrow_columns(x, y, z, rgba, count);
+
+    bool success = false;
+
+    {
+      py::gil_scoped_release release;
+
+      success = cloud_.upload(columns, count);
+    }
+
+    if (!success)
+      throw std::runtime_error("failed to upload the points");
+  }
+
+  void append(const PointArray& points)
+  {
+    const auto* data = points.data();
+
+    const uint32_t count = checked_count(size_t(points.size()));
+
+    bool success = false;
+
+    {
+      py::gil_scoped_release release;
+
+      success = cloud_.append(dataviz::VertexSpan(data, count));
+    }
+
+    if (!success)
+      throw std::runtime_error("failed to append the points");
+  }
+
+  void append_columns(const FloatArray& x, const FloatArray& y, const FloatArray& z, const py::object& rgba)
+  {
+    uint32_t count = 0;
+
+    const auto columns = borrow_columns(x, y, z, rgba, count);
+
+    bool success = false;
+
+    {
+      py::gil_scoped_release release;
+
+      success = cloud_.append(columns, count);
+    }
+
+    if (!success)
+      throw std::runtime_error("failed to append the points");
+  }
+
+  void reserve(uint32_t capacity)
+  {
+    if (!cloud_.reserve(capacity))
+      throw std::runtime_error("failed to reserve space for the points");
+  }
+
+  void clear() { cloud_.clear(); }
+
+  uint32_t size() const { return cloud_.size(); }
+
+  void render()
+  {
+    py::gil_scoped_release release;
+
+    cloud_.render();
+  }
+
+  void render_slab(float min, float max)
+  {
+    py::gil_scoped_release release;
+
+    cloud_.render_slab(min, max);
+  }
+
+private:
+  LibraryHandle handle_;
+
+  dataviz::Cloud cloud_;
+};
+
+} // namespace
+
+PYBIND11_MODULE(datviz, m)
+{
+  m.doc() = "Interactive point cloud rendering, straight from NumPy arrays.";
+
+  PYBIND11_NUMPY_DTYPE(dataviz_vertex, x, y, z, r, g, b, a);
+
+  m.attr("vertex_dtype") = py::dtype::of<dataviz_vertex>();
+
+  if (datviz_global_init() != 0)
+    throw std::runtime_error("failed to initialize the library");
+
+  py::module_::import("atexit").attr("register")(py::cpp_function([]() { g_lifetime.exit(); }));
+
+  // Arrays are never converted, so an array of the wrong type is an error instead of a silent copy.
+  py::class_<ViewerBinding>(m, "Viewer", "A window that point clouds are rendered onto.")
+    .def(py::init<>())
+    .def("should_close", &ViewerBinding::should_close)
+    .def("poll_input", &ViewerBinding::poll_input)
+    .def("begin_frame", &ViewerBinding::begin_frame)
+    .def("end_frame", &ViewerBinding::end_frame)
+    .def("render_points",
+         &ViewerBinding::render_points,
+         "Renders a structured array of vertex_dtype for one frame.",
+         py::arg("points").noconvert())
+    .def("render_points",
+         &ViewerBinding::render_columns,
+         "Renders columns of float32 positions and optional (n, 4) uint8 colors for one frame.",
+         py::arg("x").noconvert(),
+         py::arg("y").noconvert(),
+         py::arg("z").noconvert(),
+         py::arg("rgba") = py::none())
+    .def("set_window_title", &ViewerBinding::set_window_title)
+    .def("set_background", &ViewerBinding::set_background, py::arg("r"), py::arg("g"), py::arg("b"), py::arg("a") = 1)
+    .def("set_perspective", &ViewerBinding::set_perspective, py::arg("fovy"), py::arg("near"), py::arg("far"));
+
+  // Clouds keep their viewer alive, since they must be destroyed before it.
+  py::class_<CloudBinding>(m, "Cloud", "A point cloud kept in GPU memory.")
+    .def(py::init<ViewerBinding&>(), py::keep_alive<1, 2>(), py::arg("viewer"))
+    .def("upload", &CloudBinding::upload, py::arg("points").noconvert())
+    .def("upload",
+         &CloudBinding::upload_columns,
+         py::arg("x").noconvert(),
+         py::arg("y").noconvert(),
+         py::arg("z").noconvert(),
+         py::arg("rgba") = py::none())
+    .def("append", &CloudBinding::append, py::arg("points").noconvert())
+    .def("append",
+         &CloudBinding::append_columns,
+         py::arg("x").noconvert(),
+         py::arg("y").noconvert(),
+         py::arg("z").noconvert(),
+         py::arg("rgba") = py::none())
+    .def("reserve", &CloudBinding::reserve, py::arg("capacity"))
+    .def("clear", &CloudBinding::clear)
+    .def("__len__", &CloudBinding::size)
+    .def("render", &CloudBinding::render)
+    .def("render_slab", &CloudBinding::render_slab, py::arg("min"), py::arg("max"));
+}
@@ -0,0 +1,60 @@
+"""Tests for the Python bindings, which need a display to open a viewer on.
+
+Run with the built module on the path, such as with:
+
+    PYTHONPATH=build python3 -m pytest python/test_datviz.py
+"""
+
+import numpy as np
+import pytest
+
+import datviz
+
+
+@pytest.fixture(scope="module")
+def viewer():
+    try:
+        return datviz.Viewer()
+    except RuntimeError:
+        pytest.skip("no display to open a viewer on")
+
+
+def columns(count):
+    rng = np.random.default_rng(0)
+    x, y, z = (rng.uniform(-1, 1, count).astype(np.float32) for _ in range(3))
+    rgba = rng.integers(0, 256, (count, 4), dtype=np.uint8)
+    return x, y, z, rgba
+
+
+def test_render_points_with_colors(viewer):
+    x, y, z, rgba = columns(1000)
+    viewer.begin_frame()
+    viewer.render_points(x, y, z, rgba)
+    viewer.end_frame()
+
+
+def test_upload_and_append_with_colors(viewer):
+    x, y, z, rgba = columns(1000)
+    cloud = datviz.Cloud(viewer)
+    cloud.upload(x, y, z, rgba)
+    cloud.append(x, y, z, rgba)
+    assert len(cloud) == 2000
+
+
+def test_colors_may_be_a_slice_of_a_larger_array(viewer):
+    x, y, z, rgba = columns(1000)
+    cloud = datviz.Cloud(viewer)
+    cloud.upload(x[::2], y[::2], z[::2], rgba[::2])
+    assert len(cloud) == 500
+
+
+def test_colors_must_have_four_channels(viewer):
+    x, y, z, _ = columns(10)
+    with pytest.raises(ValueError):
+        viewer.render_points(x, y, z, np.zeros((10, 3), dtype=np.uint8))
+
+
+def test_colors_must_match_the_positions(viewer):
+    x, y, z, _ = columns(10)
+    with pytest.raises(ValueError):
+        viewer.render_points(x, y, z, np.zeros((9, 4), dtype=np.uint8))
@@ -0,0 +1,102 @@
+#include <datviz.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+#include <cstdlib>
+
+namespace {
+
+void
+print_usage(const char* program)
+{
+  std::cerr << "usage: " << program << " [--real-time] [--visible] [--repeat N] [--perf-json PATH] CAPTURE"
+            << std::endl;
+  std::cerr << std::endl;
+  std::cerr << "Replays a capture made with datviz_capture_begin, or with the DATAVIZ_CAPTURE environment variable."
+            << std::endl;
+  std::cerr << "Calls are made as fast as possible into a hidden window, unless asked otherwise." << std::endl;
+}
+
+void
+print_stats(const dataviz_replay_stats_z& stats)
+{
+  std::cout << "frames:        " << stats.frames << std::endl;
+  std::cout << "calls:         " << stats.calls << " (" << stats.skipped_calls << " skipped)" << std::endl;
+  std::cout << "seconds:       " << stats.seconds << std::endl;
+  std::cout << "mean frame ms: " << stats.mean_frame_ms << std::endl;
+  std::cout << "max frame ms:  " << stats.max_frame_ms << std::endl;
+}
+
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+  int flags = DATVIZ_REPLAY_HEADLESS;
+
+  int repeat = 1;
+
+  const char* perf_json = nullptr;
+
+  const char* capture = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+
+    const std::string arg(argv[i]);
+
+    if (arg == "--real-time") {
+      flags |= DATVIZ_REPLAY_REAL_TIME;
+    } else if (arg == "--visible") {
+      flags &= ~DATVIZ_REPLAY_HEADLESS;
+    } else if ((arg == "--repeat") && ((i + 1) < argc)) {
+      repeat = std::max(std::atoi(argv[++i]), 1);
+    } else if ((arg == "--perf-json") && ((i + 1) < argc)) {
+      perf_json = argv[++i];
+    } else if (!capture && (arg[0] != '-')) {
+      capture = argv[i];
+    } else {
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!capture) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (datviz_global_init() != 0) {
+    std::cerr << "Failed to initialize the library." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  int result = EXIT_SUCCESS;
+
+  // The first runs warm up the driver and the caches, so comparisons between versions should use the later ones.
+  for (int run = 0; run < repeat; run++) {
+
+    dataviz_replay_stats_z stats{};
+
+    if (datviz_replay_capture(capture, flags, &stats) != 0) {
+      std::cerr << "Failed to replay " << capture << ", it is either missing or damaged." << std::endl;
+      result = EXIT_FAILURE;
+      break;
+    }
+
+    if (repeat > 1)
+      std::cout << "run " << (run + 1) << " of " << repeat << std::endl;
+
+    print_stats(stats);
+  }
+
+  if (perf_json && (datviz_write_perf_counters_json(perf_json) != 0)) {
+    std::cerr << "Failed to write performance counters to " << perf_json << std::endl;
+    result = EXIT_FAILURE;
+  }
+
+  datviz_global_cleanup();
+
+  return result;
+}